@@ -53,6 +53,7 @@
 #include "Config.h"
 #include "DynamicString.h"
 #include "FileInfo.h"
+#include "HashTable.h"
 #include "Locale.h"
 #include "Logfile.h"
 #include "Requesters.h"
@@ -61,6 +62,12 @@
 #include "Debug.h"
 
 static void ClearABookGroup(struct ABookNode *group);
+static void DropABookIndexes(struct ABook *abook);
+
+// bumped whenever nodes are added to or removed from any address book,
+// the indexes of an address book are rebuilt on demand if their generation
+// does not match anymore
+static ULONG abookGeneration = 1;
 
 /// CreateABookNode
 struct ABookNode *CreateABookNode(enum ABookNodeType type)
@@ -127,6 +134,8 @@ void AddABookNode(struct ABookNode *group, struct ABookNode *member, struct ABoo
   else
     Insert((struct List *)&group->GroupMembers, (struct Node *)member, (struct Node *)afterThis);
 
+  abookGeneration++;
+
   LEAVE();
 }
 
@@ -138,6 +147,8 @@ void RemoveABookNode(struct ABookNode *member)
 
   Remove((struct Node *)member);
 
+  abookGeneration++;
+
   LEAVE();
 }
 
@@ -228,8 +239,10 @@ BOOL CompareABookNodes(const struct ABookNode *abn1, const struct ABookNode *abn
 }
 
 ///
-/// InitABook
-void InitABook(struct ABook *abook, const char *name)
+/// ResetABook
+// reset an address book to an empty root group, the indexes and their
+// semaphore are left untouched
+static void ResetABook(struct ABook *abook, const char *name)
 {
   ENTER();
 
@@ -240,6 +253,24 @@ void InitABook(struct ABook *abook, const char *name)
   LEAVE();
 }
 
+///
+/// InitABook
+void InitABook(struct ABook *abook, const char *name)
+{
+  ENTER();
+
+  ResetABook(abook, name);
+  abook->addressIndex = NULL;
+  abook->aliasIndex = NULL;
+  abook->indexGeneration = 0;
+
+  // the semaphore structure must be cleared before InitSemaphore()
+  memset(&abook->indexSemaphore, 0, sizeof(abook->indexSemaphore));
+  InitSemaphore(&abook->indexSemaphore);
+
+  LEAVE();
+}
+
 ///
 /// ClearABookGroup
 static void ClearABookGroup(struct ABookNode *group)
@@ -266,8 +297,10 @@ void ClearABook(struct ABook *abook)
 {
   ENTER();
 
+  DropABookIndexes(abook);
   ClearABookGroup(&abook->rootGroup);
-  InitABook(abook, NULL);
+  // don't use InitABook() here, another thread might wait for the semaphore
+  ResetABook(abook, NULL);
 
   LEAVE();
 }
@@ -280,9 +313,291 @@ void MoveABookNodes(struct ABook *dst, struct ABook *src)
 
   MoveList((struct List *)&dst->rootGroup.GroupMembers, (struct List *)&src->rootGroup.GroupMembers);
 
+  DropABookIndexes(src);
+  abookGeneration++;
+
+  LEAVE();
+}
+
+///
+
+// an entry of the address and alias indexes of an address book, the layout
+// of the first two members must match struct HashEntry. Most addresses and
+// aliases are unique and need no further allocation.
+struct ABookIndexEntry
+{
+  struct HashEntryHeader header;
+  void *key;               // the indexed string of the first node
+  ULONG count;             // number of nodes with this string
+  ULONG size;              // number of slots in 'more'
+  struct ABookNode *first; // the first node with this string
+  struct ABookNode **more; // all further nodes with this string
+};
+
+/// ABookIndexHashKey
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static ULONG ABookIndexHashKey(UNUSED struct HashTable *table, const void *key)
+{
+  const unsigned char *s = (const unsigned char *)key;
+  ULONG h = 0;
+
+  // hash the lower case characters only, this way all strings which are
+  // equal for Stricmp() end up with the same hash value
+  for(; *s != '\0'; s++)
+    h = (h >> (HASH_BITS - 4)) ^ (h << 4) ^ (UBYTE)ToLower((ULONG)*s);
+
+  return h;
+}
+
+///
+/// ABookIndexMatchEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static BOOL ABookIndexMatchEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry, const void *key)
+{
+  return (Stricmp(((const struct ABookIndexEntry *)entry)->key, key) == 0);
+}
+
+///
+/// ABookIndexClearEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void ABookIndexClearEntry(struct HashTable *table, struct HashEntryHeader *entry)
+{
+  struct ABookIndexEntry *indexEntry = (struct ABookIndexEntry *)entry;
+
+  free(indexEntry->more);
+  memset(entry, 0, table->entrySize);
+}
+
+///
+/// ABookIndexDestroyEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void ABookIndexDestroyEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  struct ABookIndexEntry *indexEntry = (struct ABookIndexEntry *)entry;
+
+  free(indexEntry->more);
+}
+
+///
+/// abookIndexOps
+static const struct HashTableOps abookIndexOps =
+{
+  DefaultHashAllocTable,
+  DefaultHashFreeTable,
+  DefaultHashGetKey,
+  ABookIndexHashKey,
+  ABookIndexMatchEntry,
+  DefaultHashMoveEntry,
+  ABookIndexClearEntry,
+  DefaultHashFinalize,
+  NULL,
+  ABookIndexDestroyEntry
+};
+
+///
+/// DropABookIndexes
+// throw away the indexes of an address book, they are rebuilt on demand
+static void DropABookIndexes(struct ABook *abook)
+{
+  ENTER();
+
+  ObtainSemaphore(&abook->indexSemaphore);
+
+  if(abook->addressIndex != NULL)
+  {
+    HashTableDestroy(abook->addressIndex);
+    abook->addressIndex = NULL;
+  }
+  if(abook->aliasIndex != NULL)
+  {
+    HashTableDestroy(abook->aliasIndex);
+    abook->aliasIndex = NULL;
+  }
+  abook->indexGeneration = 0;
+
+  ReleaseSemaphore(&abook->indexSemaphore);
+
+  LEAVE();
+}
+
+///
+/// InvalidateABookIndexes
+// must be called whenever the address or alias of a node which is part of
+// the address book was modified in place
+void InvalidateABookIndexes(struct ABook *abook)
+{
+  ENTER();
+
+  DropABookIndexes(abook);
+
   LEAVE();
 }
 
+///
+/// AddABookIndexEntry
+// add a node to one of the indexes of an address book
+static BOOL AddABookIndexEntry(struct HashTable *table, const char *key, struct ABookNode *abn)
+{
+  struct ABookIndexEntry *entry;
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if((entry = (struct ABookIndexEntry *)HashTableOperate(table, key, htoAdd)) != NULL)
+  {
+    if(entry->count == 0)
+    {
+      // a new entry
+      entry->key = (void *)key;
+      entry->first = abn;
+      entry->count = 1;
+      success = TRUE;
+    }
+    else
+    {
+      // a duplicate, remember it in the overflow array
+      if(entry->count > entry->size)
+      {
+        ULONG newSize = (entry->size == 0) ? 4 : entry->size * 2;
+        struct ABookNode **newMore;
+
+        if((newMore = realloc(entry->more, newSize * sizeof(*newMore))) != NULL)
+        {
+          entry->more = newMore;
+          entry->size = newSize;
+        }
+      }
+
+      if(entry->count <= entry->size)
+      {
+        entry->more[entry->count-1] = abn;
+        entry->count++;
+        success = TRUE;
+      }
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// IndexABookEntry
+static BOOL IndexABookEntry(const struct ABookNode *abn, UNUSED ULONG flags, void *userData)
+{
+  struct ABook *abook = (struct ABook *)userData;
+  BOOL result = FALSE;
+
+  ENTER();
+
+  if(AddABookIndexEntry(abook->addressIndex, abn->Address, (struct ABookNode *)abn) == TRUE &&
+     AddABookIndexEntry(abook->aliasIndex, abn->Alias, (struct ABookNode *)abn) == TRUE)
+  {
+    result = TRUE;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// BuildABookIndexes
+// build the address and alias indexes of an address book, the nodes are
+// added in the same order as IterateABook() visits them. The index semaphore
+// must be held by the caller.
+static BOOL BuildABookIndexes(struct ABook *abook)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  DropABookIndexes(abook);
+
+  if((abook->addressIndex = HashTableNew(&abookIndexOps, NULL, sizeof(struct ABookIndexEntry), 128)) != NULL &&
+     (abook->aliasIndex = HashTableNew(&abookIndexOps, NULL, sizeof(struct ABookIndexEntry), 128)) != NULL)
+  {
+    if(IterateABook(abook, 0, IndexABookEntry, abook) == TRUE)
+    {
+      abook->indexGeneration = abookGeneration;
+      success = TRUE;
+    }
+  }
+
+  if(success == FALSE)
+  {
+    E(DBF_ABOOK, "failed to build indexes of address book %08lx", abook);
+    DropABookIndexes(abook);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// SearchABookIndex
+// search the address or alias index of an address book with the same
+// semantics as an exact search by SearchABook(), returns FALSE if the
+// index could not be used and the address book must be searched the
+// traditional way
+static BOOL SearchABookIndex(struct ABook *abook, const char *text, ULONG mode, struct ABookNode **abn, ULONG *hits)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  // the spam classifier threads look up addresses as well, so building,
+  // using and dropping the indexes must not overlap
+  ObtainSemaphore(&abook->indexSemaphore);
+
+  if(abook->indexGeneration == abookGeneration || BuildABookIndexes(abook) == TRUE)
+  {
+    struct HashTable *table = isAliasSearch(mode) == TRUE ? abook->aliasIndex : abook->addressIndex;
+    struct ABookIndexEntry *entry;
+
+    success = TRUE;
+    *hits = 0;
+
+    entry = (struct ABookIndexEntry *)HashTableOperate(table, text, htoLookup);
+    if(HASH_ENTRY_IS_BUSY(&entry->header))
+    {
+      ULONG i;
+
+      for(i = 0; i < entry->count; i++)
+      {
+        struct ABookNode *node = (i == 0) ? entry->first : entry->more[i-1];
+        const char *field = isAliasSearch(mode) == TRUE ? node->Alias : node->Address;
+
+        // a node which was modified without invalidating the index
+        // renders the complete index useless
+        if(Stricmp(field, text) != 0)
+        {
+          W(DBF_ABOOK, "index of address book %08lx is outdated", abook);
+          DropABookIndexes(abook);
+          success = FALSE;
+          break;
+        }
+
+        if((node->type == ABNT_USER && isUserTypeSearch(mode) == TRUE) ||
+           (node->type == ABNT_LIST && isListTypeSearch(mode) == TRUE) ||
+           (node->type == ABNT_GROUP && isGroupTypeSearch(mode) == TRUE))
+        {
+          *abn = node;
+          (*hits)++;
+
+          // stop at the second hit just like SearchABookEntry() does
+          if(*hits >= 2)
+            break;
+        }
+      }
+    }
+  }
+
+  ReleaseSemaphore(&abook->indexSemaphore);
+
+  RETURN(success);
+  return success;
+}
+
 ///
 /// FixAlias
 //  Avoids ambiguos aliases
@@ -1985,17 +2300,26 @@ ULONG SearchABook(const struct ABook *abook, const char *text, ULONG mode, struc
 {
   struct PlainSearchStuff stuff;
   ULONG hits;
+  ULONG fields;
 
   ENTER();
 
-  stuff.text = text;
-  stuff.textLen = strlen(text);
-  stuff.mode = mode;
-  stuff.result = abn;
-  stuff.hits = 0;
-  IterateABook(abook, 0, SearchABookEntry, &stuff);
-
-  hits = stuff.hits;
+  // exact searches for a single alias or address are answered by the
+  // indexes of the address book, these are an internal cache only and
+  // hence are built even for a const address book
+  fields = mode & (ASM_ALIAS|ASM_REALNAME|ASM_ADDRESS|ASM_COMMENT|ASM_USERINFO);
+  if(isCompleteSearch(mode) == TRUE || (fields != ASM_ALIAS && fields != ASM_ADDRESS) ||
+     SearchABookIndex((struct ABook *)abook, text, mode, abn, &hits) == FALSE)
+  {
+    stuff.text = text;
+    stuff.textLen = strlen(text);
+    stuff.mode = mode;
+    stuff.result = abn;
+    stuff.hits = 0;
+    IterateABook(abook, 0, SearchABookEntry, &stuff);
+
+    hits = stuff.hits;
+  }
 
   RETURN(hits);
   return hits;
@@ -2117,15 +2441,16 @@ struct ABookNode *CreateABookGroup(struct ABook *abook, const char *name)
 }
 
 ///
-/// FindPersonInABook
-struct ABookNode *FindPersonInABook(const struct ABook *abook, const struct Person *pe)
+/// FindAddressInABook
+struct ABookNode *FindAddressInABook(const struct ABook *abook, const char *address)
 {
   struct ABookNode *result = NULL;
   struct ABookNode *abn;
 
   ENTER();
 
-  if(SearchABook(abook, pe->Address, ASM_ADDRESS|ASM_USER|ASM_COMPLETE, &abn) == 1)
+  // an exact search is answered by the address index
+  if(SearchABook(abook, address, ASM_ADDRESS|ASM_USER, &abn) == 1)
   {
     result = abn;
   }
@@ -2134,6 +2459,20 @@ struct ABookNode *FindPersonInABook(const struct ABook *abook, const struct Pers
   return result;
 }
 
+///
+/// FindPersonInABook
+struct ABookNode *FindPersonInABook(const struct ABook *abook, const struct Person *pe)
+{
+  struct ABookNode *result;
+
+  ENTER();
+
+  result = FindAddressInABook(abook, pe->Address);
+
+  RETURN(result);
+  return result;
+}
+
 ///
 
 struct BirthdayStuff
@@ -31,10 +31,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <exec/semaphores.h>
+
 #include "YAM_stringsizes.h"
 #include "YAM_write.h"
 
 // forward declarations
+struct HashTable;
 struct Person;
 
 enum ABookNodeType
@@ -72,6 +75,10 @@ struct ABook
   struct ABookNode  rootGroup;
   struct ABookNode *arexxABN;
   BOOL modified;
+  struct HashTable *addressIndex; // case insensitive index of all addresses, built on demand
+  struct HashTable *aliasIndex;   // case insensitive index of all aliases, built on demand
+  ULONG indexGeneration;          // generation of the address book the indexes were built for
+  struct SignalSemaphore indexSemaphore; // protects the indexes, lookups may happen on several threads
 };
 
 // flags for IterateABook()
@@ -110,6 +117,7 @@ BOOL CompareABookNodes(const struct ABookNode *abn1, const struct ABookNode *abn
 void InitABook(struct ABook *abook, const char *name);
 void ClearABook(struct ABook *abook);
 void MoveABookNodes(struct ABook *dst, struct ABook *src);
+void InvalidateABookIndexes(struct ABook *abook);
 BOOL IterateABook(const struct ABook *abook, ULONG flags, BOOL (*nodeFunc)(const struct ABookNode *abn, ULONG flags, void *userData), void *userData);
 BOOL IterateABookGroup(const struct ABookNode *group, ULONG flags, BOOL (*nodeFunc)(const struct ABookNode *abn, ULONG flags, void *userData), void *userData);
 BOOL CreateEmptyABookFile(const char *filename);
@@ -123,6 +131,7 @@ BOOL ImportXMLABook(const char *filename, struct ABook *abook, BOOL append);
 ULONG SearchABook(const struct ABook *abook, const char *text, ULONG mode, struct ABookNode **abn);
 ULONG PatternSearchABook(const struct ABook *abook, const char *pattern, ULONG mode, char **aliases);
 struct ABookNode *CreateABookGroup(struct ABook *abook, const char *name);
+struct ABookNode *FindAddressInABook(const struct ABook *abook, const char *address);
 struct ABookNode *FindPersonInABook(const struct ABook *abook, const struct Person *pe);
 void CheckABookBirthdays(const struct ABook *abook, BOOL check);
 void FixAlias(const struct ABook *abook, struct ABookNode *abn, const struct ABookNode *excludeThis);
@@ -0,0 +1,338 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "AhoCorasick.h"
+#include "YAM_utilities.h"
+
+#include "Debug.h"
+
+/// FindChild
+// find the child of a state which is reached by the given character
+static ULONG FindChild(const struct AhoCorasickContext *acc, ULONG state, const unsigned char c)
+{
+  ULONG child;
+
+  for(child = acc->states[state].child; child != 0; child = acc->states[child].sibling)
+  {
+    if(acc->states[child].c == c)
+      break;
+  }
+
+  return child;
+}
+
+///
+/// NextState
+// calculate the state following the given one for a character, this
+// follows the failure links until a matching child has been found
+static ULONG NextState(const struct AhoCorasickContext *acc, ULONG state, const unsigned char c)
+{
+  ULONG next = 0;
+
+  while(state != 0)
+  {
+    if((next = FindChild(acc, state, c)) != 0)
+      break;
+
+    state = acc->states[state].fail;
+  }
+
+  if(state == 0)
+    next = acc->root[c];
+
+  return next;
+}
+
+///
+/// AddState
+// add a new child state to the given state
+static ULONG AddState(struct AhoCorasickContext *acc, const ULONG parent, const unsigned char c)
+{
+  ULONG state = 0;
+
+  if(acc->numStates == acc->maxStates)
+  {
+    ULONG newMax = acc->maxStates * 2;
+    struct AhoCorasickState *newStates;
+
+    if((newStates = realloc(acc->states, newMax * sizeof(*newStates))) != NULL)
+    {
+      acc->states = newStates;
+      acc->maxStates = newMax;
+    }
+  }
+
+  if(acc->numStates < acc->maxStates)
+  {
+    struct AhoCorasickState *s;
+
+    state = acc->numStates++;
+    s = &acc->states[state];
+    s->child = 0;
+    s->sibling = acc->states[parent].child;
+    s->fail = 0;
+    s->dictLink = 0;
+    s->output = -1;
+    s->c = c;
+
+    acc->states[parent].child = state;
+  }
+
+  return state;
+}
+
+///
+/// AhoCorasickInit
+// create an empty context for an Aho-Corasick search
+struct AhoCorasickContext *AhoCorasickInit(void)
+{
+  struct AhoCorasickContext *acc;
+
+  ENTER();
+
+  if((acc = calloc(1, sizeof(*acc))) != NULL)
+  {
+    acc->maxStates = 64;
+    acc->maxPatterns = 16;
+
+    if((acc->states = malloc(acc->maxStates * sizeof(*acc->states))) != NULL &&
+       (acc->patterns = malloc(acc->maxPatterns * sizeof(*acc->patterns))) != NULL)
+    {
+      // set up the root state
+      memset(&acc->states[0], 0, sizeof(acc->states[0]));
+      acc->states[0].output = -1;
+      acc->numStates = 1;
+    }
+    else
+    {
+      AhoCorasickCleanup(acc);
+      acc = NULL;
+    }
+  }
+
+  RETURN(acc);
+  return acc;
+}
+
+///
+/// AhoCorasickCleanup
+// free the context of an Aho-Corasick search
+void AhoCorasickCleanup(struct AhoCorasickContext *acc)
+{
+  ENTER();
+
+  if(acc != NULL)
+  {
+    if(acc->patterns != NULL)
+    {
+      ULONG i;
+
+      for(i = 0; i < acc->numPatterns; i++)
+        free(acc->patterns[i].pattern);
+
+      free(acc->patterns);
+    }
+
+    free(acc->states);
+    free(acc);
+  }
+
+  LEAVE();
+}
+
+///
+/// AhoCorasickAddPattern
+// add a pattern to the trie of an Aho-Corasick search, empty patterns
+// are rejected as they would match any string
+BOOL AhoCorasickAddPattern(struct AhoCorasickContext *acc, const char *pattern, const BOOL caseSensitive, const ULONG id)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if(acc != NULL && acc->compiled == FALSE && pattern != NULL && pattern[0] != '\0')
+  {
+    if(acc->numPatterns == acc->maxPatterns)
+    {
+      ULONG newMax = acc->maxPatterns * 2;
+      struct AhoCorasickPattern *newPatterns;
+
+      if((newPatterns = realloc(acc->patterns, newMax * sizeof(*newPatterns))) != NULL)
+      {
+        acc->patterns = newPatterns;
+        acc->maxPatterns = newMax;
+      }
+    }
+
+    if(acc->numPatterns < acc->maxPatterns)
+    {
+      const char *p;
+      ULONG state = 0;
+
+      // walk down the trie and add the missing states
+      for(p = pattern; *p != '\0' && state != -1UL; p++)
+      {
+        unsigned char c = tolower((unsigned char)*p);
+        ULONG child;
+
+        if((child = FindChild(acc, state, c)) == 0 && (child = AddState(acc, state, c)) == 0)
+          state = -1UL;
+        else
+          state = child;
+      }
+
+      if(state != -1UL)
+      {
+        struct AhoCorasickPattern *pat = &acc->patterns[acc->numPatterns];
+
+        pat->length = p - pattern;
+        pat->id = id;
+        pat->pattern = NULL;
+
+        if(caseSensitive == FALSE || (pat->pattern = strdup(pattern)) != NULL)
+        {
+          pat->next = acc->states[state].output;
+          acc->states[state].output = acc->numPatterns;
+          acc->numPatterns++;
+
+          success = TRUE;
+        }
+      }
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// AhoCorasickCompile
+// calculate the failure and dictionary links of all states by walking
+// through the trie in breadth first order
+BOOL AhoCorasickCompile(struct AhoCorasickContext *acc)
+{
+  BOOL success = FALSE;
+  ULONG *queue;
+
+  ENTER();
+
+  if(acc != NULL && (queue = malloc(acc->numStates * sizeof(*queue))) != NULL)
+  {
+    struct AhoCorasickState *states = acc->states;
+    ULONG head = 0;
+    ULONG tail = 0;
+    ULONG state;
+
+    // the children of the root state fail back to the root state
+    memset(acc->root, 0, sizeof(acc->root));
+    for(state = states[0].child; state != 0; state = states[state].sibling)
+    {
+      acc->root[states[state].c] = state;
+      states[state].fail = 0;
+      states[state].dictLink = 0;
+      queue[tail++] = state;
+    }
+
+    while(head < tail)
+    {
+      ULONG parent = queue[head++];
+
+      for(state = states[parent].child; state != 0; state = states[state].sibling)
+      {
+        ULONG fail = NextState(acc, states[parent].fail, states[state].c);
+
+        states[state].fail = fail;
+        states[state].dictLink = (states[fail].output != -1) ? fail : states[fail].dictLink;
+        queue[tail++] = state;
+      }
+    }
+
+    free(queue);
+
+    D(DBF_FILTER, "compiled %ld patterns into %ld states", acc->numPatterns, acc->numStates);
+
+    acc->compiled = TRUE;
+    success = TRUE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// AhoCorasickSearch
+// search all patterns in a string in a single pass, the entries of the
+// match array are set to TRUE for the IDs of all found patterns. Returns
+// the number of patterns which were found additionally.
+// the context structure must be compiled first using AhoCorasickCompile()
+ULONG AhoCorasickSearch(const struct AhoCorasickContext *acc, const char *string, UBYTE *matches)
+{
+  ULONG found = 0;
+
+  ENTER();
+
+  if(acc != NULL && acc->compiled == TRUE && string != NULL)
+  {
+    const struct AhoCorasickState *states = acc->states;
+    const char *p;
+    ULONG state = 0;
+
+    for(p = string; *p != '\0'; p++)
+    {
+      ULONG s;
+
+      state = NextState(acc, state, tolower((unsigned char)*p));
+
+      // report all patterns ending at this position
+      for(s = (states[state].output != -1) ? state : states[state].dictLink; s != 0; s = states[s].dictLink)
+      {
+        LONG o;
+
+        for(o = states[s].output; o != -1; o = acc->patterns[o].next)
+        {
+          const struct AhoCorasickPattern *pat = &acc->patterns[o];
+
+          if(matches[pat->id] == FALSE &&
+             (pat->pattern == NULL || strncmp(&p[1-pat->length], pat->pattern, pat->length) == 0))
+          {
+            matches[pat->id] = TRUE;
+            found++;
+          }
+        }
+      }
+    }
+  }
+
+  RETURN(found);
+  return found;
+}
+
+///
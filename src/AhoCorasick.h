@@ -0,0 +1,86 @@
+#ifndef AHOCORASICK_H
+#define AHOCORASICK_H 1
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <exec/types.h>
+
+/*
+ An implementation of the Aho/Corasick multi pattern string search
+ algorithm. All patterns are added to a context structure created by
+ AhoCorasickInit() using AhoCorasickAddPattern(), each pattern is given
+ a caller defined ID. AhoCorasickCompile() then calculates the failure
+ links of the pattern trie. Afterwards a single pass of AhoCorasickSearch()
+ over a string finds all patterns contained in it, no matter how many
+ patterns there are. Finally the context must be freed using
+ AhoCorasickCleanup().
+
+ The trie is built from the lower case patterns, case sensitive patterns
+ are verified against the original string when they are found.
+
+ Details about the Aho/Corasick string search algorithm can be found here:
+   http://en.wikipedia.org/wiki/Aho%E2%80%93Corasick_algorithm
+*/
+
+struct AhoCorasickState
+{
+  ULONG child;       // first child state, 0 if there is none
+  ULONG sibling;     // next child of the same parent state, 0 if there is none
+  ULONG fail;        // state to continue with if no child matches
+  ULONG dictLink;    // next state on the failure chain which ends a pattern, 0 if there is none
+  LONG output;       // first pattern ending in this state, -1 if there is none
+  unsigned char c;   // character leading from the parent to this state
+};
+
+struct AhoCorasickPattern
+{
+  char *pattern;     // the original pattern, only kept for case sensitive patterns
+  ULONG length;
+  ULONG id;          // caller defined ID, used as index in the match array
+  LONG next;         // next pattern ending in the same state, -1 if there is none
+};
+
+struct AhoCorasickContext
+{
+  struct AhoCorasickState *states;  // state 0 is the root state
+  ULONG numStates;
+  ULONG maxStates;
+  struct AhoCorasickPattern *patterns;
+  ULONG numPatterns;
+  ULONG maxPatterns;
+  BOOL compiled;
+  ULONG root[256];                  // direct transitions of the root state
+};
+
+struct AhoCorasickContext *AhoCorasickInit(void);
+void AhoCorasickCleanup(struct AhoCorasickContext *acc);
+BOOL AhoCorasickAddPattern(struct AhoCorasickContext *acc, const char *pattern, const BOOL caseSensitive, const ULONG id);
+BOOL AhoCorasickCompile(struct AhoCorasickContext *acc);
+ULONG AhoCorasickSearch(const struct AhoCorasickContext *acc, const char *string, UBYTE *matches);
+
+#endif /* AHOCORASICK_H */
@@ -31,8 +31,10 @@
 #include <math.h>
 #include <float.h>
 
+#include <clib/alib_protos.h>
 #include <proto/exec.h>
 #include <proto/dos.h>
+#include <proto/muimaster.h>
 
 #include "YAM.h"
 #include "YAM_read.h"
@@ -49,31 +51,91 @@
 #include "FileInfo.h"
 #include "Locale.h"
 #include "MethodStack.h"
+#include "Threads.h"
 
 #include "Debug.h"
 
-#define BAYES_TOKEN_DELIMITERS  " \t\n\r\f.,"
-#define BAYES_MIN_TOKEN_LENGTH  3
-#define BAYES_MAX_TOKEN_LENGTH  12
-
 #define SPAMDATAFILE            ".spamdata"
+#define SPAMLOGFILE             ".spamdata.log"
+#define SPAMNEWFILE             ".spamdata.new"
+
+// number of mails a classifying thread handles at once
+#define SPAM_CHUNK_SIZE         16
+// maximum number of threads classifying mails
+#define SPAM_MAX_THREADS        4
 
 // some compilers (vbcc) don't define this, so lets do it ourself
 #ifndef M_LN2
 #define M_LN2                   0.69314718055994530942
 #endif
 
+// the size of the puddles of the string pool of a tokenizer
+#define TOKEN_POOL_PUDDLE       16384
+#define TOKEN_POOL_THRESHOLD    1024
+
 /*** Structure definitions ***/
-struct Token
+// the key of a token. Tokens in the table always carry the complete
+// "prefix:word" string in 'word' and no prefix. Keys used for lookups
+// may refer to the prefix and the word separately to avoid building the
+// concatenated string first.
+struct TokenKey
 {
-  struct HashEntryHeader hash;
+  const char *prefix;
+  ULONG prefixLength;
   const char *word;
   ULONG length;
+};
+
+struct Token
+{
+  struct HashEntryHeader hash;
+  struct TokenKey key;
   ULONG count;
   double probability;
   double distance;
 };
 
+// The training database (.spamdata) is read into memory in one go and
+// used as is. It consists of a header, a hash table of tableSize slots
+// and the NUL terminated words. A slot with a length of zero is free.
+// All numbers are stored in big endian order. Changes are kept in the
+// token tables of the analyzer and are appended to a delta log
+// (.spamdata.log) until they are merged into a new database. Each merge
+// bumps the generation of the database. The log records the generation
+// it applies to, so a log left over by an interrupted merge is ignored.
+struct DatabaseHeader
+{
+  unsigned char cookie[4];
+  ULONG goodCount;                 // number of non-spam mails
+  ULONG badCount;                  // number of spam mails
+  ULONG goodWords;                 // number of distinct non-spam words
+  ULONG badWords;                  // number of distinct spam words
+  ULONG tableSize;                 // number of slots, a power of 2
+  ULONG stringsSize;               // size of the words area
+  ULONG generation;                // incremented by each merge
+};
+
+struct DatabaseSlot
+{
+  ULONG hash;
+  ULONG offset;                    // offset of the word in the words area
+  ULONG length;
+  ULONG goodCount;
+  ULONG badCount;
+};
+
+struct DatabaseBuilder
+{
+  char *image;
+  ULONG imageSize;
+  ULONG tableSize;
+  ULONG tokenCount;
+  ULONG stringsSize;
+  ULONG goodWords;
+  ULONG badWords;
+  BOOL optimize;
+};
+
 struct TokenEnumeration
 {
   ULONG entrySize;
@@ -85,17 +147,105 @@ struct TokenEnumeration
 
 // the magic data we expect upon reading the data file
 static const unsigned char magicCookie[] = { '\xFE', '\xED', '\xFA', '\xCE' };
+static const unsigned char databaseCookie[] = { 'Y', 'S', 'D', '2' };
+static const unsigned char logCookie[] = { 'Y', 'S', 'L', '1' };
 
 /*** Static functions ***/
+/// tokenGetKey
+// return the key of a token in the table
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static const void *tokenGetKey(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  return &((const struct Token *)entry)->key;
+}
+
+///
+/// tokenHashKey
+// calculate the hash value of a token key, this gives the same result
+// for a separate prefix and word as for the concatenated "prefix:word"
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static ULONG tokenHashKey(UNUSED struct HashTable *table, const void *key)
+{
+  const struct TokenKey *tk = (const struct TokenKey *)key;
+  const unsigned char *s;
+  const unsigned char *e;
+  ULONG h = 0;
+
+  if(tk->prefix != NULL)
+  {
+    for(s = (const unsigned char *)tk->prefix, e = s + tk->prefixLength; s < e; s++)
+      h = (h >> (HASH_BITS - 4)) ^ (h << 4) ^ *s;
+
+    h = (h >> (HASH_BITS - 4)) ^ (h << 4) ^ ':';
+  }
+
+  for(s = (const unsigned char *)tk->word, e = s + tk->length; s < e; s++)
+    h = (h >> (HASH_BITS - 4)) ^ (h << 4) ^ *s;
+
+  return h;
+}
+
+///
+/// tokenMatchEntry
+// compare a token in the table with a token key
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static BOOL tokenMatchEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry, const void *key)
+{
+  const struct TokenKey *ek = &((const struct Token *)entry)->key;
+  const struct TokenKey *tk = (const struct TokenKey *)key;
+  BOOL result = FALSE;
+
+  if(tk->prefix == NULL)
+  {
+    if(ek->length == tk->length && memcmp(ek->word, tk->word, tk->length) == 0)
+      result = TRUE;
+  }
+  else if(ek->length == tk->prefixLength + 1 + tk->length)
+  {
+    if(memcmp(ek->word, tk->prefix, tk->prefixLength) == 0 &&
+       ek->word[tk->prefixLength] == ':' &&
+       memcmp(&ek->word[tk->prefixLength + 1], tk->word, tk->length) == 0)
+    {
+      result = TRUE;
+    }
+  }
+
+  return result;
+}
+
+///
 /// tokenizerInit
 // initalize a token table
 static BOOL tokenizerInit(struct Tokenizer *t)
 {
-  BOOL result;
+  static const struct HashTableOps tokenOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    tokenGetKey,
+    tokenHashKey,
+    tokenMatchEntry,
+    DefaultHashMoveEntry,
+    DefaultHashClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    NULL
+  };
+  BOOL result = FALSE;
 
   ENTER();
 
-  result = HashTableInit(&t->tokenTable, HashTableGetDefaultStringOps(), NULL, sizeof(struct Token), 4096);
+  // the strings of all tokens are kept in a private pool which is
+  // freed as a whole when the tokenizer is cleaned up
+  if((t->stringPool = AllocSysObjectTags(ASOT_MEMPOOL,
+    ASOPOOL_MFlags,    MEMF_SHARED,
+    ASOPOOL_Puddle,    TOKEN_POOL_PUDDLE,
+    ASOPOOL_Threshold, TOKEN_POOL_THRESHOLD,
+    ASOPOOL_Name,      (ULONG)"YAM spam tokens",
+    TAG_DONE)) != NULL)
+  {
+    result = HashTableInit(&t->tokenTable, &tokenOps, NULL, sizeof(struct Token), 4096);
+  }
 
   RETURN(result);
   return result;
@@ -110,6 +260,13 @@ static void tokenizerCleanup(struct Tokenizer *t)
 
   HashTableCleanup(&t->tokenTable);
 
+  // this frees the strings of all tokens at once
+  if(t->stringPool != NULL)
+  {
+    FreeSysObject(ASOT_MEMPOOL, t->stringPool);
+    t->stringPool = NULL;
+  }
+
   LEAVE();
 }
 
@@ -132,57 +289,23 @@ static BOOL tokenizerClearTokens(struct Tokenizer *t)
   return ok;
 }
 
-///
-/// optimizeToken
-// optimize a token table
-static enum HashTableOperator optimizeToken(UNUSED struct HashTable *table,
-                                            struct HashEntryHeader *entry,
-                                            UNUSED ULONG number,
-                                            void *arg)
-{
-  enum HashTableOperator result;
-  struct Token *token = (struct Token *)entry;
-
-  ENTER();
-
-  // Check whether the token's count value is less or equal to the
-  // threshold. If yes, then this token should be removed.
-  if(token->count <= (ULONG)arg)
-    result = htoNext|htoRemove;
-  else
-    result = htoNext;
-
-  RETURN(result);
-  return result;
-}
-
-///
-/// tokenizerOptimizeTokens
-// Optimize a token table and return the number of removed words
-static ULONG tokenizerOptimizeTokens(struct Tokenizer *t,
-                                     const ULONG maxCount)
-{
-  ULONG num;
-
-  ENTER();
-
-  num = HashTableEnumerate(&t->tokenTable, optimizeToken, (void *)maxCount);
-
-  RETURN(num);
-  return num;
-}
-
 ///
 /// tokenizerGet
 // look up a word in the token table
 static struct Token *tokenizerGet(struct Tokenizer *t,
                                   const char *word)
 {
+  struct TokenKey key;
   struct HashEntryHeader *entry;
 
   ENTER();
 
-  entry = HashTableOperate(&t->tokenTable, word, htoLookup);
+  key.prefix = NULL;
+  key.prefixLength = 0;
+  key.word = word;
+  key.length = strlen(word);
+
+  entry = HashTableOperate(&t->tokenTable, &key, htoLookup);
   if(HASH_ENTRY_IS_FREE(entry))
   {
     // we didn't find the entry we were looking for
@@ -196,75 +319,68 @@ static struct Token *tokenizerGet(struct Tokenizer *t,
 ///
 /// tokenizerAdd
 // add a word to the token table with an arbitrary prefix (maybe NULL) and count
+// the "prefix:word" string is copied to the string pool of the tokenizer only
+// if the token is not yet known
 static struct Token *tokenizerAdd(struct Tokenizer *t,
                                   const char *word,
                                   const char *prefix,
                                   const ULONG count)
 {
-  struct Token *token = NULL;
-  ULONG len;
-  char *tmpWord;
+  struct TokenKey key;
+  struct Token *token;
 
   ENTER();
 
-  len = strlen(word) + 1;
-  if(prefix != NULL)
-    len += strlen(prefix) + 1;
+  key.prefix = prefix;
+  key.prefixLength = (prefix != NULL) ? strlen(prefix) : 0;
+  key.word = word;
+  key.length = strlen(word);
 
-  if((tmpWord = (STRPTR)malloc(len)) != NULL)
+  if((token = (struct Token *)HashTableOperate(&t->tokenTable, &key, htoAdd)) != NULL)
   {
-    if(prefix != NULL)
-      snprintf(tmpWord, len, "%s:%s", prefix, word);
-    else
-      strlcpy(tmpWord, word, len);
-
-    if((token = (struct Token *)HashTableOperate(&t->tokenTable, tmpWord, htoAdd)) != NULL)
+    if(token->key.word == NULL)
     {
-      if(token->word == NULL)
+      ULONG len = key.length;
+      char *tmpWord;
+
+      if(prefix != NULL)
+        len += key.prefixLength + 1;
+
+      if((tmpWord = AllocPooled(t->stringPool, len+1)) != NULL)
       {
-        token->word = tmpWord;
-        token->length = len-1;
+        char *p = tmpWord;
+
+        if(prefix != NULL)
+        {
+          memcpy(p, prefix, key.prefixLength);
+          p += key.prefixLength;
+          *p++ = ':';
+        }
+        memcpy(p, word, key.length);
+        tmpWord[len] = '\0';
+
+        token->key.prefix = NULL;
+        token->key.prefixLength = 0;
+        token->key.word = tmpWord;
+        token->key.length = len;
         token->count = count;
         token->probability = 0.0;
-        // make sure this one isn't free()'d
-        tmpWord = NULL;
       }
       else
-        token->count += count;
+      {
+        // drop the new entry again
+        HashTableRawRemove(&t->tokenTable, (struct HashEntryHeader *)token);
+        token = NULL;
+      }
     }
-
-    free(tmpWord);
+    else
+      token->count += count;
   }
 
   RETURN(token);
   return token;
 }
 
-///
-/// tokenizerRemove
-// remove <count> occurences of word from the token table
-static void tokenizerRemove(struct Tokenizer *t,
-                            const char *word,
-                            const ULONG count)
-{
-  struct Token *token;
-
-  ENTER();
-
-  if((token = tokenizerGet(t, word)) != NULL)
-  {
-    if(token->count >= count)
-    {
-      token->count -= count;
-
-      if(token->count == 0)
-        HashTableRawRemove(&t->tokenTable, (struct HashEntryHeader *)token);
-    }
-  }
-
-  LEAVE();
-}
-
 ///
 /// isDecimalNumber
 // check if <word> is a decimal number
@@ -670,12 +786,183 @@ static struct Token *tokenizerCopyTokens(const struct Tokenizer *t)
 }
 
 ///
-/// tokenizerForgetTokens
-// remove all words of the enumeration from the token table
-static void tokenizerForgetTokens(struct Tokenizer *t,
-                                  struct TokenEnumeration *te)
+/// databaseSlots
+// return the hash table of the training database
+static struct DatabaseSlot *databaseSlots(const char *image)
+{
+  return (struct DatabaseSlot *)(image + sizeof(struct DatabaseHeader));
+}
+
+///
+/// databaseStrings
+// return the strings area of the training database
+static const char *databaseStrings(const char *image)
+{
+  const struct DatabaseHeader *hdr = (const struct DatabaseHeader *)image;
+
+  return (const char *)&databaseSlots(image)[ntohl(hdr->tableSize)];
+}
+
+///
+/// databaseCheck
+// check the structure of a training database before it is used
+static BOOL databaseCheck(const char *image, const ULONG size)
+{
+  const struct DatabaseHeader *hdr = (const struct DatabaseHeader *)image;
+  BOOL valid = FALSE;
+
+  ENTER();
+
+  if(size >= sizeof(*hdr) && memcmp(hdr->cookie, databaseCookie, sizeof(databaseCookie)) == 0)
+  {
+    ULONG tableSize = ntohl(hdr->tableSize);
+    ULONG stringsSize = ntohl(hdr->stringsSize);
+
+    // the table size must be a power of 2 and the parts must add up to the file size
+    if(tableSize != 0 && (tableSize & (tableSize-1)) == 0 && tableSize < HASH_SIZE_LIMIT &&
+       sizeof(*hdr) + tableSize * sizeof(struct DatabaseSlot) + stringsSize == size)
+    {
+      const struct DatabaseSlot *slots = databaseSlots(image);
+      const char *strings = databaseStrings(image);
+      ULONG used = 0;
+      ULONG i;
+
+      valid = TRUE;
+
+      // make sure no word points outside of the strings area
+      for(i = 0; i < tableSize; i++)
+      {
+        ULONG offset = ntohl(slots[i].offset);
+        ULONG length = ntohl(slots[i].length);
+
+        if(length != 0)
+        {
+          if(offset >= stringsSize || length >= stringsSize - offset || strings[offset + length] != '\0')
+          {
+            E(DBF_SPAM, "invalid word in slot %ld of training database", i);
+            valid = FALSE;
+            break;
+          }
+
+          used++;
+        }
+      }
+
+      // lookups rely on at least one free slot
+      if(used == tableSize)
+        valid = FALSE;
+    }
+    else
+      E(DBF_SPAM, "invalid training database size %ld, table size %ld, strings size %ld", size, tableSize, stringsSize);
+  }
+
+  RETURN(valid);
+  return valid;
+}
+
+///
+/// databaseFindSlot
+// look up a word in the training database
+static const struct DatabaseSlot *databaseFindSlot(const char *word, const ULONG length)
+{
+  const struct DatabaseSlot *slot = NULL;
+  const char *image = G->spamFilter.database;
+
+  if(image != NULL)
+  {
+    const struct DatabaseHeader *hdr = (const struct DatabaseHeader *)image;
+    const struct DatabaseSlot *slots = databaseSlots(image);
+    const char *strings = databaseStrings(image);
+    ULONG mask = ntohl(hdr->tableSize) - 1;
+    struct TokenKey key;
+    ULONG hash;
+    ULONG i;
+
+    key.prefix = NULL;
+    key.prefixLength = 0;
+    key.word = word;
+    key.length = length;
+
+    hash = tokenHashKey(NULL, &key);
+
+    // the table is never filled more than half, so there is always a free slot
+    for(i = hash & mask; slots[i].length != 0; i = (i + 1) & mask)
+    {
+      if(ntohl(slots[i].hash) == hash && ntohl(slots[i].length) == length &&
+         memcmp(&strings[ntohl(slots[i].offset)], word, length) == 0)
+      {
+        slot = &slots[i];
+        break;
+      }
+    }
+  }
+
+  return slot;
+}
+
+///
+/// trainingTokens
+// return the changed tokens of a class
+static struct Tokenizer *trainingTokens(const enum BayesClassification class)
+{
+  return (class == BC_SPAM) ? &G->spamFilter.badTokens : &G->spamFilter.goodTokens;
+}
+
+///
+/// trainingCount
+// return the number of occurences of a word in the ham or spam corpus.
+// Words which have been changed since the last merge are taken from the
+// token tables, all others from the training database.
+static ULONG trainingCount(const enum BayesClassification class, const char *word)
 {
   struct Token *token;
+  ULONG count = 0;
+
+  if((token = tokenizerGet(trainingTokens(class), word)) != NULL)
+    count = token->count;
+  else
+  {
+    const struct DatabaseSlot *slot;
+
+    if((slot = databaseFindSlot(word, strlen(word))) != NULL)
+      count = ntohl(class == BC_SPAM ? slot->badCount : slot->goodCount);
+  }
+
+  return count;
+}
+
+///
+/// trainingToken
+// get the token of a word for modification, the current count is taken
+// over from the training database if the word has not been changed yet.
+// Tokens with a count of zero are kept to hide the database entry.
+static struct Token *trainingToken(const enum BayesClassification class, const char *word)
+{
+  struct Tokenizer *t = trainingTokens(class);
+  struct Token *token;
+
+  if((token = tokenizerGet(t, word)) == NULL)
+  {
+    const struct DatabaseSlot *slot;
+    ULONG count = 0;
+
+    if((slot = databaseFindSlot(word, strlen(word))) != NULL)
+      count = ntohl(class == BC_SPAM ? slot->badCount : slot->goodCount);
+
+    token = tokenizerAdd(t, word, NULL, count);
+  }
+
+  return token;
+}
+
+///
+/// trainingForgetTokens
+// remove all words of the enumeration from the ham or spam corpus
+static void trainingForgetTokens(const enum BayesClassification class,
+                                 struct TokenEnumeration *te)
+{
+  ULONG *words = (class == BC_SPAM) ? &G->spamFilter.badWords : &G->spamFilter.goodWords;
+  struct Token *token;
 
   ENTER();
 
@@ -683,23 +970,44 @@ static void tokenizerForgetTokens(struct Tokenizer *t,
   // count for that token in the training set, because we assume we only bumped the training
   // set count once per message containing the token
   while((token = tokenEnumerationNext(te)) != NULL)
-    tokenizerRemove(t, token->word, 1);
+  {
+    struct Token *tt;
+
+    if((tt = trainingToken(class, token->key.word)) != NULL && tt->count > 0)
+    {
+      tt->count--;
+
+      if(tt->count == 0)
+        (*words)--;
+    }
+  }
 
   LEAVE();
 }
 
 ///
-/// tokenizerRememberTokens
-// put all words of the enumeration back into the token table
-static void tokenizerRememberTokens(struct Tokenizer *t,
-                                    struct TokenEnumeration *te)
+/// trainingRememberTokens
+// put all words of the enumeration into the ham or spam corpus
+static void trainingRememberTokens(const enum BayesClassification class,
+                                   struct TokenEnumeration *te)
 {
+  ULONG *words = (class == BC_SPAM) ? &G->spamFilter.badWords : &G->spamFilter.goodWords;
   struct Token *token;
 
   ENTER();
 
   while((token = tokenEnumerationNext(te)) != NULL)
-    tokenizerAdd(t, token->word, NULL, 1);
+  {
+    struct Token *tt;
+
+    if((tt = trainingToken(class, token->key.word)) != NULL)
+    {
+      if(tt->count == 0)
+        (*words)++;
+
+      tt->count++;
+    }
+  }
 
   LEAVE();
 }
@@ -716,7 +1024,10 @@ static BOOL tokenAnalyzerInit(void)
   // initialize the counters
   G->spamFilter.goodCount = 0;
   G->spamFilter.badCount = 0;
+  G->spamFilter.goodWords = 0;
+  G->spamFilter.badWords = 0;
   G->spamFilter.numDirtyingMessages = 0;
+  G->spamFilter.database = NULL;
 
   memset(&G->spamFilter.lockSema, 0, sizeof(G->spamFilter.lockSema));
   InitSemaphore(&G->spamFilter.lockSema);
@@ -740,53 +1051,14 @@ static void tokenAnalyzerCleanup(void)
   tokenizerCleanup(&G->spamFilter.goodTokens);
   tokenizerCleanup(&G->spamFilter.badTokens);
 
+  free(G->spamFilter.database);
+  G->spamFilter.database = NULL;
+
   ReleaseSemaphore(&G->spamFilter.lockSema);
 
   LEAVE();
 }
 
-///
-/// writeTokens
-// write the tokens of a token table to a stream
-static BOOL writeTokens(FILE *stream,
-                        const struct Tokenizer *t)
-{
-  ULONG tokenCount = t->tokenTable.entryCount;
-
-  ENTER();
-
-  if(WriteUInt32(stream, tokenCount) != 1)
-  {
-    RETURN(FALSE);
-    return FALSE;
-  }
-
-  if(tokenCount > 0)
-  {
-    struct TokenEnumeration te;
-    ULONG i;
-
-    tokenEnumerationInit(&te, t);
-    for(i = 0; i < tokenCount; i++)
-    {
-      struct Token *token = tokenEnumerationNext(&te);
-      ULONG length = token->length;
-
-      if(WriteUInt32(stream, token->count) != 1)
-        break;
-
-      if(WriteUInt32(stream, length) != 1)
-        break;
-
-      if(fwrite(token->word, length, 1, stream) != 1)
-        break;
-    }
-  }
-
-  RETURN(TRUE);
-  return TRUE;
-}
-
 ///
 /// readTokens
 // read tokens from a stream into the token table
@@ -862,16 +1134,451 @@ static BOOL readTokens(FILE *stream,
 
       filePos += size;
 
-      buffer[size] = '\0';
+      buffer[size] = '\0';
+
+      tokenizerAdd(t, buffer, NULL, count);
+    }
+
+    free(buffer);
+  }
+
+  RETURN(TRUE);
+  return TRUE;
+}
+
+/// builderAddToken
+// add a word to a new training database, during the first pass only the
+// required space is calculated
+static void builderAddToken(struct DatabaseBuilder *b, const char *word, const ULONG length, ULONG goodCount, ULONG badCount)
+{
+  // optimizing filters out words which occured only once so far
+  if(b->optimize == TRUE)
+  {
+    if(goodCount <= 1)
+      goodCount = 0;
+    if(badCount <= 1)
+      badCount = 0;
+  }
+
+  if(goodCount != 0 || badCount != 0)
+  {
+    if(b->image != NULL)
+    {
+      struct DatabaseSlot *slots = databaseSlots(b->image);
+      char *strings = (char *)databaseStrings(b->image);
+      ULONG mask = b->tableSize - 1;
+      struct TokenKey key;
+      ULONG hash;
+      ULONG i;
+
+      key.prefix = NULL;
+      key.prefixLength = 0;
+      key.word = word;
+      key.length = length;
+
+      hash = tokenHashKey(NULL, &key);
+
+      for(i = hash & mask; slots[i].length != 0; i = (i + 1) & mask)
+        ;
+
+      slots[i].hash = htonl(hash);
+      slots[i].offset = htonl(b->stringsSize);
+      slots[i].length = htonl(length);
+      slots[i].goodCount = htonl(goodCount);
+      slots[i].badCount = htonl(badCount);
+
+      memcpy(&strings[b->stringsSize], word, length+1);
+    }
+
+    b->tokenCount++;
+    b->stringsSize += length+1;
+
+    if(goodCount != 0)
+      b->goodWords++;
+    if(badCount != 0)
+      b->badWords++;
+  }
+}
+
+///
+/// builderMergeTokens
+// add the merged words of the current training database and the changed
+// tokens to a new training database
+static void builderMergeTokens(struct DatabaseBuilder *b)
+{
+  const char *image = G->spamFilter.database;
+  struct TokenEnumeration te;
+  struct Token *token;
+
+  ENTER();
+
+  b->tokenCount = 0;
+  b->stringsSize = 0;
+  b->goodWords = 0;
+  b->badWords = 0;
+
+  // first all words of the current database with their changed counts
+  if(image != NULL)
+  {
+    const struct DatabaseHeader *hdr = (const struct DatabaseHeader *)image;
+    const struct DatabaseSlot *slots = databaseSlots(image);
+    const char *strings = databaseStrings(image);
+    ULONG tableSize = ntohl(hdr->tableSize);
+    ULONG i;
+
+    for(i = 0; i < tableSize; i++)
+    {
+      if(slots[i].length != 0)
+      {
+        const char *word = &strings[ntohl(slots[i].offset)];
+        struct Token *good = tokenizerGet(&G->spamFilter.goodTokens, word);
+        struct Token *bad = tokenizerGet(&G->spamFilter.badTokens, word);
+
+        builderAddToken(b, word, ntohl(slots[i].length),
+                        good != NULL ? good->count : ntohl(slots[i].goodCount),
+                        bad != NULL ? bad->count : ntohl(slots[i].badCount));
+      }
+    }
+  }
+
+  // then all new ham words
+  tokenEnumerationInit(&te, &G->spamFilter.goodTokens);
+  while((token = tokenEnumerationNext(&te)) != NULL)
+  {
+    if(databaseFindSlot(token->key.word, token->key.length) == NULL)
+    {
+      struct Token *bad = tokenizerGet(&G->spamFilter.badTokens, token->key.word);
+
+      builderAddToken(b, token->key.word, token->key.length, token->count, bad != NULL ? bad->count : 0);
+    }
+  }
+
+  // and finally all new spam words which are no ham words
+  tokenEnumerationInit(&te, &G->spamFilter.badTokens);
+  while((token = tokenEnumerationNext(&te)) != NULL)
+  {
+    if(databaseFindSlot(token->key.word, token->key.length) == NULL &&
+       tokenizerGet(&G->spamFilter.goodTokens, token->key.word) == NULL)
+    {
+      builderAddToken(b, token->key.word, token->key.length, 0, token->count);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// databaseBuild
+// build a new training database from the current one and the changed tokens
+static BOOL databaseBuild(struct DatabaseBuilder *b)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  // the first pass calculates the required space only
+  b->image = NULL;
+  builderMergeTokens(b);
+
+  // keep the table filled by no more than 50%
+  b->tableSize = HASH_MIN_SIZE;
+  while(b->tableSize < 2 * b->tokenCount)
+    b->tableSize <<= 1;
+
+  b->imageSize = sizeof(struct DatabaseHeader) + b->tableSize * sizeof(struct DatabaseSlot) + b->stringsSize;
+
+  // a zeroed slot is a free slot
+  if((b->image = calloc(1, b->imageSize)) != NULL)
+  {
+    struct DatabaseHeader *hdr = (struct DatabaseHeader *)b->image;
+
+    memcpy(hdr->cookie, databaseCookie, sizeof(hdr->cookie));
+    hdr->goodCount = htonl(G->spamFilter.goodCount);
+    hdr->badCount = htonl(G->spamFilter.badCount);
+    hdr->tableSize = htonl(b->tableSize);
+    hdr->generation = htonl(G->spamFilter.generation+1);
+
+    builderMergeTokens(b);
+
+    hdr->goodWords = htonl(b->goodWords);
+    hdr->badWords = htonl(b->badWords);
+    hdr->stringsSize = htonl(b->stringsSize);
+
+    D(DBF_SPAM, "built training database with %ld words, %ld bytes", b->tokenCount, b->imageSize);
+
+    success = TRUE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// tokenAnalyzerAppendToLog
+// append a changed classification to the delta log of the training data
+static void tokenAnalyzerAppendToLog(const struct Tokenizer *t,
+                                     const enum BayesClassification oldClass,
+                                     const enum BayesClassification newClass)
+{
+  char fname[SIZE_PATHFILE];
+  FILE *stream;
+  BOOL success = FALSE;
+
+  ENTER();
+
+  AddPath(fname, G->MA_MailDir, SPAMLOGFILE, sizeof(fname));
+
+  if((stream = fopen(fname, "ab")) != NULL)
+  {
+    setvbuf(stream, NULL, _IOFBF, SIZE_FILEBUF);
+
+    // a new log starts with the cookie and the generation of the
+    // database the changes apply to
+    if((ftell(stream) > 0 || (fwrite(logCookie, sizeof(logCookie), 1, stream) == 1 && WriteUInt32(stream, G->spamFilter.generation) == 1)) &&
+       WriteUInt32(stream, oldClass) == 1 &&
+       WriteUInt32(stream, newClass) == 1 &&
+       WriteUInt32(stream, t->tokenTable.entryCount) == 1)
+    {
+      struct TokenEnumeration te;
+      struct Token *token;
+
+      success = TRUE;
+
+      tokenEnumerationInit(&te, t);
+      while((token = tokenEnumerationNext(&te)) != NULL)
+      {
+        if(WriteUInt32(stream, token->key.length) != 1 ||
+           fwrite(token->key.word, token->key.length, 1, stream) != 1)
+        {
+          success = FALSE;
+          break;
+        }
+      }
+    }
+
+    if(fclose(stream) != 0)
+      success = FALSE;
+  }
+
+  // the change is still merged into the database on the next flush
+  if(success == FALSE)
+    W(DBF_SPAM, "couldn't append to training data log '%s'", fname);
+
+  LEAVE();
+}
+
+///
+/// tokenAnalyzerSetClassification
+// set a new classification for a token table, substract the data from the old class
+// and add them to the new class, if possible
+static void tokenAnalyzerSetClassification(const struct Tokenizer *t,
+                                           const enum BayesClassification oldClass,
+                                           const enum BayesClassification newClass,
+                                           const BOOL addToLog)
+{
+  struct TokenEnumeration te;
+
+  ENTER();
+
+  ObtainSemaphore(&G->spamFilter.lockSema);
+
+  if(oldClass != newClass)
+  {
+    switch(oldClass)
+    {
+      case BC_SPAM:
+      {
+        // remove tokens from spam corpus
+        if(G->spamFilter.badCount > 0)
+        {
+          G->spamFilter.badCount--;
+          G->spamFilter.numDirtyingMessages++;
+          tokenEnumerationInit(&te, t);
+          trainingForgetTokens(BC_SPAM, &te);
+        }
+      }
+      break;
+
+      case BC_HAM:
+      {
+        // remove tokens from ham corpus
+        if(G->spamFilter.goodCount > 0)
+        {
+          G->spamFilter.goodCount--;
+          G->spamFilter.numDirtyingMessages++;
+          tokenEnumerationInit(&te, t);
+          trainingForgetTokens(BC_HAM, &te);
+        }
+      }
+      break;
+
+      case BC_OTHER:
+        // nothing
+      break;
+    }
+
+    switch(newClass)
+    {
+      case BC_SPAM:
+      {
+        // put tokens into spam corpus
+        G->spamFilter.badCount++;
+        G->spamFilter.numDirtyingMessages++;
+        tokenEnumerationInit(&te, t);
+        trainingRememberTokens(BC_SPAM, &te);
+      }
+      break;
+
+      case BC_HAM:
+      {
+        // put tokens into ham corpus
+        G->spamFilter.goodCount++;
+        G->spamFilter.numDirtyingMessages++;
+        tokenEnumerationInit(&te, t);
+        trainingRememberTokens(BC_HAM, &te);
+      }
+      break;
+
+      case BC_OTHER:
+        // nothing
+      break;
+    }
+
+    // the log is written while the semaphore is still held, so a
+    // merge can't slip in between the change and its log entry
+    if(addToLog == TRUE)
+      tokenAnalyzerAppendToLog(t, oldClass, newClass);
+  }
+
+  ReleaseSemaphore(&G->spamFilter.lockSema);
+
+  LEAVE();
+}
+
+///
+/// tokenAnalyzerReplayLog
+// apply the changes of the delta log which have not been merged into the
+// training database yet. Returns FALSE if the log is damaged.
+static BOOL tokenAnalyzerReplayLog(void)
+{
+  char fname[SIZE_PATHFILE];
+  LONG fileSize;
+  BOOL intact = TRUE;
+
+  ENTER();
+
+  AddPath(fname, G->MA_MailDir, SPAMLOGFILE, sizeof(fname));
+
+  if(ObtainFileInfo(fname, FI_SIZE, &fileSize) == TRUE && fileSize > 0)
+  {
+    FILE *stream;
+
+    intact = FALSE;
+
+    if((stream = fopen(fname, "rb")) != NULL)
+    {
+      unsigned char cookie[4];
+      ULONG generation;
+      ULONG bufferSize = SIZE_LARGE;
+      char *buffer;
+      BOOL stale = FALSE;
+
+      setvbuf(stream, NULL, _IOFBF, SIZE_FILEBUF);
+
+      if(fread(cookie, sizeof(cookie), 1, stream) == 1 &&
+         memcmp(cookie, logCookie, sizeof(cookie)) == 0 &&
+         ReadUInt32(stream, &generation) == 1 &&
+         generation != G->spamFilter.generation)
+      {
+        // the merge which wrote the current database was interrupted
+        // before it could delete the log, its changes are merged already
+        W(DBF_SPAM, "ignoring training data log of generation %ld, database generation is %ld", generation, G->spamFilter.generation);
+        stale = TRUE;
+        intact = TRUE;
+      }
+      else if(ftell(stream) == sizeof(cookie) + sizeof(generation) &&
+              (buffer = malloc(bufferSize)) != NULL)
+      {
+        ULONG records = 0;
+        ULONG oldClass;
+
+        // a short read at the end means that the last record was not
+        // written completely, this is checked below
+        while(ReadUInt32(stream, &oldClass) == 1)
+        {
+          struct Tokenizer t;
+          ULONG newClass;
+          ULONG tokenCount;
+          BOOL complete = FALSE;
+
+          if(ReadUInt32(stream, &newClass) != 1 || ReadUInt32(stream, &tokenCount) != 1 ||
+             oldClass > BC_OTHER || newClass > BC_OTHER)
+          {
+            break;
+          }
+
+          if(tokenizerInit(&t) == TRUE)
+          {
+            ULONG i;
+
+            for(i = 0; i < tokenCount; i++)
+            {
+              ULONG length;
+
+              if(ReadUInt32(stream, &length) != 1 || (LONG)length >= fileSize)
+                break;
+
+              if(length >= bufferSize)
+              {
+                char *newBuffer;
+
+                if((newBuffer = realloc(buffer, length+1)) == NULL)
+                  break;
+
+                buffer = newBuffer;
+                bufferSize = length+1;
+              }
+
+              if(fread(buffer, length, 1, stream) != 1)
+                break;
+
+              buffer[length] = '\0';
+              tokenizerAdd(&t, buffer, NULL, 1);
+            }
+
+            if(i == tokenCount)
+            {
+              tokenAnalyzerSetClassification(&t, oldClass, newClass, FALSE);
+              records++;
+              complete = TRUE;
+            }
+
+            tokenizerCleanup(&t);
+          }
+
+          if(complete == FALSE)
+            break;
+        }
+
+        D(DBF_SPAM, "replayed %ld records of training data log", records);
+
+        if(ftell(stream) == fileSize)
+          intact = TRUE;
+        else
+          W(DBF_SPAM, "training data log '%s' is damaged", fname);
+
+        free(buffer);
+      }
+
+      fclose(stream);
 
-      tokenizerAdd(t, buffer, NULL, count);
+      if(stale == TRUE)
+        DeleteFile(fname);
     }
-
-    free(buffer);
   }
 
-  RETURN(TRUE);
-  return TRUE;
+  RETURN(intact);
+  return intact;
 }
 
 ///
@@ -885,21 +1592,27 @@ static void tokenAnalyzerResetTrainingData(void)
 
   ObtainSemaphore(&G->spamFilter.lockSema);
 
-  if(G->spamFilter.goodCount != 0 || G->spamFilter.goodTokens.tokenTable.entryCount != 0)
-  {
-    tokenizerClearTokens(&G->spamFilter.goodTokens);
-    G->spamFilter.goodCount = 0;
-  }
+  tokenizerClearTokens(&G->spamFilter.goodTokens);
+  tokenizerClearTokens(&G->spamFilter.badTokens);
 
-  if(G->spamFilter.badCount != 0 || G->spamFilter.badTokens.tokenTable.entryCount != 0)
-  {
-    tokenizerClearTokens(&G->spamFilter.badTokens);
-    G->spamFilter.badCount = 0;
-  }
+  free(G->spamFilter.database);
+  G->spamFilter.database = NULL;
+
+  G->spamFilter.goodCount = 0;
+  G->spamFilter.badCount = 0;
+  G->spamFilter.goodWords = 0;
+  G->spamFilter.badWords = 0;
+  G->spamFilter.numDirtyingMessages = 0;
+  G->spamFilter.generation = 0;
 
   // prepare the filename for analysis
   AddPath(fname, G->MA_MailDir, SPAMDATAFILE, sizeof(fname));
 
+  if(FileExists(fname) == TRUE)
+    DeleteFile(fname);
+
+  AddPath(fname, G->MA_MailDir, SPAMLOGFILE, sizeof(fname));
+
   if(FileExists(fname) == TRUE)
     DeleteFile(fname);
 
@@ -909,60 +1622,142 @@ static void tokenAnalyzerResetTrainingData(void)
 }
 
 ///
-/// tokenAnalyzerOptimizeTrainingData
-// Optimize the training data by filtering out words which occured only once so far
-static void tokenAnalyzerOptimizeTrainingData(void)
+/// tokenAnalyzerMergeTrainingData
+// merge the changed tokens into a new training database and write it to
+// disk. The new database is built while holding the semaphore in shared
+// mode only, so classifying mails is not blocked. If the training data
+// has been changed in the meantime the new database is thrown away and
+// the merge is retried on the next flush.
+static BOOL tokenAnalyzerMergeTrainingData(const BOOL optimize)
 {
+  struct DatabaseBuilder b;
+  char fname[SIZE_PATHFILE];
+  char newFname[SIZE_PATHFILE];
+  ULONG numDirtyingMessages;
+  BOOL written = FALSE;
+  BOOL success = FALSE;
+
   ENTER();
 
-  ObtainSemaphore(&G->spamFilter.lockSema);
+  AddPath(fname, G->MA_MailDir, SPAMDATAFILE, sizeof(fname));
+  AddPath(newFname, G->MA_MailDir, SPAMNEWFILE, sizeof(newFname));
+
+  memset(&b, 0, sizeof(b));
+  b.optimize = optimize;
+
+  ObtainSemaphoreShared(&G->spamFilter.lockSema);
+
+  numDirtyingMessages = G->spamFilter.numDirtyingMessages;
 
-  if(G->spamFilter.goodTokens.tokenTable.entryCount != 0)
-    G->spamFilter.numDirtyingMessages += tokenizerOptimizeTokens(&G->spamFilter.goodTokens, 1);
+  if(databaseBuild(&b) == TRUE)
+  {
+    FILE *stream;
+
+    // the complete database is written in one go
+    if((stream = fopen(newFname, "wb")) != NULL)
+    {
+      if(fwrite(b.image, b.imageSize, 1, stream) == 1)
+        written = TRUE;
 
-  if(G->spamFilter.badTokens.tokenTable.entryCount != 0)
-    G->spamFilter.numDirtyingMessages += tokenizerOptimizeTokens(&G->spamFilter.badTokens, 1);
+      if(fclose(stream) != 0)
+        written = FALSE;
+    }
+  }
 
   ReleaseSemaphore(&G->spamFilter.lockSema);
 
+  if(written == TRUE)
+  {
+    ObtainSemaphore(&G->spamFilter.lockSema);
+
+    if(G->spamFilter.numDirtyingMessages == numDirtyingMessages)
+    {
+      // Rename() cannot replace an existing file. If we crash between
+      // deleting the old and renaming the new database the new one is
+      // picked up by tokenAnalyzerRecoverTrainingData() upon next start.
+      DeleteFile(fname);
+
+      if(RenameFile(newFname, fname) == TRUE)
+      {
+        char logFname[SIZE_PATHFILE];
+
+        // the new database replaces the old one and all changes
+        free(G->spamFilter.database);
+        G->spamFilter.database = b.image;
+        G->spamFilter.goodWords = b.goodWords;
+        G->spamFilter.badWords = b.badWords;
+        G->spamFilter.numDirtyingMessages = 0;
+        G->spamFilter.generation++;
+        b.image = NULL;
+
+        tokenizerClearTokens(&G->spamFilter.goodTokens);
+        tokenizerClearTokens(&G->spamFilter.badTokens);
+
+        // all changes are part of the database now, a log which survives
+        // a crash right here is ignored due to its outdated generation
+        AddPath(logFname, G->MA_MailDir, SPAMLOGFILE, sizeof(logFname));
+        DeleteFile(logFname);
+
+        success = TRUE;
+      }
+      else
+        E(DBF_SPAM, "couldn't rename '%s' to '%s'", newFname, fname);
+    }
+    else
+      D(DBF_SPAM, "training data changed during merge, retrying later");
+
+    ReleaseSemaphore(&G->spamFilter.lockSema);
+  }
+
+  // keep a complete new database if the old one is gone already
+  if(success == FALSE && (written == FALSE || FileExists(fname) == TRUE))
+    DeleteFile(newFname);
+
+  free(b.image);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// tokenAnalyzerOptimizeTrainingData
+// Optimize the training data by filtering out words which occured only once so far
+static void tokenAnalyzerOptimizeTrainingData(void)
+{
+  ENTER();
+
+  tokenAnalyzerMergeTrainingData(TRUE);
+
   LEAVE();
 }
 
 ///
-/// tokenAnalyzerWriteTraningData
-// write the accumulated training data to disk
-static void tokenAnalyzerWriteTrainingData(void)
+/// tokenAnalyzerRecoverTrainingData
+// finish a merge of the training data which was interrupted after the new
+// database was written completely
+static void tokenAnalyzerRecoverTrainingData(void)
 {
   char fname[SIZE_PATHFILE];
-  FILE *stream;
+  char newFname[SIZE_PATHFILE];
 
   ENTER();
 
-  // prepare the filename for saving
   AddPath(fname, G->MA_MailDir, SPAMDATAFILE, sizeof(fname));
+  AddPath(newFname, G->MA_MailDir, SPAMNEWFILE, sizeof(newFname));
 
-  // open the .spamdata file for binary write
-  if((stream = fopen(fname, "wb")) != NULL)
+  if(FileExists(newFname) == TRUE)
   {
-    setvbuf(stream, NULL, _IOFBF, SIZE_FILEBUF);
-
-    if(fwrite(magicCookie, sizeof(magicCookie), 1, stream) == 1 &&
-       WriteUInt32(stream, G->spamFilter.goodCount) == 1 &&
-       WriteUInt32(stream, G->spamFilter.badCount) == 1 &&
-       writeTokens(stream, &G->spamFilter.goodTokens) == 1 &&
-       writeTokens(stream, &G->spamFilter.badTokens) == 1)
-    {
-      // everything is ok
-      fclose(stream);
-      G->spamFilter.numDirtyingMessages = 0;
-    }
-    else
+    // the old database is deleted only after the new one has been written
+    // completely. As long as it exists the new one might be incomplete.
+    if(FileExists(fname) == FALSE)
     {
-      // anything went wrong, so delete the training data file
-      fclose(stream);
+      W(DBF_SPAM, "recovering training database from '%s'", newFname);
 
-      DeleteFile(fname);
+      if(RenameFile(newFname, fname) == FALSE)
+        E(DBF_SPAM, "couldn't rename '%s' to '%s'", newFname, fname);
     }
+    else
+      DeleteFile(newFname);
   }
 
   LEAVE();
@@ -970,14 +1765,19 @@ static void tokenAnalyzerWriteTrainingData(void)
 
 ///
 /// tokenAnalyzerReadTrainingData
-// read the training data from disk
+// read the training data from disk. The training database is read in one
+// go and used as is, only the changes logged since the last merge are
+// replayed.
 static void tokenAnalyzerReadTrainingData(void)
 {
   char fname[SIZE_PATHFILE];
   LONG fileSize;
+  BOOL merge = FALSE;
 
   ENTER();
 
+  tokenAnalyzerRecoverTrainingData();
+
   // prepare the filename for loading
   AddPath(fname, G->MA_MailDir, SPAMDATAFILE, sizeof(fname));
 
@@ -991,22 +1791,57 @@ static void tokenAnalyzerReadTrainingData(void)
       unsigned char cookie[4];
       BOOL success = FALSE;
 
-      setvbuf(stream, NULL, _IOFBF, SIZE_FILEBUF);
+      if(fread(cookie, sizeof(cookie), 1, stream) == 1)
+      {
+        if(memcmp(cookie, databaseCookie, sizeof(cookie)) == 0)
+        {
+          char *image;
+
+          if((image = malloc(fileSize)) != NULL)
+          {
+            memcpy(image, cookie, sizeof(cookie));
+
+            if(fread(&image[sizeof(cookie)], fileSize - sizeof(cookie), 1, stream) == 1 &&
+               databaseCheck(image, fileSize) == TRUE)
+            {
+              const struct DatabaseHeader *hdr = (const struct DatabaseHeader *)image;
 
-      fread(cookie, sizeof(cookie), 1, stream);
+              G->spamFilter.database = image;
+              G->spamFilter.goodCount = ntohl(hdr->goodCount);
+              G->spamFilter.badCount = ntohl(hdr->badCount);
+              G->spamFilter.goodWords = ntohl(hdr->goodWords);
+              G->spamFilter.badWords = ntohl(hdr->badWords);
+              G->spamFilter.generation = ntohl(hdr->generation);
 
-      if(memcmp(cookie, magicCookie, sizeof(cookie)) == 0)
-      {
-        if(ReadUInt32(stream, &G->spamFilter.goodCount) == 1 &&
-           ReadUInt32(stream, &G->spamFilter.badCount) == 1)
+              SHOWVALUE(DBF_SPAM, G->spamFilter.goodCount);
+              SHOWVALUE(DBF_SPAM, G->spamFilter.badCount);
+
+              success = TRUE;
+            }
+            else
+              free(image);
+          }
+        }
+        else if(memcmp(cookie, magicCookie, sizeof(cookie)) == 0)
         {
-          SHOWVALUE(DBF_SPAM, G->spamFilter.goodCount);
-          SHOWVALUE(DBF_SPAM, G->spamFilter.badCount);
+          // training data of former versions is read token by token
+          // and converted to the new database format below
+          setvbuf(stream, NULL, _IOFBF, SIZE_FILEBUF);
 
-          if(readTokens(stream, &G->spamFilter.goodTokens, fileSize) == TRUE &&
-             readTokens(stream, &G->spamFilter.badTokens, fileSize) == TRUE)
+          if(ReadUInt32(stream, &G->spamFilter.goodCount) == 1 &&
+             ReadUInt32(stream, &G->spamFilter.badCount) == 1)
           {
-            success = TRUE;
+            SHOWVALUE(DBF_SPAM, G->spamFilter.goodCount);
+            SHOWVALUE(DBF_SPAM, G->spamFilter.badCount);
+
+            if(readTokens(stream, &G->spamFilter.goodTokens, fileSize) == TRUE &&
+               readTokens(stream, &G->spamFilter.badTokens, fileSize) == TRUE)
+            {
+              G->spamFilter.goodWords = G->spamFilter.goodTokens.tokenTable.entryCount;
+              G->spamFilter.badWords = G->spamFilter.badTokens.tokenTable.entryCount;
+              merge = TRUE;
+              success = TRUE;
+            }
           }
         }
       }
@@ -1021,85 +1856,12 @@ static void tokenAnalyzerReadTrainingData(void)
     }
   }
 
-  LEAVE();
-}
-
-///
-/// tokenAnalyzerSetClassification
-// set a new classification for a token table, substract the data from the old class
-// and add them to the new class, if possible
-static void tokenAnalyzerSetClassification(const struct Tokenizer *t,
-                                           const enum BayesClassification oldClass,
-                                           const enum BayesClassification newClass)
-{
-  struct TokenEnumeration te;
-
-  ENTER();
-
-  tokenEnumerationInit(&te, t);
-
-  ObtainSemaphore(&G->spamFilter.lockSema);
-
-  if(oldClass != newClass)
-  {
-    switch(oldClass)
-    {
-      case BC_SPAM:
-      {
-        // remove tokens from spam corpus
-        if(G->spamFilter.badCount > 0)
-        {
-          G->spamFilter.badCount--;
-          G->spamFilter.numDirtyingMessages++;
-          tokenizerForgetTokens(&G->spamFilter.badTokens, &te);
-        }
-      }
-      break;
-
-      case BC_HAM:
-      {
-        // remove tokens from ham corpus
-        if(G->spamFilter.goodCount > 0)
-        {
-          G->spamFilter.goodCount--;
-          G->spamFilter.numDirtyingMessages++;
-          tokenizerForgetTokens(&G->spamFilter.goodTokens, &te);
-        }
-      }
-      break;
-
-      case BC_OTHER:
-        // nothing
-      break;
-    }
-
-    switch(newClass)
-    {
-      case BC_SPAM:
-      {
-        // put tokens into spam corpus
-        G->spamFilter.badCount++;
-        G->spamFilter.numDirtyingMessages++;
-        tokenizerRememberTokens(&G->spamFilter.badTokens, &te);
-      }
-      break;
-
-      case BC_HAM:
-      {
-        // put tokens into ham corpus
-        G->spamFilter.goodCount++;
-        G->spamFilter.numDirtyingMessages++;
-        tokenizerRememberTokens(&G->spamFilter.goodTokens, &te);
-      }
-      break;
-
-      case BC_OTHER:
-        // nothing
-      break;
-    }
-  }
+  // a damaged log is rewritten by merging it into the database
+  if(tokenAnalyzerReplayLog() == FALSE)
+    merge = TRUE;
 
-  ReleaseSemaphore(&G->spamFilter.lockSema);
+  if(merge == TRUE)
+    tokenAnalyzerMergeTrainingData(FALSE);
 
   LEAVE();
 }
@@ -1374,7 +2136,7 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
   if(C->SpamAddressBookIsWhiteList == TRUE)
   {
     // try to find the sender's address in the address book
-    isInWhiteList = (FindPersonInABook(&G->abook, &mail->From) != NULL);
+    isInWhiteList = (FindAddressInABook(&G->abook, mail->From.Address) != NULL);
   }
   else
   {
@@ -1396,11 +2158,11 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
     {
       double nGood = G->spamFilter.goodCount;
 
-      if(nGood != 0 || G->spamFilter.goodTokens.tokenTable.entryCount != 0)
+      if(nGood != 0 || G->spamFilter.goodWords != 0)
       {
         double nBad = G->spamFilter.badCount;
 
-        if(nBad != 0 || G->spamFilter.badTokens.tokenTable.entryCount != 0)
+        if(nBad != 0 || G->spamFilter.badWords != 0)
         {
           ULONG i;
           ULONG goodClues = 0;
@@ -1416,8 +2178,7 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
           for(i = 0; i < count; i++)
           {
             struct Token *token = &tokens[i];
-            const char *word = token->word;
-            struct Token *_t;
+            const char *word = token->key.word;
             double hamCount;
             double spamCount;
             double denom;
@@ -1425,10 +2186,8 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
             double n;
             double distance;
 
-            _t = tokenizerGet(&G->spamFilter.goodTokens, word);
-            hamCount = (_t != NULL) ? _t->count : 0;
-            _t = tokenizerGet(&G->spamFilter.badTokens, word);
-            spamCount = (_t != NULL) ? _t->count : 0;
+            hamCount = trainingCount(BC_HAM, word);
+            spamCount = trainingCount(BC_SPAM, word);
 
             denom = hamCount * nBad + spamCount * nGood;
             // avoid division by zero error
@@ -1594,18 +2353,13 @@ void BayesFilterCleanup(void)
   // check whether BayesFilterInit() has been called before, otherwise we must not access the semaphore
   if(G->spamFilter.initialized == TRUE)
   {
-    ObtainSemaphore(&G->spamFilter.lockSema);
-
-    // only write the spam training data to disk if there are any tokens and if something has changed since the last flush
-    if(G->spamFilter.numDirtyingMessages > 0 && (G->spamFilter.goodCount > 0 || G->spamFilter.badCount > 0))
-    {
-      tokenAnalyzerWriteTrainingData();
-    }
+    // merge the changes since the last flush into the training database,
+    // this keeps the log short for the next start
+    if(G->spamFilter.numDirtyingMessages > 0)
+      tokenAnalyzerMergeTrainingData(FALSE);
 
     tokenAnalyzerCleanup();
 
-    ReleaseSemaphore(&G->spamFilter.lockSema);
-
     // we are no longer initialized
     G->spamFilter.initialized = FALSE;
   }
@@ -1678,6 +2432,185 @@ BOOL BayesFilterClassifyMessage(const struct Mail *mail)
   return isSpam;
 }
 
+///
+/// BayesFilterClassifyBatch
+// Classifies the mails of a batch chunk by chunk. This is executed by
+// several threads in parallel (TA_ClassifyMails), each thread fetches the
+// next chunk of mails until all mails have been classified. Tokenizing a
+// mail needs no lock, the training data is accessed in shared mode only.
+LONG BayesFilterClassifyBatch(struct SpamBatch *batch)
+{
+  LONG classified = 0;
+  BOOL done = FALSE;
+
+  ENTER();
+
+  do
+  {
+    ULONG first;
+    ULONG last;
+
+    // fetch the next chunk of mails
+    ObtainSemaphore(&batch->lock);
+
+    first = batch->nextMail;
+    last = MIN(first + SPAM_CHUNK_SIZE, batch->numMails);
+    if(batch->aborted == TRUE)
+      last = first;
+    batch->nextMail = last;
+
+    ReleaseSemaphore(&batch->lock);
+
+    if(first < last)
+    {
+      ULONG i;
+
+      for(i = first; i < last; i++)
+      {
+        struct Tokenizer t;
+
+        if(tokenizerInit(&t) == TRUE)
+        {
+          tokenizeMail(&t, batch->mails[i]);
+
+          batch->results[i] = (tokenAnalyzerClassifyMessage(&t, batch->mails[i]) == TRUE) ? BC_SPAM : BC_HAM;
+          classified++;
+
+          tokenizerCleanup(&t);
+        }
+      }
+
+      ObtainSemaphore(&batch->lock);
+      batch->processedMails += last - first;
+      ReleaseSemaphore(&batch->lock);
+    }
+    else
+      done = TRUE;
+  }
+  while(done == FALSE && ThreadWasAborted() == FALSE);
+
+  // let the main thread know that we ran out of work
+  ObtainSemaphore(&batch->lock);
+  batch->finishedThreads++;
+  ReleaseSemaphore(&batch->lock);
+
+  RETURN(classified);
+  return classified;
+}
+
+///
+/// BayesFilterClassifyMessages
+// Classifies a number of mails by several threads while the main thread
+// keeps the busy bar and the GUI up to date. The result of each mail is
+// returned in 'results', mails which were not classified due to an abort
+// get BC_OTHER. Returns FALSE if the user aborted the classification.
+BOOL BayesFilterClassifyMessages(struct Mail **mails, enum BayesClassification *results, const ULONG numMails, struct BusyNode *busy)
+{
+  struct SpamBatch batch;
+  BOOL result = TRUE;
+  ULONG numThreads;
+  ULONG startedThreads = 0;
+  ULONG i;
+
+  ENTER();
+
+  memset(&batch, 0, sizeof(batch));
+  InitSemaphore(&batch.lock);
+  batch.mails = mails;
+  batch.results = results;
+  batch.numMails = numMails;
+
+  for(i = 0; i < numMails; i++)
+    results[i] = BC_OTHER;
+
+  // there is no point in starting more threads than there are chunks
+  numThreads = MIN(SPAM_MAX_THREADS, (numMails + SPAM_CHUNK_SIZE - 1) / SPAM_CHUNK_SIZE);
+
+  for(i = 0; i < numThreads; i++)
+  {
+    if(DoAction(NULL, TA_ClassifyMails,
+      TT_ClassifyMails_Batch, &batch,
+      TAG_DONE) == NULL)
+    {
+      W(DBF_SPAM, "could only start %ld of %ld classifying threads", startedThreads, numThreads);
+      break;
+    }
+
+    startedThreads++;
+  }
+
+  D(DBF_SPAM, "classifying %ld mails with %ld threads", numMails, startedThreads);
+
+  if(startedThreads == 0)
+  {
+    // no thread could be started at all, do the work ourself
+    // chunk by chunk to be able to react on an abort
+    while(batch.nextMail < numMails && result == TRUE)
+    {
+      ULONG last = MIN(batch.nextMail + SPAM_CHUNK_SIZE, numMails);
+
+      for(i = batch.nextMail; i < last; i++)
+      {
+        results[i] = BayesFilterClassifyMessage(mails[i]) == TRUE ? BC_SPAM : BC_HAM;
+
+        if(BusyProgress(busy, i+1, numMails) == FALSE)
+        {
+          result = FALSE;
+          break;
+        }
+      }
+
+      batch.nextMail = last;
+    }
+  }
+  else
+  {
+    BOOL finished = FALSE;
+
+    do
+    {
+      ULONG processedMails;
+
+      ObtainSemaphore(&batch.lock);
+      processedMails = batch.processedMails;
+      finished = (batch.finishedThreads == startedThreads);
+      ReleaseSemaphore(&batch.lock);
+
+      if(finished == FALSE)
+      {
+        // set the gauge and check the stopButton status as well
+        if(result == TRUE && BusyProgress(busy, processedMails, numMails) == FALSE)
+        {
+          D(DBF_SPAM, "classification aborted by user");
+
+          // let the threads finish their current chunk and stop then
+          ObtainSemaphore(&batch.lock);
+          batch.aborted = TRUE;
+          ReleaseSemaphore(&batch.lock);
+
+          result = FALSE;
+        }
+
+        // handle the possibly received methods and messages of the threads
+        CheckMethodStack();
+        HandleThreads(TRUE);
+
+        // give the GUI the chance to refresh
+        DoMethod(G->App, MUIM_Application_InputBuffered);
+
+        Delay(1);
+      }
+    }
+    while(finished == FALSE);
+
+    // return the threads to the idle list
+    HandleThreads(TRUE);
+  }
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// BayesFilterSetClassification
 // change the classification of a message
@@ -1702,7 +2635,7 @@ void BayesFilterSetClassification(const struct Mail *mail,
     tokenizeMail(&t, mail);
 
     // now we invert the current classification
-    tokenAnalyzerSetClassification(&t, oldClass, newClass);
+    tokenAnalyzerSetClassification(&t, oldClass, newClass, TRUE);
 
     tokenizerCleanup(&t);
   }
@@ -1737,7 +2670,7 @@ ULONG BayesFilterNumberOfSpamClassifiedWords(void)
   ENTER();
 
   ObtainSemaphoreShared(&G->spamFilter.lockSema);
-  num = G->spamFilter.badTokens.tokenTable.entryCount;
+  num = G->spamFilter.badWords;
   ReleaseSemaphore(&G->spamFilter.lockSema);
 
   RETURN(num);
@@ -1771,7 +2704,7 @@ ULONG BayesFilterNumberOfHamClassifiedWords(void)
   ENTER();
 
   ObtainSemaphoreShared(&G->spamFilter.lockSema);
-  num = G->spamFilter.goodTokens.tokenTable.entryCount;
+  num = G->spamFilter.goodWords;
   ReleaseSemaphore(&G->spamFilter.lockSema);
 
   RETURN(num);
@@ -1784,23 +2717,23 @@ ULONG BayesFilterNumberOfHamClassifiedWords(void)
 void BayesFilterFlushTrainingData(void)
 {
   struct BusyNode *busy;
+  ULONG numDirtyingMessages;
 
   ENTER();
 
   busy = BusyBegin(BUSY_TEXT);
 
-  ObtainSemaphore(&G->spamFilter.lockSema);
-
   BusyText(busy, tr(MSG_BUSYFLUSHINGSPAMTRAININGDATA), "");
 
-  if(C->SpamFlushTrainingDataThreshold > 0 && G->spamFilter.numDirtyingMessages > (ULONG)C->SpamFlushTrainingDataThreshold)
-  {
-    tokenAnalyzerWriteTrainingData();
-    G->spamFilter.numDirtyingMessages = 0;
-  }
-
+  ObtainSemaphoreShared(&G->spamFilter.lockSema);
+  numDirtyingMessages = G->spamFilter.numDirtyingMessages;
   ReleaseSemaphore(&G->spamFilter.lockSema);
 
+  // all changes are already safe in the log, merging them into the
+  // training database is only needed once the log has grown enough
+  if(C->SpamFlushTrainingDataThreshold > 0 && numDirtyingMessages > (ULONG)C->SpamFlushTrainingDataThreshold)
+    tokenAnalyzerMergeTrainingData(FALSE);
+
   BusyEnd(busy);
 
   LEAVE();
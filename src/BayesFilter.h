@@ -34,6 +34,7 @@
 
 // forward declarations
 struct Mail;
+struct BusyNode;
 
 /*
  YAM's spam filter is based upon Mozilla Thunderbird's junk filter.
@@ -55,6 +56,12 @@ enum BayesClassification
   BC_OTHER,
 };
 
+// the rules to split a text into words, these are shared with the
+// full-text index of the folders
+#define BAYES_TOKEN_DELIMITERS  " \t\n\r\f.,"
+#define BAYES_MIN_TOKEN_LENGTH  3
+#define BAYES_MAX_TOKEN_LENGTH  12
+
 #define DEFAULT_SPAM_PROBABILITY_THRESHOLD      90
 #define DEFAULT_FLUSH_TRAINING_DATA_INTERVAL    (15 * 60)
 #define DEFAULT_FLUSH_TRAINING_DATA_THRESHOLD   50
@@ -62,23 +69,43 @@ enum BayesClassification
 struct Tokenizer
 {
   struct HashTable tokenTable;
+  APTR stringPool;                 // pool for the strings of all tokens
 };
 
 struct TokenAnalyzer
 {
-  struct Tokenizer goodTokens;     // non-spam words
-  struct Tokenizer badTokens;      // spam words
-  ULONG goodCount;                 // number of non-spam words
-  ULONG badCount;                  // number of spam words
+  struct Tokenizer goodTokens;     // non-spam words changed since the last merge
+  struct Tokenizer badTokens;      // spam words changed since the last merge
+  char *database;                  // training database as read from disk
+  ULONG goodCount;                 // number of non-spam mails
+  ULONG badCount;                  // number of spam mails
+  ULONG goodWords;                 // number of distinct non-spam words
+  ULONG badWords;                  // number of distinct spam words
   ULONG numDirtyingMessages;       // number of modifications since last save operation
+  ULONG generation;                // generation of the training database on disk
   struct SignalSemaphore lockSema; // semaphore for multi-threading
   BOOL initialized;                // has this structure been initialized?
 };
 
+// the state of a batch classification shared by all classifying threads
+struct SpamBatch
+{
+  struct SignalSemaphore lock;              // protects the counters below
+  struct Mail **mails;                      // the mails to be classified
+  enum BayesClassification *results;        // BC_SPAM or BC_HAM per mail, BC_OTHER if not classified
+  ULONG numMails;                           // number of mails
+  ULONG nextMail;                           // the first mail of the next chunk to be classified
+  ULONG processedMails;                     // number of mails classified so far
+  ULONG finishedThreads;                    // number of threads which ran out of work
+  BOOL aborted;                             // the classification was aborted by the user
+};
+
 /*** Public functions ***/
 BOOL BayesFilterInit(void);
 void BayesFilterCleanup(void);
 BOOL BayesFilterClassifyMessage(const struct Mail *mail);
+BOOL BayesFilterClassifyMessages(struct Mail **mails, enum BayesClassification *results, const ULONG numMails, struct BusyNode *busy);
+LONG BayesFilterClassifyBatch(struct SpamBatch *batch);
 void BayesFilterSetClassification(const struct Mail *mail, const enum BayesClassification newClass);
 ULONG BayesFilterNumberOfSpamClassifiedMails(void);
 ULONG BayesFilterNumberOfSpamClassifiedWords(void);
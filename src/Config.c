@@ -97,6 +97,7 @@
 #include "mui/WriteWindow.h"
 #include "mui/YAMApplication.h"
 
+#include "tcp/imap.h"
 #include "tcp/ssl.h"
 
 #include "Busy.h"
@@ -494,6 +495,7 @@ BOOL CompareConfigs(const struct Config *c1, const struct Config *c2)
      c1->SpamFlushTrainingDataInterval   == c2->SpamFlushTrainingDataInterval &&
      c1->SpamFlushTrainingDataThreshold  == c2->SpamFlushTrainingDataThreshold &&
      c1->SocketTimeout                   == c2->SocketTimeout &&
+     c1->POP3PipelineWindow              == c2->POP3PipelineWindow &&
      c1->PrintMethod                     == c2->PrintMethod &&
      c1->LogfileMode                     == c2->LogfileMode &&
      c1->MDN_NoRecipient                 == c2->MDN_NoRecipient &&
@@ -975,6 +977,7 @@ void SetDefaultConfig(struct Config *co, enum ConfigPage page)
     co->SocketOptions.NoDelay     = FALSE;
     co->SocketOptions.LowDelay    = FALSE;
     co->SocketTimeout = 30; // 30s socket timeout per default
+    co->POP3PipelineWindow = 8; // up to 8 pipelined POP3 commands per default
     co->TRBufferSize = 8192; // 8K buffer per default
     co->EmbeddedMailDelay = 200; // 200ms delay per default
     co->KeepAliveInterval = 30;  // 30s interval per default
@@ -1216,6 +1219,7 @@ int LoadConfig(struct Config *co, const char *fname)
                 else if(stricmp(q, "Description") == 0)          strlcpy(msn->description, value, sizeof(msn->description));
                 else if(stricmp(q, "Server") == 0)               strlcpy(msn->hostname, value, sizeof(msn->hostname));
                 else if(stricmp(q, "Port") == 0)                 msn->port = atoi(value);
+                else if(stricmp(q, "Connections") == 0)          msn->smtpConnections = MAX(1, MIN(atoi(value), SMTP_MAX_CONNECTIONS));
                 else if(stricmp(q, "Enabled") == 0)              Txt2Bool(value) == TRUE ? setFlag(msn->flags, MSF_ACTIVE) : clearFlag(msn->flags, MSF_ACTIVE);
                 else if(stricmp(q, "SecMethod") == 0)            setFlag(msn->flags, SMTPSecMethod2MSF(atoi(value)));
                 else if(stricmp(q, "Allow8bit") == 0)            Txt2Bool(value) == TRUE ? setFlag(msn->flags, MSF_ALLOW_8BIT) : clearFlag(msn->flags, MSF_ALLOW_8BIT);
@@ -1267,6 +1271,7 @@ int LoadConfig(struct Config *co, const char *fname)
                 char *q = strchr(buf, '.')+1;
 
                 if(stricmp(q, "ID") == 0)                          msn->id = strtoul(value, NULL, 16);
+                else if(stricmp(q, "Protocol") == 0)               msn->type = (stricmp(value, "IMAP4") == 0) ? MST_IMAP : MST_POP3;
                 else if(stricmp(q, "Description") == 0)            strlcpy(msn->description, value, sizeof(msn->description));
                 else if(stricmp(q, "Server") == 0)                 strlcpy(msn->hostname, value, sizeof(msn->hostname));
                 else if(stricmp(q, "Port") == 0)                   msn->port = atoi(value);
@@ -1294,6 +1299,8 @@ int LoadConfig(struct Config *co, const char *fname)
                 else if(stricmp(q, "SSLCertFailures") == 0)        msn->certFailures = atoi(value);
                 else if(stricmp(q, "IncomingFolderID") == 0)       msn->mailStoreFolderID = strtoul(value, NULL, 16);
                 else if(stricmp(q, "IncomingFolder") == 0)         strlcpy(msn->mailStoreFolderName, value, sizeof(msn->mailStoreFolderName));
+                else if(stricmp(q, "IMAPMailbox") == 0)            strlcpy(msn->imapMailbox, value, sizeof(msn->imapMailbox));
+                else if(stricmp(q, "IMAPIdle") == 0)               msn->imapIdle = Txt2Bool(value);
                 else
                   W(DBF_CONFIG, "unknown '%s' POP config tag", q);
               }
@@ -1991,6 +1998,7 @@ int LoadConfig(struct Config *co, const char *fname)
             }
           }
           else if(stricmp(buf, "SocketTimeout") == 0)            co->SocketTimeout = atoi(value);
+          else if(stricmp(buf, "POP3PipelineWindow") == 0)       co->POP3PipelineWindow = atoi(value);
           else if(stricmp(buf, "TRBufferSize") == 0)             co->TRBufferSize = atoi(value);
           else if(stricmp(buf, "EmbeddedMailDelay") == 0)        co->EmbeddedMailDelay = atoi(value);
           else if(stricmp(buf, "KeepAliveInterval") == 0)        co->KeepAliveInterval = atoi(value);
@@ -2362,6 +2370,7 @@ BOOL SaveConfig(struct Config *co, const char *fname, BOOL savePrivateData)
       fprintf(fh, "SMTP%02d.Description           = %s\n", i, msn->description);
       fprintf(fh, "SMTP%02d.Server                = %s\n", i, msn->hostname);
       fprintf(fh, "SMTP%02d.Port                  = %d\n", i, msn->port);
+      fprintf(fh, "SMTP%02d.Connections           = %d\n", i, msn->smtpConnections);
       fprintf(fh, "SMTP%02d.SecMethod             = %d\n", i, MSF2SMTPSecMethod(msn));
       fprintf(fh, "SMTP%02d.Allow8bit             = %s\n", i, Bool2Txt(hasServer8bit(msn)));
       fprintf(fh, "SMTP%02d.SMTP-AUTH             = %s\n", i, Bool2Txt(hasServerAuth(msn)));
@@ -2380,6 +2389,7 @@ BOOL SaveConfig(struct Config *co, const char *fname, BOOL savePrivateData)
     IterateList(&co->pop3ServerList, struct MailServerNode *, msn)
     {
       fprintf(fh, "POP%02d.ID                     = %08x\n", i, msn->id);
+      fprintf(fh, "POP%02d.Protocol               = %s\n", i, isIMAPServer(msn) ? "IMAP4" : "POP3");
       fprintf(fh, "POP%02d.Enabled                = %s\n", i, Bool2Txt(isServerActive(msn)));
       fprintf(fh, "POP%02d.Description            = %s\n", i, msn->description);
       fprintf(fh, "POP%02d.Server                 = %s\n", i, msn->hostname);
@@ -2406,6 +2416,8 @@ BOOL SaveConfig(struct Config *co, const char *fname, BOOL savePrivateData)
       fprintf(fh, "POP%02d.SSLCert                = %s\n", i, msn->certFingerprint);
       fprintf(fh, "POP%02d.SSLCertFailures        = %d\n", i, msn->certFailures);
       fprintf(fh, "POP%02d.IncomingFolderID       = %08x\n", i, msn->mailStoreFolderID);
+      fprintf(fh, "POP%02d.IMAPMailbox            = %s\n", i, msn->imapMailbox);
+      fprintf(fh, "POP%02d.IMAPIdle               = %s\n", i, Bool2Txt(msn->imapIdle));
 
       i++;
     }
@@ -2754,6 +2766,7 @@ BOOL SaveConfig(struct Config *co, const char *fname, BOOL savePrivateData)
 
     fprintf(fh, "SocketOptions            =%s\n", buf);
     fprintf(fh, "SocketTimeout            = %d\n", co->SocketTimeout);
+    fprintf(fh, "POP3PipelineWindow       = %d\n", co->POP3PipelineWindow);
     fprintf(fh, "TRBufferSize             = %d\n", co->TRBufferSize);
     fprintf(fh, "EmbeddedMailDelay        = %d\n", co->EmbeddedMailDelay);
     fprintf(fh, "KeepAliveInterval        = %d\n", co->KeepAliveInterval);
@@ -3431,6 +3444,9 @@ void ValidateConfig(struct Config *co, BOOL update, BOOL saveChanges)
 
       // requeue the timerequest for the POP3 servers
       RestartPOP3Timers();
+
+      // watch the IMAP servers with the new settings
+      RestartIMAPWatchers();
     }
 
     if(visited[cp_Spam] == TRUE || updateAll == TRUE)
@@ -141,6 +141,7 @@ struct Config
   int   SpamFlushTrainingDataInterval;
   int   SpamFlushTrainingDataThreshold;
   int   SocketTimeout;
+  int   POP3PipelineWindow;
 
   enum  PrintMethod        PrintMethod;
   enum  LFMode             LogfileMode;
@@ -65,8 +65,8 @@ static ULONG debug_flags = DBF_ALWAYS | DBF_STARTUP; // default debug flags
 static ULONG debug_classes = DBC_ERROR | DBC_DEBUG | DBC_WARNING | DBC_ASSERT | DBC_REPORT | DBC_MTRACK | DBC_TIMEVAL; // default debug classes
 static char debug_modules[256] = "";
 static char debug_files[256] = "";
-static int timer_level = -1;
-static struct TimeVal startTimes[8];
+static BOOL trace_output = FALSE;
+static char trace_file[256] = "T:YAM.trace.json";
 
 // static function prototypes
 static void SetupDbgMalloc(void);
@@ -158,6 +158,58 @@ static void *thread_id[THREAD_MAX];
 static int indent_level[THREAD_MAX];
 static char indent_spaces[INDENT_MAX];
 
+// every thread has its own stack of running clocks and spans
+#define CLOCK_MAX           16
+struct DbgClock
+{
+  struct TimeVal start; // the time the clock was started
+  const char *name;     // the span name, NULL for STARTCLOCK()
+};
+
+static int clock_level[THREAD_MAX];
+static struct DbgClock clock_stack[THREAD_MAX][CLOCK_MAX];
+
+// the types of events recorded in the trace buffers
+#define TRACE_ENTER         0 // ENTER(), name is the function
+#define TRACE_LEAVE         1 // LEAVE(), name is the function
+#define TRACE_RETURN        2 // RETURN(), arg is the result
+#define TRACE_BEGIN         3 // STARTSPAN(), name is the span
+#define TRACE_END           4 // STOPSPAN()
+#define TRACE_CLOCK         5 // STOPCLOCK(), time is the start, arg the duration in us
+#define TRACE_TEXT          6 // all other output, arg is the position in the text ring
+
+// the number of events and text bytes each thread can keep before the
+// oldest ones are overwritten. Both must be a power of two.
+#define TRACE_EVENTS        4096
+#define TRACE_TEXT_SIZE     16384
+#define TRACE_TEXT_MAX      256
+
+struct TraceEvent
+{
+  struct TimeVal time;  // the time the event happened
+  const char *name;     // function, span or clock name, never copied
+  const char *file;     // the source file
+  ULONG line;           // the source line
+  ULONG arg;            // type specific argument
+  UWORD type;           // TRACE_ENTER, TRACE_LEAVE, etc.
+  UWORD dbclass;        // the DBC_#? class of the event
+};
+
+// A trace buffer is only ever written by the thread it belongs to, hence
+// recording an event needs no locking at all. Nothing is formatted before
+// DumpDbgTrace() is called, except for the text of D()/W()/E() etc whose
+// arguments might not exist anymore by then.
+struct TraceBuffer
+{
+  ULONG head;                             // number of events recorded so far
+  ULONG textHead;                         // number of text bytes written so far
+  char name[32];                          // the name of the recording task
+  struct TraceEvent events[TRACE_EVENTS];
+  char text[TRACE_TEXT_SIZE];
+};
+
+static struct TraceBuffer *trace_buffers[THREAD_MAX];
+
 /****************************************************************************/
 
 #if !defined(NO_THREADS)
@@ -189,6 +241,38 @@ static INLINE int _thread_id(const void *thread_ptr)
   return result;
 }
 
+static int _trace_thread_id(const void *thread_ptr)
+{
+  int result=-1;
+  int i;
+
+  // the thread table is only ever appended to, so a thread which has been
+  // seen before can be looked up without obtaining the semaphore
+  for(i=0; i < THREAD_MAX && thread_id[i] != NULL; i++)
+  {
+    if(thread_id[i] == thread_ptr)
+    {
+      result = i;
+      break;
+    }
+  }
+
+  if(result == -1)
+  {
+    THREAD_LOCK;
+    result = _thread_id(thread_ptr);
+    THREAD_UNLOCK;
+  }
+
+  return result;
+}
+
+#define TRACE_THREAD_ID     _trace_thread_id(FindTask(NULL))
+
+#else
+
+#define TRACE_THREAD_ID     0
+
 #endif
 
 static void _DBPRINTF(const char *format, ...)
@@ -336,6 +420,120 @@ static INLINE void _VDPRINTF(const unsigned long c,
 
 /****************************************************************************/
 
+static struct TraceBuffer *_TRACEBUFFER(void)
+{
+  struct TraceBuffer *tb = NULL;
+  const int threadID = TRACE_THREAD_ID;
+
+  if(threadID >= 0)
+  {
+    // the buffer is allocated upon the first event of a thread
+    if((tb = trace_buffers[threadID]) == NULL)
+    {
+      if((tb = calloc(1, sizeof(*tb))) != NULL)
+      {
+        struct Task *task = FindTask(NULL);
+
+        if(task->tc_Node.ln_Name != NULL)
+          strlcpy(tb->name, task->tc_Node.ln_Name, sizeof(tb->name));
+
+        trace_buffers[threadID] = tb;
+      }
+    }
+  }
+
+  return tb;
+}
+
+/****************************************************************************/
+
+static INLINE void _TRACEEVENT(struct TraceBuffer *tb,
+                               const UWORD type, const unsigned long c,
+                               const char *name,
+                               const char *file, const unsigned long line,
+                               const ULONG arg, const struct TimeVal *time)
+{
+  struct TraceEvent *te = &tb->events[tb->head & (TRACE_EVENTS-1)];
+
+  if(time != NULL)
+    te->time = *time;
+  else if(TimerBase != NULL)
+    GetSysTime(TIMEVAL(&te->time));
+  else
+    memset(&te->time, 0, sizeof(te->time));
+
+  te->name = name;
+  te->file = file;
+  te->line = line;
+  te->arg = arg;
+  te->type = type;
+  te->dbclass = c;
+
+  // the event becomes visible to DumpDbgTrace() only after it is complete
+  tb->head++;
+}
+
+/****************************************************************************/
+
+static void _TRACE(const UWORD type, const unsigned long c,
+                   const char *name,
+                   const char *file, const unsigned long line,
+                   const ULONG arg)
+{
+  struct TraceBuffer *tb;
+
+  if((tb = _TRACEBUFFER()) != NULL)
+    _TRACEEVENT(tb, type, c, name, file, line, arg, NULL);
+}
+
+/****************************************************************************/
+
+static void _VTRACE(const unsigned long c,
+                    const char *file, const unsigned long line,
+                    const char *format, va_list args)
+{
+  struct TraceBuffer *tb;
+
+  if((tb = _TRACEBUFFER()) != NULL)
+  {
+    ULONG pos = tb->textHead;
+    ULONG offset = pos & (TRACE_TEXT_SIZE-1);
+    int len;
+
+    // never let a text wrap around the end of the ring
+    if(offset + TRACE_TEXT_MAX > TRACE_TEXT_SIZE)
+    {
+      pos += TRACE_TEXT_SIZE - offset;
+      offset = 0;
+    }
+
+    len = vsnprintf(&tb->text[offset], TRACE_TEXT_MAX, format, args);
+    if(len < 0)
+      len = 0;
+    else if(len >= TRACE_TEXT_MAX)
+      len = TRACE_TEXT_MAX-1;
+
+    tb->textHead = pos + len + 1;
+
+    _TRACEEVENT(tb, TRACE_TEXT, c, NULL, file, line, pos, NULL);
+  }
+}
+
+/****************************************************************************/
+
+static void _TRACEF(const unsigned long c,
+                    const char *file, const unsigned long line,
+                    const char *format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  _VTRACE(c, file, line, format, args);
+  va_end(args);
+}
+
+/****************************************************************************/
+
 void SetupDebug(void)
 {
   char var[256];
@@ -347,6 +545,8 @@ void SetupDebug(void)
   #endif
 
   memset(&indent_level, 0, sizeof(indent_level));
+  memset(&clock_level, 0, sizeof(clock_level));
+  memset(&trace_buffers, 0, sizeof(trace_buffers));
 
   if(GetVar("yamdebug", var, sizeof(var), 0) > 0)
   {
@@ -534,6 +734,24 @@ void SetupDebug(void)
 
             _DBPRINTF("FILE output enabled to: '%s'\n", filename);
           }
+          else if(strnicmp(s, "trace", 5) == 0)
+          {
+            // the user wants all output to be recorded in the trace
+            // buffers and dumped to a Chrome trace file upon exit
+            if(s[5] == ':')
+            {
+              char *ee;
+              char *tt = s+6;
+
+              if((ee = strpbrk(tt, " ,;")) == NULL)
+                strlcpy(trace_file, tt, sizeof(trace_file));
+              else
+                strlcpy(trace_file, tt, ee-tt+1);
+            }
+
+            trace_output = TRUE;
+            _DBPRINTF("TRACE output enabled to: '%s'\n", trace_file);
+          }
           else
           {
             int found=0;
@@ -593,6 +811,22 @@ void SetupDebug(void)
 
 void CleanupDebug(void)
 {
+  if(trace_output == TRUE)
+  {
+    int i;
+
+    DumpDbgTrace();
+
+    // everything from here on goes to the normal output again
+    trace_output = FALSE;
+
+    for(i=0; i < THREAD_MAX; i++)
+    {
+      free(trace_buffers[i]);
+      trace_buffers[i] = NULL;
+    }
+  }
+
   CleanupDbgMalloc();
 
   _DBPRINTF("** Cleaned up debugging ********************************************\n");
@@ -622,37 +856,45 @@ void _ENTER(const unsigned long c, const char *m,
             const char *file, const unsigned long line,
             const char *function)
 {
-  THREAD_LOCK;
-
-  if(matchDebugSpec(c, 0, m, file) == TRUE)
+  if(trace_output == TRUE)
+  {
+    if(matchDebugSpec(c, 0, m, file) == TRUE)
+      _TRACE(TRACE_ENTER, c, function, file, line, 0);
+  }
+  else
   {
-    const int threadID = THREAD_ID;
+    THREAD_LOCK;
 
-    if(ansi_output)
-    {
-      _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:Entering %s%s\n",
-                  ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
-                  DBC_CTRACE_BGCOLOR DBC_CTRACE_STR ANSI_ESC_CLR DBC_CTRACE_COLOR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, function, ANSI_ESC_CLR);
-    }
-    else
+    if(matchDebugSpec(c, 0, m, file) == TRUE)
     {
-      _DBPRINTF("%02ld:%s|%s|%s%s:%ld:Entering %s\n",
-                  threadID,
-                  DBC_CTRACE_STR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, function);
-    }
+      const int threadID = THREAD_ID;
 
-    checkIndentLevel(0);
-  }
+      if(ansi_output)
+      {
+        _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:Entering %s%s\n",
+                    ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
+                    DBC_CTRACE_BGCOLOR DBC_CTRACE_STR ANSI_ESC_CLR DBC_CTRACE_COLOR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, function, ANSI_ESC_CLR);
+      }
+      else
+      {
+        _DBPRINTF("%02ld:%s|%s|%s%s:%ld:Entering %s\n",
+                    threadID,
+                    DBC_CTRACE_STR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, function);
+      }
 
-  INDENT_LEVEL+=1;
+      checkIndentLevel(0);
+    }
 
-  THREAD_UNLOCK;
+    INDENT_LEVEL+=1;
+
+    THREAD_UNLOCK;
+  }
 }
 
 /****************************************************************************/
@@ -661,37 +903,45 @@ void _LEAVE(const unsigned long c, const char *m,
             const char *file, const unsigned long line,
             const char *function)
 {
-  THREAD_LOCK;
-
-  INDENT_LEVEL-=1;
-
-  if(matchDebugSpec(c, 0, m, file) == TRUE)
+  if(trace_output == TRUE)
+  {
+    if(matchDebugSpec(c, 0, m, file) == TRUE)
+      _TRACE(TRACE_LEAVE, c, function, file, line, 0);
+  }
+  else
   {
-    const int threadID = THREAD_ID;
+    THREAD_LOCK;
 
-    if(ansi_output)
-    {
-      _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:Leaving %s%s\n",
-                  ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
-                  DBC_CTRACE_BGCOLOR DBC_CTRACE_STR ANSI_ESC_CLR DBC_CTRACE_COLOR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, function, ANSI_ESC_CLR);
-    }
-    else
+    INDENT_LEVEL-=1;
+
+    if(matchDebugSpec(c, 0, m, file) == TRUE)
     {
-      _DBPRINTF("%02ld:%s|%s|%s%s:%ld:Leaving %s\n",
-                  threadID,
-                  DBC_CTRACE_STR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, function);
+      const int threadID = THREAD_ID;
+
+      if(ansi_output)
+      {
+        _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:Leaving %s%s\n",
+                    ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
+                    DBC_CTRACE_BGCOLOR DBC_CTRACE_STR ANSI_ESC_CLR DBC_CTRACE_COLOR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, function, ANSI_ESC_CLR);
+      }
+      else
+      {
+        _DBPRINTF("%02ld:%s|%s|%s%s:%ld:Leaving %s\n",
+                    threadID,
+                    DBC_CTRACE_STR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, function);
+      }
+
+      checkIndentLevel(0);
     }
 
-    checkIndentLevel(0);
+    THREAD_UNLOCK;
   }
-
-  THREAD_UNLOCK;
 }
 
 /****************************************************************************/
@@ -700,37 +950,45 @@ void _RETURN(const unsigned long c, const char *m,
              const char *file, const unsigned long line,
              const char *function, unsigned long result)
 {
-  THREAD_LOCK;
-
-  INDENT_LEVEL-=1;
-
-  if(matchDebugSpec(c, 0, m, file) == TRUE)
+  if(trace_output == TRUE)
+  {
+    if(matchDebugSpec(c, 0, m, file) == TRUE)
+      _TRACE(TRACE_RETURN, c, function, file, line, result);
+  }
+  else
   {
-    const int threadID = THREAD_ID;
+    THREAD_LOCK;
 
-    if(ansi_output)
-    {
-      _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:Leaving %s (result 0x%08lx, %ld)%s\n",
-                  ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
-                  DBC_CTRACE_BGCOLOR DBC_CTRACE_STR ANSI_ESC_CLR DBC_CTRACE_COLOR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, function, result, result, ANSI_ESC_CLR);
-    }
-    else
+    INDENT_LEVEL-=1;
+
+    if(matchDebugSpec(c, 0, m, file) == TRUE)
     {
-      _DBPRINTF("%02ld:%s|%s|%s%s:%ld:Leaving %s (result 0x%08lx, %ld)\n",
-                  threadID,
-                  DBC_CTRACE_STR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, function, result, result);
+      const int threadID = THREAD_ID;
+
+      if(ansi_output)
+      {
+        _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:Leaving %s (result 0x%08lx, %ld)%s\n",
+                    ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
+                    DBC_CTRACE_BGCOLOR DBC_CTRACE_STR ANSI_ESC_CLR DBC_CTRACE_COLOR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, function, result, result, ANSI_ESC_CLR);
+      }
+      else
+      {
+        _DBPRINTF("%02ld:%s|%s|%s%s:%ld:Leaving %s (result 0x%08lx, %ld)\n",
+                    threadID,
+                    DBC_CTRACE_STR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, function, result, result);
+      }
+
+      checkIndentLevel(0);
     }
 
-    checkIndentLevel(0);
+    THREAD_UNLOCK;
   }
-
-  THREAD_UNLOCK;
 }
 
 /****************************************************************************/
@@ -739,12 +997,16 @@ void _CHECKINDENT(const unsigned long c,
                   const char *file, const unsigned long line,
                   const long level)
 {
-  THREAD_LOCK;
+  // the indention levels are not maintained while tracing
+  if(trace_output == FALSE)
+  {
+    THREAD_LOCK;
 
-  if(matchDebugSpec(c, 0, NULL, file) == TRUE)
-    checkIndentLevel(level);
+    if(matchDebugSpec(c, 0, NULL, file) == TRUE)
+      checkIndentLevel(level);
 
-  THREAD_UNLOCK;
+    THREAD_UNLOCK;
+  }
 }
 
 /****************************************************************************/
@@ -753,64 +1015,72 @@ void _SHOWVALUE(const unsigned long c, const unsigned long f, const char *m,
                 const char *file, const unsigned long line,
                 const unsigned long value, const int size, const char *name)
 {
-  THREAD_LOCK;
-
-  if(matchDebugSpec(c, f, m, file) == TRUE)
+  if(trace_output == TRUE)
   {
-    const int threadID = THREAD_ID;
-    const char *fmt;
+    if(matchDebugSpec(c, f, m, file) == TRUE)
+      _TRACEF(c, file, line, "%s = %ld, 0x%08lx", name, value, value);
+  }
+  else
+  {
+    THREAD_LOCK;
 
-    if(ansi_output)
-    {
-      _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:%s = %ld, 0x",
-                  ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
-                  DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, name, value);
-    }
-    else
+    if(matchDebugSpec(c, f, m, file) == TRUE)
     {
-      _DBPRINTF("%02ld:%s|%s|%s%s:%ld:%s = %ld, 0x",
-                  threadID,
-                  DBC_CTRACE_STR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, name, value);
-    }
+      const int threadID = THREAD_ID;
+      const char *fmt;
 
-    switch(size)
-    {
-      case 1:
-        fmt = "%02lx";
-      break;
+      if(ansi_output)
+      {
+        _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:%s = %ld, 0x",
+                    ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
+                    DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, name, value);
+      }
+      else
+      {
+        _DBPRINTF("%02ld:%s|%s|%s%s:%ld:%s = %ld, 0x",
+                    threadID,
+                    DBC_CTRACE_STR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, name, value);
+      }
 
-      case 2:
-        fmt = "%04lx";
-      break;
+      switch(size)
+      {
+        case 1:
+          fmt = "%02lx";
+        break;
 
-      default:
-        fmt = "%08lx";
-      break;
-    }
+        case 2:
+          fmt = "%04lx";
+        break;
 
-    _DBPRINTF(fmt, value);
+        default:
+          fmt = "%08lx";
+        break;
+      }
 
-    if(size == 1 && value < 256)
-    {
-      if(value < ' ' || (value >= 127 && value < 160))
-        _DBPRINTF(", '\\x%02lx'", value);
+      _DBPRINTF(fmt, value);
+
+      if(size == 1 && value < 256)
+      {
+        if(value < ' ' || (value >= 127 && value < 160))
+          _DBPRINTF(", '\\x%02lx'", value);
+        else
+          _DBPRINTF(", '%c'", (unsigned char)value);
+      }
+
+      if(ansi_output)
+        _DBPRINTF("%s\n", ANSI_ESC_CLR);
       else
-        _DBPRINTF(", '%c'", (unsigned char)value);
+        _DBPRINTF("\n");
     }
 
-    if(ansi_output)
-      _DBPRINTF("%s\n", ANSI_ESC_CLR);
-    else
-      _DBPRINTF("\n");
+    THREAD_UNLOCK;
   }
-
-  THREAD_UNLOCK;
 }
 
 /****************************************************************************/
@@ -819,43 +1089,51 @@ void _SHOWPOINTER(const unsigned long c, const unsigned long f, const char *m,
                   const char *file, const unsigned long line,
                   const void *p, const char *name)
 {
-  THREAD_LOCK;
-
-  if(matchDebugSpec(c, f, m, file) == TRUE)
+  if(trace_output == TRUE)
+  {
+    if(matchDebugSpec(c, f, m, file) == TRUE)
+      _TRACEF(c, file, line, "%s = 0x%08lx", name, p);
+  }
+  else
   {
-    const int threadID = THREAD_ID;
+    THREAD_LOCK;
 
-    if(ansi_output)
+    if(matchDebugSpec(c, f, m, file) == TRUE)
     {
-      _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:%s = ",
-                  ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
-                  DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, name);
-    }
-    else
-    {
-      _DBPRINTF("%02ld:%s|%s|%s%s:%ld:%s = ",
-                  threadID,
-                  DBC_CTRACE_STR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, name);
-    }
+      const int threadID = THREAD_ID;
 
-    if(p != NULL)
-      _DBPRINTF("0x%08lx", p);
-    else
-      _DBPRINTF("NULL");
+      if(ansi_output)
+      {
+        _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:%s = ",
+                    ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
+                    DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, name);
+      }
+      else
+      {
+        _DBPRINTF("%02ld:%s|%s|%s%s:%ld:%s = ",
+                    threadID,
+                    DBC_CTRACE_STR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, name);
+      }
 
-    if(ansi_output)
-      _DBPRINTF("%s\n", ANSI_ESC_CLR);
-    else
-      _DBPRINTF("\n");
-  }
+      if(p != NULL)
+        _DBPRINTF("0x%08lx", p);
+      else
+        _DBPRINTF("NULL");
 
-  THREAD_UNLOCK;
+      if(ansi_output)
+        _DBPRINTF("%s\n", ANSI_ESC_CLR);
+      else
+        _DBPRINTF("\n");
+    }
+
+    THREAD_UNLOCK;
+  }
 }
 
 /****************************************************************************/
@@ -864,33 +1142,41 @@ void _SHOWSTRING(const unsigned long c, const unsigned long f, const char *m,
                  const char *file, const unsigned long line,
                  const char *string, const char *name)
 {
-  THREAD_LOCK;
-
-  if(matchDebugSpec(c, f, m, file) == TRUE)
+  if(trace_output == TRUE)
   {
-    const int threadID = THREAD_ID;
+    if(matchDebugSpec(c, f, m, file) == TRUE)
+      _TRACEF(c, file, line, "%s = 0x%08lx \"%s\"", name, (unsigned long)string, string);
+  }
+  else
+  {
+    THREAD_LOCK;
 
-    if(ansi_output)
-    {
-      _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:%s = 0x%08lx \"%s\"%s\n",
-                  ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
-                  DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, name, (unsigned long)string, string, ANSI_ESC_CLR);
-    }
-    else
+    if(matchDebugSpec(c, f, m, file) == TRUE)
     {
-      _DBPRINTF("%02ld:%s|%s|%s%s:%ld:%s = 0x%08lx \"%s\"\n",
-                  threadID,
-                  DBC_REPORT_STR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, name, (unsigned long)string, string);
+      const int threadID = THREAD_ID;
+
+      if(ansi_output)
+      {
+        _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:%s = 0x%08lx \"%s\"%s\n",
+                    ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
+                    DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, name, (unsigned long)string, string, ANSI_ESC_CLR);
+      }
+      else
+      {
+        _DBPRINTF("%02ld:%s|%s|%s%s:%ld:%s = 0x%08lx \"%s\"\n",
+                    threadID,
+                    DBC_REPORT_STR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, name, (unsigned long)string, string);
+      }
     }
-  }
 
-  THREAD_UNLOCK;
+    THREAD_UNLOCK;
+  }
 }
 
 /****************************************************************************/
@@ -899,33 +1185,41 @@ void _SHOWMSG(const unsigned long c, const unsigned long f, const char *m,
               const char *file, const unsigned long line,
               const char *msg)
 {
-  THREAD_LOCK;
-
-  if(matchDebugSpec(c, f, m, file) == TRUE)
+  if(trace_output == TRUE)
+  {
+    if(matchDebugSpec(c, f, m, file) == TRUE)
+      _TRACEF(c, file, line, "%s", msg);
+  }
+  else
   {
-    const int threadID = THREAD_ID;
+    THREAD_LOCK;
 
-    if(ansi_output)
-    {
-      _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:%s%s\n",
-                  ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
-                  DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, msg, ANSI_ESC_CLR);
-    }
-    else
+    if(matchDebugSpec(c, f, m, file) == TRUE)
     {
-      _DBPRINTF("%02ld:%s|%s|%s%s:%ld:%s\n",
-                  threadID,
-                  DBC_REPORT_STR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, msg);
+      const int threadID = THREAD_ID;
+
+      if(ansi_output)
+      {
+        _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:%s%s\n",
+                    ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
+                    DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, msg, ANSI_ESC_CLR);
+      }
+      else
+      {
+        _DBPRINTF("%02ld:%s|%s|%s%s:%ld:%s\n",
+                    threadID,
+                    DBC_REPORT_STR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, msg);
+      }
     }
-  }
 
-  THREAD_UNLOCK;
+    THREAD_UNLOCK;
+  }
 }
 
 /****************************************************************************/
@@ -934,51 +1228,67 @@ void _SHOWTAGS(const unsigned long c, const unsigned long f, const char *m,
                const char *file, const unsigned long line,
                const struct TagItem *tags)
 {
-  THREAD_LOCK;
-
-  if(matchDebugSpec(c, f, m, file) == TRUE)
+  if(trace_output == TRUE)
   {
-    int i;
-    struct TagItem *tag;
-    struct TagItem *tstate = (struct TagItem *)tags;
-    const int threadID = THREAD_ID;
-
-    if(ansi_output)
-    {
-      _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:tag list %08lx%s\n",
-                  ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
-                  DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, tags, ANSI_ESC_CLR);
-    }
-    else
+    if(matchDebugSpec(c, f, m, file) == TRUE)
     {
-      _DBPRINTF("%02ld:%s|%s|%s%s:%ld:tag list %08lx\n",
-                  threadID,
-                  DBC_REPORT_STR,
-                  _NOW(), _INDENT(),
-                  (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
-                  line, tags);
-    }
+      struct TagItem *tag;
+      struct TagItem *tstate = (struct TagItem *)tags;
 
-    INDENT_LEVEL+=1;
+      _TRACEF(c, file, line, "tag list %08lx", tags);
 
-    i = 0;
-    while((tag = NextTagItem(&tstate)) != NULL)
+      while((tag = NextTagItem(&tstate)) != NULL)
+        _TRACEF(c, file, line, "tag=%08lx data=%08lx", tag->ti_Tag, tag->ti_Data);
+    }
+  }
+  else
+  {
+    THREAD_LOCK;
+
+    if(matchDebugSpec(c, f, m, file) == TRUE)
     {
-      i++;
+      int i;
+      struct TagItem *tag;
+      struct TagItem *tstate = (struct TagItem *)tags;
+      const int threadID = THREAD_ID;
 
       if(ansi_output)
-        _DBPRINTF("%s%2ld: tag=%08lx data=%08lx%s\n", DBC_REPORT_COLOR, i, tag->ti_Tag, tag->ti_Data, ANSI_ESC_CLR);
+      {
+        _DBPRINTF("%s%ldm%02ld:%s%s|%s|%s%s:%ld:tag list %08lx%s\n",
+                    ANSI_ESC_BG, (threadID+1)%6, threadID, ANSI_ESC_CLR,
+                    DBC_REPORT_BGCOLOR DBC_REPORT_STR ANSI_ESC_CLR DBC_REPORT_COLOR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, tags, ANSI_ESC_CLR);
+      }
       else
-        _DBPRINTF("%2ld: tag=%08lx data=%08lx\n", i, tag->ti_Tag, tag->ti_Data);
+      {
+        _DBPRINTF("%02ld:%s|%s|%s%s:%ld:tag list %08lx\n",
+                    threadID,
+                    DBC_REPORT_STR,
+                    _NOW(), _INDENT(),
+                    (strrchr(file, '/') ? strrchr(file, '/')+1 : file),
+                    line, tags);
+      }
+
+      INDENT_LEVEL+=1;
+
+      i = 0;
+      while((tag = NextTagItem(&tstate)) != NULL)
+      {
+        i++;
+
+        if(ansi_output)
+          _DBPRINTF("%s%2ld: tag=%08lx data=%08lx%s\n", DBC_REPORT_COLOR, i, tag->ti_Tag, tag->ti_Data, ANSI_ESC_CLR);
+        else
+          _DBPRINTF("%2ld: tag=%08lx data=%08lx\n", i, tag->ti_Tag, tag->ti_Data);
+      }
+
+      INDENT_LEVEL-=1;
     }
 
-    INDENT_LEVEL-=1;
+    THREAD_UNLOCK;
   }
-
-  THREAD_UNLOCK;
 }
 
 /****************************************************************************/
@@ -987,65 +1297,130 @@ void _DPRINTF(const unsigned long c, const unsigned long f, const char *m,
               const char *file, unsigned long line,
               const char *format, ...)
 {
-  THREAD_LOCK;
-
   if(matchDebugSpec(c, f, m, file) == TRUE)
   {
     va_list args;
 
     va_start(args, format);
-    _VDPRINTF(c, file, line, format, args);
+
+    // a failed assertion aborts right away, so it never makes it into
+    // a trace dump and must always be output immediately
+    if(trace_output == TRUE && c != DBC_ASSERT)
+      _VTRACE(c, file, line, format, args);
+    else
+    {
+      THREAD_LOCK;
+      _VDPRINTF(c, file, line, format, args);
+      THREAD_UNLOCK;
+    }
+
     va_end(args);
   }
-
-  THREAD_UNLOCK;
 }
 
 /****************************************************************************/
 
-void _STARTCLOCK(const unsigned long c, const unsigned long f, const char *m,
-                 const char *file, const unsigned long line)
+static void _PUSHCLOCK(const unsigned long c, const unsigned long f, const char *m,
+                       const char *file, const unsigned long line,
+                       const char *name)
 {
-  THREAD_LOCK;
+  const int threadID = TRACE_THREAD_ID;
 
-  if(matchDebugSpec(c, f, m, file) == TRUE)
+  if(threadID >= 0)
   {
-    if(timer_level + 1 < (int)ARRAY_SIZE(startTimes))
+    // the clock stack is private to the thread, no locking required
+    if(clock_level[threadID] < CLOCK_MAX)
     {
-      timer_level++;
-      GetSysTime(TIMEVAL(&startTimes[timer_level]));
+      struct DbgClock *clock = &clock_stack[threadID][clock_level[threadID]];
+
+      clock_level[threadID]++;
+      clock->name = name;
+
+      if(trace_output == TRUE && name != NULL)
+        _TRACE(TRACE_BEGIN, c, name, file, line, 0);
+
+      GetSysTime(TIMEVAL(&clock->start));
     }
     else
-      _DPRINTF(DBC_ERROR, DBF_ALWAYS, m, file, line, "already %ld clocks in use!", ARRAY_SIZE(startTimes));
+      _DPRINTF(DBC_ERROR, DBF_ALWAYS, m, file, line, "already %ld clocks in use!", CLOCK_MAX);
   }
-
-  THREAD_UNLOCK;
 }
 
 /****************************************************************************/
 
-void _STOPCLOCK(const unsigned long c, const unsigned long f, const char *m,
-                const char *file, const unsigned long line,
-                const char *msg)
+static void _POPCLOCK(const unsigned long c, const unsigned long f, const char *m,
+                      const char *file, const unsigned long line,
+                      const char *msg)
 {
-  THREAD_LOCK;
+  const int threadID = TRACE_THREAD_ID;
 
-  if(matchDebugSpec(c, f, m, file) == TRUE)
+  if(threadID >= 0)
   {
-    if(timer_level >= 0)
+    if(clock_level[threadID] > 0)
     {
+      struct DbgClock *clock;
       struct TimeVal stopTime;
 
       GetSysTime(TIMEVAL(&stopTime));
-      SubTime(TIMEVAL(&stopTime), TIMEVAL(&startTimes[timer_level]));
-      _DPRINTF(DBC_TIMEVAL, f, m, file, line, "operation '%s' took %ld.%06ld seconds", msg, stopTime.Seconds, stopTime.Microseconds);
-      timer_level--;
+
+      clock_level[threadID]--;
+      clock = &clock_stack[threadID][clock_level[threadID]];
+
+      SubTime(TIMEVAL(&stopTime), TIMEVAL(&clock->start));
+
+      if(trace_output == TRUE)
+      {
+        struct TraceBuffer *tb;
+
+        if(clock->name != NULL)
+          _TRACE(TRACE_END, c, clock->name, file, line, 0);
+        else if((tb = _TRACEBUFFER()) != NULL)
+          _TRACEEVENT(tb, TRACE_CLOCK, c, msg, file, line, stopTime.Seconds*1000000 + stopTime.Microseconds, &clock->start);
+      }
+      else
+        _DPRINTF(DBC_TIMEVAL, f, m, file, line, "operation '%s' took %ld.%06ld seconds", clock->name != NULL ? clock->name : msg, stopTime.Seconds, stopTime.Microseconds);
     }
     else
       _DPRINTF(DBC_ERROR, DBF_ALWAYS, m, file, line, "no clocks in use!");
   }
+}
 
-  THREAD_UNLOCK;
+/****************************************************************************/
+
+void _STARTCLOCK(const unsigned long c, const unsigned long f, const char *m,
+                 const char *file, const unsigned long line)
+{
+  if(matchDebugSpec(c, f, m, file) == TRUE)
+    _PUSHCLOCK(c, f, m, file, line, NULL);
+}
+
+/****************************************************************************/
+
+void _STOPCLOCK(const unsigned long c, const unsigned long f, const char *m,
+                const char *file, const unsigned long line,
+                const char *msg)
+{
+  if(matchDebugSpec(c, f, m, file) == TRUE)
+    _POPCLOCK(c, f, m, file, line, msg);
+}
+
+/****************************************************************************/
+
+void _STARTSPAN(const unsigned long c, const unsigned long f, const char *m,
+                const char *file, const unsigned long line,
+                const char *name)
+{
+  if(matchDebugSpec(c, f, m, file) == TRUE)
+    _PUSHCLOCK(c, f, m, file, line, name);
+}
+
+/****************************************************************************/
+
+void _STOPSPAN(const unsigned long c, const unsigned long f, const char *m,
+               const char *file, const unsigned long line)
+{
+  if(matchDebugSpec(c, f, m, file) == TRUE)
+    _POPCLOCK(c, f, m, file, line, NULL);
 }
 
 /****************************************************************************/
@@ -1060,7 +1435,10 @@ void D(const unsigned long f, const char *format, ...)
     va_list args;
 
     va_start(args, format);
-    _VDPRINTF(DBC_DEBUG, __FILE__, __LINE__, format, args);
+    if(trace_output == TRUE)
+      _VTRACE(DBC_DEBUG, __FILE__, __LINE__, format, args);
+    else
+      _VDPRINTF(DBC_DEBUG, __FILE__, __LINE__, format, args);
     va_end(args);
   }
 
@@ -1080,7 +1458,10 @@ void E(const unsigned long f, const char *format, ...)
     va_list args;
 
     va_start(args, format);
-    _VDPRINTF(DBC_ERROR, __FILE__, __LINE__, format, args);
+    if(trace_output == TRUE)
+      _VTRACE(DBC_ERROR, __FILE__, __LINE__, format, args);
+    else
+      _VDPRINTF(DBC_ERROR, __FILE__, __LINE__, format, args);
     va_end(args);
   }
 
@@ -1100,7 +1481,10 @@ void W(const unsigned long f, const char *format, ...)
     va_list args;
 
     va_start(args, format);
-    _VDPRINTF(DBC_WARNING, f, __FILE__, __LINE__, format, args);
+    if(trace_output == TRUE)
+      _VTRACE(DBC_WARNING, __FILE__, __LINE__, format, args);
+    else
+      _VDPRINTF(DBC_WARNING, f, __FILE__, __LINE__, format, args);
     va_end(args);
   }
 
@@ -1331,6 +1715,208 @@ void DumpDbgMalloc(void)
   LEAVE();
 }
 
+///
+/// _JSONSTRING
+// output a string as JSON string literal
+static void _JSONSTRING(FILE *fh, const char *str)
+{
+  const unsigned char *p = (const unsigned char *)str;
+  unsigned char c;
+
+  fputc('"', fh);
+
+  while((c = *p++) != '\0')
+  {
+    if(c == '"' || c == '\\')
+    {
+      fputc('\\', fh);
+      fputc(c, fh);
+    }
+    else if(c < 0x20)
+      fprintf(fh, "\\u%04x", c);
+    else if(c >= 0x80)
+    {
+      // our texts are ISO-8859-1, but JSON must be UTF-8
+      fputc(0xc0 | (c >> 6), fh);
+      fputc(0x80 | (c & 0x3f), fh);
+    }
+    else
+      fputc(c, fh);
+  }
+
+  fputc('"', fh);
+}
+
+///
+/// _JSONTIME
+// output a time stamp as microseconds relative to the given base time
+static void _JSONTIME(FILE *fh, const struct TimeVal *tv, const struct TimeVal *base)
+{
+  struct TimeVal rel;
+
+  // events recorded before timer.device was available have no time
+  if(tv->Seconds != 0 || tv->Microseconds != 0)
+  {
+    rel = *tv;
+    SubTime(TIMEVAL(&rel), TIMEVAL(base));
+  }
+  else
+    memset(&rel, 0, sizeof(rel));
+
+  if(rel.Seconds != 0)
+    fprintf(fh, "%lu%06lu", rel.Seconds, rel.Microseconds);
+  else
+    fprintf(fh, "%lu", rel.Microseconds);
+}
+
+///
+/// _DUMPTRACEEVENT
+// output a single trace event in the Chrome trace event format
+static void _DUMPTRACEEVENT(FILE *fh, const struct TraceBuffer *tb, const struct TraceEvent *te,
+                            const int threadID, const struct TimeVal *base)
+{
+  const char *ph;
+  const char *cat;
+  const char *name = te->name;
+
+  switch(te->type)
+  {
+    case TRACE_ENTER:  ph = "B"; cat = "ctrace"; break;
+    case TRACE_LEAVE:  ph = "E"; cat = "ctrace"; break;
+    case TRACE_RETURN: ph = "E"; cat = "ctrace"; break;
+    case TRACE_BEGIN:  ph = "B"; cat = "span";   break;
+    case TRACE_END:    ph = "E"; cat = "span";   break;
+    case TRACE_CLOCK:  ph = "X"; cat = "clock";  break;
+
+    default:
+    {
+      ph = "i";
+
+      switch(te->dbclass)
+      {
+        case DBC_REPORT:  cat = "report";  break;
+        case DBC_ASSERT:  cat = "assert";  break;
+        case DBC_TIMEVAL: cat = "timeval"; break;
+        case DBC_ERROR:   cat = "error";   break;
+        case DBC_WARNING: cat = "warning"; break;
+        case DBC_MTRACK:  cat = "mtrack";  break;
+        case DBC_TAGS:    cat = "tags";    break;
+        default:          cat = "debug";   break;
+      }
+
+      // the text may have been overwritten by newer texts already
+      if(tb->textHead - te->arg <= TRACE_TEXT_SIZE)
+        name = &tb->text[te->arg & (TRACE_TEXT_SIZE-1)];
+      else
+        name = "<overwritten>";
+    }
+    break;
+  }
+
+  fprintf(fh, "{\"ph\":\"%s\",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":", ph, cat, threadID);
+  _JSONTIME(fh, &te->time, base);
+
+  if(te->type == TRACE_CLOCK)
+    fprintf(fh, ",\"dur\":%lu", te->arg);
+  else if(te->type == TRACE_TEXT)
+    fputs(",\"s\":\"t\"", fh);
+
+  if(name != NULL)
+  {
+    fputs(",\"name\":", fh);
+    _JSONSTRING(fh, name);
+  }
+
+  fprintf(fh, ",\"args\":{\"line\":%lu", te->line);
+
+  if(te->file != NULL)
+  {
+    fputs(",\"file\":", fh);
+    _JSONSTRING(fh, strrchr(te->file, '/') ? strrchr(te->file, '/')+1 : te->file);
+  }
+
+  if(te->type == TRACE_RETURN)
+    fprintf(fh, ",\"result\":%ld", (long)te->arg);
+
+  fputs("}}", fh);
+}
+
+///
+/// DumpDbgTrace
+// write the contents of all trace buffers to the trace file in the Chrome
+// trace event format, which can be viewed with chrome://tracing or Perfetto
+void DumpDbgTrace(void)
+{
+  FILE *fh;
+
+  if(trace_output == TRUE && (fh = fopen(trace_file, "w")) != NULL)
+  {
+    struct TimeVal base;
+    BOOL first = TRUE;
+    int i;
+
+    // the oldest event still available becomes time zero
+    memset(&base, 0, sizeof(base));
+    for(i=0; i < THREAD_MAX; i++)
+    {
+      struct TraceBuffer *tb = trace_buffers[i];
+
+      if(tb != NULL)
+      {
+        ULONG j;
+
+        for(j = (tb->head > TRACE_EVENTS) ? tb->head-TRACE_EVENTS : 0; j < tb->head; j++)
+        {
+          struct TimeVal *tv = &tb->events[j & (TRACE_EVENTS-1)].time;
+
+          if(tv->Seconds != 0 || tv->Microseconds != 0)
+          {
+            if((base.Seconds == 0 && base.Microseconds == 0) ||
+               tv->Seconds < base.Seconds ||
+               (tv->Seconds == base.Seconds && tv->Microseconds < base.Microseconds))
+            {
+              base = *tv;
+            }
+
+            // the events of a thread are in chronological order
+            break;
+          }
+        }
+      }
+    }
+
+    fputs("{\"traceEvents\":[\n", fh);
+
+    for(i=0; i < THREAD_MAX; i++)
+    {
+      struct TraceBuffer *tb = trace_buffers[i];
+
+      if(tb != NULL)
+      {
+        ULONG head = tb->head;
+        ULONG j;
+
+        // name the thread after its task
+        fprintf(fh, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", i);
+        _JSONSTRING(fh, tb->name);
+        fputs("}}", fh);
+        first = FALSE;
+
+        for(j = (head > TRACE_EVENTS) ? head-TRACE_EVENTS : 0; j < head; j++)
+        {
+          fputs(",\n", fh);
+          _DUMPTRACEEVENT(fh, tb, &tb->events[j & (TRACE_EVENTS-1)], i, &base);
+        }
+      }
+    }
+
+    fputs("\n]}\n", fh);
+    fclose(fh);
+
+    _DBPRINTF("trace events written to '%s'\n", trace_file);
+  }
+}
+
 ///
 
 #endif /* DEBUG */
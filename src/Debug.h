@@ -39,6 +39,8 @@
 #undef SHOWMSG
 #undef STARTCLOCK
 #undef STOPCLOCK
+#undef STARTSPAN
+#undef STOPSPAN
 #undef MEMTRACK
 #undef UNMEMTRACK
 #undef D
@@ -57,7 +59,7 @@
 #define DBC_CTRACE   (1<<0) // call tracing (ENTER/LEAVE etc.)
 #define DBC_REPORT   (1<<1) // reports (SHOWVALUE/SHOWSTRING etc.)
 #define DBC_ASSERT   (1<<2) // asserts (ASSERT)
-#define DBC_TIMEVAL  (1<<3) // time evaluations (STARTCLOCK/STOPCLOCK)
+#define DBC_TIMEVAL  (1<<3) // time evaluations (STARTCLOCK/STOPCLOCK/STARTSPAN/STOPSPAN)
 #define DBC_DEBUG    (1<<4) // debugging output D()
 #define DBC_ERROR    (1<<5) // error output     E()
 #define DBC_WARNING  (1<<6) // warning output   W()
@@ -106,6 +108,7 @@
 void SetupDebug(void);
 void CleanupDebug(void);
 void DumpDbgMalloc(void);
+void DumpDbgTrace(void);
 
 void _ENTER(const unsigned long c, const char *m, const char *file, const unsigned long line, const char *function);
 void _LEAVE(const unsigned long c, const char *m, const char *file, const unsigned long line, const char *function);
@@ -119,6 +122,8 @@ void _SHOWTAGS(const unsigned long c, const unsigned long f, const char *m, cons
 void _DPRINTF(const unsigned long c, const unsigned long f, const char *m, const char *file, unsigned long line, const char *format, ...);
 void _STARTCLOCK(const unsigned long c, const unsigned long f, const char *m, const char *file, unsigned long line);
 void _STOPCLOCK(const unsigned long c, const unsigned long f, const char *m, const char *file, unsigned long line, const char *msg);
+void _STARTSPAN(const unsigned long c, const unsigned long f, const char *m, const char *file, unsigned long line, const char *name);
+void _STOPSPAN(const unsigned long c, const unsigned long f, const char *m, const char *file, unsigned long line);
 void _MEMTRACK(const char *file, const int line, const char *func, void *ptr, size_t size);
 void _UNMEMTRACK(const char *file, const int line, const void *ptr);
 void _FLUSH(void);
@@ -140,6 +145,8 @@ void _FLUSH(void);
 #define SHOWTAGS(f, t)        _SHOWTAGS(DBC_TAGS, f, DEBUG_MODULE, __FILE__, __LINE__, t)
 #define STARTCLOCK(f)         _STARTCLOCK(DBC_TIMEVAL, f, DEBUG_MODULE, __FILE__, __LINE__)
 #define STOPCLOCK(f, msg)     _STOPCLOCK(DBC_TIMEVAL, f, DEBUG_MODULE, __FILE__, __LINE__, msg)
+#define STARTSPAN(f, name)    _STARTSPAN(DBC_TIMEVAL, f, DEBUG_MODULE, __FILE__, __LINE__, name) // name must be a string constant
+#define STOPSPAN(f)           _STOPSPAN(DBC_TIMEVAL, f, DEBUG_MODULE, __FILE__, __LINE__)
 #define MEMTRACK(f, p, s)     _MEMTRACK(__FILE__, __LINE__, f, p, s)
 #define UNMEMTRACK(p)         _UNMEMTRACK(__FILE__, __LINE__, p)
 #define FLUSH()               _FLUSH()
@@ -469,6 +476,8 @@ void W(const unsigned long f, const char *format, ...);
 #define SHOWTAGS(f, t)        ((void)0)
 #define STARTCLOCK(f)         ((void)0)
 #define STOPCLOCK(f, m)       ((void)0)
+#define STARTSPAN(f, n)       ((void)0)
+#define STOPSPAN(f)           ((void)0)
 #define MEMTRACK(f, p, s)     ((void)0)
 #define UNMEMTRACK(p)         ((void)0)
 #define FLUSH()               ((void)0)
@@ -478,6 +487,7 @@ void W(const unsigned long f, const char *format, ...);
 #define ASSERT(expression)    ((void)0)
 
 #define DumpDbgMalloc()       ((void)0)
+#define DumpDbgTrace()        ((void)0)
 
 // we output a warning if printf()/kprintf()
 // are used when a non-debug version should be compiled
@@ -195,16 +195,29 @@ char *dstrcpy(char **dstr, const char *src)
 // string concatenation using a dynamic buffer and return the length of the string
 char *dstrcat(char **dstr, const char *src)
 {
-  size_t srcsize;
+  char *result;
+
+  ENTER();
+
+  result = dstrncat(dstr, src, (src != NULL) ? strlen(src) : 0);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// dstrncat
+// concatenate exactly srcsize bytes (which may include NUL bytes) to a
+// dynamic buffer
+char *dstrncat(char **dstr, const char *src, size_t srcsize)
+{
   size_t reqsize;
   struct DynamicString *ds = NULL;
   char *result = NULL;
 
   ENTER();
 
-  if(src != NULL)
-    srcsize = strlen(src);
-  else
+  if(src == NULL)
     srcsize = 0;
 
   reqsize = srcsize;
@@ -249,15 +262,16 @@ char *dstrcat(char **dstr, const char *src)
         *dstr = DSTR_TO_STR(ds);
       }
       else
-        reqsize = 0;
+        srcsize = 0;
     }
   }
 
-  // do a string concatenation into the new buffer
+  // do the concatenation into the new buffer
   if(srcsize > 0)
   {
-    // use strlcpy() instead of strlcat() because we keep track of the current string length
-    ds->strlen += strlcpy(&ds->str[ds->strlen], src, ds->size - ds->strlen);
+    memcpy(&ds->str[ds->strlen], src, srcsize);
+    ds->strlen += srcsize;
+    ds->str[ds->strlen] = '\0';
 
     result = *dstr;
   }
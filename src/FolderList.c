@@ -32,11 +32,197 @@
 
 #include "extrasrc.h"
 
+#include "YAM_mainFolder.h"
+
 #include "FolderList.h"
+#include "HashTable.h"
 #include "MailList.h"
+#include "TextIndex.h"
 
 #include "Debug.h"
 
+// an entry of the message ID indexes of a folder, the layout of the first
+// two members must match struct HashEntry to be able to use the default
+// hash operators. Most IDs are unique and need no further allocation.
+struct MsgIDEntry
+{
+  struct HashEntryHeader header;
+  void *key;          // the compressed message ID
+  ULONG count;        // number of mails with this ID
+  ULONG size;         // number of slots in 'more'
+  struct Mail *first; // the first mail with this ID
+  struct Mail **more; // all further mails with this ID
+};
+
+/// MsgIDClearEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void MsgIDClearEntry(struct HashTable *table, struct HashEntryHeader *entry)
+{
+  struct MsgIDEntry *msgIDEntry = (struct MsgIDEntry *)entry;
+
+  free(msgIDEntry->more);
+  memset(entry, 0, table->entrySize);
+}
+
+///
+/// MsgIDDestroyEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void MsgIDDestroyEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  struct MsgIDEntry *msgIDEntry = (struct MsgIDEntry *)entry;
+
+  free(msgIDEntry->more);
+}
+
+///
+/// msgIDOps
+// the compressed message IDs are CRC32 values already, hence the default
+// pointer hashing is good enough
+static const struct HashTableOps msgIDOps =
+{
+  DefaultHashAllocTable,
+  DefaultHashFreeTable,
+  DefaultHashGetKey,
+  DefaultHashHashKey,
+  DefaultHashMatchEntry,
+  DefaultHashMoveEntry,
+  MsgIDClearEntry,
+  DefaultHashFinalize,
+  NULL,
+  MsgIDDestroyEntry
+};
+
+///
+/// AddMsgIDEntry
+// add a mail to the given message ID index, the index is created on demand
+static void AddMsgIDEntry(struct HashTable **table, const ULONG msgID, struct Mail *mail)
+{
+  ENTER();
+
+  // zero means "no ID" and is never indexed
+  if(msgID != 0)
+  {
+    if(*table == NULL)
+      *table = HashTableNew(&msgIDOps, NULL, sizeof(struct MsgIDEntry), 512);
+
+    if(*table != NULL)
+    {
+      struct MsgIDEntry *entry;
+
+      if((entry = (struct MsgIDEntry *)HashTableOperate(*table, (void *)(IPTR)msgID, htoAdd)) != NULL)
+      {
+        if(entry->count == 0)
+        {
+          // a new entry
+          entry->key = (void *)(IPTR)msgID;
+          entry->first = mail;
+          entry->count = 1;
+        }
+        else
+        {
+          // a duplicate ID, remember it in the overflow array
+          if(entry->count > entry->size)
+          {
+            ULONG newSize = (entry->size == 0) ? 4 : entry->size * 2;
+            struct Mail **newMore;
+
+            if((newMore = realloc(entry->more, newSize * sizeof(*newMore))) != NULL)
+            {
+              entry->more = newMore;
+              entry->size = newSize;
+            }
+          }
+
+          if(entry->count <= entry->size)
+          {
+            entry->more[entry->count-1] = mail;
+            entry->count++;
+          }
+          else
+            E(DBF_FOLDER, "could not enlarge message ID index entry %08lx", msgID);
+        }
+      }
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// RemoveMsgIDEntry
+// remove a mail from the given message ID index
+static void RemoveMsgIDEntry(struct HashTable *table, const ULONG msgID, const struct Mail *mail)
+{
+  ENTER();
+
+  if(table != NULL && msgID != 0)
+  {
+    struct MsgIDEntry *entry;
+
+    entry = (struct MsgIDEntry *)HashTableOperate(table, (void *)(IPTR)msgID, htoLookup);
+    if(HASH_ENTRY_IS_LIVE(&entry->header))
+    {
+      if(entry->first == mail)
+      {
+        if(entry->count > 1)
+        {
+          // promote the first of the duplicates
+          entry->first = entry->more[0];
+          memmove(&entry->more[0], &entry->more[1], (entry->count-2) * sizeof(*entry->more));
+        }
+        entry->count--;
+      }
+      else
+      {
+        ULONG i;
+
+        for(i = 0; i < entry->count-1; i++)
+        {
+          if(entry->more[i] == mail)
+          {
+            memmove(&entry->more[i], &entry->more[i+1], (entry->count-2-i) * sizeof(*entry->more));
+            entry->count--;
+            break;
+          }
+        }
+      }
+
+      if(entry->count == 0)
+        HashTableOperate(table, (void *)(IPTR)msgID, htoRemove);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// GetMsgIDEntry
+// get the nth mail with the given ID from a message ID index
+static struct Mail *GetMsgIDEntry(struct HashTable *table, const ULONG msgID, const ULONG nth)
+{
+  struct Mail *mail = NULL;
+
+  ENTER();
+
+  if(table != NULL && msgID != 0)
+  {
+    struct MsgIDEntry *entry;
+
+    entry = (struct MsgIDEntry *)HashTableOperate(table, (void *)(IPTR)msgID, htoLookup);
+    if(HASH_ENTRY_IS_LIVE(&entry->header) && nth < entry->count)
+    {
+      if(nth == 0)
+        mail = entry->first;
+      else
+        mail = entry->more[nth-1];
+    }
+  }
+
+  RETURN(mail);
+  return mail;
+}
+
+///
 /// InitFolderList
 // initialize a folder list
 void InitFolderList(struct FolderList *flist)
@@ -300,6 +486,9 @@ struct Folder *AllocFolder(void)
 void InitFolder(struct Folder *folder, enum FolderType type)
 {
   struct MailList *messages = folder->messages;
+  struct HashTable *msgIDIndex = folder->msgIDIndex;
+  struct HashTable *irtMsgIDIndex = folder->irtMsgIDIndex;
+  struct TextIndex *textIndex = folder->textIndex;
 
   ENTER();
 
@@ -312,8 +501,11 @@ void InitFolder(struct Folder *folder, enum FolderType type)
     folder->LastActive = -1;
     folder->JumpToUnread = TRUE;
     folder->JumpToRecent = FALSE;
-    // preserve the message list
+    // preserve the message list and its indexes
     folder->messages = messages;
+    folder->msgIDIndex = msgIDIndex;
+    folder->irtMsgIDIndex = irtMsgIDIndex;
+    folder->textIndex = textIndex;
   }
 
   LEAVE();
@@ -326,6 +518,8 @@ void FreeFolder(struct Folder *folder)
 {
   ENTER();
 
+  ClearFolderMsgIDIndex(folder);
+  TextIndexFree(folder);
   DeleteMailList(folder->messages);
   free(folder);
 
@@ -339,6 +533,24 @@ void MoveFolderContents(struct Folder *to, struct Folder *from)
 {
   ENTER();
 
+  // move over the message ID indexes
+  if(to->msgIDIndex == NULL && to->irtMsgIDIndex == NULL)
+  {
+    to->msgIDIndex = from->msgIDIndex;
+    to->irtMsgIDIndex = from->irtMsgIDIndex;
+    from->msgIDIndex = NULL;
+    from->irtMsgIDIndex = NULL;
+  }
+  else
+  {
+    struct MailNode *mnode;
+
+    ForEachMailNode(from->messages, mnode)
+      IndexFolderMail(to, mnode->mail);
+
+    ClearFolderMsgIDIndex(from);
+  }
+
   // move over all messages
   MoveMailList(to->messages, from->messages);
 
@@ -359,6 +571,88 @@ void MoveFolderContents(struct Folder *to, struct Folder *from)
   LEAVE();
 }
 
+///
+/// IndexFolderMail
+// add a mail to the message ID indexes of a folder, the folder's mail list
+// must be locked by the caller
+void IndexFolderMail(struct Folder *folder, struct Mail *mail)
+{
+  ENTER();
+
+  AddMsgIDEntry(&folder->msgIDIndex, mail->cMsgID, mail);
+  AddMsgIDEntry(&folder->irtMsgIDIndex, mail->cIRTMsgID, mail);
+
+  LEAVE();
+}
+
+///
+/// UnindexFolderMail
+// remove a mail from the message ID indexes of a folder, the folder's mail
+// list must be locked by the caller
+void UnindexFolderMail(struct Folder *folder, const struct Mail *mail)
+{
+  ENTER();
+
+  RemoveMsgIDEntry(folder->msgIDIndex, mail->cMsgID, mail);
+  RemoveMsgIDEntry(folder->irtMsgIDIndex, mail->cIRTMsgID, mail);
+
+  LEAVE();
+}
+
+///
+/// ClearFolderMsgIDIndex
+// free the message ID indexes of a folder
+void ClearFolderMsgIDIndex(struct Folder *folder)
+{
+  ENTER();
+
+  if(folder->msgIDIndex != NULL)
+  {
+    HashTableDestroy(folder->msgIDIndex);
+    folder->msgIDIndex = NULL;
+  }
+
+  if(folder->irtMsgIDIndex != NULL)
+  {
+    HashTableDestroy(folder->irtMsgIDIndex);
+    folder->irtMsgIDIndex = NULL;
+  }
+
+  LEAVE();
+}
+
+///
+/// GetMailByCompressedMsgID
+// get the nth mail of a folder with the given compressed message ID,
+// returns NULL if there are no further mails with this ID
+struct Mail *GetMailByCompressedMsgID(const struct Folder *folder, const ULONG cMsgID, const ULONG nth)
+{
+  struct Mail *mail;
+
+  ENTER();
+
+  mail = GetMsgIDEntry(folder->msgIDIndex, cMsgID, nth);
+
+  RETURN(mail);
+  return mail;
+}
+
+///
+/// GetMailByCompressedIRTMsgID
+// get the nth mail of a folder which is a reply to the given compressed
+// message ID, returns NULL if there are no further replies
+struct Mail *GetMailByCompressedIRTMsgID(const struct Folder *folder, const ULONG cIRTMsgID, const ULONG nth)
+{
+  struct Mail *mail;
+
+  ENTER();
+
+  mail = GetMsgIDEntry(folder->irtMsgIDIndex, cIRTMsgID, nth);
+
+  RETURN(mail);
+  return mail;
+}
+
 ///
 /// IsUniqueFolderID
 // check for a unique folder ID
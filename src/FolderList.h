@@ -38,6 +38,7 @@
 // forward declarations
 struct SignalSemaphore;
 struct Folder;
+struct Mail;
 
 struct FolderList
 {
@@ -66,6 +67,11 @@ struct Folder *AllocFolder();
 void InitFolder(struct Folder *folder, enum FolderType type);
 void FreeFolder(struct Folder *folder);
 void MoveFolderContents(struct Folder *to, struct Folder *from);
+void IndexFolderMail(struct Folder *folder, struct Mail *mail);
+void UnindexFolderMail(struct Folder *folder, const struct Mail *mail);
+void ClearFolderMsgIDIndex(struct Folder *folder);
+struct Mail *GetMailByCompressedMsgID(const struct Folder *folder, const ULONG cMsgID, const ULONG nth);
+struct Mail *GetMailByCompressedIRTMsgID(const struct Folder *folder, const ULONG cIRTMsgID, const ULONG nth);
 BOOL IsUniqueFolderID(const struct FolderList *flist, const int id);
 struct Folder *FindFolderByID(const struct FolderList *flist, const int id);
 
@@ -1006,12 +1006,13 @@ static void ProcessImport(struct TransferContext *tc, const char *importFile, st
               // use the current date/time as transfer date
               GetSysTimeUTC(&mail->transDate);
 
+              // update the mailFile Path before the mail is recorded
+              // in the index journal
+              SetMailFile(mail, FilePart(mfilePath));
+
               // add the mail to the folderlist now
               AddMailToFolder(mail, folder);
 
-              // update the mailFile Path
-              strlcpy(mail->MailFile, FilePart(mfilePath), sizeof(mail->MailFile));
-
               // if this was a compressed/encrypted folder we need to pack the mail now
               if(folder->Mode > FM_SIMPLE)
                 RepackMailFile(mail, -1, NULL);
@@ -1096,12 +1097,13 @@ static void ProcessImport(struct TransferContext *tc, const char *importFile, st
               // use the current date/time as transfer date
               GetSysTimeUTC(&mail->transDate);
 
+              // update the mailFile Path before the mail is recorded
+              // in the index journal
+              SetMailFile(mail, FilePart(mfilePath));
+
               // add the mail to the folderlist now
               AddMailToFolder(mail, folder);
 
-              // update the mailFile Path
-              strlcpy(mail->MailFile, FilePart(mfilePath), sizeof(mail->MailFile));
-
               // if this was a compressed/encrypted folder we need to pack the mail now
               if(folder->Mode > FM_SIMPLE)
                 RepackMailFile(mail, -1, NULL);
@@ -35,19 +35,540 @@
 
 #include "YAM.h"
 #include "YAM_mainFolder.h"
+#include "YAM_stringsizes.h"
 
+#include "HashTable.h"
 #include "MailList.h"
+#include "StringTable.h"
 
 #include "Debug.h"
 
+// the minimum number of slots a mail list allocates for its nodes
+#define MAILLIST_MINSIZE 32
+
+// the number of characters of a mail file name in front of the status characters
+#define MAILFILE_KEYLEN 17
+
+// lists with less mails are searched for a file name without an index
+#define MAILFILE_INDEX_MINCOUNT 64
+
+// an entry of the file name index of a mail list, the name itself
+// is taken from the node's mail
+struct MailFileEntry
+{
+  struct HashEntryHeader header;
+  struct MailNode *mnode;
+};
+
+// counts the changes of mail file names, all file name indexes built
+// before a change are outdated
+static ULONG mailFileGeneration = 0;
+
+// the number of items a mail pool allocates at once
+#define MAILPOOL_BATCHSIZE 256
+
+// a pool for the mails and mail nodes of a single folder, which makes
+// it possible to free all of them at once when the folder is flushed
+struct MailPool
+{
+  struct SignalSemaphore *lockSemaphore; // protects the fields below
+  APTR mailItemPool;                     // item pool for struct Mail
+  APTR mailNodeItemPool;                 // item pool for struct MailNode
+  ULONG numItems;                        // number of mails and nodes currently allocated
+  BOOL orphaned;                         // the pool is deleted together with its last item
+};
+
+/// FreeMailPool
+// free a mail pool and all items allocated from it
+static void FreeMailPool(struct MailPool *pool)
+{
+  ENTER();
+
+  if(pool->mailItemPool != NULL)
+    FreeSysObject(ASOT_ITEMPOOL, pool->mailItemPool);
+  if(pool->mailNodeItemPool != NULL)
+    FreeSysObject(ASOT_ITEMPOOL, pool->mailNodeItemPool);
+  if(pool->lockSemaphore != NULL)
+    FreeSysObject(ASOT_SEMAPHORE, pool->lockSemaphore);
+
+  free(pool);
+
+  LEAVE();
+}
+
+///
+/// CreateMailPool
+// create a new pool for mails and mail nodes
+struct MailPool *CreateMailPool(void)
+{
+  struct MailPool *pool;
+
+  ENTER();
+
+  if((pool = calloc(1, sizeof(*pool))) != NULL)
+  {
+    pool->lockSemaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE);
+    pool->mailItemPool = AllocSysObjectTags(ASOT_ITEMPOOL,
+      ASOITEM_MFlags, MEMF_SHARED|MEMF_CLEAR,
+      ASOITEM_ItemSize, sizeof(struct Mail),
+      ASOITEM_BatchSize, MAILPOOL_BATCHSIZE,
+      ASOITEM_Protected, TRUE,
+      TAG_DONE);
+    pool->mailNodeItemPool = AllocSysObjectTags(ASOT_ITEMPOOL,
+      ASOITEM_MFlags, MEMF_SHARED|MEMF_CLEAR,
+      ASOITEM_ItemSize, sizeof(struct MailNode),
+      ASOITEM_BatchSize, MAILPOOL_BATCHSIZE,
+      ASOITEM_Protected, TRUE,
+      TAG_DONE);
+
+    if(pool->lockSemaphore == NULL || pool->mailItemPool == NULL || pool->mailNodeItemPool == NULL)
+    {
+      E(DBF_MAIL, "failed to create mail pool");
+      FreeMailPool(pool);
+      pool = NULL;
+    }
+  }
+
+  RETURN(pool);
+  return pool;
+}
+
+///
+/// DeleteMailPool
+// delete a mail pool, if there are still mails or mail nodes in use which
+// were allocated from this pool it is deleted as soon as the last one is freed
+void DeleteMailPool(struct MailPool *pool)
+{
+  ENTER();
+
+  if(pool != NULL)
+  {
+    BOOL unused;
+
+    ObtainSemaphore(pool->lockSemaphore);
+    pool->orphaned = TRUE;
+    unused = (pool->numItems == 0);
+    ReleaseSemaphore(pool->lockSemaphore);
+
+    if(unused == TRUE)
+      FreeMailPool(pool);
+    else
+      D(DBF_MAIL, "mail pool %08lx orphaned with %ld items still in use", pool, pool->numItems);
+  }
+
+  LEAVE();
+}
+
+///
+/// AllocPoolItem
+// allocate a mail or a mail node from a pool, the global item pools
+// are used if no pool is given
+static APTR AllocPoolItem(struct MailPool *pool, const BOOL node)
+{
+  APTR item;
+
+  ENTER();
+
+  if(pool != NULL)
+  {
+    if((item = ItemPoolAlloc(node == TRUE ? pool->mailNodeItemPool : pool->mailItemPool)) != NULL)
+    {
+      ObtainSemaphore(pool->lockSemaphore);
+      pool->numItems++;
+      ReleaseSemaphore(pool->lockSemaphore);
+    }
+  }
+  else
+    item = ItemPoolAlloc(node == TRUE ? G->mailNodeItemPool : G->mailItemPool);
+
+  RETURN(item);
+  return item;
+}
+
+///
+/// FreePoolItem
+// return a mail or a mail node to the pool it was allocated from
+static void FreePoolItem(struct MailPool *pool, const BOOL node, APTR item)
+{
+  ENTER();
+
+  if(pool != NULL)
+  {
+    BOOL unused;
+
+    ItemPoolFree(node == TRUE ? pool->mailNodeItemPool : pool->mailItemPool, item);
+
+    ObtainSemaphore(pool->lockSemaphore);
+    pool->numItems--;
+    unused = (pool->orphaned == TRUE && pool->numItems == 0);
+    ReleaseSemaphore(pool->lockSemaphore);
+
+    // the last item of an orphaned pool takes the pool with it
+    if(unused == TRUE)
+      FreeMailPool(pool);
+  }
+  else
+    ItemPoolFree(node == TRUE ? G->mailNodeItemPool : G->mailItemPool, item);
+
+  LEAVE();
+}
+
+///
+/// CanFlushMailPool
+// check if all items of the pool of a mail list are referenced by this list
+// only, in this case the complete pool can be freed at once
+static BOOL CanFlushMailPool(const struct MailList *mlist)
+{
+  struct MailPool *pool = mlist->pool;
+  struct MailNode *mnode;
+  ULONG listItems = 0;
+  BOOL canFlush = TRUE;
+
+  ENTER();
+
+  ForEachMailNode(mlist, mnode)
+  {
+    struct Mail *mail = mnode->mail;
+
+    if(mnode->pool == pool)
+      listItems++;
+
+    if(mail != NULL && mail->pool == pool)
+    {
+      // mails which are referenced by other lists as well must survive
+      if(mail->RefCounter != 1)
+      {
+        canFlush = FALSE;
+        break;
+      }
+
+      listItems++;
+    }
+  }
+
+  if(canFlush == TRUE)
+  {
+    ObtainSemaphore(pool->lockSemaphore);
+    canFlush = (pool->numItems == listItems);
+    ReleaseSemaphore(pool->lockSemaphore);
+  }
+
+  RETURN(canFlush);
+  return canFlush;
+}
+
+///
+/// RenumberMailNodes
+// update the slot numbers of the nodes within the given range of slots
+static void RenumberMailNodes(struct MailList *mlist, ULONG from, const ULONG to)
+{
+  while(from < to)
+  {
+    mlist->nodes[from]->index = from;
+    from++;
+  }
+}
+
+///
+/// ResizeMailList
+// make sure the node array of a list has at least the given number of slots
+// behind the first node
+static BOOL ResizeMailList(struct MailList *mlist, const ULONG size)
+{
+  BOOL success = TRUE;
+
+  ENTER();
+
+  if(mlist->first + size > mlist->size)
+  {
+    if(mlist->first != 0 && mlist->first >= mlist->size / 4 && size <= mlist->size)
+    {
+      // enough room if the unused slots at the front are given up
+      memmove(&mlist->nodes[0], &mlist->nodes[mlist->first], mlist->count * sizeof(*mlist->nodes));
+      mlist->first = 0;
+      RenumberMailNodes(mlist, 0, mlist->count);
+    }
+    else
+    {
+      ULONG newSize = MAX(mlist->size * 2, MAILLIST_MINSIZE);
+      struct MailNode **newNodes;
+
+      newSize = MAX(newSize, mlist->first + size);
+
+      // the slot numbers stay the same when the array is moved
+      if((newNodes = realloc(mlist->nodes, newSize * sizeof(*newNodes))) != NULL)
+      {
+        mlist->nodes = newNodes;
+        mlist->size = newSize;
+      }
+      else
+      {
+        E(DBF_MAIL, "failed to resize mail list %08lx to %ld nodes", mlist, newSize);
+        success = FALSE;
+      }
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// MailFileHashKey
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static ULONG MailFileHashKey(UNUSED struct HashTable *table, const void *key)
+{
+  const unsigned char *s = (const unsigned char *)key;
+  ULONG h = 0;
+  int i;
+
+  // only the name without the status characters is hashed
+  for(i = 0; i < MAILFILE_KEYLEN && s[i] != '\0'; i++)
+    h = (h >> (HASH_BITS - 4)) ^ (h << 4) ^ s[i];
+
+  return h;
+}
+
+///
+/// MailFileGetKey
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static const void *MailFileGetKey(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  return ((const struct MailFileEntry *)entry)->mnode->mail->MailFile;
+}
+
+///
+/// MailFileMatchEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static BOOL MailFileMatchEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry, const void *key)
+{
+  return (strncmp(((const struct MailFileEntry *)entry)->mnode->mail->MailFile, key, MAILFILE_KEYLEN) == 0);
+}
+
+///
+/// mailFileOps
+static const struct HashTableOps mailFileOps =
+{
+  DefaultHashAllocTable,
+  DefaultHashFreeTable,
+  MailFileGetKey,
+  MailFileHashKey,
+  MailFileMatchEntry,
+  DefaultHashMoveEntry,
+  DefaultHashClearEntry,
+  DefaultHashFinalize,
+  NULL,
+  NULL
+};
+
+///
+/// DropMailFileIndex
+// throw away the file name index of a list, it is rebuilt on demand
+static void DropMailFileIndex(struct MailList *mlist)
+{
+  ENTER();
+
+  if(mlist->fileIndex != NULL)
+  {
+    HashTableDestroy(mlist->fileIndex);
+    mlist->fileIndex = NULL;
+  }
+  mlist->fileIndexDuplicates = 0;
+
+  LEAVE();
+}
+
+///
+/// IndexMailFile
+// add the file name of a node's mail to the index of a list, if there is one
+static void IndexMailFile(struct MailList *mlist, struct MailNode *mnode)
+{
+  ENTER();
+
+  if(mlist->fileIndex != NULL && mnode->mail != NULL)
+  {
+    struct MailFileEntry *entry;
+
+    if((entry = (struct MailFileEntry *)HashTableOperate(mlist->fileIndex, mnode->mail->MailFile, htoAdd)) != NULL)
+    {
+      // the first node with a certain name wins
+      if(entry->mnode == NULL)
+        entry->mnode = mnode;
+      else if(entry->mnode != mnode)
+        mlist->fileIndexDuplicates++;
+    }
+    else
+      DropMailFileIndex(mlist);
+  }
+
+  LEAVE();
+}
+
+///
+/// UnindexMailFile
+// remove the file name of a node's mail from the index of a list
+static void UnindexMailFile(struct MailList *mlist, struct MailNode *mnode)
+{
+  ENTER();
+
+  if(mlist->fileIndex != NULL && mnode->mail != NULL)
+  {
+    if(mlist->fileIndexGeneration != mailFileGeneration || mlist->fileIndexDuplicates != 0)
+    {
+      // the index is outdated anyway or another node with the same name
+      // must take over, both is handled by building a new index
+      DropMailFileIndex(mlist);
+    }
+    else
+    {
+      struct MailFileEntry *entry;
+
+      entry = (struct MailFileEntry *)HashTableOperate(mlist->fileIndex, mnode->mail->MailFile, htoLookup);
+      if(HASH_ENTRY_IS_BUSY(&entry->header) && entry->mnode == mnode)
+        HashTableRawRemove(mlist->fileIndex, &entry->header);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// BuildMailFileIndex
+// build the file name index of a list
+static BOOL BuildMailFileIndex(struct MailList *mlist)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  DropMailFileIndex(mlist);
+
+  if((mlist->fileIndex = HashTableNew(&mailFileOps, NULL, sizeof(struct MailFileEntry), mlist->count)) != NULL)
+  {
+    ULONG i;
+
+    mlist->fileIndexGeneration = mailFileGeneration;
+
+    for(i = mlist->first; i < mlist->first + mlist->count && mlist->fileIndex != NULL; i++)
+      IndexMailFile(mlist, mlist->nodes[i]);
+
+    success = (mlist->fileIndex != NULL);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// InsertMailNode
+// insert a node at the given position of a list, the position is
+// relative to the first node
+static BOOL InsertMailNode(struct MailList *mlist, struct MailNode *mnode, const ULONG position)
+{
+  BOOL success = TRUE;
+  ULONG slot;
+
+  ENTER();
+
+  if(mlist->first != 0 && position < mlist->count / 2)
+  {
+    // move the nodes in front of the new one one slot towards the front
+    mlist->first--;
+    slot = mlist->first + position;
+    memmove(&mlist->nodes[mlist->first], &mlist->nodes[mlist->first + 1], position * sizeof(*mlist->nodes));
+    RenumberMailNodes(mlist, mlist->first, slot);
+  }
+  else if(ResizeMailList(mlist, mlist->count + 1) == TRUE)
+  {
+    // move the nodes behind the new one one slot towards the end
+    slot = mlist->first + position;
+    memmove(&mlist->nodes[slot + 1], &mlist->nodes[slot], (mlist->count - position) * sizeof(*mlist->nodes));
+    RenumberMailNodes(mlist, slot + 1, mlist->first + mlist->count + 1);
+  }
+  else
+    success = FALSE;
+
+  if(success == TRUE)
+  {
+    mlist->nodes[slot] = mnode;
+    mlist->count++;
+    mnode->list = mlist;
+    mnode->index = slot;
+
+    IndexMailFile(mlist, mnode);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// SortMailNodes
+// sort an array of mail nodes, equal nodes keep their order
+// the buffer must have room for at least half of the nodes
+static void SortMailNodes(struct MailNode **nodes, struct MailNode **buffer, const ULONG count, int (* compare)(const struct MailNode *m1, const struct MailNode *m2))
+{
+  if(buffer == NULL || count <= 8)
+  {
+    ULONG i;
+
+    // insertion sort for short arrays or if there is no buffer
+    for(i = 1; i < count; i++)
+    {
+      struct MailNode *mnode = nodes[i];
+      ULONG j = i;
+
+      while(j > 0 && compare(nodes[j-1], mnode) > 0)
+      {
+        nodes[j] = nodes[j-1];
+        j--;
+      }
+
+      nodes[j] = mnode;
+    }
+  }
+  else
+  {
+    ULONG half = count / 2;
+
+    SortMailNodes(nodes, buffer, half, compare);
+    SortMailNodes(&nodes[half], buffer, count - half, compare);
+
+    // merge both halves unless they are in order already
+    if(compare(nodes[half-1], nodes[half]) > 0)
+    {
+      ULONG left = 0;
+      ULONG right = half;
+      ULONG i = 0;
+
+      memcpy(buffer, nodes, half * sizeof(*nodes));
+
+      while(left < half && right < count)
+      {
+        // take the left node in case of equal nodes to keep the order
+        if(compare(nodes[right], buffer[left]) < 0)
+          nodes[i++] = nodes[right++];
+        else
+          nodes[i++] = buffer[left++];
+      }
+
+      while(left < half)
+        nodes[i++] = buffer[left++];
+    }
+  }
+}
+
+///
 /// InitMailList
-// initialize a mail list
+// reset a mail list to an empty list, the nodes are NOT freed
 void InitMailList(struct MailList *mlist)
 {
   ENTER();
 
-  NewMinList(&mlist->list);
+  mlist->first = 0;
   mlist->count = 0;
+  mlist->pool = NULL;
+  DropMailFileIndex(mlist);
 
   LEAVE();
 }
@@ -61,22 +582,15 @@ struct MailList *CreateMailList(void)
 
   ENTER();
 
-  // at first create the list itself
-  if((mlist = AllocSysObjectTags(ASOT_LIST,
-    ASOLIST_Size, sizeof(*mlist),
-    ASOLIST_Min,  TRUE,
-    TAG_DONE)) != NULL)
+  // at first create the list itself, the node array is allocated
+  // as soon as the first node is added
+  if((mlist = calloc(1, sizeof(*mlist))) != NULL)
   {
     // now create the arbitration semaphore
-    if((mlist->lockSemaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) != NULL)
-    {
-      // no mails in the list so far
-      mlist->count = 0;
-    }
-    else
+    if((mlist->lockSemaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) == NULL)
     {
       // free the list again on failure
-      FreeSysObject(ASOT_LIST, mlist);
+      free(mlist);
       mlist = NULL;
     }
   }
@@ -91,15 +605,41 @@ struct MailList *CreateMailList(void)
 // if locking of the list is needed this must be done by the calling function
 void ClearMailList(struct MailList *mlist)
 {
-  struct MailNode *mnode;
-  struct MailNode *succ;
+  struct MailPool *pool = mlist->pool;
+  ULONG i;
 
   ENTER();
 
-  SafeIterateList(&mlist->list, struct MailNode *, mnode, succ)
+  if(pool != NULL && CanFlushMailPool(mlist) == TRUE)
   {
-    DeleteMailNode(mnode);
+    D(DBF_MAIL, "flushing mail pool %08lx of list %08lx with %ld mails", pool, mlist, mlist->count);
+
+    // only the strings and the items from other pools must be freed one
+    // by one, everything else is freed together with the pool
+    for(i = mlist->first; i < mlist->first + mlist->count; i++)
+    {
+      struct MailNode *mnode = mlist->nodes[i];
+
+      if(mnode->mail != NULL && mnode->mail->pool == pool)
+        FreeMailStrings(mnode->mail);
+      else
+        DereferenceMail(mnode->mail);
+
+      if(mnode->pool != pool)
+        FreePoolItem(mnode->pool, TRUE, mnode);
+    }
+
+    pool->numItems = 0;
+  }
+  else
+  {
+    for(i = mlist->first; i < mlist->first + mlist->count; i++)
+      DeleteMailNode(mlist->nodes[i]);
   }
+
+  // the pool is either empty now or it is deleted together with
+  // the last mail which is still referenced somewhere else
+  DeleteMailPool(pool);
   InitMailList(mlist);
 
   LEAVE();
@@ -124,7 +664,8 @@ void DeleteMailList(struct MailList *mlist)
     mlist->lockSemaphore = NULL;
 
     // free the list itself
-    FreeSysObject(ASOT_LIST, mlist);
+    free(mlist->nodes);
+    free(mlist);
   }
 
   LEAVE();
@@ -149,6 +690,9 @@ struct MailList *CloneMailList(const struct MailList *mlist)
       {
         struct MailNode *mnode;
 
+        // allocate all slots at once
+        ResizeMailList(clone, mlist->count);
+
         ForEachMailNode(mlist, mnode)
         {
           AddNewMailNode(clone, mnode->mail);
@@ -175,16 +719,63 @@ struct MailList *CloneMailList(const struct MailList *mlist)
 // move all mails from one mail list to another one
 void MoveMailList(struct MailList *to, struct MailList *from)
 {
+  ULONG start;
+  ULONG i;
+
   ENTER();
 
   LockMailList(to);
   LockMailList(from);
 
-  // move all mails over
-  MoveList((struct List *)&to->list, (struct List *)&from->list);
-  // adjust the counters
-  to->count += from->count;
-  from->count = 0;
+  if(IsMailListEmpty(to) == TRUE)
+  {
+    struct MailNode **nodes = to->nodes;
+    ULONG size = to->size;
+    struct MailPool *pool = to->pool;
+
+    // an empty list simply takes over the node array of the other list
+    to->nodes = from->nodes;
+    to->first = from->first;
+    to->count = from->count;
+    to->size = from->size;
+    from->nodes = nodes;
+    from->first = 0;
+    from->count = 0;
+    from->size = size;
+
+    // the pool of the mails goes along, this keeps a freshly
+    // loaded folder flushable at once
+    to->pool = from->pool;
+    from->pool = pool;
+
+    start = to->first;
+  }
+  else if(ResizeMailList(to, to->count + from->count) == TRUE)
+  {
+    // append all nodes to the existing ones
+    start = to->first + to->count;
+    memcpy(&to->nodes[start], &from->nodes[from->first], from->count * sizeof(*to->nodes));
+    to->count += from->count;
+    from->first = 0;
+    from->count = 0;
+  }
+  else
+  {
+    // the mails stay where they are
+    E(DBF_MAIL, "couldn't move %ld mails from list %08lx to list %08lx", from->count, from, to);
+    start = to->first + to->count;
+  }
+
+  // tell all moved nodes about their new list and position
+  for(i = start; i < to->first + to->count; i++)
+  {
+    to->nodes[i]->list = to;
+    to->nodes[i]->index = i;
+  }
+
+  // both indexes are outdated now
+  DropMailFileIndex(to);
+  DropMailFileIndex(from);
 
   UnlockMailList(from);
   UnlockMailList(to);
@@ -206,24 +797,61 @@ struct MailNode *AddNewMailNode(struct MailList *mlist, struct Mail *mail)
   // NULL mail pointers so that empty nodes can be generated and
   // filled later.
   if(mlist != NULL)
+    mnode = AddNewMailNodeSorted(mlist, mail, NULL);
+
+  // return the new mail node in case someone is interested in it
+  RETURN(mnode);
+  return mnode;
+}
+
+///
+/// AddNewMailNodeSorted
+// add a new mail to an already sorted list at the position given by the
+// comparison function, mails which compare equal keep their order.
+// Without a comparison function the mail is added to the end of the list.
+// if locking of the list is needed this must be done by the calling function
+struct MailNode *AddNewMailNodeSorted(struct MailList *mlist, struct Mail *mail, int (* compare)(const struct MailNode *m1, const struct MailNode *m2))
+{
+  struct MailNode *mnode;
+
+  ENTER();
+
+  if((mnode = AllocPoolItem(mlist->pool, TRUE)) != NULL)
   {
-    if((mnode = ItemPoolAlloc(G->mailNodeItemPool)) != NULL)
+    ULONG position = mlist->count;
+
+    // initialize the node's contents
+    mnode->mail = mail;
+    mnode->pool = mlist->pool;
+
+    if(compare != NULL)
     {
-      // initialize the node's contents
-      mnode->mail = mail;
+      ULONG low = 0;
 
-      // increase the mail's reference counter
-      ReferenceMail(mail);
+      // binary search for the first node which is greater than the new one
+      while(low < position)
+      {
+        ULONG middle = (low + position) / 2;
 
-      // add the new mail node to the end of the list
-      AddTail((struct List *)&mlist->list, (struct Node *)&mnode->node);
+        if(compare(mnode, mlist->nodes[mlist->first + middle]) < 0)
+          position = middle;
+        else
+          low = middle + 1;
+      }
+    }
 
-      // and increase the counter
-      mlist->count++;
+    if(InsertMailNode(mlist, mnode, position) == TRUE)
+    {
+      // increase the mail's reference counter
+      ReferenceMail(mail);
+    }
+    else
+    {
+      FreePoolItem(mnode->pool, TRUE, mnode);
+      mnode = NULL;
     }
   }
 
-  // return the new mail node in case someone is interested in it
   RETURN(mnode);
   return mnode;
 }
@@ -240,10 +868,7 @@ void AddMailNode(struct MailList *mlist, struct MailNode *mnode)
   if(mlist != NULL && mnode != NULL && mnode->mail != NULL)
   {
     // add the new mail node to the end of the list
-    AddTail((struct List *)&mlist->list, (struct Node *)&mnode->node);
-
-    // and increase the counter
-    mlist->count++;
+    InsertMailNode(mlist, mnode, mlist->count);
   }
 
   LEAVE();
@@ -259,11 +884,29 @@ void RemoveMailNode(struct MailList *mlist, struct MailNode *mnode)
 
   if(mlist != NULL && mnode != NULL)
   {
-    // remove the mail node from the list
-    Remove((struct Node *)&mnode->node);
+    ULONG position = mnode->index - mlist->first;
+
+    UnindexMailFile(mlist, mnode);
+
+    // close the gap from the side with less nodes to move
+    if(position < mlist->count / 2)
+    {
+      memmove(&mlist->nodes[mlist->first + 1], &mlist->nodes[mlist->first], position * sizeof(*mlist->nodes));
+      mlist->first++;
+      RenumberMailNodes(mlist, mlist->first, mnode->index + 1);
+    }
+    else
+    {
+      memmove(&mlist->nodes[mnode->index], &mlist->nodes[mnode->index + 1], (mlist->count - position - 1) * sizeof(*mlist->nodes));
+      RenumberMailNodes(mlist, mnode->index, mlist->first + mlist->count - 1);
+    }
 
     // and decrease the counter
     mlist->count--;
+    if(mlist->count == 0)
+      mlist->first = 0;
+
+    mnode->list = NULL;
   }
 
   LEAVE();
@@ -278,21 +921,31 @@ void DeleteMailNode(struct MailNode *mnode)
 
   // decrease the mail's reference counter and try to free it
   DereferenceMail(mnode->mail);
-  ItemPoolFree(G->mailNodeItemPool, mnode);
+  FreePoolItem(mnode->pool, TRUE, mnode);
 
   LEAVE();
 }
 
 ///
 /// SortMailList
-// sort a list of mails with a comparison function
+// sort a list of mails with a comparison function, mails which compare
+// equal keep their order
 void SortMailList(struct MailList *mlist, int (* compare)(const struct MailNode *m1, const struct MailNode *m2))
 {
   ENTER();
 
   // sort only if there is something to sort at all
   if(mlist != NULL && mlist->count > 1)
-    SortExecList(&mlist->list, (int (*)(const struct MinNode *, const struct MinNode *))compare);
+  {
+    struct MailNode **buffer;
+
+    // without a buffer the nodes are still sorted, just slower
+    buffer = malloc((mlist->count / 2) * sizeof(*buffer));
+    SortMailNodes(&mlist->nodes[mlist->first], buffer, mlist->count, compare);
+    free(buffer);
+
+    RenumberMailNodes(mlist, mlist->first, mlist->first + mlist->count);
+  }
 
   LEAVE();
 }
@@ -313,13 +966,10 @@ struct Mail **MailListToMailArray(const struct MailList *mlist)
     // we allocate at least the terminating NULL entry
     if((marray = (struct Mail **)calloc(mlist->count + 1, sizeof(struct Mail *))) != NULL)
     {
-      struct Mail **mptr = marray;
-      struct MailNode *mnode;
+      ULONG i;
 
-      ForEachMailNode(mlist, mnode)
-      {
-        *mptr++ = mnode->mail;
-      }
+      for(i = 0; i < mlist->count; i++)
+        marray[i] = mlist->nodes[mlist->first + i]->mail;
     }
 
     UnlockMailList(mlist);
@@ -343,15 +993,15 @@ int CompareMailsByDate(const struct MailNode *m1, const struct MailNode *m2)
 struct MailNode *FindMailByAddress(const struct MailList *mlist, const struct Mail *mail)
 {
   struct MailNode *foundNode = NULL;
-  struct MailNode *mnode;
+  ULONG i;
 
   ENTER();
 
-  ForEachMailNode(mlist, mnode)
+  for(i = mlist->first; i < mlist->first + mlist->count; i++)
   {
-    if(mnode->mail == mail)
+    if(mlist->nodes[i]->mail == mail)
     {
-      foundNode = mnode;
+      foundNode = mlist->nodes[i];
       break;
     }
   }
@@ -362,21 +1012,38 @@ struct MailNode *FindMailByAddress(const struct MailList *mlist, const struct Ma
 
 ///
 /// FindMailByFilename
-// find a mail in an already locked list and return its MailNode or NULL
-struct MailNode *FindMailByFilename(const struct MailList *mlist, const char *filename)
+// find a mail in an already locked list and return its MailNode or NULL,
+// the status characters of the name are ignored. Larger lists maintain an
+// index of the names for this, hence the list must be locked exclusively.
+struct MailNode *FindMailByFilename(struct MailList *mlist, const char *filename)
 {
   struct MailNode *foundNode = NULL;
-  struct MailNode *mnode;
 
   ENTER();
 
-  ForEachMailNode(mlist, mnode)
+  if(mlist->count >= MAILFILE_INDEX_MINCOUNT &&
+     ((mlist->fileIndex != NULL && mlist->fileIndexGeneration == mailFileGeneration) || BuildMailFileIndex(mlist) == TRUE))
   {
-    // compare the names, but exclude the status characters
-    if(strncmp(mnode->mail->MailFile, filename, 17) == 0)
+    struct MailFileEntry *entry;
+
+    entry = (struct MailFileEntry *)HashTableOperate(mlist->fileIndex, filename, htoLookup);
+    if(HASH_ENTRY_IS_BUSY(&entry->header))
+      foundNode = entry->mnode;
+  }
+  else
+  {
+    ULONG i;
+
+    for(i = mlist->first; i < mlist->first + mlist->count; i++)
     {
-      foundNode = mnode;
-      break;
+      struct MailNode *mnode = mlist->nodes[i];
+
+      // compare the names, but exclude the status characters
+      if(strncmp(mnode->mail->MailFile, filename, MAILFILE_KEYLEN) == 0)
+      {
+        foundNode = mnode;
+        break;
+      }
     }
   }
 
@@ -386,6 +1053,7 @@ struct MailNode *FindMailByFilename(const struct MailList *mlist, const char *fi
 
 ///
 /// TakeMailNode
+// remove the first node from a list and return it
 struct MailNode *TakeMailNode(struct MailList *mlist)
 {
   struct MailNode *mnode = NULL;
@@ -395,11 +1063,8 @@ struct MailNode *TakeMailNode(struct MailList *mlist)
   if(mlist != NULL)
   {
     // try to remove the first node from the list
-    if((mnode = (struct MailNode *)RemHead((struct List *)&mlist->list)) != NULL)
-    {
-      // decrease the counter
-      mlist->count--;
-    }
+    if((mnode = FirstMailNode(mlist)) != NULL)
+      RemoveMailNode(mlist, mnode);
   }
 
   RETURN(mnode);
@@ -415,7 +1080,26 @@ struct Mail *AllocMail(void)
 
   ENTER();
 
-  mail = ItemPoolAlloc(G->mailItemPool);
+  mail = AllocMailFromPool(NULL);
+
+  RETURN(mail);
+  return mail;
+}
+
+///
+/// AllocMailFromPool
+// allocate a mail structure from a mail pool
+struct Mail *AllocMailFromPool(struct MailPool *pool)
+{
+  struct Mail *mail;
+
+  ENTER();
+
+  if((mail = AllocPoolItem(pool, FALSE)) != NULL)
+  {
+    mail->pool = pool;
+    InitMailStrings(mail);
+  }
 
   RETURN(mail);
   return mail;
@@ -430,12 +1114,40 @@ struct Mail *CloneMail(const struct Mail *mail)
 
   ENTER();
 
-  if((clone = ItemPoolAlloc(G->mailItemPool)) != NULL)
+  clone = CloneMailToPool(mail, NULL);
+
+  RETURN(clone);
+  return clone;
+}
+
+///
+/// CloneMailToPool
+// create a clone of a mail structure in a mail pool
+struct Mail *CloneMailToPool(const struct Mail *mail, struct MailPool *pool)
+{
+  struct Mail *clone;
+
+  ENTER();
+
+  if((clone = AllocPoolItem(pool, FALSE)) != NULL)
   {
     memcpy(clone, mail, sizeof(*clone));
 
     // start with a reference counter of zero
     clone->RefCounter = 0;
+    clone->pool = pool;
+
+    // the clone shares all strings with the original mail
+    ReferenceString(clone->From.Address);
+    ReferenceString(clone->From.RealName);
+    ReferenceString(clone->To.Address);
+    ReferenceString(clone->To.RealName);
+    ReferenceString(clone->ReplyTo.Address);
+    ReferenceString(clone->ReplyTo.RealName);
+    ReferenceString(clone->tzAbbr);
+    ReferenceString(clone->MailAccount);
+    ReferenceString(clone->Subject);
+    ReferenceString(clone->MailFile);
   }
 
   RETURN(clone);
@@ -452,7 +1164,10 @@ void FreeMail(struct Mail *mail)
   if(mail != NULL)
   {
     if(mail->RefCounter == 0)
-      ItemPoolFree(G->mailItemPool, mail);
+    {
+      FreeMailStrings(mail);
+      FreePoolItem(mail->pool, FALSE, mail);
+    }
     else
       W(DBF_MAIL, "FreeMail attempt on mail (%08lx) with RefCounter > 0 (%d)", mail, mail->RefCounter);
   }
@@ -460,6 +1175,115 @@ void FreeMail(struct Mail *mail)
   LEAVE();
 }
 
+///
+/// InitMailStrings
+// initialize all strings of a mail structure as empty strings
+void InitMailStrings(struct Mail *mail)
+{
+  ENTER();
+
+  mail->From.Address = "";
+  mail->From.RealName = "";
+  mail->To.Address = "";
+  mail->To.RealName = "";
+  mail->ReplyTo.Address = "";
+  mail->ReplyTo.RealName = "";
+  mail->tzAbbr = "";
+  mail->MailAccount = "";
+  mail->Subject = "";
+  mail->MailFile = "";
+
+  LEAVE();
+}
+
+///
+/// FreeMailStrings
+// release all strings of a mail structure
+void FreeMailStrings(struct Mail *mail)
+{
+  ENTER();
+
+  SetMailPerson(&mail->From, NULL, NULL);
+  SetMailPerson(&mail->To, NULL, NULL);
+  SetMailPerson(&mail->ReplyTo, NULL, NULL);
+  SetMailTZAbbr(mail, NULL);
+  SetMailAccount(mail, NULL);
+  SetMailSubject(mail, NULL);
+  SetMailFile(mail, NULL);
+
+  LEAVE();
+}
+
+///
+/// SetSharedString
+// replace a shared string by another one
+static void SetSharedString(const char **str, const char *value, const size_t size)
+{
+  // intern the new value first, it might be the old one
+  const char *old = *str;
+
+  *str = InternString(value, size);
+  ReleaseString(old);
+}
+
+///
+/// SetMailSubject
+// set the subject of a mail
+void SetMailSubject(struct Mail *mail, const char *subject)
+{
+  SetSharedString(&mail->Subject, subject, SIZE_SUBJECT);
+}
+
+///
+/// SetMailFile
+// set the file name of a mail
+void SetMailFile(struct Mail *mail, const char *file)
+{
+  // renaming a mail outdates the file name indexes, changes of the
+  // status characters only don't matter
+  if(mail->MailFile[0] != '\0' && file != NULL && strncmp(mail->MailFile, file, MAILFILE_KEYLEN) != 0)
+    mailFileGeneration++;
+
+  SetSharedString(&mail->MailFile, file, SIZE_MFILE);
+}
+
+///
+/// SetMailAccount
+// set the name of the account a mail was received/sent with
+void SetMailAccount(struct Mail *mail, const char *account)
+{
+  SetSharedString(&mail->MailAccount, account, SIZE_DEFAULT);
+}
+
+///
+/// SetMailTZAbbr
+// set the timezone abbreviation of a mail
+void SetMailTZAbbr(struct Mail *mail, const char *tzAbbr)
+{
+  SetSharedString(&mail->tzAbbr, tzAbbr, SIZE_SMALL);
+}
+
+///
+/// SetMailPerson
+// set the address and the real name of a sender/recipient of a mail
+void SetMailPerson(struct MailPerson *mp, const char *address, const char *realName)
+{
+  SetSharedString(&mp->Address, address, SIZE_ADDRESS);
+  SetSharedString(&mp->RealName, realName, SIZE_REALNAME);
+}
+
+///
+/// GetMailPerson
+// copy a sender/recipient of a mail to a struct Person for all functions
+// which still need one
+struct Person *GetMailPerson(const struct MailPerson *mp, struct Person *pe)
+{
+  strlcpy(pe->Address, mp->Address, sizeof(pe->Address));
+  strlcpy(pe->RealName, mp->RealName, sizeof(pe->RealName));
+
+  return pe;
+}
+
 ///
 /// ReferenceMail
 // increase a mail's reference counter
@@ -546,4 +1370,32 @@ void UnlockMailList(const struct MailList *mlist)
 
 ///
 #endif
+#if defined(DEBUG)
+/// DumpMailMemoryUsage
+// report the memory used by the given number of mails compared to the
+// former layout with fixed size string buffers within struct Mail
+void DumpMailMemoryUsage(const ULONG numMails)
+{
+  ENTER();
+
+  if(numMails != 0)
+  {
+    struct StringTableStats stats;
+    ULONG fixedSize;
+    ULONG compactSize;
+
+    GetStringTableStats(&stats);
+
+    fixedSize = sizeof(struct Mail) - 3*sizeof(struct MailPerson) - 4*sizeof(char *) +
+                3*sizeof(struct Person) + SIZE_SMALL + SIZE_DEFAULT + SIZE_SUBJECT + SIZE_MFILE;
+    compactSize = sizeof(struct Mail) + (stats.stringBytes + stats.tableBytes) / numMails;
+
+    D(DBF_MAIL, "memory usage of %ld mails: %ld bytes per mail with fixed strings, %ld bytes per mail with shared strings", numMails, fixedSize, compactSize);
+    D(DBF_MAIL, "%ld shared strings with %ld references use %ld+%ld bytes, %ld bytes saved by sharing", stats.strings, stats.references, stats.stringBytes, stats.tableBytes, stats.savedBytes);
+  }
+
+  LEAVE();
+}
 
+///
+#endif
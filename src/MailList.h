@@ -37,21 +37,38 @@
 
 // forward declarations
 struct SignalSemaphore;
+struct HashTable;
 struct Mail;
+struct MailPool;
+struct MailPerson;
+struct Person;
 
+// The nodes of a mail list are kept in a contiguous array in list order.
+// The used slots range from 'first' to 'first+count-1', which allows to
+// remove nodes from both ends without moving the remaining ones.
 struct MailList
 {
-  struct MinList list;                   // ptr to MinList to put it in exec lists
   struct SignalSemaphore *lockSemaphore; // semaphore for locking the list
+  struct MailNode **nodes;               // array of all nodes in list order
+  ULONG first;                           // slot of the first node in the array
   ULONG count;                           // number of entries in list
+  ULONG size;                            // number of allocated slots in the array
+  struct MailPool *pool;                 // pool for new nodes of this list (NULL = global pool)
+  struct HashTable *fileIndex;           // index of the mail file names, built on demand
+  ULONG fileIndexGeneration;             // mail file name generation the index was built for
+  ULONG fileIndexDuplicates;             // number of file names which are not unique in the index
 };
 
 struct MailNode
 {
-  struct MinNode node;
+  struct MailList *list;                 // the list this node is part of
+  ULONG index;                           // slot of this node in the list's array
   struct Mail *mail;
+  struct MailPool *pool;                 // the pool this node was allocated from
 };
 
+struct MailPool *CreateMailPool(void);
+void DeleteMailPool(struct MailPool *pool);
 void InitMailList(struct MailList *mlist);
 struct MailList *CreateMailList(void);
 void ClearMailList(struct MailList *mlist);
@@ -59,35 +76,52 @@ void DeleteMailList(struct MailList *mlist);
 struct MailList *CloneMailList(const struct MailList *mlist);
 void MoveMailList(struct MailList *to, struct MailList *from);
 struct MailNode *AddNewMailNode(struct MailList *mlist, struct Mail *mail);
+struct MailNode *AddNewMailNodeSorted(struct MailList *mlist, struct Mail *mail, int (* compare)(const struct MailNode *m1, const struct MailNode *m2));
 void AddMailNode(struct MailList *mlist, struct MailNode *mnode);
 void RemoveMailNode(struct MailList *mlist, struct MailNode *mnode);
 void DeleteMailNode(struct MailNode *mnode);
 void SortMailList(struct MailList *mlist, int (* compare)(const struct MailNode *m1, const struct MailNode *m2));
 struct Mail **MailListToMailArray(const struct MailList *mlist);
 struct MailNode *FindMailByAddress(const struct MailList *mlist, const struct Mail *mail);
-struct MailNode *FindMailByFilename(const struct MailList *mlist, const char *filename);
+struct MailNode *FindMailByFilename(struct MailList *mlist, const char *filename);
 struct MailNode *TakeMailNode(struct MailList *mlist);
 struct Mail *AllocMail(void);
+struct Mail *AllocMailFromPool(struct MailPool *pool);
 struct Mail *CloneMail(const struct Mail *mail);
+struct Mail *CloneMailToPool(const struct Mail *mail, struct MailPool *pool);
 void ReferenceMail(struct Mail *mail);
 void DereferenceMail(struct Mail *mail);
 void FreeMail(struct Mail *mail);
+void InitMailStrings(struct Mail *mail);
+void FreeMailStrings(struct Mail *mail);
+void SetMailSubject(struct Mail *mail, const char *subject);
+void SetMailFile(struct Mail *mail, const char *file);
+void SetMailAccount(struct Mail *mail, const char *account);
+void SetMailTZAbbr(struct Mail *mail, const char *tzAbbr);
+void SetMailPerson(struct MailPerson *mp, const char *address, const char *realName);
+struct Person *GetMailPerson(const struct MailPerson *mp, struct Person *pe);
+#if defined(DEBUG)
+void DumpMailMemoryUsage(const ULONG numMails);
+#endif
 
 // public comparison functions
 int CompareMailsByDate(const struct MailNode *m1, const struct MailNode *m2);
 
 // check if a mail list is empty
-#define IsMailListEmpty(mlist)                    IsMinListEmpty(&(mlist)->list)
+#define IsMailListEmpty(mlist)                    ((mlist)->count == 0)
 
 // navigate in the list
-#define FirstMailNode(mlist)                      (struct MailNode *)GetHead((struct List *)&((mlist)->list))
-#define LastMailNode(mlist)                       (struct MailNode *)GetTail((struct List *)&((mlist)->list))
-#define NextMailNode(mnode)                       (struct MailNode *)GetSucc((struct Node *)mnode)
-#define PreviousMailNode(mnode)                   (struct MailNode *)GetPred((struct Node *)mnode)
+#define FirstMailNode(mlist)                      ((mlist)->count != 0 ? (mlist)->nodes[(mlist)->first] : (struct MailNode *)NULL)
+#define LastMailNode(mlist)                       ((mlist)->count != 0 ? (mlist)->nodes[(mlist)->first + (mlist)->count - 1] : (struct MailNode *)NULL)
+#define NextMailNode(mnode)                       ((mnode)->index + 1 < (mnode)->list->first + (mnode)->list->count ? (mnode)->list->nodes[(mnode)->index + 1] : (struct MailNode *)NULL)
+#define PreviousMailNode(mnode)                   ((mnode)->index > (mnode)->list->first ? (mnode)->list->nodes[(mnode)->index - 1] : (struct MailNode *)NULL)
 
 // iterate through the list, the list must *NOT* be modified!
 #define ForEachMailNode(mlist, mnode)             for(mnode = FirstMailNode(mlist); mnode != NULL; mnode = NextMailNode(mnode))
 
+// iterate through the list, the current node may be removed from the list
+#define SafeForEachMailNode(mlist, mnode, succ)   for(mnode = FirstMailNode(mlist); mnode != NULL && ((succ = NextMailNode(mnode)) != NULL || succ == NULL); mnode = succ)
+
 // lock and unlock a mail list via its semaphore
 #if defined(DEBUG)
 void LockMailList(const struct MailList *mlist);
@@ -57,7 +57,7 @@
 ***************************************************************************/
 
 /// CreateNewMailServer
-//  Initializes a new POP3/SMTP account
+//  Initializes a new POP3/IMAP/SMTP account
 struct MailServerNode *CreateNewMailServer(const enum MailServerType type, const struct Config *co, const BOOL first)
 {
   struct MailServerNode *msn;
@@ -79,8 +79,9 @@ struct MailServerNode *CreateNewMailServer(const enum MailServerType type, const
     switch(type)
     {
       case MST_POP3:
+      case MST_IMAP:
       {
-        // POP3 servers keep a list of downloaded mails
+        // POP3 and IMAP servers keep a list of downloaded mails
         if((msn->downloadedMails = CreateMailList()) != NULL)
         {
           if(CreateTRequest(&msn->downloadTimer, -1, msn) == TRUE)
@@ -104,8 +105,21 @@ struct MailServerNode *CreateNewMailServer(const enum MailServerType type, const
                 strlcpy(msn->hostname, smtpMSN->hostname, sizeof(msn->hostname));
             }
 
-            msn->port = 110;
-            setFlag(msn->flags, MSF_PURGEMESSGAES);
+            // IMAP servers leave the mails on the server by default
+            if(type == MST_IMAP)
+            {
+              msn->port = 143;
+            }
+            else
+            {
+              msn->port = 110;
+              setFlag(msn->flags, MSF_PURGEMESSGAES);
+            }
+
+            // the IMAP settings are kept for POP3 servers as well, as the
+            // protocol of an account may be switched later
+            strlcpy(msn->imapMailbox, "INBOX", sizeof(msn->imapMailbox));
+            msn->imapIdle = TRUE;
             setFlag(msn->flags, MSF_AVOID_DUPLICATES);
             setFlag(msn->flags, MSF_DOWNLOAD_LARGE_MAILS);
 
@@ -154,6 +168,7 @@ struct MailServerNode *CreateNewMailServer(const enum MailServerType type, const
         struct Folder *sentFolder;
 
         msn->port = 25;
+        msn->smtpConnections = 1;
 
         // get the name of the incoming folder so that it will be
         // the default of that mail server
@@ -196,10 +211,10 @@ struct MailServerNode *CloneMailServer(const struct MailServerNode *msn)
     // the clone is not in use yet
     clone->useCount = 0;
 
-    // prepare some stuff for POP3 servers
-    if(msn->type == MST_POP3)
+    // prepare some stuff for POP3 and IMAP servers
+    if(msn->type == MST_POP3 || msn->type == MST_IMAP)
     {
-      // POP3 servers keep a list of downloaded mails and a timer
+      // POP3 and IMAP servers keep a list of downloaded mails and a timer
       if((clone->downloadedMails = CreateMailList()) != NULL)
       {
         if(CreateTRequest(&clone->downloadTimer, -1, clone) == FALSE)
@@ -227,8 +242,8 @@ void DeleteMailServer(struct MailServerNode *msn)
 {
   ENTER();
 
-  // free some additional stuff of POP3 servers first
-  if(msn->type == MST_POP3)
+  // free some additional stuff of POP3 and IMAP servers first
+  if(msn->type == MST_POP3 || msn->type == MST_IMAP)
   {
     DeleteMailList(msn->downloadedMails);
     DeleteTRequest(&msn->downloadTimer);
@@ -270,6 +285,7 @@ static BOOL CompareMailServerNodes(const struct Node *n1, const struct Node *n2)
 
   // compare the common members of the structure first
   if(msn1->id             != msn2->id ||
+     msn1->type           != msn2->type ||
      strcmp(msn1->description, msn2->description) != 0 ||
      strcmp(msn1->hostname,    msn2->hostname) != 0 ||
      strcmp(msn1->username,    msn2->username) != 0 ||
@@ -289,7 +305,7 @@ static BOOL CompareMailServerNodes(const struct Node *n1, const struct Node *n2)
   // some server type specific stuff
   if(equal == TRUE)
   {
-    if(msn1->type == MST_POP3)
+    if(msn1->type == MST_POP3 || msn1->type == MST_IMAP)
     {
       if(msn1->preselection       != msn2->preselection ||
          msn1->downloadInterval   != msn2->downloadInterval ||
@@ -304,12 +320,23 @@ static BOOL CompareMailServerNodes(const struct Node *n1, const struct Node *n2)
         // something does not match
         equal = FALSE;
       }
+      else if(msn1->type == MST_IMAP &&
+              (msn1->imapIdle != msn2->imapIdle ||
+               strcmp(msn1->imapMailbox, msn2->imapMailbox) != 0))
+      {
+        // something does not match
+        equal = FALSE;
+      }
     }
     else if(msn1->type == MST_SMTP)
     {
-      // nothing to be compared here
       // the smtpFlags field will be modified during a connection but it is never
       // saved to a configuration file
+      if(msn1->smtpConnections != msn2->smtpConnections)
+      {
+        // something does not match
+        equal = FALSE;
+      }
     }
   }
 
@@ -43,6 +43,9 @@ enum MailServerType { MST_UNKNOWN=0, MST_SMTP, MST_POP3, MST_IMAP };
 #define isPOP3Server(v) ((v)->type == MST_POP3)
 #define isIMAPServer(v) ((v)->type == MST_IMAP)
 
+// the maximum number of parallel connections to a SMTP server
+#define SMTP_MAX_CONNECTIONS 4
+
 // for managing the mail server flags. These flags are
 // dependant on the actual type of the mail server
 #define MSF_ACTIVE                (1<<0)  // [POP3/SMTP] : user enabled this server
@@ -129,6 +132,7 @@ struct MailServerNode
 
   // mail server type specific flags
   unsigned int smtpFlags;                // [MST_SMTP]: runtime SMTP flags found during connection
+  int smtpConnections;                   // [MST_SMTP]: max. number of parallel connections for sending mails
 
   struct MailList *downloadedMails;      // [MST_POP3]: list of downloaded mails
   enum PreselectionMode preselection;    // [MST_POP3]: preselection mode of mails
@@ -142,6 +146,9 @@ struct MailServerNode
   char notifySound[SIZE_PATHFILE];       // [MST_POP3]: play a sound when new mails have been received
   char notifyCommand[SIZE_COMMAND];      // [MST_POP3]: execute a command when new mails have been received
 
+  char imapMailbox[SIZE_NAME];           // [MST_IMAP]: the mailbox on the server to download mails from
+  BOOL imapIdle;                         // [MST_IMAP]: watch the mailbox for new mails via IDLE
+
   int mailStoreFolderID;                 // [MST_SMTP/POP3]: folder ID for storing transferred mail to
   char mailStoreFolderName[SIZE_NAME];   // [MST_SMTP/POP3]: folder name for storing transferred mail to
 };
@@ -65,6 +65,7 @@ struct MailTransferNode
 #define TRF_SIZE_EXCEEDED         (1<<3)  // this mail exceeds the automatic download size
 #define TRF_GOT_DETAILS           (1<<4)  // details of this mail have been obtained
 #define TRF_REMOTE_FILTER_APPLIED (1<<5)  // the remote filters have been applied for this mail already
+#define TRF_PIPELINED             (1<<6)  // a command for this mail was sent, but its reply was not yet received
 
 void InitMailTransferList(struct MailTransferList *tlist);
 void ClearMailTransferList(struct MailTransferList *tlist);
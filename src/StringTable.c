@@ -0,0 +1,290 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stddef.h>
+#include <string.h>
+
+#include <proto/exec.h>
+
+#include "YAM_stringsizes.h"
+#include "YAM_utilities.h"
+
+#include "HashTable.h"
+#include "StringTable.h"
+#include "extrasrc.h"
+
+#include "Debug.h"
+
+// the size of the puddles of the string pool
+#define STRING_POOL_PUDDLE     8192
+#define STRING_POOL_THRESHOLD   512
+
+// every shared string is preceded by its reference counter
+struct SharedString
+{
+  ULONG refCount;
+  char string[1];
+};
+
+#define SHARED_STRING(str) ((struct SharedString *)((str) - offsetof(struct SharedString, string)))
+
+/*** Static variables/functions ***/
+static struct StringTable
+{
+  struct SignalSemaphore *semaphore;
+  APTR pool;
+  struct HashTable table;   // table of struct HashEntry, the key is the shared string
+  BOOL initialized;
+  #if defined(DEBUG)
+  ULONG references;
+  ULONG stringBytes;
+  ULONG savedBytes;
+  #endif
+} stringTable;
+
+/// InitStringTable
+// set up the global string table
+BOOL InitStringTable(void)
+{
+  static const struct HashTableOps stringOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    DefaultHashGetKey,
+    StringHashHashKey,
+    StringHashMatchEntry,
+    DefaultHashMoveEntry,
+    // the strings are freed together with the pool
+    DefaultHashClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    NULL
+  };
+  BOOL result = FALSE;
+
+  ENTER();
+
+  memset(&stringTable, 0, sizeof(stringTable));
+
+  if((stringTable.semaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) != NULL)
+  {
+    if((stringTable.pool = AllocSysObjectTags(ASOT_MEMPOOL,
+      ASOPOOL_MFlags,    MEMF_SHARED,
+      ASOPOOL_Puddle,    STRING_POOL_PUDDLE,
+      ASOPOOL_Threshold, STRING_POOL_THRESHOLD,
+      ASOPOOL_Name,      (ULONG)"YAM shared strings",
+      TAG_DONE)) != NULL)
+    {
+      if(HashTableInit(&stringTable.table, &stringOps, NULL, sizeof(struct HashEntry), 4096) == TRUE)
+      {
+        stringTable.initialized = TRUE;
+        result = TRUE;
+      }
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// CleanupStringTable
+// free the global string table and all strings which are still referenced
+void CleanupStringTable(void)
+{
+  ENTER();
+
+  if(stringTable.initialized == TRUE)
+  {
+    if(stringTable.table.entryCount != 0)
+      W(DBF_UTIL, "%ld strings are still referenced", stringTable.table.entryCount);
+
+    HashTableCleanup(&stringTable.table);
+    stringTable.initialized = FALSE;
+  }
+
+  if(stringTable.pool != NULL)
+  {
+    FreeSysObject(ASOT_MEMPOOL, stringTable.pool);
+    stringTable.pool = NULL;
+  }
+
+  if(stringTable.semaphore != NULL)
+  {
+    FreeSysObject(ASOT_SEMAPHORE, stringTable.semaphore);
+    stringTable.semaphore = NULL;
+  }
+
+  LEAVE();
+}
+
+///
+/// InternString
+// return a reference to the shared copy of a string, the string is cut
+// off like strlcpy() would do for a buffer of the given size
+const char *InternString(const char *str, const size_t size)
+{
+  const char *result = "";
+
+  if(str != NULL && str[0] != '\0' && size > 1)
+  {
+    char buf[SIZE_LARGE];
+    size_t len = strlen(str);
+    struct HashEntry *entry;
+
+    if(len >= size)
+    {
+      strlcpy(buf, str, MIN(size, sizeof(buf)));
+      str = buf;
+      len = strlen(buf);
+    }
+
+    ObtainSemaphore(stringTable.semaphore);
+
+    if((entry = (struct HashEntry *)HashTableOperate(&stringTable.table, str, htoAdd)) != NULL)
+    {
+      if(entry->key == NULL)
+      {
+        struct SharedString *shared;
+
+        // a string we don't know yet
+        if((shared = AllocPooled(stringTable.pool, sizeof(*shared)+len)) != NULL)
+        {
+          shared->refCount = 1;
+          memcpy(shared->string, str, len+1);
+          entry->key = shared->string;
+          result = shared->string;
+
+          #if defined(DEBUG)
+          stringTable.references++;
+          stringTable.stringBytes += sizeof(*shared)+len;
+          #endif
+        }
+        else
+          HashTableRawRemove(&stringTable.table, &entry->header);
+      }
+      else
+      {
+        SHARED_STRING((char *)entry->key)->refCount++;
+        result = entry->key;
+
+        #if defined(DEBUG)
+        stringTable.references++;
+        stringTable.savedBytes += len+1;
+        #endif
+      }
+    }
+
+    ReleaseSemaphore(stringTable.semaphore);
+
+    if(result[0] == '\0')
+      E(DBF_UTIL, "failed to intern string '%s'", str);
+  }
+
+  return result;
+}
+
+///
+/// ReferenceString
+// add another reference to a string returned by InternString()
+const char *ReferenceString(const char *str)
+{
+  if(str != NULL && str[0] != '\0')
+  {
+    ObtainSemaphore(stringTable.semaphore);
+
+    SHARED_STRING(str)->refCount++;
+
+    #if defined(DEBUG)
+    stringTable.references++;
+    stringTable.savedBytes += strlen(str)+1;
+    #endif
+
+    ReleaseSemaphore(stringTable.semaphore);
+  }
+
+  return str;
+}
+
+///
+/// ReleaseString
+// give back a reference to a string returned by InternString() or
+// ReferenceString(), the string is freed with its last reference
+void ReleaseString(const char *str)
+{
+  if(str != NULL && str[0] != '\0')
+  {
+    struct SharedString *shared = SHARED_STRING(str);
+    size_t len = strlen(str);
+
+    ObtainSemaphore(stringTable.semaphore);
+
+    #if defined(DEBUG)
+    stringTable.references--;
+    #endif
+
+    if(--shared->refCount == 0)
+    {
+      HashTableOperate(&stringTable.table, str, htoRemove);
+      FreePooled(stringTable.pool, shared, sizeof(*shared)+len);
+
+      #if defined(DEBUG)
+      stringTable.stringBytes -= sizeof(*shared)+len;
+      #endif
+    }
+    #if defined(DEBUG)
+    else
+      stringTable.savedBytes -= len+1;
+    #endif
+
+    ReleaseSemaphore(stringTable.semaphore);
+  }
+}
+
+///
+#if defined(DEBUG)
+/// GetStringTableStats
+// get the current memory usage of the string table
+void GetStringTableStats(struct StringTableStats *stats)
+{
+  ENTER();
+
+  ObtainSemaphoreShared(stringTable.semaphore);
+
+  stats->strings = stringTable.table.entryCount;
+  stats->references = stringTable.references;
+  stats->stringBytes = stringTable.stringBytes;
+  stats->tableBytes = stringTable.initialized == TRUE ? HASH_TABLE_SIZE(&stringTable.table) * stringTable.table.entrySize : 0;
+  stats->savedBytes = stringTable.savedBytes;
+
+  ReleaseSemaphore(stringTable.semaphore);
+
+  LEAVE();
+}
+
+///
+#endif
@@ -0,0 +1,66 @@
+#ifndef STRINGTABLE_H
+#define STRINGTABLE_H 1
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+
+#include <exec/types.h>
+
+/*
+ A global table of shared read-only strings. InternString() returns a
+ reference to the single copy of a string which is kept for all users of
+ equal strings, i.e. the sender addresses and mail accounts of all the mails
+ of all folders. Each reference must be given back by ReleaseString(), the
+ string is freed as soon as its last reference is released. Empty strings
+ are never added to the table, they are represented by a static "" instead.
+
+ All functions may be called by any thread.
+*/
+
+#if defined(DEBUG)
+struct StringTableStats
+{
+  ULONG strings;      // number of different strings in the table
+  ULONG references;   // number of references to these strings
+  ULONG stringBytes;  // memory used by the strings including their headers
+  ULONG tableBytes;   // memory used by the hash table
+  ULONG savedBytes;   // memory saved by sharing strings
+};
+#endif
+
+BOOL InitStringTable(void);
+void CleanupStringTable(void);
+const char *InternString(const char *str, const size_t size);
+const char *ReferenceString(const char *str);
+void ReleaseString(const char *str);
+
+#if defined(DEBUG)
+void GetStringTableStats(struct StringTableStats *stats);
+#endif
+
+#endif /* STRINGTABLE_H */
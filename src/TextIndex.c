@@ -0,0 +1,1126 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libraries/iffparse.h>
+#include <proto/dos.h>
+
+#include "YAM.h"
+#include "YAM_folderconfig.h"
+#include "YAM_main.h"
+#include "YAM_mainFolder.h"
+#include "YAM_read.h"
+#include "YAM_utilities.h"
+
+#include "extrasrc.h"
+
+#include "BayesFilter.h"
+#include "Busy.h"
+#include "DynamicString.h"
+#include "FileInfo.h"
+#include "HashTable.h"
+#include "Locale.h"
+#include "MailList.h"
+#include "TextIndex.h"
+
+#include "Debug.h"
+
+#define TEXTINDEXFILE         ".textindex"
+#define TEXTINDEX_VER         (MAKE_ID('Y','T','I','1'))
+
+// number of characters of a mail's file name which are unique, the
+// remaining characters reflect the mail's status only
+#define MAILID_LENGTH         17
+
+// longer words are split into overlapping chunks of this size, search words
+// longer than half of this size are shortened accordingly. This makes sure
+// that every search word is fully contained in at least one chunk.
+#define MAX_WORD_LENGTH       64
+#define MAX_QUERY_LENGTH      (MAX_WORD_LENGTH/2)
+
+// the maximum number of words of a search string which are used to look up
+// candidates, this is also limited by the UBYTE match counters
+#define MAX_QUERY_WORDS       32
+
+// flags of the mails in the index
+#define TIMF_REMOVED          (1<<0) // the mail was removed, the slot is unused
+#define TIMF_UNINDEXED        (1<<1) // the mail's text could not be indexed
+#define TIMF_SEEN             (1<<2) // volatile, used during synchronization
+
+/*** Structure definitions ***/
+// a single mail of the index, referenced by its number
+struct TextIndexMail
+{
+  char mailID[MAILID_LENGTH+1];  // the unique part of the mail's file name
+  LONG size;                     // size and date are used to detect replaced mails
+  struct DateStamp date;
+  ULONG flags;
+};
+
+// maps a word to the mails it occurs in, the first two members must
+// match struct HashEntry to be able to use the string hash operators
+struct TextIndexWord
+{
+  struct HashEntryHeader header;
+  char *word;
+  ULONG count;                   // number of mails containing this word
+  ULONG size;                    // number of allocated slots in 'mails'
+  ULONG *mails;                  // the numbers of these mails in ascending order
+};
+
+// maps the ID of a mail to its number in the index
+struct TextIndexMailID
+{
+  struct HashEntryHeader header;
+  char *mailID;
+  ULONG number;
+};
+
+struct TextIndex
+{
+  struct HashTable wordTable;    // all known words
+  struct HashTable idTable;      // all known mail IDs
+  struct TextIndexMail *mails;   // all known mails
+  ULONG mailCount;               // number of used slots in 'mails'
+  ULONG mailSize;                // number of allocated slots in 'mails'
+  ULONG removedCount;            // number of removed mails in 'mails'
+  ULONG generation;              // changes whenever the mail numbers become invalid
+};
+
+struct TextIndexQuery
+{
+  char *words[MAX_QUERY_WORDS];  // the lower case words of the search string
+  ULONG wordCount;
+  BOOL exact;                    // the index result is exact, no further search required
+  const struct Folder *folder;   // the folder the candidates were determined for
+  ULONG generation;              // the generation of the folder's index
+  UBYTE *matches;                // number of matching words per mail of the index
+};
+
+// the state of writing the words of an index to disk
+struct WriteWordsState
+{
+  FILE *fh;
+  BOOL error;
+};
+
+// the state of looking up a search word in the index
+struct LookupState
+{
+  const char *word;
+  ULONG wordNumber;
+  UBYTE *matches;
+};
+
+/*** Static functions ***/
+/// WordClearEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void WordClearEntry(struct HashTable *table, struct HashEntryHeader *entry)
+{
+  struct TextIndexWord *word = (struct TextIndexWord *)entry;
+
+  free(word->mails);
+  StringHashClearEntry(table, entry);
+}
+
+///
+/// WordDestroyEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void WordDestroyEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  struct TextIndexWord *word = (struct TextIndexWord *)entry;
+
+  free(word->mails);
+  free(word->word);
+}
+
+///
+/// wordOps
+// the string hash operators, extended to free the lists of mails
+static const struct HashTableOps wordOps =
+{
+  DefaultHashAllocTable,
+  DefaultHashFreeTable,
+  DefaultHashGetKey,
+  StringHashHashKey,
+  StringHashMatchEntry,
+  DefaultHashMoveEntry,
+  WordClearEntry,
+  DefaultHashFinalize,
+  NULL,
+  WordDestroyEntry
+};
+
+///
+/// CreateIndex
+// create a new empty index
+static struct TextIndex *CreateIndex(void)
+{
+  struct TextIndex *ti;
+
+  ENTER();
+
+  if((ti = calloc(1, sizeof(*ti))) != NULL)
+  {
+    if(HashTableInit(&ti->wordTable, &wordOps, NULL, sizeof(struct TextIndexWord), 4096) == FALSE)
+    {
+      free(ti);
+      ti = NULL;
+    }
+    else if(HashTableInit(&ti->idTable, HashTableGetDefaultStringOps(), NULL, sizeof(struct TextIndexMailID), 512) == FALSE)
+    {
+      HashTableCleanup(&ti->wordTable);
+      free(ti);
+      ti = NULL;
+    }
+  }
+
+  RETURN(ti);
+  return ti;
+}
+
+///
+/// DeleteIndex
+// free an index and all its data
+static void DeleteIndex(struct TextIndex *ti)
+{
+  ENTER();
+
+  HashTableCleanup(&ti->wordTable);
+  HashTableCleanup(&ti->idTable);
+  free(ti->mails);
+  free(ti);
+
+  LEAVE();
+}
+
+///
+/// GetMailNumber
+// look up the number of a mail by its file name, returns FALSE if the
+// mail is unknown
+static BOOL GetMailNumber(struct TextIndex *ti, const char *mailFile, ULONG *number)
+{
+  BOOL found = FALSE;
+  char mailID[MAILID_LENGTH+1];
+  struct TextIndexMailID *entry;
+
+  ENTER();
+
+  strlcpy(mailID, mailFile, sizeof(mailID));
+
+  entry = (struct TextIndexMailID *)HashTableOperate(&ti->idTable, mailID, htoLookup);
+  if(HASH_ENTRY_IS_LIVE(&entry->header))
+  {
+    *number = entry->number;
+    found = TRUE;
+  }
+
+  RETURN(found);
+  return found;
+}
+
+///
+/// AddIndexMail
+// add a new mail to the index and return its number, returns FALSE if
+// there is not enough memory
+static BOOL AddIndexMail(struct TextIndex *ti, const char *mailFile, const LONG size, const struct DateStamp *date, const ULONG flags, ULONG *number)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if(ti->mailCount == ti->mailSize)
+  {
+    ULONG newSize = (ti->mailSize == 0) ? 256 : ti->mailSize * 2;
+    struct TextIndexMail *newMails;
+
+    if((newMails = realloc(ti->mails, newSize * sizeof(*newMails))) != NULL)
+    {
+      ti->mails = newMails;
+      ti->mailSize = newSize;
+    }
+  }
+
+  if(ti->mailCount < ti->mailSize)
+  {
+    struct TextIndexMail *tim = &ti->mails[ti->mailCount];
+    struct TextIndexMailID *entry;
+
+    strlcpy(tim->mailID, mailFile, sizeof(tim->mailID));
+    tim->size = size;
+    memcpy(&tim->date, date, sizeof(tim->date));
+    tim->flags = flags;
+
+    if((entry = (struct TextIndexMailID *)HashTableOperate(&ti->idTable, tim->mailID, htoAdd)) != NULL)
+    {
+      if(entry->mailID == NULL)
+        entry->mailID = strdup(tim->mailID);
+
+      if(entry->mailID != NULL)
+      {
+        entry->number = ti->mailCount;
+        *number = ti->mailCount;
+        ti->mailCount++;
+        success = TRUE;
+      }
+      else
+        HashTableRawRemove(&ti->idTable, &entry->header);
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// RemoveIndexMail
+// mark a mail of the index as removed, its number is not reused
+// until the index is compacted
+static void RemoveIndexMail(struct TextIndex *ti, const ULONG number)
+{
+  struct TextIndexMail *tim = &ti->mails[number];
+
+  ENTER();
+
+  if(isFlagClear(tim->flags, TIMF_REMOVED))
+  {
+    ULONG current;
+
+    // forget the mail's ID unless it refers to a newer mail already
+    if(GetMailNumber(ti, tim->mailID, &current) == TRUE && current == number)
+      HashTableOperate(&ti->idTable, tim->mailID, htoRemove);
+
+    setFlag(tim->flags, TIMF_REMOVED);
+    ti->removedCount++;
+  }
+
+  LEAVE();
+}
+
+///
+/// AddWord
+// add a single word for the given mail number to the index
+static BOOL AddWord(struct TextIndex *ti, const char *word, const ULONG number)
+{
+  BOOL success = FALSE;
+  struct TextIndexWord *entry;
+
+  ENTER();
+
+  if((entry = (struct TextIndexWord *)HashTableOperate(&ti->wordTable, word, htoAdd)) != NULL)
+  {
+    if(entry->word == NULL)
+      entry->word = strdup(word);
+
+    if(entry->word != NULL)
+    {
+      // the mails are indexed one after the other, hence a mail number
+      // which is already known must be the last one in the list
+      if(entry->count == 0 || entry->mails[entry->count-1] != number)
+      {
+        if(entry->count == entry->size)
+        {
+          ULONG newSize = (entry->size == 0) ? 4 : entry->size * 2;
+          ULONG *newMails;
+
+          if((newMails = realloc(entry->mails, newSize * sizeof(*newMails))) != NULL)
+          {
+            entry->mails = newMails;
+            entry->size = newSize;
+          }
+        }
+
+        if(entry->count < entry->size)
+        {
+          entry->mails[entry->count] = number;
+          entry->count++;
+          success = TRUE;
+        }
+      }
+      else
+        success = TRUE;
+    }
+
+    // don't keep empty entries
+    if(entry->count == 0)
+      HashTableRawRemove(&ti->wordTable, &entry->header);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// IndexWord
+// add a word to the index, words exceeding the maximum length are
+// split into overlapping chunks
+static BOOL IndexWord(struct TextIndex *ti, const char *word, const ULONG number)
+{
+  BOOL success = TRUE;
+  size_t length = strlen(word);
+
+  ENTER();
+
+  if(length <= MAX_WORD_LENGTH)
+  {
+    success = AddWord(ti, word, number);
+  }
+  else
+  {
+    size_t offset = 0;
+
+    do
+    {
+      char chunk[MAX_WORD_LENGTH+1];
+
+      strlcpy(chunk, &word[offset], sizeof(chunk));
+      success = AddWord(ti, chunk, number);
+
+      offset += MAX_WORD_LENGTH/2;
+    }
+    while(success == TRUE && offset + MAX_WORD_LENGTH/2 < length);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// IndexText
+// split a text into words like the spam filter's tokenizer does and add
+// them to the index, the text is modified
+static BOOL IndexText(struct TextIndex *ti, char *text, const ULONG number)
+{
+  BOOL success = TRUE;
+  char *word = text;
+  char *next;
+
+  ENTER();
+
+  do
+  {
+    if((next = strpbrk(word, BAYES_TOKEN_DELIMITERS)) != NULL)
+      *next++ = '\0';
+
+    // in contrast to the spam filter we must keep numbers and long words,
+    // because these might be searched for as well
+    if(strlen(word) >= BAYES_MIN_TOKEN_LENGTH)
+    {
+      ToLowerCase(word);
+      success = IndexWord(ti, word, number);
+    }
+
+    word = next;
+  }
+  while(word != NULL && success == TRUE);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// IndexMail
+// read in the texts of a mail and add them to the index
+static BOOL IndexMail(struct TextIndex *ti, const struct Mail *mail, const ULONG number)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  // encrypted mails are never indexed, because this would require the
+  // passphrase and would store the decrypted words on disk
+  if(isMP_CryptedMail(mail) == FALSE)
+  {
+    struct ReadMailData *rmData;
+
+    if((rmData = AllocPrivateRMData(mail, PM_TEXTS|PM_QUIET)) != NULL)
+    {
+      char *cmsg;
+
+      if((cmsg = RE_ReadInMessage(rmData, RIM_QUIET)) != NULL)
+      {
+        success = IndexText(ti, cmsg, number);
+
+        dstrfree(cmsg);
+      }
+
+      FreePrivateRMData(rmData);
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// CompactWord
+// remap the mail numbers of a word after removed mails have been dropped
+static enum HashTableOperator CompactWord(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  struct TextIndexWord *word = (struct TextIndexWord *)entry;
+  const ULONG *newNumbers = arg;
+  enum HashTableOperator result = htoNext;
+  ULONG i;
+  ULONG j = 0;
+
+  for(i = 0; i < word->count; i++)
+  {
+    ULONG newNumber = newNumbers[word->mails[i]];
+
+    if(newNumber != (ULONG)-1)
+      word->mails[j++] = newNumber;
+  }
+
+  word->count = j;
+
+  if(word->count == 0)
+    result = htoNext|htoRemove;
+
+  return result;
+}
+
+///
+/// CompactMailID
+// remap the mail number of a mail ID after removed mails have been dropped
+static enum HashTableOperator CompactMailID(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  struct TextIndexMailID *mailID = (struct TextIndexMailID *)entry;
+  const ULONG *newNumbers = arg;
+
+  // removed mails don't have an ID entry anymore
+  mailID->number = newNumbers[mailID->number];
+
+  return htoNext;
+}
+
+///
+/// CompactIndex
+// drop all removed mails from the index and renumber the remaining ones
+static BOOL CompactIndex(struct TextIndex *ti)
+{
+  BOOL success = FALSE;
+  ULONG *newNumbers;
+
+  ENTER();
+
+  if((newNumbers = malloc(ti->mailCount * sizeof(*newNumbers))) != NULL)
+  {
+    ULONG i;
+    ULONG j = 0;
+
+    for(i = 0; i < ti->mailCount; i++)
+    {
+      if(isFlagSet(ti->mails[i].flags, TIMF_REMOVED))
+      {
+        newNumbers[i] = (ULONG)-1;
+      }
+      else
+      {
+        newNumbers[i] = j;
+        if(i != j)
+          memcpy(&ti->mails[j], &ti->mails[i], sizeof(ti->mails[j]));
+        j++;
+      }
+    }
+
+    HashTableEnumerate(&ti->wordTable, CompactWord, newNumbers);
+    HashTableEnumerate(&ti->idTable, CompactMailID, newNumbers);
+
+    D(DBF_FOLDER, "compacted full-text index from %ld to %ld mails", ti->mailCount, j);
+
+    ti->mailCount = j;
+    ti->removedCount = 0;
+    ti->generation++;
+
+    free(newNumbers);
+
+    success = TRUE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// WriteWord
+// write a single word and its mail numbers to a stream
+static enum HashTableOperator WriteWord(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  struct TextIndexWord *word = (struct TextIndexWord *)entry;
+  struct WriteWordsState *state = arg;
+  enum HashTableOperator result = htoNext;
+  ULONG length = strlen(word->word);
+  ULONG i;
+
+  if(WriteUInt32(state->fh, length) != 1 ||
+     fwrite(word->word, length, 1, state->fh) != 1 ||
+     WriteUInt32(state->fh, word->count) != 1)
+  {
+    state->error = TRUE;
+  }
+
+  for(i = 0; i < word->count && state->error == FALSE; i++)
+  {
+    if(WriteUInt32(state->fh, word->mails[i]) != 1)
+      state->error = TRUE;
+  }
+
+  if(state->error == TRUE)
+    result = htoStop;
+
+  return result;
+}
+
+///
+/// SaveIndex
+// save the index of a folder, the index must not contain removed mails
+static BOOL SaveIndex(const struct Folder *folder, struct TextIndex *ti)
+{
+  BOOL success = FALSE;
+  char fname[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  AddPath(fname, folder->Fullpath, TEXTINDEXFILE, sizeof(fname));
+
+  if((fh = fopen(fname, "wb")) != NULL)
+  {
+    ULONG i;
+
+    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+    success = (WriteUInt32(fh, TEXTINDEX_VER) == 1 && WriteUInt32(fh, ti->mailCount) == 1);
+
+    for(i = 0; i < ti->mailCount && success == TRUE; i++)
+    {
+      struct TextIndexMail *tim = &ti->mails[i];
+
+      success = (fwrite(tim->mailID, MAILID_LENGTH, 1, fh) == 1 &&
+                 WriteUInt32(fh, tim->size) == 1 &&
+                 WriteUInt32(fh, tim->date.ds_Days) == 1 &&
+                 WriteUInt32(fh, tim->date.ds_Minute) == 1 &&
+                 WriteUInt32(fh, tim->date.ds_Tick) == 1 &&
+                 WriteUInt32(fh, tim->flags & TIMF_UNINDEXED) == 1);
+    }
+
+    if(success == TRUE && WriteUInt32(fh, ti->wordTable.entryCount) == 1)
+    {
+      struct WriteWordsState state;
+
+      state.fh = fh;
+      state.error = FALSE;
+
+      HashTableEnumerate(&ti->wordTable, WriteWord, &state);
+
+      success = (state.error == FALSE);
+    }
+    else
+      success = FALSE;
+
+    fclose(fh);
+
+    if(success == FALSE)
+    {
+      E(DBF_FOLDER, "failed to write full-text index '%s'", fname);
+      DeleteFile(fname);
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// LoadIndex
+// load the index of a folder, returns NULL if there is no valid index
+static struct TextIndex *LoadIndex(const struct Folder *folder)
+{
+  struct TextIndex *ti = NULL;
+  char fname[SIZE_PATHFILE];
+  LONG fileSize;
+
+  ENTER();
+
+  AddPath(fname, folder->Fullpath, TEXTINDEXFILE, sizeof(fname));
+
+  if(ObtainFileInfo(fname, FI_SIZE, &fileSize) == TRUE && fileSize > 0)
+  {
+    FILE *fh;
+
+    if((fh = fopen(fname, "rb")) != NULL)
+    {
+      ULONG id;
+      ULONG mailCount;
+      BOOL success = FALSE;
+
+      setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+      if(ReadUInt32(fh, &id) == 1 && id == TEXTINDEX_VER &&
+         ReadUInt32(fh, &mailCount) == 1 && mailCount <= (ULONG)fileSize &&
+         (ti = CreateIndex()) != NULL)
+      {
+        ULONG wordCount = 0;
+        ULONG i;
+
+        success = TRUE;
+
+        for(i = 0; i < mailCount && success == TRUE; i++)
+        {
+          char mailID[MAILID_LENGTH+1];
+          ULONG size;
+          ULONG flags;
+          struct DateStamp date;
+          ULONG number;
+
+          mailID[MAILID_LENGTH] = '\0';
+
+          success = (fread(mailID, MAILID_LENGTH, 1, fh) == 1 &&
+                     ReadUInt32(fh, &size) == 1 &&
+                     ReadUInt32(fh, (ULONG *)&date.ds_Days) == 1 &&
+                     ReadUInt32(fh, (ULONG *)&date.ds_Minute) == 1 &&
+                     ReadUInt32(fh, (ULONG *)&date.ds_Tick) == 1 &&
+                     ReadUInt32(fh, &flags) == 1 &&
+                     AddIndexMail(ti, mailID, size, &date, flags & TIMF_UNINDEXED, &number) == TRUE &&
+                     number == i);
+        }
+
+        if(success == TRUE)
+          success = (ReadUInt32(fh, &wordCount) == 1);
+
+        for(i = 0; i < wordCount && success == TRUE; i++)
+        {
+          ULONG length;
+          ULONG count;
+          char word[MAX_WORD_LENGTH+1];
+
+          if(ReadUInt32(fh, &length) == 1 && length > 0 && length <= MAX_WORD_LENGTH &&
+             fread(word, length, 1, fh) == 1 &&
+             ReadUInt32(fh, &count) == 1 && count <= mailCount)
+          {
+            ULONG j;
+
+            word[length] = '\0';
+
+            for(j = 0; j < count && success == TRUE; j++)
+            {
+              ULONG number;
+
+              success = (ReadUInt32(fh, &number) == 1 && number < mailCount && AddWord(ti, word, number) == TRUE);
+            }
+          }
+          else
+            success = FALSE;
+        }
+      }
+
+      fclose(fh);
+
+      if(success == FALSE)
+      {
+        W(DBF_FOLDER, "full-text index '%s' is invalid", fname);
+
+        if(ti != NULL)
+        {
+          DeleteIndex(ti);
+          ti = NULL;
+        }
+      }
+      else
+        D(DBF_FOLDER, "loaded full-text index of folder '%s' with %ld mails and %ld words", folder->Name, ti->mailCount, ti->wordTable.entryCount);
+    }
+  }
+
+  RETURN(ti);
+  return ti;
+}
+
+///
+/// LookupWord
+// add the mails containing the search word to the match counters
+static enum HashTableOperator LookupWord(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  struct TextIndexWord *word = (struct TextIndexWord *)entry;
+  struct LookupState *state = arg;
+
+  if(strstr(word->word, state->word) != NULL)
+  {
+    ULONG i;
+
+    for(i = 0; i < word->count; i++)
+    {
+      UBYTE *match = &state->matches[word->mails[i]];
+
+      // count each mail only once per search word and only if it
+      // matched all previous search words
+      if(*match == state->wordNumber)
+        (*match)++;
+    }
+  }
+
+  return htoNext;
+}
+
+///
+/// PrepareQuery
+// determine the candidates for a query in the given folder
+static BOOL PrepareQuery(struct TextIndexQuery *query, const struct Folder *folder)
+{
+  BOOL success = FALSE;
+  struct TextIndex *ti = folder->textIndex;
+
+  ENTER();
+
+  free(query->matches);
+  query->matches = NULL;
+  query->folder = NULL;
+
+  if(ti->mailCount == 0 || (query->matches = calloc(ti->mailCount, sizeof(*query->matches))) != NULL)
+  {
+    struct LookupState state;
+
+    state.matches = query->matches;
+
+    for(state.wordNumber = 0; state.wordNumber < query->wordCount; state.wordNumber++)
+    {
+      state.word = query->words[state.wordNumber];
+      HashTableEnumerate(&ti->wordTable, LookupWord, &state);
+    }
+
+    query->folder = folder;
+    query->generation = ti->generation;
+    success = TRUE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+
+/*** Public functions ***/
+/// TextIndexUpdate
+// synchronize the full-text index of a folder with the folder's mails.
+// Mails which are new to the index are read in and indexed, mails which
+// don't exist anymore are dropped. Returns FALSE if the folder has no index.
+BOOL TextIndexUpdate(struct Folder *folder)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if(folder->FullTextIndex == TRUE && !isGroupFolder(folder) && MA_GetIndex(folder) == TRUE)
+  {
+    if(folder->textIndex == NULL)
+    {
+      if((folder->textIndex = LoadIndex(folder)) == NULL)
+        folder->textIndex = CreateIndex();
+    }
+
+    if(folder->textIndex != NULL)
+    {
+      struct TextIndex *ti = folder->textIndex;
+      struct MailList *folderMessages;
+
+      // work on a copy of the mail list, reading in the mails takes some time
+      if((folderMessages = CloneMailList(folder->messages)) != NULL)
+      {
+        struct MailNode *mnode;
+        struct BusyNode *busy = NULL;
+        BOOL modified = FALSE;
+        ULONG progress = 0;
+        ULONG i;
+
+        for(i = 0; i < ti->mailCount; i++)
+          clearFlag(ti->mails[i].flags, TIMF_SEEN);
+
+        success = TRUE;
+
+        ForEachMailNode(folderMessages, mnode)
+        {
+          struct Mail *mail = mnode->mail;
+          ULONG number;
+
+          if(GetMailNumber(ti, mail->MailFile, &number) == TRUE)
+          {
+            struct TextIndexMail *tim = &ti->mails[number];
+
+            if(tim->size == mail->Size && memcmp(&tim->date, &mail->Date, sizeof(tim->date)) == 0)
+            {
+              setFlag(tim->flags, TIMF_SEEN);
+              continue;
+            }
+
+            // the mail has been replaced by a different one
+            RemoveIndexMail(ti, number);
+          }
+
+          if(busy == NULL)
+          {
+            busy = BusyBegin(BUSY_PROGRESS);
+            BusyText(busy, tr(MSG_BUSY_INDEXING_FOLDER), folder->Name);
+          }
+
+          if(AddIndexMail(ti, mail->MailFile, mail->Size, &mail->Date, TIMF_SEEN, &number) == TRUE)
+          {
+            // mails which can't be indexed are always searched
+            if(IndexMail(ti, mail, number) == FALSE)
+              setFlag(ti->mails[number].flags, TIMF_UNINDEXED);
+
+            modified = TRUE;
+          }
+          else
+          {
+            success = FALSE;
+            break;
+          }
+
+          BusyProgress(busy, ++progress, folderMessages->count);
+        }
+
+        if(busy != NULL)
+          BusyEnd(busy);
+
+        DeleteMailList(folderMessages);
+
+        if(success == TRUE)
+        {
+          // drop all mails which don't exist anymore
+          for(i = 0; i < ti->mailCount; i++)
+          {
+            if(isFlagClear(ti->mails[i].flags, TIMF_SEEN|TIMF_REMOVED))
+              RemoveIndexMail(ti, i);
+          }
+
+          if(ti->removedCount != 0)
+          {
+            success = CompactIndex(ti);
+            modified = TRUE;
+          }
+
+          if(modified == TRUE)
+          {
+            ti->generation++;
+
+            if(success == TRUE)
+              SaveIndex(folder, ti);
+          }
+        }
+
+        if(success == FALSE)
+        {
+          // throw away the incomplete index
+          E(DBF_FOLDER, "failed to update full-text index of folder '%s'", folder->Name);
+          TextIndexDelete(folder);
+        }
+      }
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// TextIndexFree
+// free the full-text index of a folder, the index is kept on disk
+void TextIndexFree(struct Folder *folder)
+{
+  ENTER();
+
+  if(folder->textIndex != NULL)
+  {
+    DeleteIndex(folder->textIndex);
+    folder->textIndex = NULL;
+  }
+
+  LEAVE();
+}
+
+///
+/// TextIndexDelete
+// free the full-text index of a folder and delete it from disk
+void TextIndexDelete(struct Folder *folder)
+{
+  char fname[SIZE_PATHFILE];
+
+  ENTER();
+
+  TextIndexFree(folder);
+
+  AddPath(fname, folder->Fullpath, TEXTINDEXFILE, sizeof(fname));
+  if(FileExists(fname) == TRUE)
+    DeleteFile(fname);
+
+  LEAVE();
+}
+
+///
+/// TextIndexCreateQuery
+// prepare a search string for a full-text index lookup
+struct TextIndexQuery *TextIndexCreateQuery(const char *pattern, const BOOL caseSensitive, const BOOL substring)
+{
+  struct TextIndexQuery *query;
+
+  ENTER();
+
+  if((query = calloc(1, sizeof(*query))) != NULL)
+  {
+    char *text;
+
+    if((text = strdup(pattern)) != NULL)
+    {
+      char *word = text;
+      char *next;
+      BOOL truncated = FALSE;
+
+      // split the search string into words exactly like the indexed texts
+      do
+      {
+        if((next = strpbrk(word, BAYES_TOKEN_DELIMITERS)) != NULL)
+          *next++ = '\0';
+
+        if(strlen(word) >= BAYES_MIN_TOKEN_LENGTH)
+        {
+          if(query->wordCount < MAX_QUERY_WORDS)
+          {
+            // shorten long words to make sure they are found in the
+            // overlapping chunks of long indexed words
+            if(strlen(word) > MAX_QUERY_LENGTH)
+            {
+              word[MAX_QUERY_LENGTH] = '\0';
+              truncated = TRUE;
+            }
+
+            ToLowerCase(word);
+
+            if((query->words[query->wordCount] = strdup(word)) != NULL)
+              query->wordCount++;
+          }
+          else
+            truncated = TRUE;
+        }
+
+        word = next;
+      }
+      while(word != NULL);
+
+      // a case insensitive substring search for a single word is answered by
+      // the index completely, everything else must be checked in detail
+      query->exact = (caseSensitive == FALSE && substring == TRUE && truncated == FALSE &&
+                      query->wordCount == 1 && strlen(query->words[0]) == strlen(pattern));
+
+      D(DBF_FOLDER, "full-text query '%s' with %ld words, exact %ld", pattern, query->wordCount, query->exact);
+
+      free(text);
+    }
+    else
+    {
+      free(query);
+      query = NULL;
+    }
+  }
+
+  RETURN(query);
+  return query;
+}
+
+///
+/// TextIndexDeleteQuery
+// free a query
+void TextIndexDeleteQuery(struct TextIndexQuery *query)
+{
+  ENTER();
+
+  if(query != NULL)
+  {
+    ULONG i;
+
+    for(i = 0; i < query->wordCount; i++)
+      free(query->words[i]);
+
+    free(query->matches);
+    free(query);
+  }
+
+  LEAVE();
+}
+
+///
+/// TextIndexMatchMail
+// check a mail against the full-text index of its folder. The index of the
+// folder is updated first if the mail is the first one of a new folder.
+enum TextIndexResult TextIndexMatchMail(struct TextIndexQuery *query, const struct Mail *mail)
+{
+  enum TextIndexResult result = TIR_UNKNOWN;
+  struct Folder *folder = mail->Folder;
+
+  ENTER();
+
+  // a query without any words can't be answered by the index
+  if(query != NULL && query->wordCount != 0 && folder != NULL && folder->FullTextIndex == TRUE)
+  {
+    BOOL prepared = TRUE;
+
+    if(query->folder != folder || folder->textIndex == NULL || query->generation != folder->textIndex->generation)
+    {
+      prepared = FALSE;
+
+      if(TextIndexUpdate(folder) == TRUE)
+        prepared = PrepareQuery(query, folder);
+    }
+
+    if(prepared == TRUE)
+    {
+      struct TextIndex *ti = folder->textIndex;
+      ULONG number;
+
+      // mails which were added or replaced after the index was updated
+      // are unknown to the index
+      if(GetMailNumber(ti, mail->MailFile, &number) == TRUE && number < ti->mailCount)
+      {
+        struct TextIndexMail *tim = &ti->mails[number];
+
+        if(isFlagClear(tim->flags, TIMF_UNINDEXED) &&
+           tim->size == mail->Size && memcmp(&tim->date, &mail->Date, sizeof(tim->date)) == 0)
+        {
+          if(query->matches[number] != query->wordCount)
+            result = TIR_NOMATCH;
+          else if(query->exact == TRUE)
+            result = TIR_MATCH;
+        }
+      }
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
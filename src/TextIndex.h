@@ -0,0 +1,67 @@
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H 1
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <exec/types.h>
+
+// forward declarations
+struct Folder;
+struct Mail;
+struct TextIndex;
+struct TextIndexQuery;
+
+/*
+ A per-folder full-text index of the decoded texts of all mails to speed up
+ body searches. The texts are split into words using the same rules as the
+ spam filter's tokenizer and each word refers to the list of mails it
+ occurs in. A search string is split the same way and only mails which
+ contain all words of the search string are candidates for a match.
+
+ The index is synchronized with the folder's mails on demand, i.e. only
+ mails which have been added since the last search are read in and mails
+ which were removed are dropped. The index is saved to the .textindex file
+ of the folder after each modification.
+*/
+
+// the result of checking a mail against the full-text index
+enum TextIndexResult
+{
+  TIR_UNKNOWN = 0, // the index cannot tell, the mail must be searched
+  TIR_NOMATCH,     // the mail definitely doesn't match
+  TIR_MATCH        // the mail definitely matches
+};
+
+BOOL TextIndexUpdate(struct Folder *folder);
+void TextIndexFree(struct Folder *folder);
+void TextIndexDelete(struct Folder *folder);
+struct TextIndexQuery *TextIndexCreateQuery(const char *pattern, const BOOL caseSensitive, const BOOL substring);
+void TextIndexDeleteQuery(struct TextIndexQuery *query);
+enum TextIndexResult TextIndexMatchMail(struct TextIndexQuery *query, const struct Mail *mail);
+
+#endif /* TEXTINDEX_H */
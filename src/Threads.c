@@ -55,6 +55,7 @@
 #endif
 
 #include "YAM.h"
+#include "YAM_mainFolder.h"
 #include "YAM_utilities.h"
 
 #include "SDI_stdarg.h"
@@ -63,6 +64,7 @@
 
 #include "Locale.h"
 #include "MailExport.h"
+#include "MailServers.h"
 #include "MailImport.h"
 #include "MethodStack.h"
 #include "Requesters.h"
@@ -70,6 +72,7 @@
 
 #include "mui/ClassesExtra.h"
 #include "tcp/http.h"
+#include "tcp/imap.h"
 #include "tcp/pop3.h"
 #include "tcp/smtp.h"
 
@@ -249,9 +252,21 @@ static LONG DoThreadMessage(struct ThreadMessage *msg)
 
     case TA_ReceiveMails:
     {
-      result = ReceiveMails((struct MailServerNode *)GetTagData(TT_ReceiveMails_MailServer, (IPTR)NULL, msg->actionTags),
-                            GetTagData(TT_ReceiveMails_Flags, 0, msg->actionTags),
-                            (struct DownloadResult *)GetTagData(TT_ReceiveMails_Result, (IPTR)NULL, msg->actionTags));
+      struct MailServerNode *msn = (struct MailServerNode *)GetTagData(TT_ReceiveMails_MailServer, (IPTR)NULL, msg->actionTags);
+
+      // IMAP servers are handled by their own protocol implementation
+      if(isIMAPServer(msn))
+      {
+        result = ReceiveIMAPMails(msn,
+                                  GetTagData(TT_ReceiveMails_Flags, 0, msg->actionTags),
+                                  (struct DownloadResult *)GetTagData(TT_ReceiveMails_Result, (IPTR)NULL, msg->actionTags));
+      }
+      else
+      {
+        result = ReceiveMails(msn,
+                              GetTagData(TT_ReceiveMails_Flags, 0, msg->actionTags),
+                              (struct DownloadResult *)GetTagData(TT_ReceiveMails_Result, (IPTR)NULL, msg->actionTags));
+      }
     }
     break;
 
@@ -279,6 +294,30 @@ static LONG DoThreadMessage(struct ThreadMessage *msg)
                            GetTagData(TT_DownloadURL_Flags, 0, msg->actionTags));
     }
     break;
+
+    case TA_ScanFolder:
+    {
+      result = MA_ScanFolderFiles((struct FolderScan *)GetTagData(TT_ScanFolder_Scan, (IPTR)NULL, msg->actionTags));
+    }
+    break;
+
+    case TA_ClassifyMails:
+    {
+      result = BayesFilterClassifyBatch((struct SpamBatch *)GetTagData(TT_ClassifyMails_Batch, (IPTR)NULL, msg->actionTags));
+    }
+    break;
+
+    case TA_SendMailQueue:
+    {
+      result = SendQueuedMails((struct SendMailQueue *)GetTagData(TT_SendMailQueue_Queue, (IPTR)NULL, msg->actionTags));
+    }
+    break;
+
+    case TA_WatchIMAP:
+    {
+      result = WatchIMAPMailbox((struct IMAPWatcher *)GetTagData(TT_WatchIMAP_Watcher, (IPTR)NULL, msg->actionTags));
+    }
+    break;
   }
 
   D(DBF_THREAD, "thread '%s' finished action %ld, result %ld", msg->thread->name, msg->action, result);
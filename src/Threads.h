@@ -44,6 +44,10 @@ enum ThreadAction
   TA_ImportMails,
   TA_ExportMails,
   TA_DownloadURL,
+  TA_ScanFolder,
+  TA_ClassifyMails,
+  TA_SendMailQueue,
+  TA_WatchIMAP,
 };
 
 #define TT_Priority                                0xf001 // priority of the thread
@@ -74,6 +78,14 @@ enum ThreadAction
 #define TT_DownloadURL_Filename      (TAG_STRING | (TAG_USER + 3))
 #define TT_DownloadURL_Flags                       (TAG_USER + 4)
 
+#define TT_ScanFolder_Scan                         (TAG_USER + 1)
+
+#define TT_ClassifyMails_Batch                     (TAG_USER + 1)
+
+#define TT_SendMailQueue_Queue                     (TAG_USER + 1)
+
+#define TT_WatchIMAP_Watcher                       (TAG_USER + 1)
+
 /*** Thread system init/cleanup functions ***/
 BOOL InitThreads(void);
 void CleanupThreads(void);
@@ -45,6 +45,11 @@
 
 #include "Debug.h"
 
+// the database file is rewritten from scratch as soon as more than one
+// out of this number of UIDLs in it is outdated, otherwise new UIDLs are
+// just appended
+#define UIDL_COMPACT_RATIO 4
+
 /// BuildUIDLFilename
 // set up a name for a UIDL file to be accessed
 static void BuildUIDLFilename(const struct MailServerNode *msn, char *uidlPath, const size_t uidlPathSize)
@@ -73,78 +78,190 @@ static void BuildUIDLFilename(const struct MailServerNode *msn, char *uidlPath,
 }
 
 ///
-/// InitUIDLhash
-// Initialize the UIDL list and load it from the .uidl file
-struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
+/// UIDLClearEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void UIDLClearEntry(struct HashTable *table, struct HashEntryHeader *entry)
 {
-  struct UIDLhash *uidlHash;
+  struct UIDLtoken *token = (struct UIDLtoken *)entry;
+
+  // loaded UIDLs are freed together with the file buffer
+  if(isFlagClear(token->flags, UIDLF_LOADED))
+    free((char *)token->uidl);
+  memset(entry, 0, table->entrySize);
+}
+
+///
+/// UIDLDestroyEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void UIDLDestroyEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  struct UIDLtoken *token = (struct UIDLtoken *)entry;
+
+  // loaded UIDLs are freed together with the file buffer
+  if(isFlagClear(token->flags, UIDLF_LOADED))
+    free((char *)token->uidl);
+}
+
+///
+/// uidlOps
+static const struct HashTableOps uidlOps =
+{
+  DefaultHashAllocTable,
+  DefaultHashFreeTable,
+  DefaultHashGetKey,
+  StringHashHashKey,
+  StringHashMatchEntry,
+  DefaultHashMoveEntry,
+  UIDLClearEntry,
+  DefaultHashFinalize,
+  NULL,
+  UIDLDestroyEntry
+};
+
+///
+/// LoadUIDLfile
+// read a complete UIDL database file with a single read operation and
+// add all UIDLs to the hash, the tokens point directly into the file
+// buffer instead of being duplicated one by one
+static void LoadUIDLfile(struct UIDLhash *uidlHash, FILE *fh, const char *uidlPath, const LONG size, const BOOL oldUIDLFile)
+{
+  char *buffer;
 
   ENTER();
 
-  if((uidlHash = malloc(sizeof(*uidlHash))) != NULL)
+  if((buffer = malloc(size+1)) != NULL && fread(buffer, 1, size, fh) == (size_t)size)
   {
-    // allocate a new hashtable for managing the UIDL data
-    if((uidlHash->hash = HashTableNew(HashTableGetDefaultStringOps(), NULL, sizeof(struct UIDLtoken), 512)) != NULL)
-    {
-      char uidlPath[SIZE_PATHFILE];
-      LONG size;
-      FILE *fh = NULL;
-      BOOL oldUIDLFile = FALSE;
+    char *line = buffer;
+    char *end = &buffer[size];
+    BOOL validFile = FALSE;
+    BOOL complete;
 
-      // try to access the account specific .uidl file first
-      BuildUIDLFilename(msn, uidlPath, sizeof(uidlPath));
-      if(ObtainFileInfo(uidlPath, FI_SIZE, &size) == TRUE && size > 0)
+    // new UIDLs may be appended to an account specific file only, and only
+    // if its last line is complete
+    complete = (oldUIDLFile == FALSE && buffer[size-1] == '\n');
+    *end = '\0';
+
+    if(oldUIDLFile == TRUE)
+    {
+      // old UIDL files are considered to be always valid
+      validFile = TRUE;
+    }
+    else
+    {
+      // new UIDL files must contain the usual header
+      if(strncmp(line, "UIDL", 4) == 0)
       {
-        fh = fopen(uidlPath, "r");
+        if((line = memchr(line, '\n', end-line)) != NULL)
+          line++;
+        else
+          line = end;
+
+        validFile = TRUE;
       }
+    }
 
-      if(fh == NULL)
+    if(validFile == TRUE)
+    {
+      // add all read UIDLs to the hash marking them as OLD
+      while(line < end)
       {
-        // an account specific UIDL does not seem to exist, try the old .uidl file instead
-        BuildUIDLFilename(NULL, uidlPath, sizeof(uidlPath));
-        if(ObtainFileInfo(uidlPath, FI_SIZE, &size) == TRUE && size > 0)
+        char *eol;
+        size_t len;
+
+        if((eol = memchr(line, '\n', end-line)) == NULL)
+          eol = end;
+
+        // strip the line ending
+        len = eol-line;
+        if(len > 0 && line[len-1] == '\r')
+          len--;
+        line[len] = '\0';
+
+        if(len > 0)
         {
-          fh = fopen(uidlPath, "r");
-          // this file is definitely an old style UIDL file without header
-          oldUIDLFile = TRUE;
+          struct UIDLtoken *token;
+
+          if((token = (struct UIDLtoken *)HashTableOperate(uidlHash->hash, line, htoAdd)) != NULL)
+          {
+            if(token->uidl == NULL)
+            {
+              token->uidl = line;
+              token->flags = UIDLF_OLD|UIDLF_LOADED;
+            }
+            else
+              setFlag(token->flags, UIDLF_OLD);
+          }
+          else
+            E(DBF_UIDL, "couldn't add UIDL '%s' to hash", line);
+
+          uidlHash->fileCount++;
         }
+
+        line = eol+1;
       }
 
-      if(fh != NULL)
-      {
-        // now read in the UIDL/MsgIDs line-by-line
-        char *uidl = NULL;
-        size_t uidlLen = 0;
-        BOOL validFile = FALSE;
+      uidlHash->appendable = complete;
 
-        D(DBF_UIDL, "opened UIDL database file '%s'", uidlPath);
+      // the buffer lives as long as the hash, because the tokens refer to it
+      uidlHash->fileBuffer = buffer;
+      buffer = NULL;
+    }
+    else
+      W(DBF_UIDL, "file '%s' is no valid UIDL database file", uidlPath);
+  }
+  else
+    E(DBF_UIDL, "couldn't read UIDL database file '%s'", uidlPath);
 
-        setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+  free(buffer);
 
-        if(oldUIDLFile == TRUE)
-        {
-          // old UIDL files are considered to be always valid
-          validFile = TRUE;
-        }
-        else
-        {
-          // new UIDL files must contain the usual header
-          if(GetLine(&uidl, &uidlLen, fh) >= 0 && strncmp(uidl, "UIDL", 4) == 0)
-            validFile = TRUE;
-        }
+  LEAVE();
+}
 
-        if(validFile == TRUE)
-        {
-          // add all read UIDLs to the hash marking them as OLD
-          while(GetLine(&uidl, &uidlLen, fh) >= 0)
-            AddUIDLtoHash(uidlHash, uidl, UIDLF_OLD);
-        }
-        else
-          W(DBF_UIDL, "file '%s' is no valid UIDL database file", uidlPath);
+///
+/// InitUIDLhash
+// Initialize the UIDL list and load it from the .uidl file
+struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
+{
+  struct UIDLhash *uidlHash;
+
+  ENTER();
 
-        fclose(fh);
+  if((uidlHash = calloc(1, sizeof(*uidlHash))) != NULL)
+  {
+    char uidlPath[SIZE_PATHFILE];
+    LONG size;
+    FILE *fh = NULL;
+    BOOL oldUIDLFile = FALSE;
+
+    // try to access the account specific .uidl file first
+    BuildUIDLFilename(msn, uidlPath, sizeof(uidlPath));
+    if(ObtainFileInfo(uidlPath, FI_SIZE, &size) == TRUE && size > 0)
+    {
+      fh = fopen(uidlPath, "r");
+    }
 
-        free(uidl);
+    if(fh == NULL)
+    {
+      // an account specific UIDL does not seem to exist, try the old .uidl file instead
+      BuildUIDLFilename(NULL, uidlPath, sizeof(uidlPath));
+      if(ObtainFileInfo(uidlPath, FI_SIZE, &size) == TRUE && size > 0)
+      {
+        fh = fopen(uidlPath, "r");
+        // this file is definitely an old style UIDL file without header
+        oldUIDLFile = TRUE;
+      }
+    }
+
+    // allocate a new hashtable for managing the UIDL data, roughly
+    // estimate the number of UIDLs by the size of the file to avoid
+    // growing the table over and over again
+    if((uidlHash->hash = HashTableNew(&uidlOps, NULL, sizeof(struct UIDLtoken), fh != NULL ? MAX(512, size / 32) : 512)) != NULL)
+    {
+      if(fh != NULL)
+      {
+        D(DBF_UIDL, "opened UIDL database file '%s'", uidlPath);
+
+        LoadUIDLfile(uidlHash, fh, uidlPath, size, oldUIDLFile);
       }
       else
         W(DBF_UIDL, "UIDL database file '%s' does not exist", uidlPath);
@@ -162,6 +279,9 @@ struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
       free(uidlHash);
       uidlHash = NULL;
     }
+
+    if(fh != NULL)
+      fclose(fh);
   }
   else
     E(DBF_UIDL, "couldn't create new Hashtable for UIDL management");
@@ -170,6 +290,62 @@ struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
   return uidlHash;
 }
 
+
+struct UIDLcounts
+{
+  ULONG keep;    // number of UIDLs to be kept
+  ULONG keepOld; // number of UIDLs to be kept which are part of the database file already
+};
+
+/// CountUIDLtoken
+// HashTable callback function to count the UIDLtokens which are still needed
+static enum HashTableOperator CountUIDLtoken(UNUSED struct HashTable *table,
+                                             struct HashEntryHeader *entry,
+                                             UNUSED ULONG number,
+                                             void *arg)
+{
+  struct UIDLtoken *token = (struct UIDLtoken *)entry;
+  struct UIDLcounts *counts = (struct UIDLcounts *)arg;
+
+  ENTER();
+
+  if(isFlagSet(token->flags, UIDLF_NEW))
+  {
+    counts->keep++;
+    if(isFlagSet(token->flags, UIDLF_OLD))
+      counts->keepOld++;
+  }
+
+  RETURN(htoNext);
+  return htoNext;
+}
+
+///
+/// AppendUIDLtoken
+// HashTable callback function to append a new UIDLtoken
+static enum HashTableOperator AppendUIDLtoken(UNUSED struct HashTable *table,
+                                              struct HashEntryHeader *entry,
+                                              UNUSED ULONG number,
+                                              void *arg)
+{
+  struct UIDLtoken *token = (struct UIDLtoken *)entry;
+
+  ENTER();
+
+  // only UIDLs which are not yet part of the file are appended, outdated
+  // UIDLs stay in the file until the next compaction
+  if(isFlagSet(token->flags, UIDLF_NEW) && isFlagClear(token->flags, UIDLF_OLD))
+  {
+    FILE *fh = (FILE *)arg;
+
+    fprintf(fh, "%s\n", token->uidl);
+    D(DBF_UIDL, "appended UIDL '%s' to .uidl file", token->uidl);
+  }
+
+  RETURN(htoNext);
+  return htoNext;
+}
+
 ///
 /// SaveUIDLtoken
 // HashTable callback function to save an UIDLtoken
@@ -214,16 +390,43 @@ void CleanupUIDLhash(struct UIDLhash *uidlHash)
       if(uidlHash->isDirty == TRUE)
       {
         char uidlPath[SIZE_PATHFILE];
+        struct UIDLcounts counts;
+        ULONG outdated;
         FILE *fh;
 
         // we are saving account specific .uidl files only, the old one will be kept
         // in case it still contains UIDLs of multiple accounts
         BuildUIDLFilename(uidlHash->mailServer, uidlPath, sizeof(uidlPath));
 
+        // find out how many lines of the file are no longer needed
+        counts.keep = 0;
+        counts.keepOld = 0;
+        HashTableEnumerate(uidlHash->hash, CountUIDLtoken, &counts);
+        outdated = uidlHash->fileCount - counts.keepOld;
+
+        D(DBF_UIDL, "%ld UIDLs to keep, %ld of %ld UIDLs in file outdated", counts.keep, outdated, uidlHash->fileCount);
+
+        if(uidlHash->appendable == TRUE && outdated <= counts.keep / UIDL_COMPACT_RATIO)
+        {
+          // just append the new UIDLs to the existing file and let the
+          // outdated ones accumulate until it is worth to compact the file
+          if((fh = fopen(uidlPath, "a")) != NULL)
+          {
+            setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+            HashTableEnumerate(uidlHash->hash, AppendUIDLtoken, fh);
+
+            fclose(fh);
+          }
+          else
+            E(DBF_UIDL, "couldn't open '%s' for appending", uidlPath);
+        }
         // before we go and destroy the UIDL hash we have to
         // write it to the .uidl file back again.
-        if((fh = fopen(uidlPath, "w")) != NULL)
+        else if((fh = fopen(uidlPath, "w")) != NULL)
         {
+          D(DBF_UIDL, "compacting UIDL database file '%s'", uidlPath);
+
           setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
           fprintf(fh, "UIDL - YAM UIDL database for %s@%s\n", uidlHash->mailServer->username, uidlHash->mailServer->hostname);
@@ -243,6 +446,9 @@ void CleanupUIDLhash(struct UIDLhash *uidlHash)
       D(DBF_UIDL, "destroyed UIDL hash table");
     }
 
+    // the loaded tokens are gone, now their strings can go as well
+    free(uidlHash->fileBuffer);
+
     free(uidlHash);
 
     D(DBF_UIDL, "cleaned up UIDLhash");
@@ -36,6 +36,9 @@ struct UIDLhash
 {
   struct HashTable *hash;            // the hash table to hold all data
   struct MailServerNode *mailServer; // the mail server for which the data are to be managed
+  char *fileBuffer;                  // the contents of the database file, shared by all loaded tokens
+  ULONG fileCount;                   // number of UIDLs in the database file
+  BOOL appendable;                   // can new UIDLs be appended to the database file?
   BOOL isDirty;                      // did anything change during the POP/IMAP session?
 };
 
@@ -48,6 +51,7 @@ struct UIDLtoken
 
 #define UIDLF_OLD     (1<<0) // we knew this UIDL before
 #define UIDLF_NEW     (1<<1) // this is a new UIDL
+#define UIDLF_LOADED  (1<<2) // the UIDL string is part of the loaded database file
 
 struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn);
 struct UIDLtoken *AddUIDLtoHash(struct UIDLhash *uidlHash, const char *uidl, const ULONG flags);
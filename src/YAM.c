@@ -114,11 +114,13 @@
 #include "MethodStack.h"
 #include "Requesters.h"
 #include "Rexx.h"
+#include "StringTable.h"
 #include "Threads.h"
 #include "Timer.h"
 #include "TZone.h"
 #include "UpdateCheck.h"
 #include "UserIdentity.h"
+#include "tcp/imap.h"
 #include "tcp/ssl.h"
 
 #include "Debug.h"
@@ -725,6 +727,9 @@ static void Terminate(void)
   // we are going down from now on
   G->Terminating = TRUE;
 
+  D(DBF_STARTUP, "stopping IMAP watchers...");
+  StopIMAPWatchers();
+
   D(DBF_STARTUP, "aborting all working threads...");
   AbortWorkingThreads();
 
@@ -785,6 +790,20 @@ static void Terminate(void)
 
     LockFolderList(G->folders);
 
+    #if defined(DEBUG)
+    {
+      ULONG numMails = 0;
+
+      ForEachFolderNode(G->folders, fnode)
+      {
+        if(fnode->folder->messages != NULL)
+          numMails += fnode->folder->messages->count;
+      }
+
+      DumpMailMemoryUsage(numMails);
+    }
+    #endif
+
     ForEachFolderNode(G->folders, fnode)
     {
       FO_FreeFolder(fnode->folder);
@@ -956,6 +975,13 @@ static void Terminate(void)
   CLOSELIB(CodesetsBase, ICodesets);
   CLOSELIB(LocaleBase, ILocale);
 
+  // free the index journal semaphore
+  if(G->journalSemaphore != NULL)
+  {
+    FreeSysObject(ASOT_SEMAPHORE, G->journalSemaphore);
+    G->journalSemaphore = NULL;
+  }
+
   // free the configuration semaphore
   if(G->configSemaphore != NULL)
   {
@@ -996,6 +1022,9 @@ static void Terminate(void)
     G->mailsInTransfer = NULL;
   }
 
+  // all mails are gone now, so are the references to their strings
+  CleanupStringTable();
+
   if(G->lowMemHandler != NULL)
   {
     RemMemHandler(G->lowMemHandler);
@@ -2452,6 +2481,7 @@ int main(int argc, char **argv)
     NewMinList(&G->normalBusyList);
     NewMinList(&G->arexxBusyList);
     NewMinList(&G->tzoneContinentList);
+    NewMinList(&G->imapWatchers);
     InitABook(&G->abook, NULL);
 
     if((C = AllocConfig()) == NULL)
@@ -2493,6 +2523,12 @@ int main(int argc, char **argv)
       break;
     }
 
+    if((G->journalSemaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) == NULL)
+    {
+      // break out immediately to signal an error!
+      break;
+    }
+
     // allocate two virtual mail parts for the attachment requester
     // these two must be accessible all the time
     if((G->virtualMailpart[0] = calloc(1, sizeof(*G->virtualMailpart[0]))) == NULL)
@@ -2501,12 +2537,21 @@ int main(int argc, char **argv)
     if((G->virtualMailpart[1] = calloc(1, sizeof(*G->virtualMailpart[1]))) == NULL)
       break;
 
+    // setup the table of strings shared by all mails
+    if(InitStringTable() == FALSE)
+    {
+      // break out immediately to signal an error!
+      break;
+    }
+
     // setup the item pools for mails and mail nodes
     if((G->mailItemPool = AllocSysObjectTags(ASOT_ITEMPOOL,
       ASOITEM_MFlags, MEMF_SHARED|MEMF_CLEAR,
       ASOITEM_ItemSize, sizeof(struct Mail),
       ASOITEM_BatchSize, 1000,
       ASOITEM_GCPolicy, ITEMGC_AFTERCOUNT,
+      // mails are allocated by several folder scanning threads at once
+      ASOITEM_Protected, TRUE,
       TAG_DONE)) == NULL)
     {
       // break out immediately to signal an error!
@@ -2700,6 +2745,9 @@ int main(int argc, char **argv)
     PreparePOP3Timers();
     StartPOP3Timers();
 
+    // let the IMAP servers tell about new mails themselves
+    StartIMAPWatchers();
+
     // initialize the automatic UpdateCheck facility and schedule an
     // automatic update check during startup if necessary
     InitUpdateCheck(TRUE);
@@ -122,6 +122,7 @@ struct Global
   struct SignalSemaphore * connectionSemaphore;  // a semaphore to lock all connections agains each other
   struct SignalSemaphore * hostResolveSemaphore; // a semaphore to lock all host resolve (gethostbyname) calls
   struct SignalSemaphore * configSemaphore;      // a semaphore to prevent concurrent changes to the configuration
+  struct SignalSemaphore * journalSemaphore;     // a semaphore to serialize writing the folder index journals
   struct Part *            virtualMailpart[2];   // two virtual mail parts for the attachment requester window
   struct Folder *          currentFolder;        // the currently active folder
   APTR                     mailItemPool;         // item pool for struct Mail
@@ -174,6 +175,7 @@ struct Global
   struct MinList           normalBusyList;       // list of active busy actions, normal usage
   struct MinList           arexxBusyList;        // list of active busy actions, ARexx usage
   struct MinList           tzoneContinentList;   // parsed stuff from zone.tab file
+  struct MinList           imapWatchers;         // threads watching IMAP mailboxes via IDLE
   struct Theme             theme;
   struct TokenAnalyzer     spamFilter;
   struct Timers            timerData;
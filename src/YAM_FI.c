@@ -62,18 +62,21 @@
 #include "mui/WriteWindow.h"
 #include "mui/YAMApplication.h"
 
+#include "AhoCorasick.h"
 #include "BayesFilter.h"
 #include "BoyerMooreSearch.h"
 #include "Busy.h"
 #include "Config.h"
 #include "DynamicString.h"
 #include "FolderList.h"
+#include "HashTable.h"
 #include "Locale.h"
 #include "Logfile.h"
 #include "MailList.h"
 #include "MethodStack.h"
 #include "MUIObjects.h"
 #include "Requesters.h"
+#include "TextIndex.h"
 #include "Threads.h"
 
 #include "Debug.h"
@@ -81,6 +84,51 @@
 /* local protos */
 static BOOL CopySearchData(struct Search *dstSearch, struct Search *srcSearch);
 
+// Substring rules which search the same text of a mail are collected in a
+// group and the patterns of all rules of a group are compiled into a single
+// Aho-Corasick automaton. This way each text of a mail is scanned only once
+// for all filters instead of once for each single rule.
+struct FilterMatchGroup
+{
+  struct MinNode node;
+  enum FastSearch fast;                // the searched standard field or FS_NONE for other header fields
+  int persMode;                        // search the real names instead of the addresses
+  char field[SIZE_DEFAULT];            // the searched header field for FS_NONE, empty for all fields
+  int fieldLen;                        // number of significant characters of the field name
+  struct AhoCorasickContext *acc;
+};
+
+struct FilterMatcher
+{
+  struct MinList groupList;            // list of struct FilterMatchGroup
+  ULONG fields;                        // (1 << fast) for all the searched fields
+  ULONG numSlots;                      // number of compiled rules plus one
+  UBYTE *matches;                      // match state of the compiled rules for the current mail
+};
+
+// The header of the mail which is currently filtered. It is read only once
+// for all rules of a filter list and the single lines are decoded only when
+// a rule really looks at them.
+struct HeaderField
+{
+  struct HashEntryHeader hash;
+  char *name;                          // the field name of a rule in lower case, without ':'
+  ULONG *lines;                        // indices of the header lines whose name starts with the field name
+  ULONG numLines;
+};
+
+struct HeaderCache
+{
+  const struct Mail *mail;             // the mail the cached header belongs to
+  BOOL read;                           // the header has been read already
+  BOOL validateAddresses;              // the address lines must be validated after decoding
+  struct MinList *headerList;          // the raw header lines, NULL if the header couldn't be read
+  struct HeaderNode **lines;           // the header lines in their original order
+  UBYTE *decoded;                      // the lines which have been decoded already
+  ULONG numLines;
+  struct HashTable fields;             // struct HeaderField for each field name looked up
+};
+
 /***************************************************************************
  Module: Find & Filters
 ***************************************************************************/
@@ -189,13 +237,13 @@ static BOOL FI_MatchString(const struct Search *search, const char *string)
 ///
 /// FI_MatchPerson
 //  Matches string against a person's name or address
-static BOOL FI_MatchPerson(const struct Search *search, const struct Person *pe)
+static BOOL FI_MatchPerson(const struct Search *search, const char *address, const char *realName)
 {
   BOOL match;
 
   ENTER();
 
-  match = FI_MatchString(search, search->PersMode ? pe->RealName : pe->Address);
+  match = FI_MatchString(search, search->PersMode ? realName : address);
 
   RETURN(match);
   return match;
@@ -217,7 +265,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
     {
       struct ExtendedMail *email;
 
-      if(FI_MatchPerson(search, &mail->From) == TRUE)
+      if(FI_MatchPerson(search, mail->From.Address, mail->From.RealName) == TRUE)
       {
         found = TRUE;
       }
@@ -227,7 +275,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 
         for(i=0; i < email->NumSFrom; i++)
         {
-          if(FI_MatchPerson(search, &email->SFrom[i]) == TRUE)
+          if(FI_MatchPerson(search, email->SFrom[i].Address, email->SFrom[i].RealName) == TRUE)
           {
             found = TRUE;
             break;
@@ -244,7 +292,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
     {
       struct ExtendedMail *email;
 
-      if(FI_MatchPerson(search, &mail->To) == TRUE)
+      if(FI_MatchPerson(search, mail->To.Address, mail->To.RealName) == TRUE)
       {
         found = TRUE;
       }
@@ -254,7 +302,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 
         for(i=0; i < email->NumSTo; i++)
         {
-          if(FI_MatchPerson(search, &email->STo[i]) == TRUE)
+          if(FI_MatchPerson(search, email->STo[i].Address, email->STo[i].RealName) == TRUE)
           {
             found = TRUE;
             break;
@@ -277,7 +325,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 
         for(i=0; i < email->NumCC; i++)
         {
-          if(FI_MatchPerson(search, &email->CC[i]) == TRUE)
+          if(FI_MatchPerson(search, email->CC[i].Address, email->CC[i].RealName) == TRUE)
           {
             found = TRUE;
             break;
@@ -294,7 +342,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
     {
       struct ExtendedMail *email;
 
-      if(FI_MatchPerson(search, &mail->ReplyTo) == TRUE)
+      if(FI_MatchPerson(search, mail->ReplyTo.Address, mail->ReplyTo.RealName) == TRUE)
       {
         found = TRUE;
       }
@@ -304,7 +352,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 
         for(i=0; i < email->NumSReplyTo; i++)
         {
-          if(FI_MatchPerson(search, &email->SReplyTo[i]) == TRUE)
+          if(FI_MatchPerson(search, email->SReplyTo[i].Address, email->SReplyTo[i].RealName) == TRUE)
           {
             found = TRUE;
             break;
@@ -433,11 +481,20 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 static BOOL FI_SearchPatternInBody(const struct Search *search, const struct Mail *mail)
 {
   BOOL found = FALSE;
+  enum TextIndexResult indexResult = TIR_UNKNOWN;
   struct ReadMailData *rmData;
 
   ENTER();
 
-  if((rmData = AllocPrivateRMData(mail, PM_TEXTS|PM_QUIET)) != NULL)
+  // let the full-text index decide first, this avoids reading in
+  // all the mails which cannot match at all
+  if(search->textQuery != NULL)
+  {
+    indexResult = TextIndexMatchMail(search->textQuery, mail);
+    found = (indexResult == TIR_MATCH);
+  }
+
+  if(indexResult == TIR_UNKNOWN && (rmData = AllocPrivateRMData(mail, PM_TEXTS|PM_QUIET)) != NULL)
   {
     char *cmsg;
 
@@ -475,13 +532,13 @@ static BOOL FI_SearchPatternInBody(const struct Search *search, const struct Mai
 }
 
 ///
-/// FI_SearchPatternInHeader
-//  Searches string in header field(s)
-static BOOL FI_SearchPatternInHeader(const struct Search *search, const struct Mail *mail)
+/// FI_ReadMailHeader
+//  Reads the main header of a mail into a new list of header nodes
+static struct MinList *FI_ReadMailHeader(const struct Mail *mail, const enum ReadHeaderMode mode)
 {
   char fullfile[SIZE_PATHFILE];
   char mailfile[SIZE_PATHFILE];
-  BOOL found = FALSE;
+  struct MinList *headerList = NULL;
 
   ENTER();
 
@@ -493,61 +550,360 @@ static BOOL FI_SearchPatternInHeader(const struct Search *search, const struct M
 
     if((fh = fopen(fullfile, "r")) != NULL)
     {
-      struct MinList *headerList;
-
       if((headerList = AllocSysObjectTags(ASOT_LIST,
         ASOLIST_Min, TRUE,
         TAG_DONE)) != NULL)
       {
         setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
-        if(MA_ReadHeader(mailfile, fh, headerList, RHM_MAINHEADER) == TRUE)
+        if(MA_ReadHeader(mailfile, fh, headerList, mode) == FALSE)
         {
-          int searchLen = 0;
-          struct HeaderNode *hdrNode;
+          ClearHeaderList(headerList);
+          FreeSysObject(ASOT_LIST, headerList);
+          headerList = NULL;
+        }
+      }
 
-          // prepare the search length ahead of the iteration
-          if(search->Field[0] != '\0')
-          {
-            char *ptr;
+      // close the file
+      fclose(fh);
+    }
 
-            // if the field is specified we search if it was specified with a ':'
-            // at the end
-            if((ptr = strchr(search->Field, ':')) != NULL)
-              searchLen = ptr-(search->Field);
-            else
-              searchLen = strlen(search->Field);
-          }
+    FinishUnpack(fullfile);
+  }
 
-          IterateList(headerList, struct HeaderNode *, hdrNode)
-          {
-            // if the field is explicitly specified we search for it or
-            // otherwise skip our search
-            if(search->Field[0] != '\0')
-            {
-              // the search length has been calculated before
-              if(strnicmp(hdrNode->name, search->Field, searchLen) != 0)
-                continue;
-            }
+  RETURN(headerList);
+  return headerList;
+}
 
-            found = FI_MatchString(search, hdrNode->content);
+///
+/// FI_FreeMailHeader
+//  Frees a header list read by FI_ReadMailHeader()
+static void FI_FreeMailHeader(struct MinList *headerList)
+{
+  ENTER();
 
-            // bail out as soon as we found a matching string
-            if(found == TRUE)
-              break;
-          }
+  ClearHeaderList(headerList);
+  FreeSysObject(ASOT_LIST, headerList);
+
+  LEAVE();
+}
+
+///
+/// FI_FieldLength
+//  Returns the number of significant characters of a header field name,
+//  a trailing ':' is not taken into account
+static int FI_FieldLength(const char *field)
+{
+  const char *ptr;
+  int len;
+
+  if((ptr = strchr(field, ':')) != NULL)
+    len = ptr-field;
+  else
+    len = strlen(field);
+
+  return len;
+}
+
+///
+/// HeaderFieldClearEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void HeaderFieldClearEntry(struct HashTable *table, struct HashEntryHeader *entry)
+{
+  struct HeaderField *field = (struct HeaderField *)entry;
+
+  free(field->name);
+  free(field->lines);
+  memset(entry, 0, table->entrySize);
+}
+
+///
+/// HeaderFieldDestroyEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void HeaderFieldDestroyEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  struct HeaderField *field = (struct HeaderField *)entry;
+
+  free(field->name);
+  free(field->lines);
+}
+
+///
+/// RemoveHeaderField
+// enumerator to remove all looked up field names from the cache
+static enum HashTableOperator RemoveHeaderField(UNUSED struct HashTable *table, UNUSED struct HashEntryHeader *entry, UNUSED ULONG number, UNUSED void *arg)
+{
+  return htoRemove;
+}
+
+///
+/// FI_CreateHeaderCache
+//  Creates an empty header cache for a filter pass
+static struct HeaderCache *FI_CreateHeaderCache(void)
+{
+  static const struct HashTableOps fieldOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    DefaultHashGetKey,
+    StringHashHashKey,
+    StringHashMatchEntry,
+    DefaultHashMoveEntry,
+    HeaderFieldClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    HeaderFieldDestroyEntry
+  };
+  struct HeaderCache *cache;
+
+  ENTER();
+
+  if((cache = calloc(1, sizeof(*cache))) != NULL)
+  {
+    if(HashTableInit(&cache->fields, &fieldOps, NULL, sizeof(struct HeaderField), 16) == FALSE)
+    {
+      free(cache);
+      cache = NULL;
+    }
+  }
+
+  RETURN(cache);
+  return cache;
+}
+
+///
+/// FI_ResetHeaderCache
+//  Forgets the cached header and prepares the cache for another mail,
+//  the header of the new mail is not read before it is really needed
+static void FI_ResetHeaderCache(struct HeaderCache *cache, const struct Mail *mail)
+{
+  ENTER();
+
+  if(cache->headerList != NULL)
+  {
+    FI_FreeMailHeader(cache->headerList);
+    cache->headerList = NULL;
+  }
+
+  free(cache->lines);
+  cache->lines = NULL;
+  free(cache->decoded);
+  cache->decoded = NULL;
+  cache->numLines = 0;
+
+  HashTableEnumerate(&cache->fields, RemoveHeaderField, NULL);
+
+  cache->mail = mail;
+  cache->read = FALSE;
+  cache->validateAddresses = FALSE;
+
+  LEAVE();
+}
+
+///
+/// FI_DeleteHeaderCache
+//  Frees a header cache at the end of a filter pass
+static void FI_DeleteHeaderCache(struct HeaderCache *cache)
+{
+  ENTER();
+
+  if(cache != NULL)
+  {
+    FI_ResetHeaderCache(cache, NULL);
+    HashTableCleanup(&cache->fields);
+    free(cache);
+  }
+
+  LEAVE();
+}
+
+///
+/// FI_ReadCachedHeader
+//  Reads the raw header of the cached mail if this has not been done yet,
+//  returns FALSE if the header is not available
+static BOOL FI_ReadCachedHeader(struct HeaderCache *cache)
+{
+  BOOL available;
+
+  ENTER();
+
+  if(cache->read == FALSE)
+  {
+    cache->read = TRUE;
+
+    if((cache->headerList = FI_ReadMailHeader(cache->mail, RHM_RAWHEADER)) != NULL)
+    {
+      struct HeaderNode *hdrNode;
+      ULONG numLines = 0;
+
+      IterateList(cache->headerList, struct HeaderNode *, hdrNode)
+        numLines++;
+
+      if((cache->lines = malloc(numLines * sizeof(*cache->lines))) != NULL &&
+         (cache->decoded = calloc(numLines, sizeof(*cache->decoded))) != NULL)
+      {
+        IterateList(cache->headerList, struct HeaderNode *, hdrNode)
+          cache->lines[cache->numLines++] = hdrNode;
+
+        cache->validateAddresses = MA_HasBrokenAddressLines(cache->headerList);
+      }
+      else
+      {
+        free(cache->lines);
+        cache->lines = NULL;
+        FI_FreeMailHeader(cache->headerList);
+        cache->headerList = NULL;
+      }
+    }
+  }
+
+  available = (cache->headerList != NULL);
+
+  RETURN(available);
+  return available;
+}
+
+///
+/// FI_GetHeaderLine
+//  Returns a line of the cached header, the line is decoded on first access
+static struct HeaderNode *FI_GetHeaderLine(struct HeaderCache *cache, const ULONG line)
+{
+  struct HeaderNode *hdrNode = cache->lines[line];
+
+  ENTER();
+
+  if(cache->decoded[line] == FALSE)
+  {
+    char mailfile[SIZE_PATHFILE];
+
+    GetMailFile(mailfile, sizeof(mailfile), NULL, cache->mail);
+
+    // a failed decoding leaves the content as it is
+    MA_DecodeHeaderNode(mailfile, hdrNode);
+
+    if(cache->validateAddresses == TRUE)
+      MA_ValidateAddressHeader(hdrNode);
+
+    cache->decoded[line] = TRUE;
+  }
+
+  RETURN(hdrNode);
+  return hdrNode;
+}
+
+///
+/// FI_FindHeaderField
+//  Returns the lines of the cached header matching the field name of a rule.
+//  The lines are collected on the first lookup of a field name for a mail,
+//  all further rules searching the same field get them from the hash table.
+static struct HeaderField *FI_FindHeaderField(struct HeaderCache *cache, const char *fieldName)
+{
+  struct HeaderField *result = NULL;
+  char name[SIZE_DEFAULT];
+
+  ENTER();
+
+  strlcpy(name, fieldName, MIN(sizeof(name), (size_t)FI_FieldLength(fieldName)+1));
+  ToLowerCase(name);
+
+  if(FI_ReadCachedHeader(cache) == TRUE)
+  {
+    struct HashEntryHeader *entry;
+
+    if((entry = HashTableOperate(&cache->fields, name, htoLookup)) != NULL && HASH_ENTRY_IS_LIVE(entry))
+    {
+      result = (struct HeaderField *)entry;
+    }
+    else if((entry = HashTableOperate(&cache->fields, name, htoAdd)) != NULL)
+    {
+      struct HeaderField *field = (struct HeaderField *)entry;
+
+      if((field->name = strdup(name)) != NULL &&
+         (field->lines = malloc(MAX(cache->numLines, 1) * sizeof(*field->lines))) != NULL)
+      {
+        size_t nameLen = strlen(name);
+        ULONG i;
+
+        for(i = 0; i < cache->numLines; i++)
+        {
+          if(strnicmp(cache->lines[i]->name, name, nameLen) == 0)
+            field->lines[field->numLines++] = i;
         }
 
-        // free our temporary headerList
-        ClearHeaderList(headerList);
-        FreeSysObject(ASOT_LIST, headerList);
+        result = field;
       }
+      else
+        HashTableRawRemove(&cache->fields, entry);
+    }
+  }
 
-      // close the file
-      fclose(fh);
+  RETURN(result);
+  return result;
+}
+
+///
+/// FI_SearchPatternInHeader
+//  Searches string in header field(s), the header is taken from the
+//  cache of the current filter pass if there is one
+static BOOL FI_SearchPatternInHeader(const struct Search *search, const struct Mail *mail, struct HeaderCache *cache)
+{
+  struct MinList *headerList;
+  BOOL found = FALSE;
+
+  ENTER();
+
+  if(cache != NULL)
+  {
+    if(search->Field[0] == '\0')
+    {
+      // search all header fields
+      if(FI_ReadCachedHeader(cache) == TRUE)
+      {
+        ULONG i;
+
+        for(i = 0; i < cache->numLines && found == FALSE; i++)
+          found = FI_MatchString(search, FI_GetHeaderLine(cache, i)->content);
+      }
     }
+    else
+    {
+      struct HeaderField *field;
 
-    FinishUnpack(fullfile);
+      if((field = FI_FindHeaderField(cache, search->Field)) != NULL)
+      {
+        ULONG i;
+
+        for(i = 0; i < field->numLines && found == FALSE; i++)
+          found = FI_MatchString(search, FI_GetHeaderLine(cache, field->lines[i])->content);
+      }
+    }
+  }
+  else if((headerList = FI_ReadMailHeader(mail, RHM_MAINHEADER)) != NULL)
+  {
+    // prepare the search length ahead of the iteration
+    int searchLen = FI_FieldLength(search->Field);
+    struct HeaderNode *hdrNode;
+
+    IterateList(headerList, struct HeaderNode *, hdrNode)
+    {
+      // if the field is explicitly specified we search for it or
+      // otherwise skip our search
+      if(search->Field[0] != '\0')
+      {
+        // the search length has been calculated before
+        if(strnicmp(hdrNode->name, search->Field, searchLen) != 0)
+          continue;
+      }
+
+      found = FI_MatchString(search, hdrNode->content);
+
+      // bail out as soon as we found a matching string
+      if(found == TRUE)
+        break;
+    }
+
+    // free our temporary headerList
+    FI_FreeMailHeader(headerList);
   }
 
   RETURN(found);
@@ -802,14 +1158,23 @@ BOOL FI_PrepareSearch(struct Search *search, const enum SearchMode mode,
     }
   }
 
+  if(success == TRUE && isFlagSet(flags, SEARCHF_TEXT_INDEX) && isFlagClear(flags, SEARCHF_DOS_PATTERN) &&
+     (mode == SM_BODY || mode == SM_WHOLE) && (compare == CP_EQUAL || compare == CP_NOTEQUAL))
+  {
+    // body searches may be answered by the full-text indexes of the folders,
+    // a failure here is no problem as the mails are searched as usual then
+    search->textQuery = TextIndexCreateQuery(search->Match, isFlagSet(flags, SEARCHF_CASE_SENSITIVE), isFlagSet(flags, SEARCHF_SUBSTRING));
+  }
+
   RETURN(success);
   return success;
 }
 
 ///
-/// FI_DoSearch
-//  Checks if a message fulfills the search criteria
-BOOL FI_DoSearch(struct Search *search, const struct Mail *mail)
+/// FI_SearchMail
+//  Checks if a message fulfills the search criteria, the header is taken
+//  from the cache of the current filter pass if there is one
+static BOOL FI_SearchMail(struct Search *search, const struct Mail *mail, struct HeaderCache *cache)
 {
   BOOL found = FALSE;
   #if defined(DEBUG)
@@ -859,7 +1224,7 @@ BOOL FI_DoSearch(struct Search *search, const struct Mail *mail)
     {
       // check whether this is a fast search or not.
       if(search->Fast == FS_NONE)
-        found = FI_SearchPatternInHeader(search, mail);
+        found = FI_SearchPatternInHeader(search, mail, cache);
       else
         found = FI_SearchPatternFast(search, mail);
 
@@ -876,7 +1241,7 @@ BOOL FI_DoSearch(struct Search *search, const struct Mail *mail)
 
       // always perform a matching search
       search->Compare = CP_EQUAL;
-      found = FI_SearchPatternInHeader(search, mail);
+      found = FI_SearchPatternInHeader(search, mail, cache);
       search->Compare = oldCompare;
 
       // invert the result in case a non-matching search was requested
@@ -925,7 +1290,7 @@ BOOL FI_DoSearch(struct Search *search, const struct Mail *mail)
 
         // always perform a matching search
         search->Compare = CP_EQUAL;
-        found = FI_SearchPatternInHeader(search, mail);
+        found = FI_SearchPatternInHeader(search, mail, cache);
         if(found == FALSE)
           found = FI_SearchPatternInBody(search, mail);
         search->Compare = oldCompare;
@@ -1020,9 +1385,334 @@ BOOL FI_DoSearch(struct Search *search, const struct Mail *mail)
 }
 
 ///
-/// DoFilterSearch()
-//  Does a complex search with combined criterias based on the rules of a filter
-BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail)
+/// FI_DoSearch
+//  Checks if a message fulfills the search criteria
+BOOL FI_DoSearch(struct Search *search, const struct Mail *mail)
+{
+  BOOL found;
+
+  ENTER();
+
+  found = FI_SearchMail(search, mail, NULL);
+
+  RETURN(found);
+  return found;
+}
+
+///
+/// FI_IsMatcherRule
+//  Checks whether a rule is a plain substring search which can be answered
+//  by the multi pattern matcher of a filter list
+static BOOL FI_IsMatcherRule(const struct Search *search)
+{
+  BOOL result = FALSE;
+
+  if(isFlagSet(search->flags, SEARCHF_SUBSTRING) && isFlagClear(search->flags, SEARCHF_DOS_PATTERN) &&
+     search->bmContext != NULL && search->Match[0] != '\0')
+  {
+    switch(search->Fast)
+    {
+      case FS_FROM:
+      case FS_TO:
+      case FS_CC:
+      case FS_REPLYTO:
+      {
+        // a non-matching search on several addresses is fulfilled as soon as
+        // a single address doesn't match, this can't be told from the found patterns
+        result = (search->Compare == CP_EQUAL);
+      }
+      break;
+
+      case FS_SUBJECT:
+      {
+        result = (search->Compare == CP_EQUAL || search->Compare == CP_NOTEQUAL);
+      }
+      break;
+
+      case FS_NONE:
+      {
+        // a search in all header fields is inverted as a whole, but a search in a
+        // specific header field is inverted for each single field
+        if(search->Mode == SM_HEADER)
+          result = (search->Compare == CP_EQUAL || search->Compare == CP_NOTEQUAL);
+        else if(search->Mode == SM_HEADLINE)
+          result = (search->Compare == CP_EQUAL);
+      }
+      break;
+
+      default:
+        // nothing
+      break;
+    }
+  }
+
+  return result;
+}
+
+///
+/// FI_GetMatchGroup
+//  Returns the group of a multi pattern matcher for the text a rule searches,
+//  a new group is created if there is none yet
+static struct FilterMatchGroup *FI_GetMatchGroup(struct FilterMatcher *matcher, const struct Search *search)
+{
+  struct FilterMatchGroup *group;
+  struct FilterMatchGroup *result = NULL;
+  int persMode = (search->Fast == FS_SUBJECT || search->Fast == FS_NONE) ? 0 : search->PersMode;
+  int fieldLen = (search->Fast == FS_NONE) ? FI_FieldLength(search->Field) : 0;
+
+  ENTER();
+
+  IterateList(&matcher->groupList, struct FilterMatchGroup *, group)
+  {
+    if(group->fast == search->Fast && group->persMode == persMode &&
+       group->fieldLen == fieldLen && strnicmp(group->field, search->Field, fieldLen) == 0)
+    {
+      result = group;
+      break;
+    }
+  }
+
+  if(result == NULL && (group = AllocSysObjectTags(ASOT_NODE,
+    ASONODE_Size, sizeof(*group),
+    ASONODE_Min, TRUE,
+    TAG_DONE)) != NULL)
+  {
+    group->fast = search->Fast;
+    group->persMode = persMode;
+    strlcpy(group->field, search->Field, sizeof(group->field));
+    group->fieldLen = fieldLen;
+
+    if((group->acc = AhoCorasickInit()) != NULL)
+    {
+      AddTail((struct List *)&matcher->groupList, (struct Node *)group);
+      setFlag(matcher->fields, (1 << group->fast));
+      result = group;
+    }
+    else
+      FreeSysObject(ASOT_NODE, group);
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// FI_DeleteFilterMatcher
+//  Frees a multi pattern matcher including all its groups
+static void FI_DeleteFilterMatcher(struct FilterMatcher *matcher)
+{
+  ENTER();
+
+  if(matcher != NULL)
+  {
+    struct FilterMatchGroup *group;
+    struct FilterMatchGroup *next;
+
+    SafeIterateList(&matcher->groupList, struct FilterMatchGroup *, group, next)
+    {
+      AhoCorasickCleanup(group->acc);
+      FreeSysObject(ASOT_NODE, group);
+    }
+
+    free(matcher->matches);
+    free(matcher);
+  }
+
+  LEAVE();
+}
+
+///
+/// FI_CreateFilterMatcher
+//  Compiles the patterns of all substring rules of a filter list which search
+//  the same text of a mail into a single Aho-Corasick automaton. Returns NULL
+//  if the filter list contains no such rules.
+static struct FilterMatcher *FI_CreateFilterMatcher(const struct MinList *filterList)
+{
+  struct FilterMatcher *matcher;
+
+  ENTER();
+
+  if((matcher = calloc(1, sizeof(*matcher))) != NULL)
+  {
+    struct FilterNode *filter;
+    struct FilterMatchGroup *group;
+    ULONG numGroups = 0;
+    BOOL success = TRUE;
+
+    NewMinList(&matcher->groupList);
+    // slot 0 marks rules which are not compiled
+    matcher->numSlots = 1;
+
+    IterateList(filterList, struct FilterNode *, filter)
+    {
+      struct RuleNode *rule;
+
+      IterateList(&filter->ruleList, struct RuleNode *, rule)
+      {
+        struct Search *search = rule->search;
+
+        if(search != NULL)
+        {
+          // rules which can't be compiled are searched one by one as before
+          search->matcherSlot = 0;
+
+          if(FI_IsMatcherRule(search) == TRUE &&
+             (group = FI_GetMatchGroup(matcher, search)) != NULL &&
+             AhoCorasickAddPattern(group->acc, search->Match, isFlagSet(search->flags, SEARCHF_CASE_SENSITIVE), matcher->numSlots) == TRUE)
+          {
+            search->matcherSlot = matcher->numSlots++;
+          }
+        }
+      }
+    }
+
+    IterateList(&matcher->groupList, struct FilterMatchGroup *, group)
+    {
+      if(AhoCorasickCompile(group->acc) == FALSE)
+      {
+        success = FALSE;
+        break;
+      }
+
+      numGroups++;
+    }
+
+    if(success == TRUE && matcher->numSlots > 1 && (matcher->matches = calloc(matcher->numSlots, sizeof(*matcher->matches))) != NULL)
+    {
+      D(DBF_FILTER, "compiled %ld substring rules into %ld groups", matcher->numSlots-1, numGroups);
+    }
+    else
+    {
+      FI_DeleteFilterMatcher(matcher);
+      matcher = NULL;
+    }
+  }
+
+  RETURN(matcher);
+  return matcher;
+}
+
+///
+/// FI_RunFilterMatcher
+//  Scans each text of a mail searched by the compiled rules once and
+//  remembers which of the rules did match
+static void FI_RunFilterMatcher(struct FilterMatcher *matcher, struct HeaderCache *cache, const struct Mail *mail)
+{
+  struct ExtendedMail *email = NULL;
+  struct FilterMatchGroup *group;
+  UBYTE *matches = matcher->matches;
+
+  ENTER();
+
+  memset(matches, FALSE, matcher->numSlots);
+
+  // the additional addresses are read only once for all groups
+  if((isMultiSenderMail(mail) && isFlagSet(matcher->fields, (1 << FS_FROM))) ||
+     (isMultiRCPTMail(mail) && isAnyFlagSet(matcher->fields, (1 << FS_TO)|(1 << FS_CC))) ||
+     (isMultiReplyToMail(mail) && isFlagSet(matcher->fields, (1 << FS_REPLYTO))))
+  {
+    email = MA_ExamineMail(mail->Folder, mail->MailFile, TRUE);
+  }
+
+  IterateList(&matcher->groupList, struct FilterMatchGroup *, group)
+  {
+    int i;
+
+    switch(group->fast)
+    {
+      case FS_FROM:
+      {
+        AhoCorasickSearch(group->acc, group->persMode ? mail->From.RealName : mail->From.Address, matches);
+
+        if(email != NULL && isMultiSenderMail(mail))
+        {
+          for(i=0; i < email->NumSFrom; i++)
+            AhoCorasickSearch(group->acc, group->persMode ? email->SFrom[i].RealName : email->SFrom[i].Address, matches);
+        }
+      }
+      break;
+
+      case FS_TO:
+      {
+        AhoCorasickSearch(group->acc, group->persMode ? mail->To.RealName : mail->To.Address, matches);
+
+        if(email != NULL && isMultiRCPTMail(mail))
+        {
+          for(i=0; i < email->NumSTo; i++)
+            AhoCorasickSearch(group->acc, group->persMode ? email->STo[i].RealName : email->STo[i].Address, matches);
+        }
+      }
+      break;
+
+      case FS_CC:
+      {
+        if(email != NULL && isMultiRCPTMail(mail))
+        {
+          for(i=0; i < email->NumCC; i++)
+            AhoCorasickSearch(group->acc, group->persMode ? email->CC[i].RealName : email->CC[i].Address, matches);
+        }
+      }
+      break;
+
+      case FS_REPLYTO:
+      {
+        AhoCorasickSearch(group->acc, group->persMode ? mail->ReplyTo.RealName : mail->ReplyTo.Address, matches);
+
+        if(email != NULL && isMultiReplyToMail(mail))
+        {
+          for(i=0; i < email->NumSReplyTo; i++)
+            AhoCorasickSearch(group->acc, group->persMode ? email->SReplyTo[i].RealName : email->SReplyTo[i].Address, matches);
+        }
+      }
+      break;
+
+      case FS_SUBJECT:
+      {
+        AhoCorasickSearch(group->acc, mail->Subject, matches);
+      }
+      break;
+
+      case FS_NONE:
+      {
+        if(group->fieldLen == 0)
+        {
+          // search all header fields
+          if(FI_ReadCachedHeader(cache) == TRUE)
+          {
+            for(i=0; i < (int)cache->numLines; i++)
+              AhoCorasickSearch(group->acc, FI_GetHeaderLine(cache, i)->content, matches);
+          }
+        }
+        else
+        {
+          struct HeaderField *field;
+
+          if((field = FI_FindHeaderField(cache, group->field)) != NULL)
+          {
+            for(i=0; i < (int)field->numLines; i++)
+              AhoCorasickSearch(group->acc, FI_GetHeaderLine(cache, field->lines[i])->content, matches);
+          }
+        }
+      }
+      break;
+
+      default:
+        // nothing
+      break;
+    }
+  }
+
+  if(email != NULL)
+    MA_FreeEMailStruct(email);
+
+  LEAVE();
+}
+
+///
+/// FI_MatchFilterRules
+//  Does a complex search with combined criterias based on the rules of a filter,
+//  the results of the compiled rules are taken from the matcher if there is one
+static BOOL FI_MatchFilterRules(const struct FilterNode *filter, const struct Mail *mail, const struct FilterMatcher *matcher, struct HeaderCache *cache)
 {
   ULONG numRules;
   ULONG matchedRules;
@@ -1044,7 +1734,20 @@ BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail)
 
     if(rule->search != NULL)
     {
-      if(FI_DoSearch(rule->search, mail) == TRUE)
+      BOOL found;
+
+      if(matcher != NULL && rule->search->matcherSlot != 0)
+      {
+        found = matcher->matches[rule->search->matcherSlot];
+
+        // invert the result in case a non-matching search was requested
+        if(rule->search->Compare == CP_NOTEQUAL)
+          found = !found;
+      }
+      else
+        found = FI_SearchMail(rule->search, mail, cache);
+
+      if(found == TRUE)
         matchedRules++;
     }
   }
@@ -1083,9 +1786,26 @@ BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail)
 }
 
 ///
-/// FI_FilterSingleMail
-//  applies the configured filters on a single mail
-BOOL FI_FilterSingleMail(const struct MinList *filterList, struct Mail *mail, int *matches, struct FilterResult *result)
+/// DoFilterSearch()
+//  Does a complex search with combined criterias based on the rules of a filter
+BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail)
+{
+  BOOL result;
+
+  ENTER();
+
+  result = FI_MatchFilterRules(filter, mail, NULL, NULL);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// FI_FilterMail
+//  applies the filters of a list on a single mail, all compiled rules
+//  are matched in one go first if a matcher is given. The matcher
+//  requires a header cache.
+static BOOL FI_FilterMail(const struct MinList *filterList, struct FilterMatcher *matcher, struct HeaderCache *cache, struct Mail *mail, int *matches, struct FilterResult *result)
 {
   BOOL success = TRUE;
   struct FilterNode *filter;
@@ -1093,9 +1813,15 @@ BOOL FI_FilterSingleMail(const struct MinList *filterList, struct Mail *mail, in
 
   ENTER();
 
+  if(cache != NULL)
+    FI_ResetHeaderCache(cache, mail);
+
+  if(matcher != NULL)
+    FI_RunFilterMatcher(matcher, cache, mail);
+
   IterateList(filterList, struct FilterNode *, filter)
   {
-    if(DoFilterSearch(filter, mail) == TRUE)
+    if(FI_MatchFilterRules(filter, mail, matcher, cache) == TRUE)
     {
       match++;
 
@@ -1116,6 +1842,21 @@ BOOL FI_FilterSingleMail(const struct MinList *filterList, struct Mail *mail, in
   return success;
 }
 
+///
+/// FI_FilterSingleMail
+//  applies the configured filters on a single mail
+BOOL FI_FilterSingleMail(const struct MinList *filterList, struct Mail *mail, int *matches, struct FilterResult *result)
+{
+  BOOL success;
+
+  ENTER();
+
+  success = FI_FilterMail(filterList, NULL, NULL, mail, matches, result);
+
+  RETURN(success);
+  return success;
+}
+
 ///
 /// FreeSearchData
 // Function to free the search data
@@ -1140,6 +1881,13 @@ void FreeSearchData(struct Search *search)
     search->bmContext = NULL;
   }
 
+  // free a possibly created full-text index query
+  if(search->textQuery != NULL)
+  {
+    TextIndexDeleteQuery(search->textQuery);
+    search->textQuery = NULL;
+  }
+
   LEAVE();
 }
 
@@ -1561,6 +2309,7 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
   struct MinList *filterList;
 
   ENTER();
+  STARTSPAN(DBF_FILTER, "filter mails");
 
   // clear the result statistics first
   memset(result, 0, sizeof(*result));
@@ -1568,11 +2317,18 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
   if((filterList = CloneFilterList(mode)) != NULL)
   {
     struct BusyNode *busy;
+    struct FilterMatcher *matcher = NULL;
+    struct HeaderCache *headerCache = NULL;
     struct Folder *spamfolder = FO_GetFolderByType(FT_SPAM, NULL);
     struct MailNode *mnode;
+    struct Mail **spamMails = NULL;
+    enum BayesClassification *spamResults = NULL;
+    ULONG numClassified = 0;
+    ULONG c;
     ULONG m;
     int matches = 0;
     BOOL noFilters = IsMinListEmpty(filterList);
+    BOOL aborted = FALSE;
     struct TimeVal lastStatsUpdate;
     struct FilterResult lastResult;
 
@@ -1595,6 +2351,60 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
     memset(&lastStatsUpdate, 0, sizeof(lastStatsUpdate));
     memset(&lastResult, 0, sizeof(lastResult));
 
+    // first classify all mails which need it in one batch, this is done
+    // by several threads in parallel
+    if(C->SpamFilterEnabled == TRUE && (mode == APPLY_AUTO || mode == APPLY_SPAM) && mlist->count > 0)
+    {
+      if((spamMails = calloc(mlist->count, sizeof(*spamMails))) != NULL &&
+         (spamResults = calloc(mlist->count, sizeof(*spamResults))) != NULL)
+      {
+        ULONG numSpamMails = 0;
+
+        ForEachMailNode(mlist, mnode)
+        {
+          struct Mail *mail = mnode->mail;
+
+          if(mail != NULL)
+          {
+            if(mode == APPLY_AUTO && C->SpamFilterForNewMail == TRUE && mail->Folder != NULL && isTrashFolder(mail->Folder) == FALSE)
+            {
+              // classify this mail if we are allowed to check new mails automatically
+              spamMails[numSpamMails++] = mail;
+            }
+            else if(mode == APPLY_SPAM && hasStatusSpam(mail) == FALSE && hasStatusHam(mail) == FALSE)
+            {
+              // classify mails if the user triggered this and the mail is not yet classified
+              spamMails[numSpamMails++] = mail;
+            }
+          }
+        }
+
+        D(DBF_FILTER, "classifying %ld of %ld messages", numSpamMails, mlist->count);
+
+        STARTSPAN(DBF_FILTER, "classify spam");
+        if(numSpamMails > 0 && BayesFilterClassifyMessages(spamMails, spamResults, numSpamMails, busy) == FALSE)
+        {
+          // the mails are handled up to the first one which was not
+          // classified anymore
+          aborted = TRUE;
+        }
+        STOPSPAN(DBF_FILTER);
+
+        numClassified = numSpamMails;
+      }
+      else
+        E(DBF_FILTER, "couldn't allocate the spam classification batch");
+    }
+
+    // compile the substring rules of all filters, this lets us scan each
+    // field of a mail only once for all of them. The header of each mail
+    // is read only once for all rules as well.
+    if(noFilters == FALSE && (headerCache = FI_CreateHeaderCache()) != NULL)
+      matcher = FI_CreateFilterMatcher(filterList);
+
+    // now apply the results of the classification and the filters,
+    // this must be done on the main thread
+    c = 0;
     m = 0;
     ForEachMailNode(mlist, mnode)
     {
@@ -1605,52 +2415,38 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
       {
         D(DBF_FILTER, "about to apply filters to message with subject '%s' in folder '%s'", mail->Subject, (mail->Folder != NULL) ? mail->Folder->Name : "<NULL>");
 
-        if(C->SpamFilterEnabled == TRUE && (mode == APPLY_AUTO || mode == APPLY_SPAM))
+        // the classified mails are in the same order as in the mail list
+        if(c < numClassified && spamMails[c] == mail)
         {
-          BOOL doClassification;
-
-          D(DBF_FILTER, "about to apply spam filter to message with subject '%s'", mail->Subject);
-
-          if(mode == APPLY_AUTO && C->SpamFilterForNewMail == TRUE && mail->Folder != NULL && isTrashFolder(mail->Folder) == FALSE)
-          {
-            // classify this mail if we are allowed to check new mails automatically
-            doClassification = TRUE;
-          }
-          else if(mode == APPLY_SPAM && hasStatusSpam(mail) == FALSE && hasStatusHam(mail) == FALSE)
+          // after an abort of the classification we stop at the first mail
+          // without a result, just like an abort during the filtering does
+          if(aborted == TRUE && spamResults[c] == BC_OTHER)
           {
-            // classify mails if the user triggered this and the mail is not yet classified
-            doClassification = TRUE;
-          }
-          else
-          {
-            // don't try to classify this mail
-            doClassification = FALSE;
+            D(DBF_FILTER, "classification was aborted before message with subject '%s'", mail->Subject);
+            break;
           }
 
-          if(doClassification == TRUE)
+          if(spamResults[c] == BC_SPAM)
           {
-            D(DBF_FILTER, "classifying message with subject '%s'", mail->Subject);
+            D(DBF_FILTER, "message with subject '%s' was classified as spam", mail->Subject);
 
-            if(BayesFilterClassifyMessage(mail) == TRUE)
-            {
-              D(DBF_FILTER, "message was classified as spam");
-
-              // set the SPAM flags, but clear the NEW and READ flags only if desired
-              if(C->SpamMarkAsRead == TRUE)
-                setStatusToReadAutoSpam(mail);
-              else
-                setStatusToAutoSpam(mail);
+            // set the SPAM flags, but clear the NEW and READ flags only if desired
+            if(C->SpamMarkAsRead == TRUE)
+              setStatusToReadAutoSpam(mail);
+            else
+              setStatusToAutoSpam(mail);
 
-              // move newly recognized spam to the spam folder
-              MA_MoveCopy(mail, spamfolder, "spam filter", MVCPF_QUIET);
-              wasSpam = TRUE;
+            // move newly recognized spam to the spam folder
+            MA_MoveCopy(mail, spamfolder, "spam filter", MVCPF_QUIET);
+            wasSpam = TRUE;
 
-              // update the stats
-              result->Spam++;
-              // we just checked the mail
-              result->Checked++;
-            }
+            // update the stats
+            result->Spam++;
+            // we just checked the mail
+            result->Checked++;
           }
+
+          c++;
         }
 
         if(noFilters == FALSE && wasSpam == FALSE)
@@ -1660,12 +2456,12 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
           result->Checked++;
 
           // now we process the search
-          FI_FilterSingleMail(filterList, mail, &matches, result);
+          FI_FilterMail(filterList, matcher, headerCache, mail, &matches, result);
         }
 
         // we update the busy gauge and
         // see if we have to exit/abort in case it returns FALSE
-        if(BusyProgress(busy, ++m, mlist->count) == FALSE)
+        if(aborted == FALSE && BusyProgress(busy, ++m, mlist->count) == FALSE)
           break;
 
         // check if some mails were deleted, moved or recognized as spam
@@ -1682,8 +2478,13 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
       }
     }
 
+    free(spamMails);
+    free(spamResults);
+
     UnlockMailList(mlist);
 
+    FI_DeleteFilterMatcher(matcher);
+    FI_DeleteHeaderCache(headerCache);
     DeleteFilterList(filterList);
 
     if(result->Checked != 0)
@@ -1705,6 +2506,7 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
       DisplayStatistics(NULL, TRUE);
   }
 
+  STOPSPAN(DBF_FILTER);
   LEAVE();
 }
 
@@ -1790,6 +2592,7 @@ static BOOL CopySearchData(struct Search *dstSearch, struct Search *srcSearch)
   memcpy(dstSearch, srcSearch, sizeof(*dstSearch));
 
   dstSearch->bmContext = NULL;
+  dstSearch->textQuery = NULL;
 
   // now we have to copy the patternList as well
   NewMinList(&dstSearch->patternList);
@@ -449,6 +449,7 @@ BOOL FO_LoadConfig(struct Folder *fo)
           else if(stricmp(buf, "JumpToRecent") == 0)   fo->JumpToRecent = Txt2Bool(value);
           else if(stricmp(buf, "ExpireUnread") == 0)   fo->ExpireUnread = Txt2Bool(value);
           else if(stricmp(buf, "MLSupport") == 0)      fo->MLSupport = Txt2Bool(value);
+          else if(stricmp(buf, "FullTextIndex") == 0)  fo->FullTextIndex = Txt2Bool(value);
           else if(stricmp(buf, "MLIdentityID") == 0)   fo->MLIdentity = FindUserIdentityByID(&C->userIdentityList, strtoul(value, NULL, 16));
           else if(stricmp(buf, "MLRepToAddr") == 0)    strlcpy(fo->MLReplyToAddress, value, sizeof(fo->MLReplyToAddress));
           else if(stricmp(buf, "MLAddress") == 0)      strlcpy(fo->MLAddress, value, sizeof(fo->MLAddress));
@@ -537,6 +538,7 @@ BOOL FO_SaveConfig(const struct Folder *fo)
     fprintf(fh, "JumpToRecent   = %s\n", Bool2Txt(fo->JumpToRecent));
     fprintf(fh, "ExpireUnread   = %s\n", Bool2Txt(fo->ExpireUnread));
     fprintf(fh, "MLSupport      = %s\n", Bool2Txt(fo->MLSupport));
+    fprintf(fh, "FullTextIndex  = %s\n", Bool2Txt(fo->FullTextIndex));
     fprintf(fh, "MLIdentityID   = %08x\n", fo->MLIdentity != NULL ? fo->MLIdentity->id : 0);
     fprintf(fh, "MLRepToAddr    = %s\n", fo->MLReplyToAddress);
     fprintf(fh, "MLPattern      = %s\n", fo->MLPattern);
@@ -1487,6 +1489,28 @@ BOOL FO_MoveFolderDir(struct Folder *fo, struct Folder *oldfo)
       success = FALSE;
     }
     else
+    {
+      // the .journal file belongs to the .index file
+      AddPath(srcbuf, oldfo->Fullpath, ".journal", sizeof(srcbuf));
+      AddPath(dstbuf, fo->Fullpath, ".journal", sizeof(dstbuf));
+      if(FileExists(srcbuf) == TRUE && MoveFile(srcbuf, dstbuf) == FALSE)
+      {
+        W(DBF_FOLDER, "failed to move file '%s' to '%s'", srcbuf, dstbuf);
+        success = FALSE;
+      }
+    }
+
+    if(success == TRUE)
+    {
+      // the full-text index is optional, it will be rebuilt if it
+      // cannot be moved
+      AddPath(srcbuf, oldfo->Fullpath, ".textindex", sizeof(srcbuf));
+      AddPath(dstbuf, fo->Fullpath, ".textindex", sizeof(dstbuf));
+      if(FileExists(srcbuf) == TRUE && MoveFile(srcbuf, dstbuf) == FALSE)
+        W(DBF_FOLDER, "failed to move file '%s' to '%s'", srcbuf, dstbuf);
+    }
+
+    if(success == TRUE)
     {
       // now we try to move the .fimage file aswell
       AddPath(srcbuf, oldfo->Fullpath, ".fimage", sizeof(srcbuf));
@@ -108,6 +108,7 @@
 
 /* local protos */
 static void MA_MoveCopySingle(struct Mail *mail, struct Folder *to, const char *originator, const ULONG flags);
+static BOOL UpdateMailFile(struct Mail *mail, const unsigned int oldSFlags);
 
 /***************************************************************************
  Module: Main
@@ -415,6 +416,7 @@ void MA_ChangeMailStatus(struct Mail *mail, int addflags, int clearflags)
     if(IsMainThread() == TRUE)
     {
       struct Folder *folder = mail->Folder;
+      unsigned int oldstatus = mail->sflags;
 
       // first substract the mail's old status from the folder's stats
       if(hasStatusNew(mail))
@@ -439,11 +441,9 @@ void MA_ChangeMailStatus(struct Mail *mail, int addflags, int clearflags)
       if(hasStatusSent(mail))
         folder->Sent++;
 
-      // set the comment to the Mailfile
-      MA_UpdateMailFile(mail);
-
-      // flag the index as expired
-      MA_ExpireIndex(mail->Folder);
+      // set the comment to the Mailfile, this also records the
+      // status change in the index journal
+      UpdateMailFile(mail, oldstatus);
 
       // update the status of the readmaildata (window)
       // of the mail here
@@ -463,14 +463,16 @@ void MA_ChangeMailStatus(struct Mail *mail, int addflags, int clearflags)
 }
 
 ///
-/// MA_UpdateMailFile
+/// UpdateMailFile
 // Updates the mail filename by taking the supplied mail structure
-// into account
-BOOL MA_UpdateMailFile(struct Mail *mail)
+// into account. The new name and the status are recorded in the index
+// journal, 'oldSFlags' are the status flags the journal knows so far.
+static BOOL UpdateMailFile(struct Mail *mail, const unsigned int oldSFlags)
 {
   char *dateFilePart = NULL;
   char statusFilePart[14 + 1];
   char oldFilePath[SIZE_PATHFILE];
+  char oldMailFile[SIZE_MFILE];
   char *ptr;
   BOOL success = FALSE;
   int mcounter;
@@ -487,7 +489,7 @@ BOOL MA_UpdateMailFile(struct Mail *mail)
     *ptr = '-';
 
   // get the counter from the current mailfile
-  mcounter = atoi(&mail->MailFile[13]);
+  mcounter = (strlen(mail->MailFile) > 13) ? atoi(&mail->MailFile[13]) : 0;
   if(mcounter < 1 || mcounter > 999)
     mcounter = 1;
 
@@ -509,6 +511,7 @@ BOOL MA_UpdateMailFile(struct Mail *mail)
 
   // construct the full old file path
   AddPath(oldFilePath, mail->Folder->Fullpath, mail->MailFile, sizeof(oldFilePath));
+  strlcpy(oldMailFile, mail->MailFile, sizeof(oldMailFile));
 
   while(success == FALSE)
   {
@@ -547,7 +550,7 @@ BOOL MA_UpdateMailFile(struct Mail *mail)
 
       D(DBF_MAIL, "renamed '%s' to '%s'", oldFilePath, newFilePath);
 
-      strlcpy(mail->MailFile, newFileName, sizeof(mail->MailFile));
+      SetMailFile(mail, newFileName);
       success = TRUE;
 
       // before we exit we check through all our read windows if
@@ -564,6 +567,27 @@ BOOL MA_UpdateMailFile(struct Mail *mail)
 
   free(dateFilePart);
 
+  // the index refers to the mail by its previous name until the
+  // journal tells about the new one
+  if(strcmp(oldMailFile, mail->MailFile) != 0 || oldSFlags != mail->sflags)
+    MA_JournalMailStatus(mail, oldSFlags, oldMailFile);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// MA_UpdateMailFile
+// Updates the mail filename by taking the supplied mail structure
+// into account
+BOOL MA_UpdateMailFile(struct Mail *mail)
+{
+  BOOL success;
+
+  ENTER();
+
+  success = UpdateMailFile(mail, mail->sflags);
+
   RETURN(success);
   return success;
 }
@@ -808,7 +832,7 @@ static void MA_MoveCopySingle(struct Mail *mail, struct Folder *to, const char *
         AddMailToFolder(newMail, to);
 
         // restore the old filename in case it was changed by TransferMailFile()
-        strlcpy(mail->MailFile, mfile, sizeof(mail->MailFile));
+        SetMailFile(mail, mfile);
       }
     }
     else
@@ -1142,34 +1166,22 @@ unsigned int MA_FromXStatusHeader(char *xstatusflags)
 struct Mail *FindThreadInFolder(const struct Mail *srcMail, const struct Folder *folder, const BOOL nextThread)
 {
   struct Mail *result = NULL;
-  struct MailNode *mnode;
 
   ENTER();
 
   LockMailListShared(folder->messages);
 
-  ForEachMailNode(folder->messages, mnode)
+  // look up the folder's message ID indexes instead of comparing each mail,
+  // zero IDs are never indexed and hence can never match
+  if(nextThread == TRUE)
   {
-    struct Mail *mail = mnode->mail;
-
-    if(nextThread == TRUE)
-    {
-      // find the answer to the srcMail
-      if(mail->cIRTMsgID != 0 && mail->cIRTMsgID == srcMail->cMsgID)
-      {
-        result = mail;
-        break;
-      }
-    }
-    else
-    {
-      // else we have to find the question to the srcMail
-      if(mail->cMsgID != 0 && mail->cMsgID == srcMail->cIRTMsgID)
-      {
-        result = mail;
-        break;
-      }
-    }
+    // find the answer to the srcMail
+    result = GetMailByCompressedIRTMsgID(folder, srcMail->cMsgID, 0);
+  }
+  else
+  {
+    // else we have to find the question to the srcMail
+    result = GetMailByCompressedMsgID(folder, srcMail->cIRTMsgID, 0);
   }
 
   UnlockMailList(folder->messages);
@@ -1431,6 +1443,9 @@ void MA_RemoveAttach(struct Mail *mail, struct Part **whichParts, BOOL warning)
 
                 if(keepThisPart == TRUE)
                 {
+                  // parts kept in memory must exist as a file for the following steps
+                  RE_FlushPart(part);
+
                   // write out this part to the new mail file
 
                   D(DBF_MAIL, "keeping part '%s' '%s'", part->CParName, part->Filename);
@@ -1821,8 +1836,7 @@ struct WriteMailData *NewMessage(enum NewMailMode mode, const int flags)
 
         // in case there is only one mail selected we have to check wheter there is
         // text currently selected by the user
-        if(C->EmbeddedReadPane == TRUE &&
-           NextMailNode(FirstMailNode(mlist)) == NULL)
+        if(C->EmbeddedReadPane == TRUE && mlist->count == 1)
         {
           replytext = (char *)DoMethod(G->MA->GUI.MN_EMBEDDEDREADPANE, MUIM_ReadMailGroup_ExportSelectedText);
         }
@@ -2249,7 +2263,7 @@ void MA_GetAddress(struct MailList *mlist, struct MUI_NListtree_TreeNode *dropTa
   BOOL isSentFolder = (folder != NULL) ? isSentMailFolder(folder) : FALSE;
   BOOL isMLFolder = (folder != NULL) ? folder->MLSupport : FALSE;
   struct ExtendedMail *email;
-  struct Person *pe = NULL;
+  const struct MailPerson *pe = NULL;
   struct ABookNode abn;
 
   ENTER();
@@ -2613,7 +2627,7 @@ BOOL MA_Send(enum SendMailMode mode, ULONG flags)
         struct MailNode *succ;
         ULONG i;
 
-        SafeIterateList(mlist, struct MailNode *, mnode, succ)
+        SafeForEachMailNode(mlist, mnode, succ)
         {
           struct Mail *mail = mnode->mail;
           struct ExtendedMail *email;
@@ -3181,6 +3195,8 @@ void MA_ChangeSubject(struct Mail *mail, char *subj)
       {
         FILE *oldfh;
         LONG size;
+        unsigned int oldstatus = mail->sflags;
+        long oldsize = mail->Size;
 
         setvbuf(newfh, NULL, _IOFBF, SIZE_FILEBUF);
 
@@ -3233,8 +3249,8 @@ void MA_ChangeSubject(struct Mail *mail, char *subj)
           mail->Size = -1;
 
         AppendToLogfile(LF_ALL, 82, tr(MSG_LOG_ChangingSubject), mail->Subject, mail->MailFile, fo->Name, subj);
-        strlcpy(mail->Subject, subj, sizeof(mail->Subject));
-        MA_ExpireIndex(fo);
+        SetMailSubject(mail, subj);
+        MA_JournalUpdateMail(mail, oldstatus, oldsize);
 
         if(fo->Mode > FM_SIMPLE)
           DoPack(newfile, oldfile, fo);
@@ -3319,11 +3335,11 @@ MakeHook(MA_ChangeSubjectHook, MA_ChangeSubjectFunc);
 ///
 /// MA_GetRealSubject
 //  Strips reply prefix / mailing list name from subject
-char *MA_GetRealSubject(char *sub)
+const char *MA_GetRealSubject(const char *sub)
 {
-  char *p;
+  const char *p;
   int sublen;
-  char *result = sub;
+  const char *result = sub;
 
   ENTER();
 
@@ -3333,7 +3349,7 @@ char *MA_GetRealSubject(char *sub)
   {
     if(sub[2] == ':' && !sub[3])
     {
-      result = (char *)"";
+      result = "";
     }
     // check if the subject contains some strings embedded in brackets like [test]
     // and return only the real subject after the last bracket.
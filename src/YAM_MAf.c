@@ -74,10 +74,12 @@
 #include "FolderList.h"
 #include "Locale.h"
 #include "MailList.h"
+#include "MethodStack.h"
 #include "MUIObjects.h"
 #include "Requesters.h"
 #include "Rexx.h"
 #include "Signature.h"
+#include "Threads.h"
 #include "UserIdentity.h"
 
 #include "Debug.h"
@@ -151,15 +153,93 @@ struct FIndex
   int   New;          // number of new mails in folder
   int   Unread;       // number of unread mails in folder
   int   Size;         // size of folder (bytes)
-  long  reserved[2];  // reserved unused area
+  ULONG Count;        // number of mail rows in the columns (FINDEX_VER only)
+  ULONG HeapSize;     // size of the UTF8 string heap (FINDEX_VER only)
 };
 
-// whenever you change something up there (in FIndex or ComprMail) you
-// need to increase this version ID!
-#define FINDEX_VER  (MAKE_ID('Y','I','N','8'))
+/*
+** layout of a FINDEX_VER index file
+**
+** Instead of one ComprMail structure per mail the index stores each field
+** of all mails in a separate column of fixed size elements, followed by a
+** heap with all strings. This allows us to read the whole file in one go
+** and to convert all strings to the local charset with a single call.
+**
+**   struct FIndex    header
+**   struct DateStamp date[Count]
+**   struct TimeVal   transDate[Count]
+**   ULONG            sflags[Count]
+**   ULONG            mflags[Count]
+**   ULONG            cMsgID[Count]
+**   ULONG            cIRTMsgID[Count]
+**   LONG             size[Count]
+**   ULONG            heapOffset[Count]   // offset of the mail's first string
+**   char             mailFile[Count][SIZE_MFILE]
+**   char             heap[HeapSize]      // COMPRMAIL_MORELINES '\n' terminated
+**                                        // UTF8 strings per mail
+**
+** The 4 byte columns come first to keep them properly aligned.
+*/
+#define FINDEX_ROWSIZE  (sizeof(struct DateStamp) + sizeof(struct TimeVal) + 6*sizeof(ULONG) + SIZE_MFILE)
+
+// whenever you change something up there (in FIndex, ComprMail or the
+// column layout) you need to increase this version ID!
+#define FINDEX_VER            (MAKE_ID('Y','I','N','9'))
+// the previous row based format using struct ComprMail which we still
+// are able to load
+#define FINDEX_VER_COMPRMAIL  (MAKE_ID('Y','I','N','8'))
+
+/*
+** structure of a record in the index journal
+**
+** Instead of rewriting the complete .index file each time a single mail
+** is added, removed or changes its status, these changes are appended to
+** the .journal file next to it. Loading an index replays the journal on top
+** of the .index snapshot and saving an index (compacting) deletes it again.
+**
+** DO NOT CHANGE ALIGNMENT here or the .journal
+** files of a folder will be corrupt !
+**
+*/
+struct JournalRecord
+{
+  ULONG            type;                 // enum JournalRecordType
+  struct DateStamp date;                 // the creation date of the mail (UTC)
+  struct TimeVal   transDate;            // the received/sent date with ms (UTC)
+  ULONG            sflags;               // mail status flags
+  ULONG            mflags;               // general mail flags
+  ULONG            cMsgID;               // compressed MessageID
+  ULONG            cIRTMsgID;            // compressed InReturnTo MessageID
+  LONG             size;                 // the total size of the message
+  ULONG            oldSFlags;            // status flags of the removed/replaced mail
+  LONG             oldSize;              // size of the removed/replaced mail
+  ULONG            moreBytes;            // number of UTF8 string bytes following
+                                         // this record (JRT_ADD and JRT_UPDATE) or
+                                         // length of the previous filename (JRT_STATUS)
+  char             mailFile[SIZE_MFILE]; // mail filename without path
+};
+
+#define JOURNAL_VER  (MAKE_ID('Y','J','N','1'))
 
 #include "default-align.h"
 
+// the different types of journal records
+enum JournalRecordType
+{
+  JRT_ADD=1,  // a new mail was added
+  JRT_REMOVE, // a mail was removed
+  JRT_UPDATE, // all data of a mail was replaced
+  JRT_STATUS  // the status flags and/or the filename of a mail changed
+};
+
+// the size a journal may grow to before it is merged into the .index again
+#define JOURNAL_MAXSIZE  (128*1024)
+
+// number of mail files a scanning thread examines at once
+#define SCAN_CHUNK_SIZE  32
+// maximum number of threads examining the mail files of a folder
+#define SCAN_MAX_THREADS 4
+
 /* local protos */
 static BOOL MA_ScanMailBox(struct Folder *folder);
 
@@ -266,6 +346,624 @@ static void MA_ValidateStatus(struct Folder *folder)
   LEAVE();
 }
 
+///
+/// CopyIndexLine
+//  Copies one '\n' terminated line of an index string heap to the given
+//  buffer and returns a pointer to the following line
+static const char *CopyIndexLine(const char *line, const char *end, char *dst, const size_t dstSize)
+{
+  const char *eol;
+  size_t len;
+
+  if((eol = memchr(line, '\n', end-line)) == NULL)
+    eol = end;
+
+  len = eol-line;
+  if(len > dstSize-1)
+    len = dstSize-1;
+
+  memcpy(dst, line, len);
+  dst[len] = '\0';
+
+  return (eol < end) ? eol+1 : end;
+}
+
+///
+/// ReadIndexStrings
+//  Sets the strings of a mail from the '\n' separated lines of an index
+//  string heap and returns a pointer to the line following them
+static const char *ReadIndexStrings(struct Mail *mail, const char *line, const char *end)
+{
+  char subject[SIZE_SUBJECT];
+  char fromAddress[SIZE_ADDRESS];
+  char fromRealName[SIZE_REALNAME];
+  char toAddress[SIZE_ADDRESS];
+  char toRealName[SIZE_REALNAME];
+  char replyToAddress[SIZE_ADDRESS];
+  char replyToRealName[SIZE_REALNAME];
+  char mailAccount[SIZE_DEFAULT];
+
+  line = CopyIndexLine(line, end, subject, sizeof(subject));
+  line = CopyIndexLine(line, end, fromAddress, sizeof(fromAddress));
+  line = CopyIndexLine(line, end, fromRealName, sizeof(fromRealName));
+  line = CopyIndexLine(line, end, toAddress, sizeof(toAddress));
+  line = CopyIndexLine(line, end, toRealName, sizeof(toRealName));
+  line = CopyIndexLine(line, end, replyToAddress, sizeof(replyToAddress));
+  line = CopyIndexLine(line, end, replyToRealName, sizeof(replyToRealName));
+  line = CopyIndexLine(line, end, mailAccount, sizeof(mailAccount));
+
+  SetMailSubject(mail, subject);
+  SetMailPerson(&mail->From, fromAddress, fromRealName);
+  SetMailPerson(&mail->To, toAddress, toRealName);
+  SetMailPerson(&mail->ReplyTo, replyToAddress, replyToRealName);
+  SetMailAccount(mail, mailAccount);
+
+  return line;
+}
+
+///
+/// LoadIndexColumns
+//  Loads the mails of a columnar (FINDEX_VER) index file. The whole file
+//  is read with a single call and the strings of all mails are converted
+//  to the local charset at once.
+static BOOL LoadIndexColumns(struct Folder *folder, struct Folder *tempFolder, FILE *fh, const struct FIndex *fi, const ULONG dataSize, BOOL *corrupt)
+{
+  BOOL error = FALSE;
+  const ULONG count = fi->Count;
+
+  ENTER();
+
+  if(count > dataSize / FINDEX_ROWSIZE || dataSize != count * FINDEX_ROWSIZE + fi->HeapSize)
+  {
+    E(DBF_FOLDER, "column data size mismatch, %ld rows and %ld heap bytes don't fit into %ld bytes", count, fi->HeapSize, dataSize);
+    *corrupt = TRUE;
+  }
+  else if(count > 0)
+  {
+    char *data;
+
+    // one extra byte to be able to NUL terminate the string heap
+    if((data = malloc(dataSize+1)) != NULL)
+    {
+      if(fread(data, dataSize, 1, fh) == 1)
+      {
+        struct DateStamp *dateCol = (struct DateStamp *)data;
+        struct TimeVal *transDateCol = (struct TimeVal *)&dateCol[count];
+        ULONG *sflagsCol = (ULONG *)&transDateCol[count];
+        ULONG *mflagsCol = &sflagsCol[count];
+        ULONG *msgIDCol = &mflagsCol[count];
+        ULONG *irtMsgIDCol = &msgIDCol[count];
+        LONG *sizeCol = (LONG *)&irtMsgIDCol[count];
+        ULONG *heapOffsetCol = (ULONG *)&sizeCol[count];
+        char *mailFileCol = (char *)&heapOffsetCol[count];
+        char *utf8Heap = &mailFileCol[count * SIZE_MFILE];
+        char *heap;
+        ULONG heapSize = fi->HeapSize;
+        BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+
+        utf8Heap[heapSize] = '\0';
+
+        if(systemIsUTF8 == TRUE)
+        {
+          // no conversion required
+          heap = utf8Heap;
+        }
+        else
+        {
+          // convert the complete heap to the local charset in one go, the
+          // strings of the mails are walked sequentially afterwards
+          if((heap = CodesetsUTF8ToStr(CSA_Source,          utf8Heap,
+                                       CSA_SourceLen,       heapSize,
+                                       CSA_DestCodeset,     G->systemCodeset,
+                                       CSA_MapForeignChars, C->MapForeignChars,
+                                       CSA_DestLenPtr,      &heapSize,
+                                       TAG_DONE)) == NULL)
+          {
+            E(DBF_FOLDER, "error while converting UTF8 data to local charset");
+            error = TRUE;
+          }
+        }
+
+        if(heap != NULL)
+        {
+          const char *heapEnd = &heap[heapSize];
+          const char *line = heap;
+          ULONG i;
+
+          for(i=0; i < count; i++)
+          {
+            struct Mail *mail;
+
+            if(systemIsUTF8 == TRUE)
+            {
+              // the unconverted heap allows random access to each row
+              if(heapOffsetCol[i] > heapSize)
+              {
+                E(DBF_FOLDER, "invalid heap offset %ld of row %ld", heapOffsetCol[i], i);
+                *corrupt = TRUE;
+                break;
+              }
+
+              line = &heap[heapOffsetCol[i]];
+            }
+
+            if((mail = AllocMailFromPool(tempFolder->messages->pool)) == NULL)
+            {
+              error = TRUE;
+              break;
+            }
+
+            line = ReadIndexStrings(mail, line, heapEnd);
+
+            mail->mflags = mflagsCol[i];
+            mail->sflags = sflagsCol[i];
+            // we have to make sure that the volatile flag field isn't loaded
+            setVOLValue(mail, 0);
+            SetMailFile(mail, &mailFileCol[i * SIZE_MFILE]);
+            mail->Date = dateCol[i];
+            mail->transDate = transDateCol[i];
+            mail->cMsgID = msgIDCol[i];
+            mail->cIRTMsgID = irtMsgIDCol[i];
+            mail->Size = sizeCol[i];
+
+            // add the new mail structure to the temporary folder, see
+            // LoadIndexComprMails() for the details
+            AddMailToFolderSimple(mail, tempFolder);
+            mail->Folder = folder;
+          }
+
+          if(systemIsUTF8 == FALSE)
+          {
+            // free the codesets buffer
+            CodesetsFreeA(heap, NULL);
+          }
+        }
+      }
+      else
+      {
+        E(DBF_FOLDER, "fread error while reading index columns");
+        error = TRUE;
+      }
+
+      free(data);
+    }
+    else
+      error = TRUE;
+  }
+
+  RETURN(error);
+  return error;
+}
+
+///
+/// LoadIndexComprMails
+//  Loads the mails of an old row based (FINDEX_VER_COMPRMAIL) index file
+static BOOL LoadIndexComprMails(struct Folder *folder, struct Folder *tempFolder, FILE *fh, const char *indexFileName, BOOL *corrupt)
+{
+  BOOL error = FALSE;
+  BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+
+  ENTER();
+
+  do
+  {
+    struct Mail *mail;
+    struct ComprMail cmail;
+    char utf8buf[SIZE_LARGE];
+    char *buf;
+
+    if(fread(&cmail, sizeof(struct ComprMail), 1, fh) != 1)
+    {
+      // check if we are here because of an error or EOF
+      if(ferror(fh) != 0 || feof(fh) == 0)
+      {
+        E(DBF_FOLDER, "error while loading ComprMail struct from .index file");
+        error = TRUE;
+      }
+
+      // if we end up here it is just a EOF and no error.
+      break;
+    }
+
+    if(cmail.moreBytes > sizeof(utf8buf)-1)
+    {
+      ER_NewError(tr(MSG_ER_INDEX_CORRUPTED), indexFileName, folder->Name, ftell(fh), cmail.mailFile, cmail.moreBytes);
+      *corrupt = TRUE;
+      break;
+    }
+
+    // read the moreBytes data
+    if(fread(utf8buf, cmail.moreBytes, 1, fh) != 1)
+    {
+      E(DBF_FOLDER, "fread error while reading index file");
+      error = TRUE;
+      break;
+    }
+
+    // make sure to NUL terminate the utf8 string
+    utf8buf[cmail.moreBytes] = '\0';
+
+    if(systemIsUTF8 == TRUE)
+    {
+      // no conversion required
+      buf = utf8buf;
+    }
+    else
+    {
+      // convert the utf8 encoded buffer to the local charset
+      if((buf = CodesetsUTF8ToStr(CSA_Source,          utf8buf,
+                                  CSA_SourceLen,       cmail.moreBytes,
+                                  CSA_DestCodeset,     G->systemCodeset,
+                                  CSA_MapForeignChars, C->MapForeignChars,
+                                  TAG_DONE)) == NULL)
+      {
+        E(DBF_FOLDER, "error while converting UTF8 data to local charset");
+        error = TRUE;
+        break;
+      }
+    }
+
+    // create a new mail structure
+    if((mail = AllocMailFromPool(tempFolder->messages->pool)) != NULL)
+    {
+      ReadIndexStrings(mail, buf, &buf[strlen(buf)]);
+
+      mail->mflags = cmail.mflags;
+      mail->sflags = cmail.sflags;
+      // we have to make sure that the volatile flag field isn't loaded
+      setVOLValue(mail, 0);
+      SetMailFile(mail, cmail.mailFile);
+      mail->Date = cmail.date;
+      mail->transDate = cmail.transDate;
+      mail->cMsgID = cmail.cMsgID;
+      mail->cIRTMsgID = cmail.cIRTMsgID;
+      mail->Size = cmail.size;
+
+      // finally add the new mail structure to the temporary folder
+      // no message list locking or index expiring is necessary here,
+      // because it is a temporary folder which is not publically known
+      AddMailToFolderSimple(mail, tempFolder);
+
+      // the AddMailToFolderSimple() call set the mail's folder pointer to the
+      // temporary folder. But since this is a temporary one only and will be
+      // invalid after leaving this function we must set the mail's folder
+      // pointer to the correct current folder.
+      mail->Folder = folder;
+    }
+    else
+      error = TRUE;
+
+    if(systemIsUTF8 == FALSE)
+    {
+      // free the codesets buffer
+      CodesetsFreeA(buf, NULL);
+    }
+  }
+  while(error == FALSE);
+
+  RETURN(error);
+  return error;
+}
+
+///
+/// DeleteIndexJournal
+//  Deletes the index journal of a folder
+static void DeleteIndexJournal(struct Folder *folder)
+{
+  char journalFileName[SIZE_PATHFILE];
+
+  ENTER();
+
+  ObtainSemaphore(G->journalSemaphore);
+
+  AddPath(journalFileName, folder->Fullpath, ".journal", sizeof(journalFileName));
+  DeleteFile(journalFileName);
+  folder->journalSize = 0;
+
+  ReleaseSemaphore(G->journalSemaphore);
+
+  LEAVE();
+}
+
+///
+/// ChangeMailStats
+//  Adds (count=1) or subtracts (count=-1) the status and size of a mail
+//  to/from the statistics of a folder, the total number is not touched
+static void ChangeMailStats(struct Folder *folder, const struct Mail *mail, const int count)
+{
+  folder->Size += count * mail->Size;
+
+  if(hasStatusNew(mail))
+    folder->New += count;
+
+  if(!hasStatusRead(mail))
+    folder->Unread += count;
+
+  if(hasStatusSent(mail))
+    folder->Sent += count;
+}
+
+///
+/// ApplyJournalStats
+//  Applies a journal record to the statistics of a folder of which only
+//  the index header has been loaded
+static void ApplyJournalStats(struct Folder *folder, const struct JournalRecord *rec)
+{
+  // remove the previous state of the mail first
+  if(rec->type != JRT_ADD)
+  {
+    if(rec->type == JRT_REMOVE)
+      folder->Total--;
+
+    folder->Size -= rec->oldSize;
+
+    if(isFlagSet(rec->oldSFlags, SFLAG_NEW))
+      folder->New--;
+
+    if(isFlagClear(rec->oldSFlags, SFLAG_READ))
+      folder->Unread--;
+  }
+
+  // then add the new state
+  if(rec->type != JRT_REMOVE)
+  {
+    if(rec->type == JRT_ADD)
+      folder->Total++;
+
+    folder->Size += rec->size;
+
+    if(isFlagSet(rec->sflags, SFLAG_NEW))
+      folder->New++;
+
+    if(isFlagClear(rec->sflags, SFLAG_READ))
+      folder->Unread++;
+  }
+}
+
+///
+/// ApplyJournalRecord
+//  Applies a journal record to the mails loaded from the index snapshot
+static BOOL ApplyJournalRecord(struct Folder *folder, struct Folder *tempFolder, const struct JournalRecord *rec, const char *strings, const size_t stringsLen)
+{
+  BOOL success = TRUE;
+  const char *mailFile = rec->mailFile;
+  struct MailNode *mnode;
+  struct Mail *mail = NULL;
+
+  ENTER();
+
+  // a renamed mail is still known by its previous name
+  if(rec->type == JRT_STATUS && stringsLen > 0)
+    mailFile = strings;
+
+  if((mnode = FindMailByFilename(tempFolder->messages, mailFile)) != NULL)
+  {
+    mail = mnode->mail;
+
+    // take the old state of the mail out of the stats and the
+    // message ID indexes
+    ChangeMailStats(tempFolder, mail, -1);
+    UnindexFolderMail(tempFolder, mail);
+  }
+
+  switch(rec->type)
+  {
+    case JRT_ADD:
+    case JRT_UPDATE:
+    {
+      BOOL isNewMail = FALSE;
+
+      if(mail == NULL)
+      {
+        mail = AllocMailFromPool(tempFolder->messages->pool);
+        isNewMail = TRUE;
+      }
+
+      if(mail != NULL)
+      {
+        const char *line = strings;
+        const char *end = &strings[stringsLen];
+
+        ReadIndexStrings(mail, line, end);
+
+        mail->mflags = rec->mflags;
+        mail->sflags = rec->sflags;
+        setVOLValue(mail, 0);
+        SetMailFile(mail, rec->mailFile);
+        mail->Date = rec->date;
+        mail->transDate = rec->transDate;
+        mail->cMsgID = rec->cMsgID;
+        mail->cIRTMsgID = rec->cIRTMsgID;
+        mail->Size = rec->size;
+
+        if(isNewMail == TRUE)
+        {
+          // this accounts the stats of the new mail
+          AddMailToFolderSimple(mail, tempFolder);
+          mail->Folder = folder;
+        }
+        else
+        {
+          ChangeMailStats(tempFolder, mail, 1);
+          IndexFolderMail(tempFolder, mail);
+        }
+      }
+      else
+        success = FALSE;
+    }
+    break;
+
+    case JRT_REMOVE:
+    {
+      if(mnode != NULL)
+      {
+        tempFolder->Total--;
+        RemoveMailNode(tempFolder->messages, mnode);
+        DeleteMailNode(mnode);
+      }
+    }
+    break;
+
+    case JRT_STATUS:
+    {
+      if(mail != NULL)
+      {
+        mail->mflags = rec->mflags;
+        mail->sflags = rec->sflags;
+        setVOLValue(mail, 0);
+        // the status and the transfer date are part of the filename
+        mail->transDate = rec->transDate;
+        SetMailFile(mail, rec->mailFile);
+
+        ChangeMailStats(tempFolder, mail, 1);
+        IndexFolderMail(tempFolder, mail);
+      }
+    }
+    break;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// ReplayIndexJournal
+//  Replays the journal of a folder on top of the loaded index snapshot.
+//  If tempFolder is NULL only the statistics of the folder are updated.
+//  Returns FALSE in case of an error, a truncated journal (i.e. due to a
+//  crash during writing) is reported via 'damaged'.
+static BOOL ReplayIndexJournal(struct Folder *folder, struct Folder *tempFolder, BOOL *damaged)
+{
+  BOOL success = TRUE;
+  char journalFileName[SIZE_PATHFILE];
+  ULONG journalFileSize;
+
+  ENTER();
+
+  folder->journalSize = 0;
+
+  AddPath(journalFileName, folder->Fullpath, ".journal", sizeof(journalFileName));
+
+  if(ObtainFileInfo(journalFileName, FI_SIZE, &journalFileSize) == TRUE && journalFileSize > 0)
+  {
+    FILE *fh;
+
+    if((fh = fopen(journalFileName, "r")) != NULL)
+    {
+      ULONG id;
+
+      setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+      if(fread(&id, sizeof(id), 1, fh) == 1 && id == JOURNAL_VER)
+      {
+        BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+        ULONG validSize = sizeof(id);
+        ULONG records = 0;
+        char *utf8buf = NULL;
+        ULONG utf8bufSize = 0;
+
+        do
+        {
+          struct JournalRecord rec;
+          char *buf;
+          ULONG bufLen;
+
+          // a short read at the end means that the last record was not
+          // written completely, this is checked below
+          if(fread(&rec, sizeof(rec), 1, fh) != 1)
+            break;
+
+          if(rec.type < JRT_ADD || rec.type > JRT_STATUS || rec.moreBytes > journalFileSize)
+          {
+            E(DBF_FOLDER, "invalid journal record type %ld/length %ld", rec.type, rec.moreBytes);
+            break;
+          }
+
+          // the strings of a record are not limited in length
+          if(rec.moreBytes >= utf8bufSize)
+          {
+            char *newBuf;
+
+            if((newBuf = realloc(utf8buf, rec.moreBytes+1)) == NULL)
+            {
+              success = FALSE;
+              break;
+            }
+
+            utf8buf = newBuf;
+            utf8bufSize = rec.moreBytes+1;
+          }
+
+          if(rec.moreBytes > 0 && fread(utf8buf, rec.moreBytes, 1, fh) != 1)
+            break;
+
+          validSize += sizeof(rec) + rec.moreBytes;
+          records++;
+
+          if(tempFolder == NULL)
+          {
+            ApplyJournalStats(folder, &rec);
+            continue;
+          }
+
+          utf8buf[rec.moreBytes] = '\0';
+          bufLen = rec.moreBytes;
+
+          if(systemIsUTF8 == TRUE || rec.moreBytes == 0 || rec.type == JRT_STATUS)
+          {
+            // no conversion required, filenames are plain ASCII
+            buf = utf8buf;
+          }
+          else if((buf = CodesetsUTF8ToStr(CSA_Source,          utf8buf,
+                                           CSA_SourceLen,       rec.moreBytes,
+                                           CSA_DestCodeset,     G->systemCodeset,
+                                           CSA_MapForeignChars, C->MapForeignChars,
+                                           CSA_DestLenPtr,      &bufLen,
+                                           TAG_DONE)) == NULL)
+          {
+            E(DBF_FOLDER, "error while converting UTF8 data to local charset");
+            success = FALSE;
+            break;
+          }
+
+          success = ApplyJournalRecord(folder, tempFolder, &rec, buf, bufLen);
+
+          if(buf != utf8buf)
+            CodesetsFreeA(buf, NULL);
+        }
+        while(success == TRUE);
+
+        free(utf8buf);
+
+        D(DBF_FOLDER, "replayed %ld journal records of folder '%s'", records, folder->Name);
+
+        if(validSize != journalFileSize)
+        {
+          W(DBF_FOLDER, "journal '%s' is truncated, %ld of %ld bytes are valid", journalFileName, validSize, journalFileSize);
+          *damaged = TRUE;
+        }
+      }
+      else
+      {
+        W(DBF_FOLDER, "journal '%s' has an invalid header", journalFileName);
+        *damaged = TRUE;
+      }
+
+      fclose(fh);
+
+      folder->journalSize = journalFileSize;
+    }
+    else
+    {
+      E(DBF_FOLDER, "fopen() on '%s' failed.", journalFileName);
+      success = FALSE;
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
 ///
 /// MA_LoadIndex
 //  Loads a folder index from disk
@@ -276,8 +974,10 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
   enum LoadedMode indexloaded = LM_UNLOAD;
   BOOL corrupt = FALSE;
   BOOL error = FALSE;
+  BOOL journalDamaged = FALSE;
 
   ENTER();
+  STARTSPAN(DBF_FOLDER, "load index");
 
   D(DBF_FOLDER, "Loading index for folder '%s'", folder->Name);
 
@@ -303,7 +1003,7 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
         E(DBF_FOLDER, "error while loading struct FIndex from .index file");
         error = TRUE;
       }
-      else if(fi.ID == FINDEX_VER)
+      else if(fi.ID == FINDEX_VER || fi.ID == FINDEX_VER_COMPRMAIL)
       {
         folder->Total  = fi.Total;
         folder->New    = fi.New;
@@ -321,161 +1021,34 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
           // mail list for each single mail we get from the index
           if((tempFolder = AllocFolder()) != NULL)
           {
-            BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
-
-            do
-            {
-              struct Mail *mail;
-              struct ComprMail cmail;
-              char utf8buf[SIZE_LARGE];
-              char *buf;
-              char *line;
-              char *nextLine;
-              int lineNr;
-
-              if(fread(&cmail, sizeof(struct ComprMail), 1, fh) != 1)
-              {
-                // check if we are here because of an error or EOF
-                if(ferror(fh) != 0 || feof(fh) == 0)
-                {
-                  E(DBF_FOLDER, "error while loading ComprMail struct from .index file");
-                  error = TRUE;
-                }
-
-                // if we end up here it is just a EOF and no error.
-                break;
-              }
-
-              if(cmail.moreBytes > sizeof(utf8buf)-1)
-              {
-                ER_NewError(tr(MSG_ER_INDEX_CORRUPTED), indexFileName, folder->Name, ftell(fh), cmail.mailFile, cmail.moreBytes);
-                corrupt = TRUE;
-                break;
-              }
-
-              // read the moreBytes data
-              if(fread(utf8buf, cmail.moreBytes, 1, fh) != 1)
-              {
-                E(DBF_FOLDER, "fread error while reading index file");
-                error = TRUE;
-                break;
-              }
-
-              // make sure to NUL terminate the utf8 string
-              utf8buf[cmail.moreBytes] = '\0';
-
-              if(systemIsUTF8 == TRUE)
-              {
-                // no conversion required
-                buf = utf8buf;
-			  }
-			  else
-			  {
-                // convert the utf8 encoded buffer to the local charset
-                if((buf = CodesetsUTF8ToStr(CSA_Source,          utf8buf,
-                                            CSA_SourceLen,       cmail.moreBytes,
-                                            CSA_DestCodeset,     G->systemCodeset,
-                                            CSA_MapForeignChars, C->MapForeignChars,
-                                            TAG_DONE)) == NULL)
-                {
-                  E(DBF_FOLDER, "error while converting UTF8 data to local charset");
-                  error = TRUE;
-                  break;
-                }
-              }
-
-              // create a new mail structure
-              if((mail = AllocMail()) != NULL)
-              {
-                line = buf;
-                lineNr = 0;
-                do
-                {
-                  if((nextLine = strchr(line, '\n')) != NULL)
-                    *nextLine++ = '\0';
-
-                  lineNr++;
-
-                  switch(lineNr)
-                  {
-                    case 1:
-                      strlcpy(mail->Subject, line, sizeof(mail->Subject));
-                    break;
-
-                    case 2:
-                      strlcpy(mail->From.Address, line, sizeof(mail->From.Address));
-                    break;
-
-                    case 3:
-                      strlcpy(mail->From.RealName, line, sizeof(mail->From.RealName));
-                    break;
-
-                    case 4:
-                      strlcpy(mail->To.Address, line, sizeof(mail->To.Address));
-                    break;
-
-                    case 5:
-                      strlcpy(mail->To.RealName, line, sizeof(mail->To.RealName));
-                    break;
-
-                    case 6:
-                      strlcpy(mail->ReplyTo.Address, line, sizeof(mail->ReplyTo.Address));
-                    break;
-
-                    case 7:
-                      strlcpy(mail->ReplyTo.RealName, line, sizeof(mail->ReplyTo.RealName));
-                    break;
-
-                    case 8:
-                      strlcpy(mail->MailAccount, line, sizeof(mail->MailAccount));
-                    break;
-                  }
-
-                  line = nextLine;
-                }
-                while(line != NULL && lineNr < COMPRMAIL_MORELINES);
-
-                mail->mflags = cmail.mflags;
-                mail->sflags = cmail.sflags;
-                // we have to make sure that the volatile flag field isn't loaded
-                setVOLValue(mail, 0);
-                strlcpy(mail->MailFile, cmail.mailFile, sizeof(mail->MailFile));
-                mail->Date = cmail.date;
-                mail->transDate = cmail.transDate;
-                mail->cMsgID = cmail.cMsgID;
-                mail->cIRTMsgID = cmail.cIRTMsgID;
-                mail->Size = cmail.size;
-
-                // finally add the new mail structure to the temporary folder
-                // no message list locking or index expiring is necessary here,
-                // because it is a temporary folder which is not publically known
-                AddMailToFolderSimple(mail, tempFolder);
-
-                // the AddMailToFolderSimple() call set the mail's folder pointer to the
-                // temporary folder. But since this is a temporary one only and will be
-                // invalid after leaving this function we must set the mail's folder
-                // pointer to the correct current folder.
-                mail->Folder = folder;
-              }
-              else
-                error = TRUE;
-
-              if(systemIsUTF8 == FALSE)
-              {
-                // free the codesets buffer
-                CodesetsFreeA(buf, NULL);
-              }
-            }
-            while(error == FALSE);
+            // all mails of the folder go into a pool of their own which
+            // can be freed at once when the folder is flushed again
+            tempFolder->messages->pool = CreateMailPool();
+
+            if(fi.ID == FINDEX_VER)
+              error = LoadIndexColumns(folder, tempFolder, fh, &fi, indexFileSize-sizeof(fi), &corrupt);
+            else
+              error = LoadIndexComprMails(folder, tempFolder, fh, indexFileName, &corrupt);
+
+            // bring the snapshot up to date with all changes since it was saved
+            if(error == FALSE && corrupt == FALSE && ReplayIndexJournal(folder, tempFolder, &journalDamaged) == FALSE)
+              error = TRUE;
+
+            // if everything went well then move all mails from the temporary folder
+            // to the real folder
+            if(error == FALSE && corrupt == FALSE)
+              MoveFolderContents(folder, tempFolder);
+
+            // free the temporary folder in any case
+            FreeFolder(tempFolder);
           }
-
-          // if everything went well then move all mails from the temporary folder
-          // to the real folder
-          if(error == FALSE)
-            MoveFolderContents(folder, tempFolder);
-
-          // free the temporary folder in any case
-          FreeFolder(tempFolder);
+          else
+            error = TRUE;
+        }
+        else
+        {
+          // update the statistics from the index header
+          ReplayIndexJournal(folder, NULL, &journalDamaged);
         }
       }
 
@@ -535,15 +1108,21 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
   {
     indexloaded = LM_VALID;
     clearFlag(folder->Flags, FOFL_MODIFY);
+
+    // a partially written journal must not be appended to, hence we
+    // merge the valid part into a new snapshot right now
+    if(journalDamaged == TRUE)
+      MA_SaveIndex(folder);
   }
 
+  STOPSPAN(DBF_FOLDER);
   RETURN(indexloaded);
   return indexloaded;
 }
 
 ///
 /// MA_SaveIndex
-//  Saves a folder index to disk
+//  Saves a folder index to disk in the columnar FINDEX_VER format
 BOOL MA_SaveIndex(struct Folder *folder)
 {
   BOOL success = FALSE;
@@ -561,100 +1140,206 @@ BOOL MA_SaveIndex(struct Folder *folder)
     struct BusyNode *busy;
     struct FIndex fi;
     struct MailNode *mnode;
+    char *heap;
+    size_t heapSize;
 
     setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
     busy = BusyBegin(BUSY_TEXT);
     BusyText(busy, tr(MSG_BusySavingIndex), folder->Name);
 
-    // lets prepare the Folder Index struct and write it out
-    // we clear it first, so that the reserved field is also 0
-    memset(&fi, 0, sizeof(struct FIndex));
-    fi.ID = FINDEX_VER;
-    fi.Total = folder->Total;
-    fi.New = folder->New;
-    fi.Unread = folder->Unread;
-    fi.Size = folder->Size;
+    LockMailListShared(folder->messages);
+
+    // no journal record must be appended while the snapshot is written.
+    // The journal semaphore is always obtained after a mail list lock,
+    // i.e. MA_ValidateStatus() changes the status of mails while it holds
+    // the folder's mail list.
+    ObtainSemaphore(G->journalSemaphore);
 
-    // write the index header out first
-    if(fwrite(&fi, sizeof(fi), 1, fh) == 1)
+    // the journal is merged into the new snapshot, hence it must be gone
+    // before the new .index is complete. Otherwise a crash in between would
+    // replay it a second time on top of the new snapshot. A crash while the
+    // .index is written leaves a corrupt one, which causes a rescan.
+    DeleteIndexJournal(folder);
+
+    // calculate the size of the string heap first to avoid that the
+    // dynamic string must be enlarged over and over again
+    heapSize = 0;
+    ForEachMailNode(folder->messages, mnode)
     {
-      BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+      struct Mail *mail = mnode->mail;
+      size_t len;
 
-      // assume success at first
-      success = TRUE;
+      len = strlen(mail->Subject) +
+            strlen(mail->From.Address) + strlen(mail->From.RealName) +
+            strlen(mail->To.Address) + strlen(mail->To.RealName) +
+            strlen(mail->ReplyTo.Address) + strlen(mail->ReplyTo.RealName) +
+            strlen(mail->MailAccount) + COMPRMAIL_MORELINES;
+
+      heapSize += len;
+    }
+
+    // collect the strings of all mails in one heap, this is
+    // converted to UTF8 in one go afterwards
+    if((heap = dstralloc(heapSize)) != NULL)
+    {
+      BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+      UTF8 *utf8Heap;
+      ULONG utf8HeapSize = 0;
 
-      LockMailListShared(folder->messages);
       ForEachMailNode(folder->messages, mnode)
       {
         struct Mail *mail = mnode->mail;
-        struct ComprMail cmail;
-        char buf[SIZE_LARGE];
-        UTF8 *utf8buf;
-
-        // create the moreBytes string we append at the end
-        snprintf(buf, sizeof(buf), "%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n",
-                                   mail->Subject,
-                                   mail->From.Address, mail->From.RealName,
-                                   mail->To.Address, mail->To.RealName,
-                                   mail->ReplyTo.Address, mail->ReplyTo.RealName,
-                                   mail->MailAccount);
-
-        if(systemIsUTF8 == TRUE)
+        const char *lines[COMPRMAIL_MORELINES];
+        int i;
+
+        lines[0] = mail->Subject;
+        lines[1] = mail->From.Address;
+        lines[2] = mail->From.RealName;
+        lines[3] = mail->To.Address;
+        lines[4] = mail->To.RealName;
+        lines[5] = mail->ReplyTo.Address;
+        lines[6] = mail->ReplyTo.RealName;
+        lines[7] = mail->MailAccount;
+
+        // append the strings directly, the loader relies on exactly
+        // COMPRMAIL_MORELINES complete lines per mail
+        for(i=0; i < COMPRMAIL_MORELINES; i++)
         {
-          // no conversion required;
-          utf8buf = (UTF8 *)buf;
-		}
-		else
-		{
-          // convert the buffer string to UTF8
-          // the length of the generated string is directly put into the moreBytes variable
-          utf8buf = CodesetsUTF8Create(CSA_Source, buf,
-                                       CSA_SourceCodeset, G->systemCodeset,
-                                       CSA_DestLenPtr, &cmail.moreBytes,
-                                       TAG_DONE);
+          dstrcat(&heap, lines[i]);
+          dstrcat(&heap, "\n");
         }
+      }
+
+      if(systemIsUTF8 == TRUE)
+      {
+        // no conversion required
+        utf8Heap = (UTF8 *)heap;
+        utf8HeapSize = dstrlen(heap);
+      }
+      else
+      {
+        // convert the whole heap to UTF8
+        utf8Heap = CodesetsUTF8Create(CSA_Source, heap,
+                                      CSA_SourceLen, dstrlen(heap),
+                                      CSA_SourceCodeset, G->systemCodeset,
+                                      CSA_DestLenPtr, &utf8HeapSize,
+                                      TAG_DONE);
+      }
 
-        if(utf8buf != NULL)
+      if(utf8Heap != NULL)
+      {
+        // lets prepare the Folder Index struct and write it out
+        memset(&fi, 0, sizeof(struct FIndex));
+        fi.ID = FINDEX_VER;
+        fi.Total = folder->Total;
+        fi.New = folder->New;
+        fi.Unread = folder->Unread;
+        fi.Size = folder->Size;
+        fi.Count = folder->messages->count;
+        fi.HeapSize = utf8HeapSize;
+
+        // write the index header out first
+        if(fwrite(&fi, sizeof(fi), 1, fh) == 1)
         {
-          strlcpy(cmail.mailFile, mail->MailFile, sizeof(cmail.mailFile));
-          cmail.date = mail->Date;
-          cmail.transDate = mail->transDate;
-          cmail.sflags = mail->sflags;
-          cmail.mflags = mail->mflags;
-          // we have to make sure that the volatile flag field isn't saved
-          setVOLValue(&cmail, 0);
-          cmail.cMsgID = mail->cMsgID;
-          cmail.cIRTMsgID = mail->cIRTMsgID;
-          cmail.size = mail->Size;
-
-          if(fwrite(&cmail, sizeof(cmail), 1, fh) != 1 ||
-             fwrite(utf8buf, cmail.moreBytes, 1, fh) != 1)
+          const char *utf8Line = (const char *)utf8Heap;
+          const char *utf8End = &utf8Line[utf8HeapSize];
+
+          // assume success at first
+          success = TRUE;
+
+          // now write out each column, the file buffer takes care
+          // that we don't issue one write per value
+          ForEachMailNode(folder->messages, mnode)
+            fwrite(&mnode->mail->Date, sizeof(struct DateStamp), 1, fh);
+          ForEachMailNode(folder->messages, mnode)
+            fwrite(&mnode->mail->transDate, sizeof(struct TimeVal), 1, fh);
+          ForEachMailNode(folder->messages, mnode)
           {
-            E(DBF_FOLDER, "couldn't write index data of mail '%s'", cmail.mailFile);
-            success = FALSE;
+            ULONG sflags = mnode->mail->sflags;
+
+            fwrite(&sflags, sizeof(sflags), 1, fh);
           }
+          ForEachMailNode(folder->messages, mnode)
+          {
+            // we have to make sure that the volatile flag field isn't saved
+            ULONG mflags = mnode->mail->mflags & ~(7<<MFLAG_VOLFIELD);
 
-          if(systemIsUTF8 == FALSE)
+            fwrite(&mflags, sizeof(mflags), 1, fh);
+          }
+          ForEachMailNode(folder->messages, mnode)
           {
-            // free the codesets buffer
-            CodesetsFreeA(utf8buf, NULL);
+            ULONG cMsgID = mnode->mail->cMsgID;
+
+            fwrite(&cMsgID, sizeof(cMsgID), 1, fh);
+          }
+          ForEachMailNode(folder->messages, mnode)
+          {
+            ULONG cIRTMsgID = mnode->mail->cIRTMsgID;
+
+            fwrite(&cIRTMsgID, sizeof(cIRTMsgID), 1, fh);
+          }
+          ForEachMailNode(folder->messages, mnode)
+          {
+            LONG size = mnode->mail->Size;
+
+            fwrite(&size, sizeof(size), 1, fh);
+          }
+          ForEachMailNode(folder->messages, mnode)
+          {
+            ULONG heapOffset = utf8Line - (const char *)utf8Heap;
+            int lineNr;
+
+            fwrite(&heapOffset, sizeof(heapOffset), 1, fh);
+
+            // skip the mail's lines to get the offset of the next mail
+            for(lineNr=0; lineNr < COMPRMAIL_MORELINES && utf8Line < utf8End; lineNr++)
+            {
+              const char *eol;
+
+              if((eol = memchr(utf8Line, '\n', utf8End-utf8Line)) != NULL)
+                utf8Line = eol+1;
+              else
+                utf8Line = utf8End;
+            }
+          }
+          ForEachMailNode(folder->messages, mnode)
+          {
+            char mailFile[SIZE_MFILE];
+
+            // clear the buffer first to not write out random data
+            memset(mailFile, 0, sizeof(mailFile));
+            strlcpy(mailFile, mnode->mail->MailFile, sizeof(mailFile));
+            fwrite(mailFile, sizeof(mailFile), 1, fh);
+          }
+
+          if(utf8HeapSize > 0 && fwrite(utf8Heap, utf8HeapSize, 1, fh) != 1)
+            success = FALSE;
+
+          if(ferror(fh) != 0)
+          {
+            E(DBF_FOLDER, "couldn't write index data of folder '%s'", folder->Name);
+            success = FALSE;
           }
+
+          clearFlag(folder->Flags, FOFL_MODIFY);
         }
-        else
-          success = FALSE;
 
-        // break out if something went wrong
-        if(success == FALSE)
-          break;
+        if(systemIsUTF8 == FALSE)
+        {
+          // free the codesets buffer
+          CodesetsFreeA(utf8Heap, NULL);
+        }
       }
 
-      UnlockMailList(folder->messages);
-
-      clearFlag(folder->Flags, FOFL_MODIFY);
+      dstrfree(heap);
     }
 
+    ReleaseSemaphore(G->journalSemaphore);
+    UnlockMailList(folder->messages);
+
     fclose(fh);
+
     BusyEnd(busy);
   }
   else
@@ -663,6 +1348,11 @@ BOOL MA_SaveIndex(struct Folder *folder)
     ER_NewError(tr(MSG_ER_CANNOT_WRITE_INDEX), indexFileName, folder->Name);
   }
 
+  // the journaled changes are lost without a new snapshot, they must be
+  // saved again later and no journal must be written on top of it
+  if(success == FALSE)
+    setFlag(folder->Flags, FOFL_MODIFY);
+
   RETURN(success);
   return success;
 }
@@ -740,6 +1430,7 @@ void MA_ExpireIndex(struct Folder *folder)
 
     AddPath(indexFileName, folder->Fullpath, ".index", sizeof(indexFileName));
     DeleteFile(indexFileName);
+    DeleteIndexJournal(folder);
   }
 
   setFlag(folder->Flags, FOFL_MODIFY);
@@ -747,6 +1438,207 @@ void MA_ExpireIndex(struct Folder *folder)
   LEAVE();
 }
 
+///
+/// AppendJournalRecord
+//  Appends a record for the given mail to the journal of a folder. In case
+//  the folder's index is not journaled at the moment or the journal can't
+//  be written the index is expired instead.
+static void AppendJournalRecord(struct Folder *folder, enum JournalRecordType type, const struct Mail *mail, const unsigned int oldSFlags, const long oldSize, const char *oldMailFile)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  // the download threads add mails while the main thread records status
+  // changes, hence the appends must not interfere with each other
+  ObtainSemaphore(G->journalSemaphore);
+
+  // a journal only makes sense on top of a valid index snapshot
+  if(folder->LoadedMode == LM_VALID && isModified(folder) == FALSE)
+  {
+    struct JournalRecord rec;
+    UTF8 *utf8buf = NULL;
+    BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+    char *strings = NULL;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type = type;
+    rec.date = mail->Date;
+    rec.transDate = mail->transDate;
+    rec.sflags = mail->sflags;
+    // we have to make sure that the volatile flag field isn't saved
+    rec.mflags = mail->mflags & ~(7<<MFLAG_VOLFIELD);
+    rec.cMsgID = mail->cMsgID;
+    rec.cIRTMsgID = mail->cIRTMsgID;
+    rec.size = mail->Size;
+    rec.oldSFlags = oldSFlags;
+    rec.oldSize = oldSize;
+    strlcpy(rec.mailFile, mail->MailFile, sizeof(rec.mailFile));
+
+    if(type == JRT_ADD || type == JRT_UPDATE)
+    {
+      const char *lines[COMPRMAIL_MORELINES];
+      size_t len = COMPRMAIL_MORELINES;
+      int i;
+
+      lines[0] = mail->Subject;
+      lines[1] = mail->From.Address;
+      lines[2] = mail->From.RealName;
+      lines[3] = mail->To.Address;
+      lines[4] = mail->To.RealName;
+      lines[5] = mail->ReplyTo.Address;
+      lines[6] = mail->ReplyTo.RealName;
+      lines[7] = mail->MailAccount;
+
+      for(i=0; i < COMPRMAIL_MORELINES; i++)
+        len += strlen(lines[i]);
+
+      // the replay relies on exactly COMPRMAIL_MORELINES complete lines
+      // just like the index heap, hence nothing must be cut off
+      if((strings = dstralloc(len)) != NULL)
+      {
+        for(i=0; i < COMPRMAIL_MORELINES; i++)
+        {
+          dstrcat(&strings, lines[i]);
+          dstrcat(&strings, "\n");
+        }
+      }
+
+      if(strings == NULL)
+      {
+        E(DBF_FOLDER, "couldn't allocate %ld bytes for the journal strings", len);
+      }
+      else if(systemIsUTF8 == TRUE)
+      {
+        // no conversion required
+        utf8buf = (UTF8 *)strings;
+        rec.moreBytes = dstrlen(strings);
+      }
+      else
+      {
+        utf8buf = CodesetsUTF8Create(CSA_Source, strings,
+                                     CSA_SourceLen, dstrlen(strings),
+                                     CSA_SourceCodeset, G->systemCodeset,
+                                     CSA_DestLenPtr, &rec.moreBytes,
+                                     TAG_DONE);
+      }
+    }
+    else if(type == JRT_STATUS && oldMailFile != NULL && strcmp(oldMailFile, mail->MailFile) != 0)
+    {
+      // the previous filename lets the replay find the renamed mail
+      utf8buf = (UTF8 *)oldMailFile;
+      rec.moreBytes = strlen(oldMailFile);
+    }
+
+    if(rec.moreBytes == 0 || utf8buf != NULL)
+    {
+      char journalFileName[SIZE_PATHFILE];
+      FILE *fh;
+
+      AddPath(journalFileName, folder->Fullpath, ".journal", sizeof(journalFileName));
+
+      // start a new journal if there is none yet
+      if((fh = fopen(journalFileName, folder->journalSize == 0 ? "w" : "a")) != NULL)
+      {
+        ULONG id = JOURNAL_VER;
+
+        if((folder->journalSize > 0 || fwrite(&id, sizeof(id), 1, fh) == 1) &&
+           fwrite(&rec, sizeof(rec), 1, fh) == 1 &&
+           (rec.moreBytes == 0 || fwrite(utf8buf, rec.moreBytes, 1, fh) == 1))
+        {
+          if(folder->journalSize == 0)
+            folder->journalSize = sizeof(id);
+
+          folder->journalSize += sizeof(rec) + rec.moreBytes;
+          success = TRUE;
+        }
+
+        fclose(fh);
+      }
+
+      if(success == FALSE)
+        W(DBF_FOLDER, "couldn't append to journal '%s'", journalFileName);
+    }
+
+    if(utf8buf != NULL && (char *)utf8buf != strings && (const char *)utf8buf != oldMailFile)
+      CodesetsFreeA(utf8buf, NULL);
+
+    dstrfree(strings);
+  }
+
+  // fall back to rewrite the whole index later on
+  if(success == FALSE)
+    MA_ExpireIndex(folder);
+
+  ReleaseSemaphore(G->journalSemaphore);
+
+  LEAVE();
+}
+
+///
+/// MA_JournalAddMail
+//  Records a mail just added to its folder in the index journal
+void MA_JournalAddMail(const struct Mail *mail)
+{
+  ENTER();
+
+  AppendJournalRecord(mail->Folder, JRT_ADD, mail, 0, 0, NULL);
+
+  LEAVE();
+}
+
+///
+/// MA_JournalRemoveMail
+//  Records a mail just removed from a folder in the index journal
+void MA_JournalRemoveMail(struct Folder *folder, const struct Mail *mail)
+{
+  ENTER();
+
+  AppendJournalRecord(folder, JRT_REMOVE, mail, mail->sflags, mail->Size, NULL);
+
+  LEAVE();
+}
+
+///
+/// MA_JournalUpdateMail
+//  Records the changed data of a mail in the index journal
+void MA_JournalUpdateMail(const struct Mail *mail, const unsigned int oldSFlags, const long oldSize)
+{
+  ENTER();
+
+  AppendJournalRecord(mail->Folder, JRT_UPDATE, mail, oldSFlags, oldSize, NULL);
+
+  LEAVE();
+}
+
+///
+/// MA_JournalMailStatus
+//  Records the changed status and/or filename of a mail in the index journal
+void MA_JournalMailStatus(const struct Mail *mail, const unsigned int oldSFlags, const char *oldMailFile)
+{
+  ENTER();
+
+  AppendJournalRecord(mail->Folder, JRT_STATUS, mail, oldSFlags, mail->Size, oldMailFile);
+
+  LEAVE();
+}
+
+///
+/// MA_JournalNeedsCompaction
+//  Checks whether the journal of a folder has grown so much that it should
+//  be merged into the .index file again
+BOOL MA_JournalNeedsCompaction(const struct Folder *folder)
+{
+  BOOL result;
+
+  ENTER();
+
+  result = (folder->LoadedMode == LM_VALID && folder->journalSize > JOURNAL_MAXSIZE);
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// MA_RebuildIndexes
 //  Rebuild indices of all folders
@@ -765,16 +1657,24 @@ void MA_RebuildIndexes(void)
     if(folder != NULL && !isGroupFolder(folder))
     {
       char indexFileName[SIZE_PATHFILE];
+      char journalFileName[SIZE_PATHFILE];
       ULONG dirDate;
       ULONG indexDate;
+      ULONG journalDate;
 
       AddPath(indexFileName, folder->Fullpath, ".index", sizeof(indexFileName));
+      AddPath(journalFileName, folder->Fullpath, ".journal", sizeof(journalFileName));
 
       // get date of the folder directory and the .index file
       // itself
       if(ObtainFileInfo(folder->Fullpath, FI_TIME, &dirDate) == TRUE &&
          ObtainFileInfo(indexFileName, FI_TIME, &indexDate) == TRUE)
       {
+        // changes recorded in the journal are as good as the
+        // .index itself
+        if(indexDate > 0 && ObtainFileInfo(journalFileName, FI_TIME, &journalDate) == TRUE && journalDate > indexDate)
+          indexDate = journalDate;
+
         // only consider starting to rebuilding the .index if
         // either the date of the directory is greater than the
         // date of the .index file itself, or if there is no index
@@ -799,6 +1699,7 @@ void MA_RebuildIndexes(void)
               // rebuild it.
               if(indexDate > 0)
                 DeleteFile(indexFileName);
+              DeleteIndexJournal(folder);
 
               // then lets call GetIndex() to start rebuilding
               // the .index - but only if this folder is one of the folders
@@ -1205,8 +2106,9 @@ static unsigned long CompressMsgID(const char *msgid)
 struct Mail *FindMailByMsgID(struct Folder *folder, const char *msgid)
 {
   struct Mail *result = NULL;
-  struct MailNode *mnode;
+  struct Mail *mail;
   unsigned long msgidCRC;
+  ULONG nth = 0;
 
   ENTER();
 
@@ -1214,30 +2116,25 @@ struct Mail *FindMailByMsgID(struct Folder *folder, const char *msgid)
 
   LockMailList(folder->messages);
 
-  ForEachMailNode(folder->messages, mnode)
+  // the folder's message ID index yields all mails with the same
+  // compressed message-id without walking through the whole folder
+  while(result == NULL && (mail = GetMailByCompressedMsgID(folder, msgidCRC, nth)) != NULL)
   {
-    struct Mail *mail = mnode->mail;
-
-    // compare the compressed message-ids only for speed reasons
-    if(mail->cMsgID == msgidCRC)
-    {
-      // now go into detail and check if the full message-id matches
-      struct ExtendedMail *email;
-
-      if((email = MA_ExamineMail(folder, mail->MailFile, TRUE)) != NULL)
-      {
-        if(strcmp(email->messageID, msgid) == 0)
-        {
-          // return the mail
-          result = mail;
-        }
+    // now go into detail and check if the full message-id matches
+    struct ExtendedMail *email;
 
-        MA_FreeEMailStruct(email);
+    if((email = MA_ExamineMail(folder, mail->MailFile, TRUE)) != NULL)
+    {
+      if(strcmp(email->messageID, msgid) == 0)
+      {
+        // return the mail
+        result = mail;
       }
 
-      if(result != NULL)
-        break;
+      MA_FreeEMailStruct(email);
     }
+
+    nth++;
   }
 
   UnlockMailList(folder->messages);
@@ -1572,6 +2469,115 @@ static char *ValidateAddressLine(const char *line)
   return validLine;
 }
 
+///
+/// MA_DecodeHeaderNode
+//  Decodes the content of a header line read by MA_ReadHeader() according
+//  to RFC 2047, returns FALSE in case of a memory shortage only
+BOOL MA_DecodeHeaderNode(const char *mailFile, struct HeaderNode *hdrNode)
+{
+  BOOL success = TRUE;
+  int len;
+
+  ENTER();
+
+  // we first decode the header according to RFC 2047 which
+  // should give us the full charset interpretation
+  if((len = rfc2047_decode(hdrNode->content, hdrNode->content, dstrlen(hdrNode->content))) == -1)
+  {
+    E(DBF_FOLDER, "ERROR: malloc() error during rfc2047() decoding");
+    success = FALSE;
+  }
+  else
+  {
+    char *ptr;
+
+    if(len == -2)
+    {
+      W(DBF_FOLDER, "WARNING: unknown header encoding found");
+
+      // signal an error but continue.
+      ER_NewError(tr(MSG_ER_UNKNOWN_HEADER_ENCODING), hdrNode->content, mailFile);
+    }
+    else if(len == -3)
+    {
+      W(DBF_FOLDER, "WARNING: rfc2047 (base64) header decoding failed");
+    }
+
+    // now that we have decoded the headerline accoring to rfc2047
+    // we have to strip out eventually existing ESC sequences as
+    // this can be dangerous with MUI.
+    for(ptr=hdrNode->content; *ptr; ptr++)
+    {
+      // if we find an ESC sequence, strip it!
+      if(*ptr == 0x1b)
+        *ptr = ' ';
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// MA_HasBrokenAddressLines
+//  Checks whether a header was created by software which is known to
+//  generate broken address lines
+BOOL MA_HasBrokenAddressLines(struct MinList *headerList)
+{
+  struct HeaderNode *microsuckHeader;
+  BOOL result = FALSE;
+
+  ENTER();
+
+  // So far only Microsoft Exchange seems to generate broken address lines.
+  // Time will show if this will become an longer list...
+  if((microsuckHeader = FindHeader(headerList, "x-mimeole")) != NULL && strstr(microsuckHeader->content, "Microsoft Exchange") != NULL)
+  {
+    D(DBF_MIME, "mail was created by possibly broken Microsoft software ('%s'), validating address lines", microsuckHeader->content);
+    result = TRUE;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// MA_ValidateAddressHeader
+//  Validates the content of a header line if it is an address line
+void MA_ValidateAddressHeader(struct HeaderNode *hdrNode)
+{
+  static const char *addressLineNames[] =
+  {
+    "from", "to", "reply-to", "cc", "bcc"
+  };
+  ULONG i;
+
+  ENTER();
+
+  for(i = 0; i < ARRAY_SIZE(addressLineNames); i++)
+  {
+    if(stricmp(hdrNode->name, addressLineNames[i]) == 0)
+    {
+      // Check whether potential EMail address are valid.
+      // Buggy Microsoft software very often creates invalid addresses,
+      // i.e 'lastname, firstname <address>' without the necessary quotes around the name
+      char *validLine;
+
+      D(DBF_MIME, "validating '%s' header with content '%s'", hdrNode->name, hdrNode->content);
+
+      if((validLine = ValidateAddressLine(hdrNode->content)) != NULL)
+      {
+        dstrfree(hdrNode->content);
+        hdrNode->content = validLine;
+      }
+
+      break;
+    }
+  }
+
+  LEAVE();
+}
+
 ///
 /// MA_ReadHeader
 //  Reads header lines of a message into memory
@@ -1627,37 +2633,12 @@ BOOL MA_ReadHeader(const char *mailFile, FILE *fh, struct MinList *headerList, e
         // first validate the previous one, if it exists.
         if(hdrNode != NULL)
         {
-          char *ptr;
-          int len;
-
-          // we first decode the header according to RFC 2047 which
-          // should give us the full charset interpretation
-          if((len = rfc2047_decode(hdrNode->content, hdrNode->content, dstrlen(hdrNode->content))) == -1)
+          // a raw header is decoded later by the caller
+          if(mode != RHM_RAWHEADER && MA_DecodeHeaderNode(mailFile, hdrNode) == FALSE)
           {
-            E(DBF_FOLDER, "ERROR: malloc() error during rfc2047() decoding");
+            FreeHeaderNode(hdrNode);
             break; // break-out
           }
-          else if(len == -2)
-          {
-            W(DBF_FOLDER, "WARNING: unknown header encoding found");
-
-            // signal an error but continue.
-            ER_NewError(tr(MSG_ER_UNKNOWN_HEADER_ENCODING), hdrNode->content, mailFile);
-          }
-          else if(len == -3)
-          {
-            W(DBF_FOLDER, "WARNING: rfc2047 (base64) header decoding failed");
-          }
-
-          // now that we have decoded the headerline accoring to rfc2047
-          // we have to strip out eventually existing ESC sequences as
-          // this can be dangerous with MUI.
-          for(ptr=hdrNode->content; *ptr; ptr++)
-          {
-            // if we find an ESC sequence, strip it!
-            if(*ptr == 0x1b)
-              *ptr = ' ';
-          }
 
           // the headerNode seems to be finished so we put it into our
           // headerList
@@ -1731,7 +2712,7 @@ BOOL MA_ReadHeader(const char *mailFile, FILE *fh, struct MinList *headerList, e
     if(success == FALSE)
       ClearHeaderList(headerList);
     else if(IsMinListEmpty(headerList) == TRUE &&
-            (mode == RHM_MAINHEADER || IsStrEmpty(buffer) == FALSE || linesread != 1))
+            (mode != RHM_SUBHEADER || IsStrEmpty(buffer) == FALSE || linesread != 1))
     {
       W(DBF_MAIL, "no required header data found while scanning '%s'", mailFile);
       success = FALSE;
@@ -1740,44 +2721,13 @@ BOOL MA_ReadHeader(const char *mailFile, FILE *fh, struct MinList *headerList, e
     free(buffer);
   }
 
-  if(success == TRUE)
+  // a raw header is validated later by the caller
+  if(success == TRUE && mode != RHM_RAWHEADER && MA_HasBrokenAddressLines(headerList) == TRUE)
   {
-    struct HeaderNode *microsuckHeader;
-
-    // So far only Microsoft Exchange seems to generate broken address lines.
-    // Time will show if this will become an longer list...
-    if((microsuckHeader = FindHeader(headerList, "x-mimeole")) != NULL && strstr(microsuckHeader->content, "Microsoft Exchange") != NULL)
-    {
-      const char *addressLineNames[] =
-      {
-        "from", "to", "reply-to", "cc", "bcc"
-      };
-      ULONG i;
-
-      D(DBF_MIME, "mail was created by possibly broken Microsoft software ('%s'), validating address lines", microsuckHeader->content);
-
-      // iterate over the possibly malformed header lines
-      for(i = 0; i < ARRAY_SIZE(addressLineNames); i++)
-      {
-        struct HeaderNode *addressHeader;
-
-        if((addressHeader = FindHeader(headerList, addressLineNames[i])) != NULL)
-        {
-          // Check whether potential EMail address are valid.
-          // Buggy Microsoft software very often creates invalid addresses,
-          // i.e 'lastname, firstname <address>' without the necessary quotes around the name
-          char *validLine;
-
-          D(DBF_MIME, "validating '%s' header with content '%s'", addressHeader->name, addressHeader->content);
+    struct HeaderNode *hdrNode;
 
-          if((validLine = ValidateAddressLine(addressHeader->content)) != NULL)
-          {
-            dstrfree(addressHeader->content);
-            addressHeader->content = validLine;
-          }
-        }
-      }
-    }
+    IterateList(headerList, struct HeaderNode *, hdrNode)
+      MA_ValidateAddressHeader(hdrNode);
   }
 
   RETURN(success);
@@ -1898,6 +2848,8 @@ void MA_FreeEMailStruct(struct ExtendedMail *email)
       email->NumMailReplyTo = 0;
     }
 
+    FreeMailStrings(&email->Mail);
+
     free(email);
   }
 
@@ -2217,7 +3169,7 @@ static BOOL MA_ScanDate(struct Mail *mail, const char *date)
       mail->gmtOffset = TZtoMinutes(tzAbbr);
 
     // save the tzone abbreviation
-    strlcpy(mail->tzAbbr, tzAbbr, sizeof(mail->tzAbbr));
+    SetMailTZAbbr(mail, tzAbbr);
 
     // bring the date in relation to UTC
     ds->ds_Minute -= mail->gmtOffset;
@@ -2242,7 +3194,7 @@ static BOOL MA_ScanDate(struct Mail *mail, const char *date)
 struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *file, const BOOL deep)
 {
   struct ExtendedMail *email;
-  static struct Person pe;
+  struct Person pe;
   struct MinList headerList;
   struct Mail *mail;
   char fullfile[SIZE_PATHFILE];
@@ -2261,7 +3213,8 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
   }
 
   mail = &email->Mail;
-  strlcpy(mail->MailFile, file, sizeof(mail->MailFile));
+  InitMailStrings(mail);
+  SetMailFile(mail, file);
 
   GetMailFile(fullfile, sizeof(fullfile), folder, mail);
   if((fh = fopen(fullfile, "r")) != NULL)
@@ -2336,7 +3289,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
 
         // extract the main mail address
         ExtractAddress(value, &pe);
-        mail->From = pe;
+        SetMailPerson(&mail->From, pe.Address, pe.RealName);
 
         // we have to check if we can match the user identity
         // from the email address
@@ -2387,7 +3340,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
          *p++ = '\0';
 
         ExtractAddress(value, &pe);
-        mail->ReplyTo = pe;
+        SetMailPerson(&mail->ReplyTo, pe.Address, pe.RealName);
 
         // we have to check if we can match the user identity
         // from the email address
@@ -2456,7 +3409,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
             *p++ = '\0';
 
           ExtractAddress(value, &pe);
-          mail->To = pe;
+          SetMailPerson(&mail->To, pe.Address, pe.RealName);
 
           // we have to check if we can match the user identity
           // from the email address
@@ -2586,7 +3539,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
       }
       else if(stricmp(field, "subject") == 0)
       {
-        strlcpy(mail->Subject, Trim(value), sizeof(mail->Subject));
+        SetMailSubject(mail, Trim(value));
       }
       else if(stricmp(field, "message-id") == 0)
       {
@@ -2672,7 +3625,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
       }
       else if(stricmp(field, "x-yam-mailaccount") == 0)
       {
-        strlcpy(mail->MailAccount, value, sizeof(mail->MailAccount));
+        SetMailAccount(mail, value);
       }
       else if(deep == TRUE) // and if we end up here we check if we really have to go further
       {
@@ -2780,7 +3733,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
 
         // extract the main mail address
         ExtractAddress(value, &pe);
-        mail->From = pe;
+        SetMailPerson(&mail->From, pe.Address, pe.RealName);
 
         // we have to check if we can match the user identity
         // from the email address
@@ -2860,7 +3813,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
     // completly the same like the from address we go and copy the realname as both
     // are the same.
     if(foundReplyTo == TRUE && mail->ReplyTo.RealName[0] != '\0' && stricmp(mail->ReplyTo.Address, mail->From.Address) == 0)
-      strlcpy(mail->ReplyTo.RealName, mail->From.RealName, sizeof(mail->ReplyTo.RealName));
+      SetMailPerson(&mail->ReplyTo, mail->ReplyTo.Address, mail->From.RealName);
 
     // if this function call has a folder of NULL then we are examining a virtual mail
     // which means this mail doesn't have any folder and also no filename that may contain
@@ -2868,6 +3821,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
     if(folder != NULL)
     {
       char *timebuf = NULL;
+      const char *status;
 
       // now we take the filename of our mailfile into account to check for
       // the transfer date at the start of the name and for the set status
@@ -2901,17 +3855,18 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
         free(timebuf);
       }
 
-      // now grab the status out of the end of the mailfilename
-      ptr = &mail->MailFile[17];
-      while(*ptr != '\0')
+      // now grab the status out of the end of the mailfilename, the name is
+      // not padded to a fixed size anymore, so check its length first
+      status = (strlen(mail->MailFile) > 17) ? &mail->MailFile[17] : "";
+      while(*status != '\0')
       {
-        if(*ptr >= '1' && *ptr <= '7')
+        if(*status >= '1' && *status <= '7')
         {
-          setPERValue(mail, *ptr-'1'+1);
+          setPERValue(mail, *status-'1'+1);
         }
         else
         {
-          switch(*ptr)
+          switch(*status)
           {
             case SCHAR_READ:
               setFlag(mail->sflags, SFLAG_READ);
@@ -2958,12 +3913,12 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
             break;
 
             default:
-              W(DBF_FOLDER, "invalid mail status character '%lc' found", *ptr);
+              W(DBF_FOLDER, "invalid mail status character '%lc' found", *status);
             break;
           }
         }
 
-        ptr++;
+        status++;
       }
     }
 
@@ -2988,7 +3943,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
 
       // set the timeZone to our local one
       mail->gmtOffset = G->gmtOffset;
-      strlcpy(mail->tzAbbr, G->tzAbbr, sizeof(mail->tzAbbr));
+      SetMailTZAbbr(mail, G->tzAbbr);
     }
 
     // lets calculate the mailSize out of the FileSize() function
@@ -3017,9 +3972,212 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
   return NULL;
 }
 
+///
+/// MA_ScanFolderFiles
+//  Examines the mail files of a folder scan chunk by chunk. This is executed
+//  by several threads in parallel (TA_ScanFolder), each thread fetches the
+//  next chunk of files until all files have been examined. Mails which could
+//  not be examined are left for the main thread which will ask the user how
+//  to proceed with them.
+LONG MA_ScanFolderFiles(struct FolderScan *scan)
+{
+  LONG examined = 0;
+  BOOL done = FALSE;
+
+  ENTER();
+
+  do
+  {
+    ULONG first;
+    ULONG last;
+
+    // fetch the next chunk of files
+    ObtainSemaphore(&scan->lock);
+
+    first = scan->nextFile;
+    last = MIN(first + SCAN_CHUNK_SIZE, scan->numFiles);
+    if(scan->aborted == TRUE)
+      last = first;
+    scan->nextFile = last;
+
+    ReleaseSemaphore(&scan->lock);
+
+    if(first < last)
+    {
+      ULONG i;
+
+      for(i = first; i < last; i++)
+      {
+        struct FolderScanFile *file = &scan->files[i];
+        struct ExtendedMail *email;
+
+        D(DBF_FOLDER, "examining mail file '%s'", file->name);
+
+        if((email = MA_ExamineMail(scan->folder, file->name, FALSE)) != NULL)
+        {
+          file->mail = CloneMailToPool(&email->Mail, scan->mailPool);
+          MA_FreeEMailStruct(email);
+
+          examined++;
+        }
+      }
+
+      ObtainSemaphore(&scan->lock);
+      scan->processedFiles += last - first;
+      ReleaseSemaphore(&scan->lock);
+    }
+    else
+      done = TRUE;
+  }
+  while(done == FALSE && ThreadWasAborted() == FALSE);
+
+  // let the main thread know that we ran out of work
+  ObtainSemaphore(&scan->lock);
+  scan->finishedThreads++;
+  ReleaseSemaphore(&scan->lock);
+
+  RETURN(examined);
+  return examined;
+}
+
+///
+/// MA_ExamineFolderFiles
+//  Lets a number of threads examine the files collected by a folder scan
+//  while the main thread keeps the busy bar and the GUI up to date
+static BOOL MA_ExamineFolderFiles(struct FolderScan *scan, struct BusyNode *busy)
+{
+  BOOL result = TRUE;
+  ULONG numThreads;
+  ULONG startedThreads = 0;
+  ULONG i;
+
+  ENTER();
+
+  // there is no point in starting more threads than there are chunks
+  numThreads = MIN(SCAN_MAX_THREADS, (scan->numFiles + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE);
+
+  for(i = 0; i < numThreads; i++)
+  {
+    if(DoAction(NULL, TA_ScanFolder,
+      TT_ScanFolder_Scan, scan,
+      TAG_DONE) == NULL)
+    {
+      W(DBF_FOLDER, "could only start %ld of %ld scanning threads", startedThreads, numThreads);
+      break;
+    }
+
+    startedThreads++;
+  }
+
+  D(DBF_FOLDER, "examining %ld files of folder '%s' with %ld threads", scan->numFiles, scan->folder->Name, startedThreads);
+
+  if(startedThreads == 0)
+  {
+    // no thread could be started at all, do the work ourself
+    MA_ScanFolderFiles(scan);
+  }
+  else
+  {
+    BOOL finished = FALSE;
+
+    do
+    {
+      ULONG processedFiles;
+
+      ObtainSemaphore(&scan->lock);
+      processedFiles = scan->processedFiles;
+      finished = (scan->finishedThreads == startedThreads);
+      ReleaseSemaphore(&scan->lock);
+
+      if(finished == FALSE)
+      {
+        // set the gauge and check the stopButton status as well
+        if(result == TRUE && BusyProgress(busy, processedFiles, scan->numFiles) == FALSE)
+        {
+          D(DBF_FOLDER, "scan process aborted by user");
+
+          // let the threads finish their current chunk and stop then
+          ObtainSemaphore(&scan->lock);
+          scan->aborted = TRUE;
+          ReleaseSemaphore(&scan->lock);
+
+          result = FALSE;
+        }
+
+        // handle the possibly received methods and messages of the threads
+        CheckMethodStack();
+        HandleThreads(TRUE);
+
+        // give the GUI the chance to refresh
+        DoMethod(G->App, MUIM_Application_InputBuffered);
+
+        Delay(1);
+      }
+    }
+    while(finished == FALSE);
+
+    // return the threads to the idle list
+    HandleThreads(TRUE);
+  }
+
+  if(scan->aborted == TRUE)
+    result = FALSE;
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// MA_AddScannedMail
+//  Adds a mail found by a folder scan to the temporary folder
+static void MA_AddScannedMail(struct Folder *folder, struct Folder *tempFolder, struct Mail *newMail)
+{
+  ENTER();
+
+  // add the mail to the temporary folder
+  AddMailToFolderSimple(newMail, tempFolder);
+
+  // the AddMailToFolderSimple() call set the mail's folder pointer to the
+  // temporary folder. But since this is a temporary one only and will be
+  // invalid after leaving this function we must set the mail's folder
+  // pointer to the correct current folder.
+  newMail->Folder = folder;
+
+  // if this new mail hasn't got a valid transDate we have to check if we
+  // have to take the fileDate as a fallback value.
+  if(newMail->transDate.Seconds == 0)
+  {
+    // only if it is _not_ a "waitforsend" and "hold" message we can take the fib_Date
+    // as the fallback
+    if(isDraftsFolder(folder) == FALSE && isOutgoingFolder(folder) == FALSE)
+    {
+      char mailfile[SIZE_PATHFILE];
+      struct DateStamp ds;
+
+      W(DBF_FOLDER, "no transfer date information found in mail file, using file date...");
+
+      GetMailFile(mailfile, sizeof(mailfile), NULL, newMail);
+      // obtain the datestamp information from  and as a fallback we take the date of the mail file
+      if(ObtainFileInfo(mailfile, FI_DATE, &ds) == TRUE)
+      {
+        // now convert the local TZ fib_Date to a UTC transDate
+        DateStamp2TimeVal(&ds, &newMail->transDate, TZC_LOCAL2UTC);
+      }
+
+      // then we update the mailfilename
+      MA_UpdateMailFile(newMail);
+    }
+  }
+
+  LEAVE();
+}
+
 ///
 /// MA_ScanMailBox
-//  Scans for message files in a folder directory
+//  Scans for message files in a folder directory. The directory is read and
+//  cleaned up on the main thread first, then the mail files are examined by
+//  several threads in parallel and finally the results are merged in the
+//  original directory order.
 static BOOL MA_ScanMailBox(struct Folder *folder)
 {
   long filecount;
@@ -3054,6 +4212,7 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
       struct MA_GUIData *gui = &G->MA->GUI;
       struct BusyNode *busy;
       struct Folder *tempFolder;
+      struct FolderScan scan;
 
       // make sure others notice that an index scanning already
       // runs
@@ -3085,12 +4244,21 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
       busy = BusyBegin(BUSY_PROGRESS_ABORT);
       BusyText(busy, tr(MSG_BusyScanning), folder->Name);
 
+      memset(&scan, 0, sizeof(scan));
+      InitSemaphore(&scan.lock);
+      scan.folder = folder;
+
       // allocate a temporary folder structure to avoid having to lock the real folder's
       // mail list for each single mail we get from the index
       if((tempFolder = AllocFolder()) != NULL)
       {
         APTR context;
 
+        // all mails of the folder go into a pool of their own which
+        // can be freed at once when the folder is flushed again
+        tempFolder->messages->pool = CreateMailPool();
+        scan.mailPool = tempFolder->messages->pool;
+
         D(DBF_FOLDER, "Scanning folder: '%s' (path '%s', %ld files)...", folder->Name, folder->Fullpath, filecount);
 
         if((context = ObtainDirContextTags(EX_StringName, (IPTR)folder->Fullpath,
@@ -3099,7 +4267,7 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
         {
           struct ExamineData *ed;
           LONG error;
-          long processedFiles = 0;
+          ULONG maxFiles = 0;
           BOOL convertAllOld = FALSE;
           BOOL skipAllOld = FALSE;
           BOOL convertAllUnknown = FALSE;
@@ -3113,19 +4281,19 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
           // visually update this state change
           DoMethod(gui->LT_FOLDERS, MUIM_NListtree_Redraw, folder->Treenode, MUIF_NONE);
 
+          // first collect all mail files of the directory, this also takes care
+          // of converting old and unknown files, as this might need the user's
+          // attention
           while((ed = ExamineDir(context)) != NULL)
           {
-            // set the gauge and check the stopButton status as well.
-            if(BusyProgress(busy, ++processedFiles, filecount) == FALSE)
+            // check the stopButton status
+            if(BusyProgress(busy, 0, filecount) == FALSE)
             {
               D(DBF_FOLDER, "scan process aborted by user");
               result = FALSE;
               break;
             }
 
-            // give the GUI the chance to refresh
-            DoMethod(G->App,MUIM_Application_InputBuffered);
-
             // then check whether this is a file as we don't care for subdirectories
             if(EXD_IS_FILE(ed))
             {
@@ -3280,11 +4448,66 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
               // check the filesize of the mail file
               if(ed->FileSize > 0)
               {
-                struct ExtendedMail *email;
+                // make room for more files, the directory might have grown
+                // since we counted the files
+                if(scan.numFiles == maxFiles)
+                {
+                  struct FolderScanFile *newFiles;
+
+                  maxFiles = MAX(scan.numFiles * 2, (ULONG)filecount);
+
+                  if((newFiles = realloc(scan.files, maxFiles * sizeof(*newFiles))) == NULL)
+                  {
+                    E(DBF_FOLDER, "couldn't allocate memory for %ld mail files", maxFiles);
+                    result = FALSE;
+                    break;
+                  }
+
+                  scan.files = newFiles;
+                }
+
+                scan.files[scan.numFiles].mail = NULL;
+                strlcpy(scan.files[scan.numFiles].name, fname, sizeof(scan.files[scan.numFiles].name));
+                scan.numFiles++;
+              }
+              else
+              {
+                char path[SIZE_PATHFILE+1];
+
+                AddPath(path, folder->Fullpath, fname, sizeof(path));
+                DeleteFile(path);
+
+                W(DBF_FOLDER, "found empty file '%s' in mail folder and deleted it", path);
+              }
+            }
+          }
+
+          error = IoErr();
+          if(error != 0 && error != ERROR_NO_MORE_ENTRIES)
+            E(DBF_FOLDER, "ExamineDir() failed, error %ld", error);
+
+          ReleaseDirContext(context);
+
+          // now let the threads examine all collected mail files
+          if(result == TRUE && scan.numFiles > 0)
+            result = MA_ExamineFolderFiles(&scan, busy);
 
-                D(DBF_FOLDER, "examining mail file '%s'", fname);
+          // finally add the mails to the temporary folder in directory order
+          if(result == TRUE)
+          {
+            ULONG i;
+
+            for(i = 0; i < scan.numFiles; i++)
+            {
+              struct FolderScanFile *file = &scan.files[i];
+
+              if(file->mail == NULL)
+              {
+                struct ExtendedMail *email;
 
-                while((email = MA_ExamineMail(folder, fname, FALSE)) == NULL &&
+                // the file could not be examined, so we give it another
+                // try and ask the user how to proceed with it
+                while((email = MA_ExamineMail(folder, file->name, FALSE)) == NULL &&
                       ignoreInvalids == FALSE)
                 {
                   // if the MA_ExamineMail() operation failed we
@@ -3295,7 +4518,7 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
                                        tr(MSG_MA_INVALIDMFILE_TITLE),
                                        tr(MSG_MA_INVALIDMFILE_BT),
                                        tr(MSG_MA_INVALIDMFILE),
-                                       fname, folder->Name);
+                                       file->name, folder->Name);
 
                   if(res == 0) // cancel/ESC
                   {
@@ -3315,7 +4538,7 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
                   {
                     char path[SIZE_PATHFILE+1];
 
-                    AddPath(path, folder->Fullpath, fname, sizeof(path));
+                    AddPath(path, folder->Fullpath, file->name, sizeof(path));
                     DeleteFile(path);
 
                     break;
@@ -3324,66 +4547,22 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
 
                 if(email != NULL)
                 {
-                  struct Mail *newMail;
-
-                  if((newMail = CloneMail(&email->Mail)) != NULL)
-                  {
-                    // add the mail to the temporary folder
-                    AddMailToFolderSimple(newMail, tempFolder);
-
-                    // the AddMailToFolderSimple() call set the mail's folder pointer to the
-                    // temporary folder. But since this is a temporary one only and will be
-                    // invalid after leaving this function we must set the mail's folder
-                    // pointer to the correct current folder.
-                    newMail->Folder = folder;
-
-                    // if this new mail hasn't got a valid transDate we have to check if we
-                    // have to take the fileDate as a fallback value.
-                    if(newMail->transDate.Seconds == 0)
-                    {
-                      // only if it is _not_ a "waitforsend" and "hold" message we can take the fib_Date
-                      // as the fallback
-                      if(isDraftsFolder(folder) == FALSE && isOutgoingFolder(folder) == FALSE)
-                      {
-                        char mailfile[SIZE_PATHFILE];
-                        struct DateStamp ds;
-
-                        W(DBF_FOLDER, "no transfer date information found in mail file, using file date...");
-
-                        GetMailFile(mailfile, sizeof(mailfile), NULL, newMail);
-                        // obtain the datestamp information from  and as a fallback we take the date of the mail file
-                        if(ObtainFileInfo(mailfile, FI_DATE, &ds) == TRUE)
-                        {
-                          // now convert the local TZ fib_Date to a UTC transDate
-                          DateStamp2TimeVal(&ds, &newMail->transDate, TZC_LOCAL2UTC);
-                        }
-
-                        // then we update the mailfilename
-                        MA_UpdateMailFile(newMail);
-                      }
-                    }
-                  }
-
+                  file->mail = CloneMailToPool(&email->Mail, scan.mailPool);
                   MA_FreeEMailStruct(email);
                 }
-              }
-              else
-              {
-                char path[SIZE_PATHFILE+1];
 
-                AddPath(path, folder->Fullpath, fname, sizeof(path));
-                DeleteFile(path);
+                if(result == FALSE)
+                  break;
+              }
 
-                W(DBF_FOLDER, "found empty file '%s' in mail folder and deleted it", path);
+              if(file->mail != NULL)
+              {
+                MA_AddScannedMail(folder, tempFolder, file->mail);
+                // the mail belongs to the temporary folder now
+                file->mail = NULL;
               }
             }
           }
-
-          error = IoErr();
-          if(error != 0 && error != ERROR_NO_MORE_ENTRIES)
-            E(DBF_FOLDER, "ExamineDir() failed, error %ld", error);
-
-          ReleaseDirContext(context);
         }
         else
         {
@@ -3400,6 +4579,20 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
         FreeFolder(tempFolder);
       }
 
+      // free all mails which didn't make it into the folder
+      if(scan.files != NULL)
+      {
+        ULONG i;
+
+        for(i = 0; i < scan.numFiles; i++)
+        {
+          if(scan.files[i].mail != NULL)
+            FreeMail(scan.files[i].mail);
+        }
+
+        free(scan.files);
+      }
+
       D(DBF_FOLDER, "scanning finished %s", result ? "successfully" : "unsuccessfully");
 
       BusyEnd(busy);
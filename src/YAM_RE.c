@@ -70,6 +70,7 @@
 #include "mime/base64.h"
 #include "mime/qprintable.h"
 #include "mime/uucode.h"
+#include "mime/mimestream.h"
 #include "tcp/Connection.h"
 #include "tcp/smtp.h"
 
@@ -98,6 +99,10 @@
 /* local defines */
 enum SMsgType { SMT_NORMAL=0, SMT_MDN, SMT_SIGNED, SMT_ENCRYPTED };
 
+// message parts up to this size are kept in memory, larger ones are
+// moved to a temporary file
+#define PART_MEMORY_LIMIT (512*1024)
+
 /* local protos */
 static BOOL RE_HandleMDNReport(const struct Part *frp);
 
@@ -761,6 +766,7 @@ void RE_SaveAll(struct ReadMailData *rmData, const char *path)
 
           AddPath(dest, path, fname, size);
 
+          RE_FlushPart(part);
           RE_Export(rmData, part->Filename, dest, part->Name, part->Nr, FALSE, FALSE, part->ContentType);
         }
       }
@@ -1074,6 +1080,11 @@ static void RE_ParseContentParameters(char *str, struct Part *rp, enum parameter
     char *next = ++p;
     char *attribute;
     char *value;
+    // the charsets of RFC 2231 parameters split into several sections,
+    // these must not be static as mails are parsed by several threads
+    struct codeset *nameCodeset = NULL;
+    struct codeset *descCodeset = NULL;
+    struct codeset *fileNameCodeset = NULL;
 
     // now we walk through our string by extracting each
     // content parameter/value combo in a while loop.
@@ -1095,8 +1106,6 @@ static void RE_ParseContentParameters(char *str, struct Part *rp, enum parameter
               // an asterisk sign (see: RFC 2231)
               if(attribute[4] == '*')
               {
-                static struct codeset *nameCodeset = NULL;
-
                 rfc2231_decode(&attribute[5], value, &rp->CParName, &nameCodeset);
               }
               else
@@ -1117,8 +1126,6 @@ static void RE_ParseContentParameters(char *str, struct Part *rp, enum parameter
               // an asterisk sign (see: RFC 2231)
               if(attribute[11] == '*')
               {
-                static struct codeset *descCodeset = NULL;
-
                 rfc2231_decode(&attribute[12], value, &rp->CParDesc, &descCodeset);
               }
               else
@@ -1166,7 +1173,6 @@ static void RE_ParseContentParameters(char *str, struct Part *rp, enum parameter
               // an asterisk sign (see: RFC 2231)
               if(attribute[8] == '*')
               {
-                static struct codeset *fileNameCodeset = NULL;
                 rfc2231_decode(&attribute[9], value, &rp->CParFileName, &fileNameCodeset);
               }
               else
@@ -1211,7 +1217,7 @@ static void RE_ParseContentParameters(char *str, struct Part *rp, enum parameter
 ///
 /// RE_ScanHeader
 //  Parses the header of the message or of a message part
-static BOOL RE_ScanHeader(struct Part *rp, FILE *in, FILE *out, enum ReadHeaderMode mode)
+static BOOL RE_ScanHeader(struct Part *rp, FILE *in, struct MimeStream *out, enum ReadHeaderMode mode)
 {
   struct HeaderNode *hdrNode;
   BOOL quietParsing = isAnyFlagSet(rp->rmData->parseFlags, PM_QUIET);
@@ -1259,9 +1265,14 @@ static BOOL RE_ScanHeader(struct Part *rp, FILE *in, FILE *out, enum ReadHeaderM
     char *field = hdrNode->name;
     char *value = hdrNode->content;
 
-    // if we have a fileoutput pointer lets write out the header immediatly
+    // if we have an output stream lets write out the header immediatly
     if(out != NULL)
-      fprintf(out, "%s: %s\n", field, value);
+    {
+      mimestream_write(out, field, strlen(field));
+      mimestream_write(out, ": ", 2);
+      mimestream_write(out, value, strlen(value));
+      mimestream_write(out, "\n", 1);
+    }
 
     if(stricmp(field, "content-type") == 0)
     {
@@ -1392,11 +1403,101 @@ static BOOL RE_ScanHeader(struct Part *rp, FILE *in, FILE *out, enum ReadHeaderM
   return TRUE;
 }
 ///
+/// RE_WritePartData
+//  Writes the text of a message part to the output stream and converts it
+//  to UTF-8 if a srcCodeset has been supplied or could be detected
+static BOOL RE_WritePartData(struct MimeStream *out, const char *data, size_t len, const struct codeset *srcCodeset,
+                             const BOOL skipCodesets, const BOOL allowAutoDetect)
+{
+  BOOL result = TRUE;
+  char *dststr = NULL;
+  size_t dstlen = 0;
+  BOOL codesetConverted = FALSE;
+
+  ENTER();
+
+  if(skipCodesets == FALSE)
+  {
+    // in case the user wants us to detect the correct codeset we do it now
+    if(allowAutoDetect == TRUE)
+    {
+      if(srcCodeset == NULL ||
+         (C->DetectCyrillic == TRUE && srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
+      {
+        struct codeset *cs = CodesetsFindBest(CSA_Source,            data,
+                                              CSA_SourceLen,         len,
+                                              CSA_CodesetFamily,     C->DetectCyrillic == TRUE ? CSV_CodesetFamily_Cyrillic : CSV_CodesetFamily_Latin,
+                                              CSA_FallbackToDefault, FALSE,
+                                              TAG_DONE);
+
+        if(cs != NULL && cs != srcCodeset)
+        {
+          D(DBF_MAIL, "Detected [%s] codeset using CodesetsFindBest()", cs->name);
+          srcCodeset = cs;
+        }
+        else
+          W(DBF_MAIL, "Couldn't autodetect codeset for supplied src text");
+      }
+    }
+
+    // if this function was invoked with a source Codeset we have to make sure
+    // we convert from the supplied source Codeset to our current local codeset with
+    // help of the functions codesets.library provides.
+    if(srcCodeset != NULL && srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
+    {
+      ULONG utf8len = 0;
+
+      // convert from the srcCodeset to UTF8
+      UTF8 *utf8str = CodesetsUTF8Create(CSA_Source,          data,
+                                         CSA_SourceLen,       len,
+                                         CSA_SourceCodeset,   srcCodeset,
+                                         CSA_DestLenPtr,      &utf8len,
+                                         TAG_DONE);
+
+      // check if operations succeeded
+      if(utf8str != NULL && utf8len > 0)
+      {
+        dststr = (char *)utf8str;
+        dstlen = utf8len;
+
+        // signal that the destination string had
+        // been converted
+        codesetConverted = TRUE;
+      }
+      else
+        W(DBF_MAIL, "couldn't convert dstr with CodesetsUTF8Create(): %08lx %ld", data, len);
+    }
+    else
+      D(DBF_MAIL, "srcCodeset is [%s], no codeset conversion performed/necessary", srcCodeset == NULL ? "<NULL>" : srcCodeset->name);
+  }
+
+  // make sure we fallback to the unconverted data
+  if(codesetConverted == FALSE)
+  {
+    dststr = (char *)data;
+    dstlen = len;
+  }
+
+  // now write back exactly the same amount of bytes we read previously
+  if(mimestream_write(out, dststr, dstlen) == 0)
+  {
+    E(DBF_MAIL, "error during write operation!");
+    result = FALSE;
+  }
+
+  // free the codesets converted string
+  if(codesetConverted == TRUE)
+    CodesetsFreeA(dststr, NULL);
+
+  RETURN(result);
+  return result;
+}
+///
 /// RE_ConsumeRestOfPart
 //  Processes body of a message part and takes care to convert the text
 //  to UTF-8 if a srcCodeset has been supplied and the encoding of the part is
 //  either 7bit or 8bit which should signal that it is actually readable text
-static BOOL RE_ConsumeRestOfPart(FILE *ifh, FILE *ofh, const struct codeset *srcCodeset,
+static BOOL RE_ConsumeRestOfPart(FILE *ifh, struct MimeStream *ofh, const struct codeset *srcCodeset,
                                  const struct Part *rp, const BOOL allowAutoDetect)
 {
   BOOL result = FALSE;
@@ -1590,87 +1691,68 @@ static BOOL RE_ConsumeRestOfPart(FILE *ifh, FILE *ofh, const struct codeset *src
 
     // now that we have the whole text in dstr we can check if we need to convert it to
     // a different codeset or write it out right away.
-    if(ofh != NULL)
-    {
-      char *dststr = NULL;
-      size_t dstlen = 0;
-      BOOL codesetConverted = FALSE;
-
-      if(skipCodesets == FALSE)
-      {
-        // in case the user wants us to detect the correct codeset we do it now
-        if(allowAutoDetect == TRUE)
-        {
-          if(srcCodeset == NULL ||
-             (C->DetectCyrillic == TRUE && srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
-          {
-            struct codeset *cs = CodesetsFindBest(CSA_Source,            dstr,
-                                                  CSA_SourceLen,         dstrlen(dstr),
-                                                  CSA_CodesetFamily,     C->DetectCyrillic == TRUE ? CSV_CodesetFamily_Cyrillic : CSV_CodesetFamily_Latin,
-                                                  CSA_FallbackToDefault, FALSE,
-                                                  TAG_DONE);
+    if(ofh != NULL && RE_WritePartData(ofh, dstr, dstrlen(dstr), srcCodeset, skipCodesets, allowAutoDetect) == FALSE)
+      result = FALSE;
 
-            if(cs != NULL && cs != srcCodeset)
-            {
-              D(DBF_MAIL, "Detected [%s] codeset using CodesetsFindBest()", cs->name);
-              srcCodeset = cs;
-            }
-            else
-              W(DBF_MAIL, "Couldn't autodetect codeset for supplied src text");
-          }
-        }
+    // free the dynamic string
+    dstrfree(dstr);
+  }
 
-        // if this function was invoked with a source Codeset we have to make sure
-        // we convert from the supplied source Codeset to our current local codeset with
-        // help of the functions codesets.library provides.
-        if(srcCodeset != NULL && srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
-        {
-          ULONG utf8len = 0;
+  RETURN(result);
+  return result;
+}
+///
+/// RE_ConsumeRestOfStream
+//  Processes the remaining body of a part which isn't encoded, this
+//  behaves exactly like RE_ConsumeRestOfPart() for data kept in memory
+static BOOL RE_ConsumeRestOfStream(struct MimeStream *in, struct MimeStream *out, const struct codeset *srcCodeset)
+{
+  BOOL result;
 
-          // convert from the srcCodeset to UTF8
-          UTF8 *utf8str = CodesetsUTF8Create(CSA_Source,          dstr,
-                                             CSA_SourceLen,       dstrlen(dstr),
-                                             CSA_SourceCodeset,   srcCodeset,
-                                             CSA_DestLenPtr,      &utf8len,
-                                             TAG_DONE);
+  ENTER();
 
-          // check if operations succeeded
-          if(utf8str != NULL && utf8len > 0)
-          {
-            dststr = (char *)utf8str;
-            dstlen = utf8len;
+  if(in->fh != NULL)
+    result = RE_ConsumeRestOfPart(in->fh, out, srcCodeset, NULL, TRUE);
+  else
+  {
+    char *dstr = NULL;
+    int numLines = 0;
 
-            // signal that the destination string had
-            // been converted
-            codesetConverted = TRUE;
-          }
-          else
-            W(DBF_MAIL, "couldn't convert dstr with CodesetsUTF8Create(): %08lx %ld", dstr, dstrlen(dstr));
-        }
-        else
-          D(DBF_MAIL, "srcCodeset is [%s], no codeset conversion performed/necessary", srcCodeset == NULL ? "<NULL>" : srcCodeset->name);
-      }
+    // split the data into lines and strip the line endings like GetLine()
+    // does, this normalizes CRLF line endings and the final line feed
+    while(in->pos < in->size)
+    {
+      const char *line = &in->buffer[in->pos];
+      const char *eol;
+      size_t len = in->size - in->pos;
 
-      // make sure we fallback to dstr
-      if(codesetConverted == FALSE)
+      if((eol = memchr(line, '\n', len)) != NULL)
       {
-        dststr = dstr;
-        dstlen = dstrlen(dstr);
-      }
+        len = eol - line;
+        in->pos += len+1;
 
-      // now write back exactly the same amount of bytes we read previously
-      if(fwrite(dststr, dstlen, 1, ofh) <= 0)
-      {
-        E(DBF_MAIL, "error during write operation!");
-        result = FALSE;
+        if(len > 0 && line[len-1] == '\r')
+          len--;
       }
+      else
+        in->pos += len;
+
+      numLines++;
 
-      // free the codesets converted string
-      if(codesetConverted == TRUE)
-        CodesetsFreeA(dststr, NULL);
+      if(numLines > 1)
+        dstrcat(&dstr, "\n");
+
+      dstrncat(&dstr, line, len);
     }
 
-    // free the dynamic string
+    in->eof = TRUE;
+
+    // if we read at least one line we must add a line feed
+    if(numLines > 1)
+      dstrcat(&dstr, "\n");
+
+    result = RE_WritePartData(out, dstr, dstrlen(dstr), srcCodeset, FALSE, TRUE);
+
     dstrfree(dstr);
   }
 
@@ -1680,7 +1762,7 @@ static BOOL RE_ConsumeRestOfPart(FILE *ifh, FILE *ofh, const struct codeset *src
 ///
 /// RE_DecodeStream
 //  Decodes contents of a part
-static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
+static BOOL RE_DecodeStream(struct Part *rp, struct MimeStream *in, struct MimeStream *out)
 {
   BOOL decodeResult = FALSE;
   struct codeset *sourceCodeset = NULL;
@@ -1689,6 +1771,7 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
   BOOL isText;
 
   ENTER();
+  STARTSPAN(DBF_MIME, "decode part");
 
   // now we find out if we should decode charset aware. This means
   // that we make sure that we convert the text in "in" into our
@@ -1728,7 +1811,7 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
     // process a base64 decoding.
     case ENC_B64:
     {
-      long decoded = base64decode_file(in, out, sourceCodeset, isText, isPrintable(rp));
+      long decoded = base64decode_stream(in, out, sourceCodeset, isText, isPrintable(rp));
       D(DBF_MAIL, "base64 decoded %ld bytes of part %ld.", decoded, rp->Nr);
 
       if(decoded > 0)
@@ -1767,7 +1850,7 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
     // process a Quoted-Printable decoding
     case ENC_QP:
     {
-      long decoded = qpdecode_file(in, out, sourceCodeset, isText);
+      long decoded = qpdecode_stream(in, out, sourceCodeset, isText);
       D(DBF_MAIL, "quoted-printable decoded %ld chars of part %ld.", decoded, rp->Nr);
 
       if(decoded >= 0)
@@ -1826,7 +1909,7 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
     // process UU-Encoded decoding
     case ENC_UUE:
     {
-      long decoded = uudecode_file(in, out, sourceCodeset, isText);
+      long decoded = uudecode_stream(in, out, sourceCodeset, isText);
       D(DBF_MAIL, "UU decoded %ld chars of part %ld.", decoded, rp->Nr);
 
       if(decoded >= 0)
@@ -1893,24 +1976,28 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
 
     default:
     {
-      if(RE_ConsumeRestOfPart(in, out, sourceCodeset, NULL, TRUE))
+      if(RE_ConsumeRestOfStream(in, out, sourceCodeset))
         decodeResult = TRUE;
     }
     break;
   }
 
+  STOPSPAN(DBF_MIME);
   RETURN(decodeResult);
   return decodeResult;
 }
 ///
 /// RE_OpenNewPart
-//  Adds a new entry to the message part list
-static FILE *RE_OpenNewPart(struct ReadMailData *rmData,
-                            struct Part **new,
-                            struct Part *prev,
-                            struct Part *first)
+//  Adds a new entry to the message part list and prepares the output stream
+//  for its contents. These are kept in memory unless they grow larger than
+//  PART_MEMORY_LIMIT in which case they are moved to the part's file.
+static BOOL RE_OpenNewPart(struct ReadMailData *rmData,
+                           struct MimeStream *out,
+                           struct Part **new,
+                           struct Part *prev,
+                           struct Part *first)
 {
-  FILE *fp = NULL;
+  BOOL result = FALSE;
   struct Part *newPart;
 
   ENTER();
@@ -1968,24 +2055,43 @@ static FILE *RE_OpenNewPart(struct ReadMailData *rmData,
     D(DBF_MAIL, "  Parentptr..: %08lx",  newPart->Parent);
     D(DBF_MAIL, "  MainAltPart: %08lx",  newPart->MainAltPart);
 
-    if((fp = fopen(newPart->Filename, "w")) != NULL)
-    {
-      setvbuf(fp, NULL, _IOFBF, SIZE_FILEBUF);
-    }
-    else
-    {
-      // opening the file failed, so we return failure
-      free(newPart);
-      newPart = NULL;
-    }
+    mimestream_spill(out, PART_MEMORY_LIMIT, newPart->Filename);
+    result = TRUE;
   }
 
   *new = newPart;
   if(newPart == NULL)
     E(DBF_MAIL, "Error: Couldn't create a new Part!");
 
-  RETURN(fp);
-  return fp;
+  RETURN(result);
+  return result;
+}
+///
+/// RE_ClosePart
+//  Finishes the output stream of a part. If the contents were not moved
+//  to the part's file they stay in memory.
+static BOOL RE_ClosePart(struct Part *rp, struct MimeStream *out)
+{
+  BOOL inMemory = (out->fh == NULL);
+  BOOL result;
+
+  ENTER();
+
+  result = mimestream_close(out);
+
+  if(inMemory == TRUE)
+  {
+    rp->Data = out->buffer;
+    rp->DataSize = out->size;
+    setFlag(rp->Flags, PFLAG_INMEMORY);
+
+    D(DBF_MAIL, "keeping %ld bytes of part #%ld in memory", rp->DataSize, rp->Nr);
+  }
+  else
+    clearFlag(rp->Flags, PFLAG_INMEMORY);
+
+  RETURN(result);
+  return result;
 }
 ///
 /// RE_UndoPart
@@ -1998,8 +2104,12 @@ static void RE_UndoPart(struct Part *rp)
 
   D(DBF_MAIL, "Undoing part #%ld [%08lx]", rp->Nr, rp);
 
-  // lets delete the file first so that we can cleanly "undo" the part
-  DeleteFile(rp->Filename);
+  // lets delete the file or the memory contents first so that we can
+  // cleanly "undo" the part
+  if(isInMemory(rp) == TRUE)
+    free(rp->Data);
+  else
+    DeleteFile(rp->Filename);
 
   // we only iterate through our partlist if there is
   // a next item, if not we can simply relink it
@@ -2019,7 +2129,8 @@ static void RE_UndoPart(struct Part *rp)
       trp->Nr--;
 
       // Now we also have to rename the temporary filename also
-      Rename(trp->Filename, trp->Prev->Filename);
+      if(isInMemory(trp) == FALSE)
+        Rename(trp->Filename, trp->Prev->Filename);
 
     }
     while(trp->Next != NULL);
@@ -2165,17 +2276,51 @@ static BOOL RE_SaveThisPart(struct Part *rp)
   return result;
 }
 ///
+/// RE_PartComment
+//  Returns the file comment describing a message part
+static const char *RE_PartComment(const struct Part *rp)
+{
+  const char *comment;
+
+  ENTER();
+
+  if(rp->Nr >= PART_LETTER && rp->Nr == rp->rmData->letterPartNum)
+  {
+    comment = tr(MSG_RE_Letter);
+  }
+  else if(rp->Nr == PART_RAW)
+  {
+    comment = tr(MSG_RE_Header);
+  }
+  else
+  {
+    // if this is not a printable LETTER part or a RAW part we
+    // write another comment
+    if(rp->Description[0] != '\0')
+      comment = rp->Description;
+    else if(rp->Name[0] != '\0')
+      comment = rp->Name;
+    else
+      comment = rp->ContentType;
+  }
+
+  RETURN(comment);
+  return comment;
+}
+///
 /// RE_SetPartInfo
 //  Determines size and other information of a message part
 static void RE_SetPartInfo(struct Part *rp)
 {
   LONG size;
-  const char *comment;
 
   ENTER();
 
-  // get the part's filesize
-  ObtainFileInfo(rp->Filename, FI_SIZE, &size);
+  // get the part's size
+  if(isInMemory(rp) == TRUE)
+    size = rp->DataSize;
+  else
+    ObtainFileInfo(rp->Filename, FI_SIZE, &size);
 
   // let's calculate the partsize of an undecoded part, if this
   // part isn't the RAW part and we found a positive size.
@@ -2255,26 +2400,11 @@ static void RE_SetPartInfo(struct Part *rp)
     D(DBF_MAIL, "setting part #%ld as LETTERPART", rp->Nr);
 
     rp->rmData->letterPartNum = rp->Nr;
-
-    comment = tr(MSG_RE_Letter);
-  }
-  else if(rp->Nr == PART_RAW)
-  {
-    comment = tr(MSG_RE_Header);
-  }
-  else
-  {
-    // if this is not a printable LETTER part or a RAW part we
-    // write another comment
-    if(rp->Description[0] != '\0')
-      comment = rp->Description;
-    else if(rp->Name[0] != '\0')
-      comment = rp->Name;
-    else
-      comment = rp->ContentType;
   }
 
-  SetComment(rp->Filename, comment);
+  // parts kept in memory get their comment as soon as they are flushed
+  if(isInMemory(rp) == FALSE)
+    SetComment(rp->Filename, RE_PartComment(rp));
 
   LEAVE();
 }
@@ -2298,17 +2428,16 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
 
   if(in != NULL)
   {
-    FILE *out = NULL;
+    struct MimeStream out;
     struct Part *rp;
 
     if(hrp == NULL)
     {
-      if((out = RE_OpenNewPart(rmData, &hrp, NULL, NULL)) != NULL)
+      if(RE_OpenNewPart(rmData, &out, &hrp, NULL, NULL) == TRUE)
       {
-        BOOL parse_ok = RE_ScanHeader(hrp, in, out, RHM_MAINHEADER);
+        BOOL parse_ok = RE_ScanHeader(hrp, in, &out, RHM_MAINHEADER);
 
-        fclose(out);
-        out = NULL;
+        RE_ClosePart(hrp, &out);
 
         if(parse_ok == TRUE)
           RE_SetPartInfo(hrp);
@@ -2334,23 +2463,19 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
         {
           struct Part *prev = rp;
 
-          out = RE_OpenNewPart(rmData, &rp, prev, hrp);
-          if(out == NULL)
+          if(RE_OpenNewPart(rmData, &out, &rp, prev, hrp) == FALSE)
             break;
 
-          if(RE_ScanHeader(rp, in, out, RHM_SUBHEADER) == FALSE)
+          if(RE_ScanHeader(rp, in, &out, RHM_SUBHEADER) == FALSE)
           {
-            fclose(out);
-            out = NULL;
-
+            RE_ClosePart(rp, &out);
             RE_UndoPart(rp);
             break;
           }
 
           if(strnicmp(rp->ContentType, "multipart", 9) == 0)
           {
-            fclose(out);
-            out = NULL;
+            RE_ClosePart(rp, &out);
 
             if(RE_ParseMessage(rmData, in, NULL, rp) != NULL)
             {
@@ -2365,35 +2490,31 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
           }
           else if(RE_SaveThisPart(rp) == TRUE || RE_RequiresSpecialHandling(hrp) == SMT_ENCRYPTED)
           {
-            fputc('\n', out);
-            done = RE_ConsumeRestOfPart(in, out, NULL, rp, FALSE);
-            fclose(out);
-            out = NULL;
+            mimestream_write(&out, "\n", 1);
+            done = RE_ConsumeRestOfPart(in, &out, NULL, rp, FALSE);
+            RE_ClosePart(rp, &out);
             RE_SetPartInfo(rp);
           }
           else
           {
-            fclose(out);
-            out = NULL;
+            RE_ClosePart(rp, &out);
             done = RE_ConsumeRestOfPart(in, NULL, NULL, rp, FALSE);
             RE_UndoPart(rp);
             rp = prev;
           }
         }
       }
-      else if((out = RE_OpenNewPart(rmData, &rp, hrp, hrp)) != NULL)
+      else if(RE_OpenNewPart(rmData, &out, &rp, hrp, hrp) == TRUE)
       {
         if(RE_SaveThisPart(rp) == TRUE || RE_RequiresSpecialHandling(hrp) == SMT_ENCRYPTED)
         {
-          RE_ConsumeRestOfPart(in, out, NULL, NULL, FALSE);
-          fclose(out);
-          out = NULL;
+          RE_ConsumeRestOfPart(in, &out, NULL, NULL, FALSE);
+          RE_ClosePart(rp, &out);
           RE_SetPartInfo(rp);
         }
         else
         {
-          fclose(out);
-          out = NULL;
+          RE_ClosePart(rp, &out);
           RE_UndoPart(rp);
           RE_ConsumeRestOfPart(in, NULL, NULL, NULL, FALSE);
         }
@@ -2402,9 +2523,6 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
 
     if(fname != NULL && in != NULL)
       fclose(in);
-
-    if(out != NULL)
-      fclose(out);
   }
 
   #if defined(DEBUG)
@@ -2458,8 +2576,9 @@ BOOL RE_DecodePart(struct Part *rp)
   // the data wasn't decoded before.
   if(isDecoded(rp) == FALSE)
   {
-    FILE *in;
-    FILE *out;
+    FILE *in = NULL;
+    struct MimeStream inStream;
+    struct MimeStream outStream;
     char filepath[SIZE_PATHFILE];
     char file[SIZE_FILE];
     char ext[SIZE_FILE];
@@ -2467,7 +2586,44 @@ BOOL RE_DecodePart(struct Part *rp)
     // start with an empty extension string
     ext[0] = '\0';
 
-    if((in = fopen(rp->Filename, "r")) != NULL)
+    if(isInMemory(rp) == TRUE)
+    {
+      mimestream_memory(&inStream, rp->Data, rp->DataSize);
+
+      // if this part has some headers, let's skip them so that
+      // we just decode the raw data.
+      if(hasSubHeaders(rp) == TRUE)
+      {
+        const char *end = &rp->Data[rp->DataSize];
+        const char *line = rp->Data;
+        BOOL bodyFound = FALSE;
+
+        // search for an empty line which signals the start of the body
+        while(line < end && bodyFound == FALSE)
+        {
+          const char *eol;
+
+          if((eol = memchr(line, '\n', end-line)) == NULL)
+            break;
+
+          if(eol == line || (eol == line+1 && line[0] == '\r'))
+            bodyFound = TRUE;
+
+          line = eol+1;
+        }
+
+        if(bodyFound == FALSE)
+        {
+          E(DBF_MAIL, "no end of PartHeader found in %ld bytes of memory", rp->DataSize);
+
+          RETURN(FALSE);
+          return FALSE;
+        }
+
+        inStream.pos = line - rp->Data;
+      }
+    }
+    else if((in = fopen(rp->Filename, "r")) != NULL)
     {
       setvbuf(in, NULL, _IOFBF, SIZE_FILEBUF);
 
@@ -2502,6 +2658,11 @@ BOOL RE_DecodePart(struct Part *rp)
         }
       }
 
+      mimestream_file(&inStream, in);
+    }
+
+    if(isInMemory(rp) == TRUE || in != NULL)
+    {
       // we try to get a proper file extension for our decoded part which we
       // in fact first try to get out of the user's MIME configuration.
       if(rp->Nr != PART_RAW)
@@ -2601,50 +2762,76 @@ BOOL RE_DecodePart(struct Part *rp)
 
       D(DBF_MAIL, "decoding '%s' to '%s'", rp->Filename, filepath);
 
-      // now open the stream and decode it afterwards.
-      if((out = fopen(filepath, "w")) != NULL)
-      {
-        BOOL decodeResult;
+      // now decode the stream, small parts are kept in memory
+      mimestream_spill(&outStream, PART_MEMORY_LIMIT, filepath);
 
-        setvbuf(out, NULL, _IOFBF, SIZE_FILEBUF);
+      if(RE_DecodeStream(rp, &inStream, &outStream) == TRUE)
+      {
+        BOOL inMemory = (outStream.fh == NULL);
 
-        // decode the stream
-        decodeResult = RE_DecodeStream(rp, in, out);
+        mimestream_close(&outStream);
 
-        // close the streams
-        fclose(out);
-        fclose(in);
+        if(in != NULL)
+          fclose(in);
 
-        // check if we were successfull in decoding the data.
-        if(decodeResult == TRUE)
-        {
-          D(DBF_MAIL, "successfully decoded file [%s] to [%s]", rp->Filename, filepath);
+        D(DBF_MAIL, "successfully decoded file [%s] to [%s]", rp->Filename, inMemory == TRUE ? "<memory>" : filepath);
 
+        // drop the undecoded data
+        if(isInMemory(rp) == TRUE)
+          free(rp->Data);
+        else
           DeleteFile(rp->Filename);
-          setFlag(rp->Flags, PFLAG_DECODED);
 
-          strlcpy(rp->Filename, filepath, sizeof(rp->Filename));
-          RE_SetPartInfo(rp);
+        if(inMemory == TRUE)
+        {
+          rp->Data = outStream.buffer;
+          rp->DataSize = outStream.size;
+          setFlag(rp->Flags, PFLAG_INMEMORY);
         }
         else
         {
-          E(DBF_MAIL, "error during RE_DecodeStream()");
-          DeleteFile(filepath); // delete the temporary file again.
+          rp->Data = NULL;
+          rp->DataSize = 0;
+          clearFlag(rp->Flags, PFLAG_INMEMORY);
         }
-      }
-      else if((out = fopen(filepath, "r")) != NULL)
-      {
-        // if we couldn't open that file for writing we check if it exists
-        // and if so we use it because it is locked actually and already decoded
-        fclose(out);
-        fclose(in);
-        DeleteFile(rp->Filename);
-        strlcpy(rp->Filename, filepath, sizeof(rp->Filename));
+
         setFlag(rp->Flags, PFLAG_DECODED);
+
+        strlcpy(rp->Filename, filepath, sizeof(rp->Filename));
         RE_SetPartInfo(rp);
       }
       else
-        fclose(in);
+      {
+        BOOL spillFailed = (outStream.fh == NULL && outStream.error == TRUE);
+
+        E(DBF_MAIL, "error during RE_DecodeStream()");
+
+        mimestream_close(&outStream);
+        free(outStream.buffer);
+
+        if(in != NULL)
+          fclose(in);
+
+        if(spillFailed == TRUE && FileExists(filepath) == TRUE)
+        {
+          // if we couldn't open that file for writing we check if it exists
+          // and if so we use it because it is locked actually and already decoded
+          if(isInMemory(rp) == TRUE)
+            free(rp->Data);
+          else
+            DeleteFile(rp->Filename);
+
+          rp->Data = NULL;
+          rp->DataSize = 0;
+          clearFlag(rp->Flags, PFLAG_INMEMORY);
+
+          strlcpy(rp->Filename, filepath, sizeof(rp->Filename));
+          setFlag(rp->Flags, PFLAG_DECODED);
+          RE_SetPartInfo(rp);
+        }
+        else
+          DeleteFile(filepath); // delete the temporary file again.
+      }
     }
   }
 
@@ -2652,6 +2839,53 @@ BOOL RE_DecodePart(struct Part *rp)
   return isDecoded(rp);
 }
 
+///
+/// RE_FlushPart
+//  Writes the contents of a part kept in memory to its file, this must be
+//  done before the file of a part is passed to anyone else
+BOOL RE_FlushPart(struct Part *rp)
+{
+  BOOL result = TRUE;
+
+  ENTER();
+
+  if(isInMemory(rp) == TRUE)
+  {
+    FILE *fh;
+
+    D(DBF_MAIL, "flushing %ld bytes of part #%ld to '%s'", rp->DataSize, rp->Nr, rp->Filename);
+
+    if((fh = fopen(rp->Filename, "w")) != NULL)
+    {
+      if(rp->DataSize > 0 && fwrite(rp->Data, rp->DataSize, 1, fh) != 1)
+        result = FALSE;
+
+      if(fclose(fh) != 0)
+        result = FALSE;
+
+      if(result == TRUE)
+      {
+        free(rp->Data);
+        rp->Data = NULL;
+        rp->DataSize = 0;
+        clearFlag(rp->Flags, PFLAG_INMEMORY);
+
+        SetComment(rp->Filename, RE_PartComment(rp));
+      }
+      else
+        DeleteFile(rp->Filename);
+    }
+    else
+      result = FALSE;
+
+    if(result == FALSE)
+      E(DBF_MAIL, "couldn't flush part #%ld to '%s'", rp->Nr, rp->Filename);
+  }
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// RE_HandleSignedMessage
 //  Handles a PGP signed message, checks validity of signature
@@ -2760,6 +2994,10 @@ static void RE_HandleEncryptedMessage(struct Part *frp)
   {
     struct TempFile *tf;
 
+    // both parts are handled as files below
+    RE_FlushPart(warnPart);
+    RE_FlushPart(encrPart);
+
     if((tf = OpenTempFile("w")) != NULL)
     {
       // first we copy our encrypted part because the DecryptPGP()
@@ -2953,7 +3191,10 @@ BOOL RE_LoadMessage(struct ReadMailData *rmData)
 
         D(DBF_MAIL, "renaming '%s' to '%s'", part->Filename, tmpFile);
 
-        RenameFile(part->Filename, tmpFile);
+        // parts kept in memory don't have a file yet
+        if(isInMemory(part) == FALSE)
+          RenameFile(part->Filename, tmpFile);
+
         strlcpy(part->Filename, tmpFile, sizeof(part->Filename));
       }
     }
@@ -3160,15 +3401,16 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
       // to parse anything at all.
       if(dodisp == TRUE && part->Size > 0)
       {
-        FILE *fh;
+        FILE *fh = NULL;
 
-        D(DBF_MAIL, "  adding text of [%s] to display", part->Filename);
+        D(DBF_MAIL, "  adding text of [%s] to display", isInMemory(part) == TRUE ? "<memory>" : part->Filename);
 
-        if((fh = fopen(part->Filename, "r")) != NULL)
+        if(isInMemory(part) == TRUE || (fh = fopen(part->Filename, "r")) != NULL)
         {
           char *msg;
 
-          setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+          if(fh != NULL)
+            setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
           // allocate memory for the complete part plus a trailing NUL byte
           if((msg = dstralloc(part->Size+1)) != NULL)
@@ -3182,10 +3424,16 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
             BOOL signatureFound = FALSE;
 
             // read the part into a dynamic string
-            nread = dstrfread(&msg, part->Size, fh);
+            if(fh == NULL)
+            {
+              nread = MIN((size_t)part->Size, part->DataSize);
+              dstrncat(&msg, part->Data, nread);
+            }
+            else
+              nread = dstrfread(&msg, part->Size, fh);
 
             // lets check if an error or short item count occurred
-            if(nread == 0 || nread != part->Size)
+            if(fh != NULL && (nread == 0 || nread != part->Size))
             {
               W(DBF_MAIL, "Warning: EOF or short item count detected: feof()=%ld ferror()=%ld", feof(fh), ferror(fh));
 
@@ -3300,7 +3548,7 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
                  rptr[7] >= '0' && rptr[7] <= '7' &&
                  rptr[8] >= '0' && rptr[8] <= '7')
               {
-                FILE *outfh;
+                struct MimeStream out;
                 char *nameptr = NULL;
                 BOOL quietParsing = isAnyFlagSet(rmData->parseFlags, PM_QUIET);
 
@@ -3318,10 +3566,12 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
 
                 // then create the new part to which we will put our uudecoded
                 // data
-                if((outfh = RE_OpenNewPart(rmData, &uup, last, first)) != NULL)
+                if(RE_OpenNewPart(rmData, &out, &uup, last, first) == TRUE)
                 {
                   char *endptr = rptr+strlen(rptr)+1;
-                  long old_pos;
+                  long old_pos = -1;
+                  struct MimeStream in;
+                  BOOL positioned = FALSE;
 
                   // prepare our part META data and fake the new part as being
                   // a application/octet-stream part as we don't know if it
@@ -3334,18 +3584,34 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
                   if(nameptr)
                     strlcpy(uup->Name, nameptr, sizeof(uup->Name));
 
-                  // save the old position of our input file position so that
-                  // we can set it back later on
-                  old_pos = ftell(fh);
+                  if(fh != NULL)
+                  {
+                    // save the old position of our input file position so that
+                    // we can set it back later on
+                    old_pos = ftell(fh);
+
+                    // then let us seek to the position where we found the starting
+                    // "begin" indicator
+                    if(old_pos >= 0 &&
+                       fseek(fh, rptr-msg, SEEK_SET) == 0)
+                    {
+                      mimestream_file(&in, fh);
+                      positioned = TRUE;
+                    }
+                  }
+                  else if((size_t)(rptr-msg) < part->DataSize)
+                  {
+                    // the part is kept in memory, so we start decoding right at
+                    // the "begin" indicator
+                    mimestream_memory(&in, &part->Data[rptr-msg], part->DataSize - (rptr-msg));
+                    positioned = TRUE;
+                  }
 
-                  // then let us seek to the position where we found the starting
-                  // "begin" indicator
-                  if(old_pos >= 0 &&
-                     fseek(fh, rptr-msg, SEEK_SET) == 0)
+                  if(positioned == TRUE)
                   {
                     // now that we are on the correct position, we
                     // call the uudecoding function accordingly.
-                    long decoded = uudecode_file(fh, outfh, NULL, FALSE); // no translation table
+                    long decoded = uudecode_stream(&in, &out, NULL, FALSE); // no translation table
                     D(DBF_MAIL, "UU decoded %ld chars of part %ld.", decoded, uup->Nr);
 
                     if(decoded >= 0)
@@ -3411,10 +3677,11 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
                   }
 
                   // set back the old position to the filehandle
-                  fseek(fh, old_pos, SEEK_SET);
+                  if(fh != NULL && old_pos >= 0)
+                    fseek(fh, old_pos, SEEK_SET);
 
-                  // close our part filehandle
-                  fclose(outfh);
+                  // close our part stream
+                  RE_ClosePart(uup, &out);
 
                   // refresh the partinfo
                   RE_SetPartInfo(uup);
@@ -3637,7 +3904,8 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
             dstrfree(msg);
           }
 
-          fclose(fh);
+          if(fh != NULL)
+            fclose(fh);
         }
       }
     }
@@ -3707,6 +3975,7 @@ void RE_UpdateSenderInfo(struct ABookNode *old, struct ABookNode *new)
     if(old->Address[0] == '\0' && new->Address[0] != '\0')
     {
       strlcpy(old->Address, new->Address, sizeof(old->Address));
+      InvalidateABookIndexes(&G->abook);
       changed = TRUE;
     }
     if(old->Street[0] == '\0' && new->Street[0] != '\0')
@@ -4514,6 +4783,7 @@ static BOOL RE_HandleMDNReport(const struct Part *frp)
     {
       // decode the part
       RE_DecodePart(rp[i]);
+      RE_FlushPart(rp[i]);
 
       // open the decoded part output
       if((fh = fopen(rp[i]->Filename, "r")) != NULL)
@@ -4609,7 +4879,16 @@ static BOOL RE_HandleMDNReport(const struct Part *frp)
 
       // replace the original decoded part
       // message
-      DeleteFile(rp[0]->Filename);
+      if(isInMemory(rp[0]) == TRUE)
+      {
+        free(rp[0]->Data);
+        rp[0]->Data = NULL;
+        rp[0]->DataSize = 0;
+        clearFlag(rp[0]->Flags, PFLAG_INMEMORY);
+      }
+      else
+        DeleteFile(rp[0]->Filename);
+
       strlcpy(rp[0]->Filename, buf, sizeof(rp[0]->Filename));
       setFlag(rp[0]->Flags, PFLAG_DECODED);
       RE_SetPartInfo(rp[0]);
@@ -4781,7 +5060,9 @@ BOOL CleanupReadMailData(struct ReadMailData *rmData, BOOL fullCleanup)
 
     D(DBF_MAIL, "freeing mail part %08lx, next %08lx", part, next);
 
-    if(part->Filename[0] != '\0')
+    if(isInMemory(part) == TRUE)
+      free(part->Data);
+    else if(part->Filename[0] != '\0')
     {
       if(DeleteFile(part->Filename) == 0)
         AddZombieFile(part->Filename);
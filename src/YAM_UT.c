@@ -1711,7 +1711,7 @@ BOOL DeleteMailDir(const char *dir, BOOL isroot)
              stricmp(filename, ".addressbook")       == 0 ||
              stricmp(filename, ".emailcache")        == 0 ||
              stricmp(filename, ".folders")           == 0 ||
-             stricmp(filename, ".spamdata")          == 0 ||
+             strnicmp(filename, ".spamdata", 9)      == 0 ||
              strnicmp(filename, ".signature", 10)    == 0 ||
              strnicmp(filename, ".altsignature", 13) == 0 ||
              strnicmp(filename, ".uidl", 6)          == 0)
@@ -1729,7 +1729,9 @@ BOOL DeleteMailDir(const char *dir, BOOL isroot)
         if(isValidMailFile(filename) == TRUE  ||
            stricmp(filename, ".fconfig") == 0 ||
            stricmp(filename, ".fimage") == 0  ||
-           stricmp(filename, ".index") == 0)
+           stricmp(filename, ".index") == 0   ||
+           stricmp(filename, ".journal") == 0 ||
+           stricmp(filename, ".textindex") == 0)
         {
           if(DeleteFile(fname) == 0)
           {
@@ -3544,8 +3546,8 @@ void AddMailToFolder(struct Mail *mail, struct Folder *folder)
     AddMailToFolderSimple(mail, folder);
     UnlockMailList(folder->messages);
 
-    // expire the folder's index as we just added a new message
-    MA_ExpireIndex(folder);
+    // record the new message in the folder's index journal
+    MA_JournalAddMail(mail);
   }
 
   LEAVE();
@@ -3562,6 +3564,7 @@ void AddMailToFolderSimple(struct Mail *mail, struct Folder *folder)
 
   // let's add the new message to the folder's message list
   AddNewMailNode(folder->messages, mail);
+  IndexFolderMail(folder, mail);
 
   // let's summarize the stats
   folder->Total++;
@@ -3620,6 +3623,11 @@ void RemoveMailFromFolder(struct Mail *mail, const BOOL closeWindows, const BOOL
     if(hasStatusSent(mail))
       folder->Sent--;
 
+    // then we have to record the removal in the folder's index journal.
+    // This must happen while the mail is still valid, deleting the node
+    // below might free it.
+    MA_JournalRemoveMail(folder, mail);
+
     LockMailList(folder->messages);
 
     if((mnode = FindMailByAddress(folder->messages, mail)) != NULL)
@@ -3627,6 +3635,9 @@ void RemoveMailFromFolder(struct Mail *mail, const BOOL closeWindows, const BOOL
       // remove the mail from the folder's mail list
       D(DBF_UTIL, "removing mail with subject '%s' from folder '%s'", mail->Subject, folder->Name);
       RemoveMailNode(folder->messages, mnode);
+      // this must happen before the node is deleted, because that might
+      // free the mail
+      UnindexFolderMail(folder, mail);
       DeleteMailNode(mnode);
     }
 
@@ -3681,10 +3692,6 @@ void RemoveMailFromFolder(struct Mail *mail, const BOOL closeWindows, const BOOL
         }
       }
     }
-
-    // then we have to mark the folder index as expired so
-    // that it will be saved next time.
-    MA_ExpireIndex(folder);
   }
   else
   {
@@ -3739,6 +3746,8 @@ struct Mail *ReplaceMailInFolder(const char *mailFile, struct Mail *mail, struct
   if(MA_GetIndex(folder) == TRUE)
   {
     struct MailNode *mnode;
+    unsigned int oldstatus = 0;
+    long oldsize = 0;
 
     LockMailList(folder->messages);
 
@@ -3746,6 +3755,8 @@ struct Mail *ReplaceMailInFolder(const char *mailFile, struct Mail *mail, struct
     {
       // remember the replaced mail
       replacedMail = mnode->mail;
+      oldstatus = replacedMail->sflags;
+      oldsize = replacedMail->Size;
 
       // remove the old mail's stats from the folder stats
       folder->Size -= replacedMail->Size;
@@ -3773,6 +3784,10 @@ struct Mail *ReplaceMailInFolder(const char *mailFile, struct Mail *mail, struct
       mnode->mail = mail;
       mail->Folder = folder;
 
+      // the new mail might carry different message IDs
+      UnindexFolderMail(folder, replacedMail);
+      IndexFolderMail(folder, mail);
+
       // increase the reference counter
       ReferenceMail(mail);
     }
@@ -3783,8 +3798,11 @@ struct Mail *ReplaceMailInFolder(const char *mailFile, struct Mail *mail, struct
 
     UnlockMailList(folder->messages);
 
-    // expire the folder's index as we just added a new message
-    MA_ExpireIndex(folder);
+    // record the new message in the folder's index journal
+    if(replacedMail != NULL)
+      MA_JournalUpdateMail(mail, oldstatus, oldsize);
+    else
+      MA_JournalAddMail(mail);
   }
   else
   {
@@ -3838,6 +3856,7 @@ BOOL ClearFolderMails(struct Folder *folder, BOOL resetstats)
   {
     LockMailList(folder->messages);
     ClearMailList(folder->messages);
+    ClearFolderMsgIDIndex(folder);
     UnlockMailList(folder->messages);
 
     if(resetstats == TRUE)
@@ -4026,7 +4045,7 @@ int TransferMailFile(BOOL copyit, struct Mail *mail, struct Folder *dstfolder)
         // if we end up here we finally found a new mailfilename which we can use, so
         // lets copy it to our MailFile variable
         D(DBF_UTIL, "renaming mail file from '%s' to '%s'", mail->MailFile, dstFileName);
-        strlcpy(mail->MailFile, dstFileName, sizeof(mail->MailFile));
+        SetMailFile(mail, dstFileName);
       }
     }
 
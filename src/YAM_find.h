@@ -36,6 +36,7 @@
 
 // forward declarations
 struct BoyerMooreContext;
+struct TextIndexQuery;
 
 enum ApplyFilterMode
 {
@@ -143,6 +144,7 @@ struct SearchPatternNode
 #define SEARCHF_SUBSTRING           (1<<1) // search for a substring instead of a complete string
 #define SEARCHF_DOS_PATTERN         (1<<2) // use AmigaDOS pattern matching
 #define SEARCHF_SKIP_ENCRYPTED      (1<<3) // skip encrypted mails (i.e. PGP)
+#define SEARCHF_TEXT_INDEX          (1<<4) // use the folders' full-text indexes for body searches (interactive searches only)
 
 struct Search
 {
@@ -159,6 +161,8 @@ struct Search
   struct DateTime      dateTime;
   struct MinList       patternList;               // for storing search patterns, including the embedded singlePattern
   struct BoyerMooreContext *bmContext;
+  struct TextIndexQuery *textQuery;               // for looking up the body search in the full-text indexes
+  ULONG                matcherSlot;               // slot in the multi pattern matcher of a filter list, 0 if not compiled
 };
 
 // A rule structure which is used to be placed
@@ -34,7 +34,9 @@
 
 // forward declarations
 struct Config;
+struct HashTable;
 struct MailList;
+struct TextIndex;
 struct UserIdentityList;
 
 // Foldertype macros
@@ -125,6 +127,9 @@ struct Folder
   int               ID;                    // unique id for the folder
   Object *          imageObject;
   struct MailList * messages;
+  struct HashTable *msgIDIndex;            // maps the compressed message IDs to the mails of the folder
+  struct HashTable *irtMsgIDIndex;         // maps the compressed in-reply-to IDs to the mails of the folder
+  struct TextIndex *textIndex;             // the full-text index of the mails' texts, loaded on demand
   struct MUI_NListtree_TreeNode *Treenode; // links to MainFolderListtree
   struct FolderNode *self;                 // ptr back to own folder node
   struct FolderNode *parent;               // ptr to parent folder node, NULL if parent is root
@@ -145,6 +150,7 @@ struct Folder
   enum LoadedMode   LoadedMode;
 
   time_t            lastAccessTime;        // when the folder was last accessed/loaded
+  ULONG             journalSize;           // size of the index journal in bytes
 
   char              Name[SIZE_NAME];       // the name of the folder
   char              Path[SIZE_PATH];       // relative or absolute path of the folder's directory
@@ -163,6 +169,7 @@ struct Folder
   BOOL              JumpToUnread;
   BOOL              JumpToRecent;
   BOOL              MLSupport;
+  BOOL              FullTextIndex;         // maintain a full-text index for body searches
 };
 
 enum LoadTreeResult
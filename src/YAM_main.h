@@ -402,7 +402,7 @@ char *MA_ToStatusHeader(struct Mail *mail);
 char *MA_ToXStatusHeader(struct Mail *mail);
 unsigned int MA_FromStatusHeader(char *statusflags);
 unsigned int MA_FromXStatusHeader(char *xstatusflags);
-char *MA_GetRealSubject(char *sub);
+const char *MA_GetRealSubject(const char *sub);
 void  MA_ChangeSelected(BOOL forceUpdate);
 
 enum NewMailMode CheckNewMailQualifier(const enum NewMailMode mode, const ULONG qualifier, int *flags);
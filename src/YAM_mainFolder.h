@@ -28,17 +28,29 @@
 
 ***************************************************************************/
 
+#include <exec/semaphores.h>
+
 #include "timeval.h"
 
 #include "YAM_utilities.h"
 
 // forward declarations
 struct Folder;
+struct HeaderNode;
+struct MailPool;
 struct UserIdentityNode;
 
+// the compact counterpart of struct Person used by struct Mail
+struct MailPerson
+{
+  const char *Address;
+  const char *RealName;
+};
+
 struct Mail
 {
   short            RefCounter; // how many struct MailNode are referencing us?
+  struct MailPool *pool;       // the pool this mail was allocated from (NULL = global pool)
   struct Folder *  Folder;     // pointer to the folder this mail belongs to
   unsigned long    cMsgID;     // compressed message ID
   unsigned long    cIRTMsgID;  // compressed in-return-to message ID
@@ -49,14 +61,16 @@ struct Mail
   short            gmtOffset;  // the offset to GMT this mail is based on
   struct DateStamp Date;       // the datestamp of the mail (UTC)
   struct TimeVal   transDate;  // the date/time when this messages arrived/was sent. (UTC)
-  struct Person    From;       // The main sender (normally first entry in "From:")
-  struct Person    To;         // The main mail recipient (first entry in "To:")
-  struct Person    ReplyTo;    // The main Reply-To recipients (first entry in "Reply-To:")
-
-  char tzAbbr[SIZE_SMALL];        // copy of the timezone abbreviation
-  char MailAccount[SIZE_DEFAULT]; // name of mail account used to receive/sent mail
-  char Subject[SIZE_SUBJECT];     // copy of the mail Subject: header
-  char MailFile[SIZE_MFILE];      // name of mail file (without path)
+  struct MailPerson From;      // The main sender (normally first entry in "From:")
+  struct MailPerson To;        // The main mail recipient (first entry in "To:")
+  struct MailPerson ReplyTo;   // The main Reply-To recipients (first entry in "Reply-To:")
+
+  // all strings are shared via the global string table (StringTable.c)
+  // and must only be changed by the SetMail...() functions (MailList.c)
+  const char *tzAbbr;          // copy of the timezone abbreviation
+  const char *MailAccount;     // name of mail account used to receive/sent mail
+  const char *Subject;         // copy of the mail Subject: header
+  const char *MailFile;        // name of mail file (without path)
 };
 
 struct ExtendedMail
@@ -99,15 +113,42 @@ struct ExtendedMail
   struct Person            OriginalRcpt;   // the original recipient for a requested MDN
 };
 
+// a mail file examined during a folder scan
+struct FolderScanFile
+{
+  struct Mail *mail;     // the examined mail, NULL if examining failed
+  char name[SIZE_MFILE]; // name of the mail file (without path)
+};
+
+// the state of a folder scan shared by all examining threads
+struct FolderScan
+{
+  struct SignalSemaphore lock;  // protects the counters below
+  struct Folder *folder;        // the folder being scanned
+  struct MailPool *mailPool;    // pool for the examined mails
+  struct FolderScanFile *files; // all mail files found in the folder directory
+  ULONG numFiles;               // number of mail files
+  ULONG nextFile;               // the first file of the next chunk to be examined
+  ULONG processedFiles;         // number of files examined so far
+  ULONG finishedThreads;        // number of threads which ran out of work
+  BOOL aborted;                 // the scan was aborted by the user
+};
+
 // MA_ReadHeader modes
 enum ReadHeaderMode
 {
   RHM_MAINHEADER=0, // we are reading the main header of a mail
   RHM_SUBHEADER,    // we are reading a sub header of a mimepart of a mail
+  RHM_RAWHEADER,    // we are reading the main header of a mail, but the caller decodes the lines
 };
 
 void  MA_ChangeFolder(struct Folder *folder, BOOL set_active);
 void  MA_ExpireIndex(struct Folder *folder);
+void  MA_JournalAddMail(const struct Mail *mail);
+void  MA_JournalRemoveMail(struct Folder *folder, const struct Mail *mail);
+void  MA_JournalUpdateMail(const struct Mail *mail, const unsigned int oldSFlags, const long oldSize);
+void  MA_JournalMailStatus(const struct Mail *mail, const unsigned int oldSFlags, const char *oldMailFile);
+BOOL  MA_JournalNeedsCompaction(const struct Folder *folder);
 struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *file, const BOOL deep);
 void  MA_FreeEMailStruct(struct ExtendedMail *email);
 BOOL  MA_GetIndex(struct Folder *folder);
@@ -115,8 +156,12 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full);
 BOOL  MA_NewMailFile(const struct Folder *folder, char *fullPath, const size_t fullPathSize);
 BOOL  MA_PromptFolderPassword(struct Folder *fo, APTR win);
 BOOL  MA_ReadHeader(const char *mailFile, FILE *fh, struct MinList *headerList, enum ReadHeaderMode mode);
+BOOL  MA_DecodeHeaderNode(const char *mailFile, struct HeaderNode *hdrNode);
+BOOL  MA_HasBrokenAddressLines(struct MinList *headerList);
+void  MA_ValidateAddressHeader(struct HeaderNode *hdrNode);
 BOOL  MA_SaveIndex(struct Folder *folder);
 void  MA_RebuildIndexes(void);
+LONG  MA_ScanFolderFiles(struct FolderScan *scan);
 void  MA_UpdateInfoBar(struct Folder *folder);
 struct Mail *FindMailByMsgID(struct Folder *folder, const char *msgid);
 void MoveHeldMailsToDraftsFolder(void);
@@ -110,12 +110,14 @@ struct ReadMailData
 #define PFLAG_ALTPART       (1<<3)  // this part is an alternative part (multipart/alternative)
 #define PFLAG_MIME          (1<<4)  // this part conforms to the MIME standard
 #define PFLAG_ATTACHMENT    (1<<5)  // this part is explicitly declared as attachment
+#define PFLAG_INMEMORY      (1<<6)  // the contents are kept in memory instead of Filename
 #define hasSubHeaders(part)     (isFlagSet((part)->Flags, PFLAG_SUBHEADERS))
 #define isPrintable(part)       (isFlagSet((part)->Flags, PFLAG_PRINTABLE))
 #define isDecoded(part)         (isFlagSet((part)->Flags, PFLAG_DECODED))
 #define isAlternativePart(part) (isFlagSet((part)->Flags, PFLAG_ALTPART))
 #define isMIMEconform(part)     (isFlagSet((part)->Flags, PFLAG_MIME))
 #define isAttachment(part)      (isFlagSet((part)->Flags, PFLAG_ATTACHMENT))
+#define isInMemory(part)        (isFlagSet((part)->Flags, PFLAG_INMEMORY))
 
 // a struct Part is a structure for managing certain message
 // parts according to the hierarchical structuring of e-mails
@@ -142,6 +144,8 @@ struct Part
   int                  Nr;
   enum Encoding        EncodingCode;
   BOOL                 nameIsArtificial;
+  char                *Data;               // the contents of a PFLAG_INMEMORY part
+  size_t               DataSize;           // the number of bytes in Data
 
   char                 Name[SIZE_DEFAULT];
   char                 Description[SIZE_DEFAULT];
@@ -156,6 +160,7 @@ struct HeaderNode
 };
 
 BOOL RE_DecodePart(struct Part *rp);
+BOOL RE_FlushPart(struct Part *rp);
 void RE_DisplayMIME(const char *srcfile, const char *dstfile, const char *ctype, const BOOL convertFromUTF8);
 BOOL RE_ProcessMDN(const enum MDNMode mode, struct Mail *mail, const BOOL multi, const BOOL autoAction, Object *win);
 
@@ -35,6 +35,8 @@
 #include "YAM.h"
 
 #include "mime/base64.h"
+#include "mime/mimecodec.h"
+#include "mime/mimestream.h"
 
 #include "Config.h"
 
@@ -55,7 +57,6 @@ static const unsigned char index_64[128] =
 };
 
 // some defines that can be usefull
-#define B64_LINELEN 72    // number of chars before the b64encode_file() issues a CRLF
 #define B64DEC_BUF  4096  // bytes to use as a base64 file decoding buffer
 #define B64ENC_BUF  4095  // bytes to use as a base64 file encoding buffer (must be a multiple of 3)
 
@@ -73,72 +74,19 @@ int base64encode(char **out, const char *in, size_t inlen)
 
   // Work out how big the output buffer
   // should be. This must be a multiple of 4 bytes
-  outlen = (inlen*4)/3;
-  if((inlen % 3) > 0) // got to pad
-    outlen += 4 - (inlen % 3);
+  outlen = BASE64ENC_MAXOUT(inlen);
 
   if(inlen > 0 && outlen > 0 &&
      (buffer = malloc(outlen + 1)) != NULL) // +1 for the \0
   {
-    char *outp = buffer;
-    const char *inp = in;
-    unsigned char cbyte;
-    unsigned char obyte;
-
-    for(; inlen >= 3; inlen -= 3)
-    {
-      cbyte = *inp++;
-      *outp++ = basis_64[(int)(cbyte >> 2)];
-      obyte = (cbyte << 4) & 0x30;             // 0011 0000
-
-      cbyte = *inp++;
-      obyte |= (cbyte >> 4);                   // 0000 1111
-      *outp++ = basis_64[(int)obyte];
-      obyte = (cbyte << 2) & 0x3C;             // 0011 1100
-
-      cbyte = *inp++;
-      obyte |= (cbyte >> 6);                   // 0000 0011
-      *outp++ = basis_64[(int)obyte];
-      *outp++ = basis_64[(int)(cbyte & 0x3F)]; // 0011 1111
-    }
-
-    if(inlen > 0)
-    {
-      char end[3];
-
-      end[0] = *inp++;
-      if(--inlen)
-        end[1] = *inp++;
-      else
-        end[1] = '\0';
-
-      end[2] = '\0';
-
-      cbyte = end[0];
-      *outp++ = basis_64[(int)(cbyte >> 2)];
-      obyte = (cbyte << 4) & 0x30;            // 0011 0000
-
-      cbyte = end[1];
-      obyte |= (cbyte >> 4);
-      *outp++ = basis_64[(int)obyte];
-      obyte = (cbyte << 2) & 0x3C;            // 0011 1100
-
-      if(inlen > 0)
-        *outp++ = basis_64[(int)obyte];
-      else
-        *outp++ = '=';
-
-      *outp++ = '=';
-    }
+    // encode the whole string in one go
+    result = base64encode_block(buffer, (const unsigned char *)in, inlen);
 
     // NUL-terminate the array
-    *outp = '\0';
+    buffer[result] = '\0';
 
     // now write the addr of buffer to out
     *out = buffer;
-
-    // return the length of the filled buffer
-    result = outp - buffer;
   }
 
   RETURN(result);
@@ -286,195 +234,139 @@ long base64encode_file(FILE *in, FILE *out, BOOL convLF)
                                   // probably need to convert each LF into a CRLF we have to
                                   // have a buffer with a maximum space of 8190 bytes.
                                   // the other 2 bytes are to be safe. :)
-  char *outbuffer = NULL;
-  char *optr;
-  BOOL eof_reached = FALSE;
-  int next_unget = 0;
-  int missing_chars = 0;
-  int sumencoded = 0;
-  int towrite;
-  int encoded;
-  size_t read = 0;
+  char *outbuffer;
+  size_t outsize = BASE64ENC_MAXLINES(sizeof(inbuffer));
+  long sumencoded = 0;
 
   ENTER();
   SHOWVALUE(DBF_MIME, convLF);
 
-  while(eof_reached == FALSE)
+  // the output buffer takes a complete encoded chunk including the line breaks
+  if((outbuffer = malloc(outsize)) != NULL)
   {
-    // before we go on with reading in more data we move
-    // the last next_unget characters of inbuffer to the start
-    // of inbuffer
-    if(next_unget > 0)
-      memmove(inbuffer, &inbuffer[read], next_unget);
-
-    // read in 4095 byte chunks
-    read = fread(&inbuffer[0]+next_unget, 1, B64ENC_BUF-next_unget, in);
-    read += next_unget;
-    next_unget = 0;
+    BOOL eof_reached = FALSE;
+    int next_unget = 0;
+    int column = 0;
+    size_t read = 0;
 
-    // on a short item count we check for a potential
-    // error and return immediatly.
-    if(read != B64ENC_BUF)
+    while(eof_reached == FALSE)
     {
-      if(feof(in) != 0)
-      {
-        D(DBF_MIME, "EOF file at %ld", ftell(in));
-
-        eof_reached = TRUE; // we found an EOF
-
-        // if the last read was zero we can exit immediatly
-        if(read == 0)
-          break;
-      }
-      else
+      size_t encoded;
+
+      // before we go on with reading in more data we move
+      // the last next_unget characters of inbuffer to the start
+      // of inbuffer
+      if(next_unget > 0)
+        memmove(inbuffer, &inbuffer[read], next_unget);
+
+      // read in 4095 byte chunks
+      read = fread(&inbuffer[0]+next_unget, 1, B64ENC_BUF-next_unget, in);
+      read += next_unget;
+      next_unget = 0;
+
+      // on a short item count we check for a potential
+      // error and return immediatly.
+      if(read != B64ENC_BUF)
       {
-        E(DBF_MIME, "error on reading data!");
-
-        // an error occurred, lets return -1
-        RETURN(-1);
-        return -1;
-      }
-    }
-
-    // now we check whether the user want to convert each LF into a CRLF
-    // and if so we need to parse the whole read bytes for \n and convert
-    // them to \r\n before the base64 encoding.
-    if(convLF)
-    {
-      char convbuffer[B64ENC_BUF*2+2];
-      char *sptr = convbuffer;
-      char *dptr = inbuffer;
-      long toconvert = read;
-      long converted = 0;
+        if(feof(in) != 0)
+        {
+          D(DBF_MIME, "EOF file at %ld", ftell(in));
 
-      // lets fill the convbuffer with the data
-      // of inbuffer first
-      memcpy(convbuffer, inbuffer, toconvert);
+          eof_reached = TRUE; // we found an EOF
 
-      while(toconvert--)
-      {
-        if(*sptr == '\n')
+          // if the last read was zero we can exit immediatly
+          if(read == 0)
+            break;
+        }
+        else
         {
-          // now write a \r first
-          *dptr = '\r';
-          dptr++;
+          E(DBF_MIME, "error on reading data!");
 
-          converted++;
+          // an error occurred, lets return -1
+          sumencoded = -1;
+          break;
         }
-
-        // copy the current character;
-        *dptr = *sptr;
-
-        // increase the pointers
-        dptr++;
-        sptr++;
       }
 
-      // increase the read counter
-      read += converted;
-
-      // now that we have converted something we have to
-      // make sure that read is still a multiple of 3 if this
-      // isn`t an EOF run.
-      if(eof_reached == FALSE)
+      // now we check whether the user want to convert each LF into a CRLF
+      // and if so we need to parse the whole read bytes for \n and convert
+      // them to \r\n before the base64 encoding.
+      if(convLF)
       {
-        // lets check how many chars we have to skip and move
-        // back later
-        next_unget = read % 3;
-        read -= next_unget;
-      }
-    }
+        char convbuffer[B64ENC_BUF*2+2];
+        char *sptr = convbuffer;
+        char *dptr = inbuffer;
+        long toconvert = read;
+        long converted = 0;
 
-    // now everything should be prepared so that we can call the
-    // base64 encoding routine and let it convert our inbuffer to
-    // the apropiate outbuffer
-    encoded = base64encode(&outbuffer, inbuffer, read);
-    sumencoded += encoded;
+        // lets fill the convbuffer with the data
+        // of inbuffer first
+        memcpy(convbuffer, inbuffer, toconvert);
 
-    // if the base64encoding routine returns <= 0 then there is obviously
-    // something wrong
-    if(encoded <= 0)
-    {
-      E(DBF_MIME, "error on encoding data!");
+        while(toconvert--)
+        {
+          if(*sptr == '\n')
+          {
+            // now write a \r first
+            *dptr = '\r';
+            dptr++;
 
-      RETURN(-1);
-      return -1;
-    }
+            converted++;
+          }
 
-    // now that we seem to have everything encoded we write out
-    // the encoded sting in 72 character long chunks followed by
-    // a newline
-    optr = outbuffer;
-    towrite = encoded;
+          // copy the current character;
+          *dptr = *sptr;
 
-    while(towrite > 0)
-    {
-      size_t todo;
+          // increase the pointers
+          dptr++;
+          sptr++;
+        }
 
-      // how many chars should be written?
-      if(missing_chars == 0)
-      {
-        if(towrite >= B64_LINELEN)
+        // increase the read counter
+        read += converted;
+
+        // now that we have converted something we have to
+        // make sure that read is still a multiple of 3 if this
+        // isn`t an EOF run.
+        if(eof_reached == FALSE)
         {
-          todo = B64_LINELEN;
+          // lets check how many chars we have to skip and move
+          // back later
+          next_unget = read % 3;
+          read -= next_unget;
         }
-        else
-          todo = towrite;
       }
-      else
-        todo = towrite < missing_chars ? towrite : missing_chars;
+
+      // now everything should be prepared so that we can encode the
+      // chunk line by line directly into the output buffer. Each line
+      // takes 72 characters followed by a newline, which is only issued
+      // if more data follows.
+      encoded = base64encode_lines(outbuffer, (const unsigned char *)inbuffer, read, &column);
+      sumencoded += encoded;
 
       // now we do a binary write of the data
-      if(fwrite(optr, 1, todo, out) != todo)
+      if(encoded > 0 && fwrite(outbuffer, 1, encoded, out) != encoded)
       {
         E(DBF_MIME, "error on writing data!");
 
-        free(outbuffer);
-
         // an error must have occurred.
-        RETURN(-1);
-        return -1;
-      }
-
-      // lets modify our counters
-      towrite -= todo;
-      optr += todo;
-
-      // then we have to check whether we have written
-      // a full 72 char long line or not and if so we can attach
-      // a newline.
-      if(missing_chars == 0 &&
-         todo < B64_LINELEN && eof_reached == FALSE)
-      {
-        // if we end up here we don`t write any newline,
-        // but we remember how many characters we are
-        // going to write in advance next time.
-        missing_chars = B64_LINELEN-todo;
-      }
-      else if((towrite > 0 || eof_reached == FALSE) && fputc('\n', out) == EOF)
-      {
-        E(DBF_MIME, "error on writing newline");
-
-        free(outbuffer);
-
-        RETURN(-1);
-        return -1;
+        sumencoded = -1;
+        break;
       }
-      else
-        missing_chars = 0;
     }
 
     free(outbuffer);
-    outbuffer = NULL;
   }
+  else
+    sumencoded = -1;
 
   RETURN(sumencoded);
   return sumencoded;
 }
 
 ///
-/// base64decode_file()
-//  Decodes a file in base64 format. Takes care of an eventually specified translation
+/// base64decode_stream()
+//  Decodes a file or memory stream in base64 format. Takes care of an eventually specified translation
 //  table as well as a CRLF->LF translation for printable text. It reads in the base64
 //  strings line by line from the in file stream, decodes it and writes out the
 //  decoded data with fwrite() to the out stream. It returns the total bytes of
@@ -482,50 +374,39 @@ long base64encode_file(FILE *in, FILE *out, BOOL convLF)
 //  found a short item count during decoding it return -2 asking the user
 //  to still consider the string decoded (however it should be treated with
 //  care)
-long base64decode_file(FILE *in, FILE *out,
-                       struct codeset *srcCodeset, BOOL isText, BOOL convCRLF)
+long base64decode_stream(struct MimeStream *in, struct MimeStream *out,
+                         struct codeset *srcCodeset, BOOL isText, BOOL convCRLF)
 {
-  char inbuffer[B64DEC_BUF+1];
-  char *outbuffer = NULL;
-  char ungetbuf[3];
+  unsigned char inbuffer[B64DEC_BUF];
+  unsigned char outbuffer[BASE64DEC_MAXOUT(B64DEC_BUF)+2];
+  struct Base64Decoder dec;
   long decodedChars = 0;
-  size_t next_unget = 0;
   BOOL eof_reached = FALSE;
-  BOOL problemDuringDecode = FALSE;
 
   ENTER();
 
   D(DBF_MIME, "codeset '%s'", srcCodeset != NULL ? srcCodeset->name : "none");
 
+  base64decode_init(&dec);
+
   while(eof_reached == FALSE)
   {
-    int outLength = 0;
-    char *sptr;
+    size_t outLength;
     char *dptr;
     size_t read;
-    size_t todo;
-
-    // if we do have some unget chars lets copy them first at the
-    // beginning of the inbuffer
-    if(next_unget > 0)
-      memcpy(inbuffer, ungetbuf, next_unget);
 
     // do a binary read of ~4096 chunks
-    read = fread(&inbuffer[next_unget], sizeof(char), B64DEC_BUF-next_unget, in);
+    read = mimestream_read(in, inbuffer, B64DEC_BUF);
 
     // on a short item count we check for a potential
     // error and return immediatly.
-    if(read != B64DEC_BUF-next_unget)
+    if(read != B64DEC_BUF)
     {
-      if(feof(in) != 0)
+      if(mimestream_eof(in) == TRUE)
       {
-        D(DBF_MIME, "EOF file at %ld", ftell(in));
+        D(DBF_MIME, "EOF reached");
 
         eof_reached = TRUE; // we found an EOF
-
-        // if the last read was zero we can exit immediatly
-        if(read == 0 && next_unget == 0)
-          break;
       }
       else
       {
@@ -537,85 +418,26 @@ long base64decode_file(FILE *in, FILE *out,
       }
     }
 
-    // increase/reset the counters
-    read += next_unget;
-    next_unget = 0;
-
-    // now that we have read 4096 bytes into our buffer
-    // we have to iterate through this buffer and "eliminate"
-    // white spaces which aren`t normally part of base64 encoded
-    // string and can be safely skipped without
-    // corrupting the decoded file.
-    sptr = inbuffer;
-    dptr = inbuffer;
-    todo = read;
+    // decode the chunk, white spaces which aren't normally part of
+    // a base64 encoded string are skipped by the decoder and an
+    // incomplete group of chars is kept for the next chunk
+    outLength = base64decode_block(&dec, outbuffer, inbuffer, read);
 
-    while(todo > 0)
+    if(eof_reached == TRUE)
     {
-      if(!isspace(*sptr))
-      {
-        *dptr = *sptr;
-        dptr++;
-      }
-      else read--;
-
-      sptr++;
-      todo--;
-    }
-
-    // if we end up with read == 0 we had only spaces in our
-    // source string, so lets skip to the next iteration
-    if(read == 0)
-      continue;
-
-    // before we going to decode the string we have to make sure
-    // that the encoded string is a multiple of 4 as 4 encoded
-    // base64 chars will get out 2 unencoded ones.
-    next_unget = read % 4;
-    if(next_unget > 0)
-    {
-      if(eof_reached == FALSE)
-      {
-        read -= next_unget;
-        memcpy(ungetbuf, &inbuffer[read], next_unget);
-      }
-      else
+      if(dec.count != 0)
       {
         W(DBF_MIME, "unget chars at EOF???");
 
-        problemDuringDecode = TRUE;
+        dec.invalid = 1;
       }
-    }
-
-    // now that we have a whitespace free somewhat base64 encoded
-    // string, we can call the base64decode() function to finally
-    // decode the string
-    if(read <= 0 ||
-       (outLength = base64decode(&outbuffer, inbuffer, read)) <= 0)
-    {
-      E(DBF_MIME, "error on decoding: %ld %ld", read, outLength);
 
-      if(outLength < 0)
-      {
-        // we faced a short item count. That can actually be a sign that the text
-        // in question is not a fully base64 compliant string. However, to
-        // at least display the text to the user we redefine the outLength and
-        // let the write function output that string (even if not correctly
-        // decoded)
-        outLength = -outLength;
-
-        problemDuringDecode = TRUE;
-      }
-      else
-      {
-        // it should not happen that we face a shortCount
-        // or error
-        free(outbuffer);
-        RETURN(-1);
-        return -1;
-      }
+      outLength += base64decode_finish(&dec, &outbuffer[outLength]);
     }
 
+    if(outLength == 0)
+      continue;
+
     // in case the user wants us to detect the correct cyrillic codeset
     // we do it now, but just if the source codeset isn't UTF-8
     if(C->DetectCyrillic == TRUE && isText == TRUE)
@@ -659,66 +481,55 @@ long base64decode_file(FILE *in, FILE *out,
       else
       {
         W(DBF_MIME, "error while trying to convert base64decoded string to UTF8");
-        dptr = outbuffer;
+        dptr = (char *)outbuffer;
       }
     }
     else
-      dptr = outbuffer;
+      dptr = (char *)outbuffer;
 
-    if(dptr != NULL)
+    // if the user also wants to convert CRLF to LF only,
+    // we do it right now
+    if(convCRLF == TRUE)
     {
-      // if the user also wants to convert CRLF to LF only,
-      // we do it right now
-      if(convCRLF == TRUE)
-      {
-        long r;
-        char *rc = dptr;
-        char *wc = dptr;
+      char *rc;
+      char *wc;
+      char *end = &dptr[outLength];
 
-        for(r=0; r < outLength; r++, rc++)
+      // skip everything up to the first CR
+      if((rc = memchr(dptr, '\r', outLength)) != NULL)
+      {
+        for(wc = rc; rc < end; rc++)
         {
-          // check if this is a CRLF
-          if(*rc == '\r' &&
-             outLength-r > 1 && rc[1] == '\n')
-          {
-            // if so, skip the \r
-            continue;
-          }
-          else
-          {
-            // if no CRLF is found, lets copy
-            // the plain character
-            *wc = *rc;
-
-            // increase the write counter
-            wc++;
-          }
+          // check if this is a CRLF and if so, skip the \r
+          if(*rc != '\r' || rc+1 == end || rc[1] != '\n')
+            *wc++ = *rc;
         }
 
         // make sure we reduce outLength by the
         // number of "overjumped" chars.
         outLength -= (rc-wc);
       }
+    }
 
-      // now that we got the string decoded we write it into
-      // our file
-      if(fwrite(dptr, sizeof(char), (size_t)outLength, out) != (size_t)outLength)
-      {
-        E(DBF_MIME, "error on writing data!");
+    // now that we got the string decoded we write it into
+    // our file
+    if(mimestream_write(out, dptr, outLength) != outLength)
+    {
+      E(DBF_MIME, "error on writing data!");
 
-        // an error occurred while writing...
-        RETURN(-1);
-        return -1;
-      }
+      if(dptr != (char *)outbuffer)
+        CodesetsFreeA(dptr, NULL);
+
+      // an error occurred while writing...
+      RETURN(-1);
+      return -1;
     }
 
     // in case the dptr buffer was allocated by codesets.library,
     // we have to free it now
-    if(dptr != outbuffer && dptr != NULL)
+    if(dptr != (char *)outbuffer)
       CodesetsFreeA(dptr, NULL);
 
-    free(outbuffer);
-
     // increase the decodedChars counter
     decodedChars += outLength;
   }
@@ -726,11 +537,35 @@ long base64decode_file(FILE *in, FILE *out,
   // if there was a problem during
   // the decoding phase we go and warn the user with a
   // return value of -2
-  if(problemDuringDecode == TRUE)
+  if(dec.invalid != 0)
+  {
+    W(DBF_MIME, "invalid base64 data found");
     decodedChars = -2;
+  }
 
   RETURN(decodedChars);
   return decodedChars;
 }
 
 ///
+/// base64decode_file()
+// decodes the contents of file 'in' and writes them to file 'out'
+long base64decode_file(FILE *in, FILE *out,
+                       struct codeset *srcCodeset, BOOL isText, BOOL convCRLF)
+{
+  struct MimeStream inStream;
+  struct MimeStream outStream;
+  long result;
+
+  ENTER();
+
+  mimestream_file(&inStream, in);
+  mimestream_file(&outStream, out);
+
+  result = base64decode_stream(&inStream, &outStream, srcCodeset, isText, convCRLF);
+
+  RETURN(result);
+  return result;
+}
+
+///
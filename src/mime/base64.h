@@ -32,6 +32,7 @@
 
 // forward declarations
 struct codeset;
+struct MimeStream;
 
 // static variables
 static const char basis_64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -42,5 +43,7 @@ int base64decode(char **out, const char *in, size_t inlen);
 long base64encode_file(FILE *in, FILE *out, BOOL convLF);
 long base64decode_file(FILE *in, FILE *out,
                        struct codeset *srcCodeset, BOOL isText, BOOL convCRLF);
+long base64decode_stream(struct MimeStream *in, struct MimeStream *out,
+                         struct codeset *srcCodeset, BOOL isText, BOOL convCRLF);
 
 #endif // BASE64_H
@@ -0,0 +1,426 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <string.h>
+
+#include "mime/mimecodec.h"
+
+// the classes of the chars in base64 encoded data, values 0-63 are the
+// base64 digits themselves
+#define B64_SPACE   64  // white space, skipped silently
+#define B64_PAD     65  // the '=' padding char
+#define B64_INVALID 255 // anything else
+
+static const unsigned char b64_class[256] =
+{
+  255,255,255,255,255,255,255,255,255, 64, 64, 64, 64, 64,255,255, // 0
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 1
+   64,255,255,255,255,255,255,255,255,255,255, 62,255,255,255, 63, // 2
+   52, 53, 54, 55, 56, 57, 58, 59, 60, 61,255,255,255, 65,255,255, // 3
+  255,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, // 4
+   15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,255,255,255,255,255, // 5
+  255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, // 6
+   41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,255,255,255,255,255, // 7
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 8
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 9
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // A
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // B
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // C
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // D
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // E
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255 // F
+};
+
+static const char b64_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// the classes of the chars in quoted-printable encoded data
+#define QP_COPY   0 // plain char, copied as is
+#define QP_ESCAPE 1 // the '=' escape char
+#define QP_CR     2 // a CR which is only allowed as part of a CRLF
+#define QP_DROP   3 // non-ASCII chars, not allowed at all
+
+static const unsigned char qp_class[256] =
+{
+  0,0,0,0,0,0,0,0,0,0,0,0,0,2,0,0, // 0
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 1
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 2
+  0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,0, // 3
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 4
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 5
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 6
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 7
+  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // 8
+  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // 9
+  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // A
+  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // B
+  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // C
+  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // D
+  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // E
+  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3 // F
+};
+
+static const unsigned char qp_hex[256] =
+{
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 0
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 1
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 2
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,255,255,255,255,255,255, // 3
+  255, 10, 11, 12, 13, 14, 15,255,255,255,255,255,255,255,255,255, // 4
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 5
+  255, 10, 11, 12, 13, 14, 15,255,255,255,255,255,255,255,255,255, // 6
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 7
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 8
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // 9
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // A
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // B
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // C
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // D
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, // E
+  255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255 // F
+};
+
+/*** BASE64 kernels ***/
+/// base64decode_init()
+// initializes the state of a base64 decoding
+void base64decode_init(struct Base64Decoder *dec)
+{
+  dec->bits = 0;
+  dec->count = 0;
+  dec->invalid = 0;
+}
+
+///
+/// base64decode_block()
+// decodes a block of base64 encoded data to dst, which must be able to take
+// BASE64DEC_MAXOUT(srclen) bytes. White space is skipped, invalid chars are
+// skipped as well but remembered in the decoder state. An incomplete group
+// of chars at the end of the block is kept for the next call. Returns the
+// number of decoded bytes.
+size_t base64decode_block(struct Base64Decoder *dec, unsigned char *dst, const unsigned char *src, size_t srclen)
+{
+  unsigned char *dptr = dst;
+  const unsigned char *end = src + srclen;
+
+  while(src < end)
+  {
+    unsigned int c;
+
+    // fast path: decode as many complete groups of 4 base64 digits as
+    // possible, a single OR tells whether all four chars are digits
+    if(dec->count == 0)
+    {
+      while(end - src >= 4)
+      {
+        unsigned int a = b64_class[src[0]];
+        unsigned int b = b64_class[src[1]];
+        unsigned int d = b64_class[src[3]];
+
+        c = b64_class[src[2]];
+
+        if((a | b | c | d) >= 64)
+          break;
+
+        a = (a << 18) | (b << 12) | (c << 6) | d;
+        dptr[0] = (unsigned char)(a >> 16);
+        dptr[1] = (unsigned char)(a >> 8);
+        dptr[2] = (unsigned char)a;
+
+        dptr += 3;
+        src += 4;
+      }
+
+      if(src == end)
+        break;
+    }
+
+    // slow path: handle a single char which may be white space, padding
+    // or the start/rest of a group interrupted by a line break
+    c = b64_class[*src++];
+
+    if(c < 64)
+    {
+      dec->bits = (dec->bits << 6) | c;
+
+      if(++dec->count == 4)
+      {
+        dptr[0] = (unsigned char)(dec->bits >> 16);
+        dptr[1] = (unsigned char)(dec->bits >> 8);
+        dptr[2] = (unsigned char)dec->bits;
+
+        dptr += 3;
+        dec->bits = 0;
+        dec->count = 0;
+      }
+    }
+    else if(c == B64_PAD)
+    {
+      // the padding terminates the current group, a second '=' finds
+      // an empty group and is ignored. Decoding goes on afterwards to
+      // handle concatenated base64 blocks.
+      dptr += base64decode_finish(dec, dptr);
+    }
+    else if(c != B64_SPACE)
+      dec->invalid = 1;
+  }
+
+  return dptr - dst;
+}
+
+///
+/// base64decode_finish()
+// flushes an incomplete group of chars at the end of the encoded data and
+// returns the number of bytes (at most 2) written to dst
+size_t base64decode_finish(struct Base64Decoder *dec, unsigned char *dst)
+{
+  size_t written = 0;
+
+  switch(dec->count)
+  {
+    case 2:
+    {
+      dst[0] = (unsigned char)(dec->bits >> 4);
+      written = 1;
+    }
+    break;
+
+    case 3:
+    {
+      dst[0] = (unsigned char)(dec->bits >> 10);
+      dst[1] = (unsigned char)(dec->bits >> 2);
+      written = 2;
+    }
+    break;
+
+    case 1:
+    {
+      // a single char can't encode a complete byte
+      dec->invalid = 1;
+    }
+    break;
+  }
+
+  dec->bits = 0;
+  dec->count = 0;
+
+  return written;
+}
+
+///
+/// base64encode_block()
+// encodes srclen bytes from src to dst which must be able to take
+// BASE64ENC_MAXOUT(srclen) chars. A final incomplete group is padded with
+// '=' chars, no line breaks are inserted. Returns the number of chars.
+size_t base64encode_block(char *dst, const unsigned char *src, size_t srclen)
+{
+  char *dptr = dst;
+
+  for(; srclen >= 3; srclen -= 3)
+  {
+    unsigned long n = ((unsigned long)src[0] << 16) | ((unsigned long)src[1] << 8) | src[2];
+
+    dptr[0] = b64_digits[(n >> 18) & 0x3f];
+    dptr[1] = b64_digits[(n >> 12) & 0x3f];
+    dptr[2] = b64_digits[(n >> 6) & 0x3f];
+    dptr[3] = b64_digits[n & 0x3f];
+
+    dptr += 4;
+    src += 3;
+  }
+
+  if(srclen > 0)
+  {
+    unsigned long n = (unsigned long)src[0] << 16;
+
+    if(srclen > 1)
+      n |= (unsigned long)src[1] << 8;
+
+    dptr[0] = b64_digits[(n >> 18) & 0x3f];
+    dptr[1] = b64_digits[(n >> 12) & 0x3f];
+    dptr[2] = (srclen > 1) ? b64_digits[(n >> 6) & 0x3f] : '=';
+    dptr[3] = '=';
+
+    dptr += 4;
+  }
+
+  return dptr - dst;
+}
+
+///
+/// base64encode_lines()
+// encodes srclen bytes from src to dst like base64encode_block(), but
+// breaks the output into lines of BASE64ENC_LINELEN chars. 'column' holds
+// the length of the current line and carries over to the next call, thus
+// srclen must be a multiple of 3 for all but the last block. A line break
+// is only issued if more data follows. dst must be able to take
+// BASE64ENC_MAXLINES(srclen) chars. Returns the number of chars including
+// the line breaks.
+size_t base64encode_lines(char *dst, const unsigned char *src, size_t srclen, int *column)
+{
+  char *dptr = dst;
+
+  while(srclen > 0)
+  {
+    size_t linebytes;
+    size_t encoded;
+
+    if(*column == BASE64ENC_LINELEN)
+    {
+      *dptr++ = '\n';
+      *column = 0;
+    }
+
+    // the number of input bytes fitting into the rest of the line
+    linebytes = (size_t)(BASE64ENC_LINELEN - *column) / 4 * 3;
+    if(linebytes > srclen)
+      linebytes = srclen;
+
+    encoded = base64encode_block(dptr, src, linebytes);
+    dptr += encoded;
+    *column += encoded;
+
+    src += linebytes;
+    srclen -= linebytes;
+  }
+
+  return dptr - dst;
+}
+
+///
+
+/*** Quoted-Printable kernels ***/
+/// qpdecode_block()
+// decodes a block of quoted-printable encoded data (RFC 2045) to dst, which
+// must be able to take srclen bytes. Runs of plain chars are copied in one
+// go. Soft line breaks are removed, invalid '=XX' sequences are kept and
+// reported with a warning of -3 and non-ASCII chars or lonely CRs are
+// dropped and reported with a warning of -4. An incomplete '=' sequence at
+// the end of the block is never consumed, a CR at the end only if 'final'
+// is set. Returns the number of decoded bytes and the number of consumed
+// bytes in 'consumed'.
+size_t qpdecode_block(unsigned char *dst, const unsigned char *src, size_t srclen,
+                      size_t *consumed, int final, int *warning)
+{
+  unsigned char *dptr = dst;
+  const unsigned char *sptr = src;
+  const unsigned char *end = src + srclen;
+  int incomplete = 0;
+
+  while(sptr < end && incomplete == 0)
+  {
+    const unsigned char *run = sptr;
+
+    // copy a run of plain chars
+    while(sptr < end && qp_class[*sptr] == QP_COPY)
+      sptr++;
+
+    if(sptr > run)
+    {
+      memcpy(dptr, run, sptr - run);
+      dptr += sptr - run;
+
+      if(sptr == end)
+        break;
+    }
+
+    switch(qp_class[*sptr])
+    {
+      case QP_ESCAPE:
+      {
+        if(end - sptr >= 2 && sptr[1] == '\n')
+        {
+          // a soft line break
+          sptr += 2;
+        }
+        else if(end - sptr >= 3)
+        {
+          unsigned int c1 = qp_hex[sptr[1]];
+          unsigned int c2 = qp_hex[sptr[2]];
+
+          if(c1 < 16 && c2 < 16)
+          {
+            *dptr++ = (unsigned char)((c1 << 4) | c2);
+          }
+          else
+          {
+            // as suggested by RFC 2045 we keep the =XX sequence
+            // and report a warning
+            dptr[0] = sptr[0];
+            dptr[1] = sptr[1];
+            dptr[2] = sptr[2];
+            dptr += 3;
+
+            *warning = -3;
+          }
+
+          sptr += 3;
+        }
+        else
+        {
+          // the sequence continues in the next block
+          incomplete = 1;
+        }
+      }
+      break;
+
+      case QP_CR:
+      {
+        if(end - sptr >= 2)
+        {
+          // keep a CR only as part of a CRLF
+          if(sptr[1] == '\n')
+            *dptr++ = '\r';
+          else
+            *warning = -4;
+
+          sptr++;
+        }
+        else if(final)
+        {
+          *warning = -4;
+          sptr++;
+        }
+        else
+          incomplete = 1;
+      }
+      break;
+
+      default:
+      {
+        // non-ASCII chars are not allowed
+        *warning = -4;
+        sptr++;
+      }
+      break;
+    }
+  }
+
+  *consumed = sptr - src;
+
+  return dptr - dst;
+}
+
+///
@@ -0,0 +1,65 @@
+#ifndef MIMECODEC_H
+#define MIMECODEC_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stddef.h>
+
+// The decoding/encoding kernels in this file work on plain memory buffers
+// only and don't depend on any other part of YAM. This keeps them usable
+// for the stream functions in base64.c/qprintable.c as well as for the
+// host built benchmark in tools/mimebench.
+
+// state of a base64 decoding which spans several blocks of input
+struct Base64Decoder
+{
+  unsigned long bits; // the bits of the currently incomplete 4 char group
+  int count;          // number of chars of the current group
+  int invalid;        // invalid chars or a bad padding were found
+};
+
+// base64 kernels
+void base64decode_init(struct Base64Decoder *dec);
+size_t base64decode_block(struct Base64Decoder *dec, unsigned char *dst, const unsigned char *src, size_t srclen);
+size_t base64decode_finish(struct Base64Decoder *dec, unsigned char *dst);
+size_t base64encode_block(char *dst, const unsigned char *src, size_t srclen);
+size_t base64encode_lines(char *dst, const unsigned char *src, size_t srclen, int *column);
+
+// quoted-printable kernels
+size_t qpdecode_block(unsigned char *dst, const unsigned char *src, size_t srclen,
+                      size_t *consumed, int final, int *warning);
+
+// the size of the buffers required by the kernels
+#define BASE64DEC_MAXOUT(len) (((len)/4)*3+3)
+#define BASE64ENC_MAXOUT(len) ((((len)+2)/3)*4)
+#define BASE64ENC_MAXLINES(len) (BASE64ENC_MAXOUT(len) + BASE64ENC_MAXOUT(len)/BASE64ENC_LINELEN + 1)
+
+// number of chars per line of base64 encoded data, must be a multiple of 4
+#define BASE64ENC_LINELEN 72
+
+#endif // MIMECODEC_H
@@ -0,0 +1,258 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "YAM_stringsizes.h"
+#include "YAM_utilities.h"
+
+#include "mime/mimestream.h"
+
+#include "Debug.h"
+
+/// mimestream_file
+// initializes a stream reading from or writing to an already opened file
+void mimestream_file(struct MimeStream *ms, FILE *fh)
+{
+  ENTER();
+
+  memset(ms, 0, sizeof(*ms));
+  ms->fh = fh;
+
+  LEAVE();
+}
+
+///
+/// mimestream_memory
+// initializes a stream reading from a memory buffer
+void mimestream_memory(struct MimeStream *ms, const char *buffer, size_t size)
+{
+  ENTER();
+
+  memset(ms, 0, sizeof(*ms));
+  ms->buffer = (char *)buffer;
+  ms->size = size;
+
+  LEAVE();
+}
+
+///
+/// mimestream_spill
+// initializes a stream writing to memory. As soon as more than spillSize
+// bytes are written all data is moved to the file spillFile instead.
+// A spillFile of NULL keeps everything in memory.
+void mimestream_spill(struct MimeStream *ms, size_t spillSize, const char *spillFile)
+{
+  ENTER();
+
+  memset(ms, 0, sizeof(*ms));
+  ms->spillSize = spillSize;
+  ms->spillFile = spillFile;
+
+  LEAVE();
+}
+
+///
+/// mimestream_read
+// a fread() like function to read len bytes from a stream
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+size_t mimestream_read(struct MimeStream *ms, void *ptr, size_t len)
+{
+  size_t nread;
+
+  if(ms->fh != NULL)
+  {
+    nread = fread(ptr, 1, len, ms->fh);
+
+    if(nread != len)
+    {
+      if(feof(ms->fh) != 0)
+        ms->eof = TRUE;
+      else
+        ms->error = TRUE;
+    }
+  }
+  else
+  {
+    nread = MIN(len, ms->size - ms->pos);
+
+    memcpy(ptr, &ms->buffer[ms->pos], nread);
+    ms->pos += nread;
+
+    if(nread != len)
+      ms->eof = TRUE;
+  }
+
+  return nread;
+}
+
+///
+/// mimestream_gets
+// a fgets() like function to read a single line from a stream
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+char *mimestream_gets(struct MimeStream *ms, char *str, int len)
+{
+  char *result = NULL;
+
+  if(ms->fh != NULL)
+  {
+    if((result = fgets(str, len, ms->fh)) == NULL)
+    {
+      if(feof(ms->fh) != 0)
+        ms->eof = TRUE;
+      else
+        ms->error = TRUE;
+    }
+  }
+  else if(ms->pos < ms->size && len > 1)
+  {
+    const char *start = &ms->buffer[ms->pos];
+    size_t n = MIN((size_t)len-1, ms->size - ms->pos);
+    const char *eol;
+
+    // copy everything up to and including the next newline
+    if((eol = memchr(start, '\n', n)) != NULL)
+      n = eol - start + 1;
+
+    memcpy(str, start, n);
+    str[n] = '\0';
+    ms->pos += n;
+
+    result = str;
+  }
+  else
+    ms->eof = TRUE;
+
+  return result;
+}
+
+///
+/// mimestream_write
+// a fwrite() like function to write len bytes to a stream
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+size_t mimestream_write(struct MimeStream *ms, const void *ptr, size_t len)
+{
+  size_t nwritten = 0;
+
+  // move everything to the file as soon as the memory limit is exceeded
+  if(ms->fh == NULL && ms->spillFile != NULL && ms->size + len > ms->spillSize)
+  {
+    D(DBF_MIME, "moving %ld bytes of data to file '%s'", ms->size, ms->spillFile);
+
+    if((ms->fh = fopen(ms->spillFile, "w")) != NULL)
+    {
+      setvbuf(ms->fh, NULL, _IOFBF, SIZE_FILEBUF);
+      ms->ownFile = TRUE;
+
+      if(ms->size > 0 && fwrite(ms->buffer, 1, ms->size, ms->fh) != ms->size)
+        ms->error = TRUE;
+    }
+    else
+    {
+      E(DBF_MIME, "cannot create file '%s'", ms->spillFile);
+      ms->error = TRUE;
+    }
+
+    free(ms->buffer);
+    ms->buffer = NULL;
+    ms->size = 0;
+    ms->allocated = 0;
+  }
+
+  if(ms->error == FALSE)
+  {
+    if(ms->fh != NULL)
+    {
+      if((nwritten = fwrite(ptr, 1, len, ms->fh)) != len)
+        ms->error = TRUE;
+    }
+    else
+    {
+      // make sure the buffer is large enough, grow it exponentially
+      // to avoid lots of small reallocations
+      if(ms->size + len > ms->allocated)
+      {
+        size_t newSize = MAX(ms->allocated * 2, ms->size + len);
+        char *newBuffer;
+
+        newSize = MAX(newSize, SIZE_FILEBUF);
+
+        if((newBuffer = realloc(ms->buffer, newSize)) != NULL)
+        {
+          ms->buffer = newBuffer;
+          ms->allocated = newSize;
+        }
+        else
+          ms->error = TRUE;
+      }
+
+      if(ms->error == FALSE)
+      {
+        memcpy(&ms->buffer[ms->size], ptr, len);
+        ms->size += len;
+        nwritten = len;
+      }
+    }
+  }
+
+  return nwritten;
+}
+
+///
+/// mimestream_eof
+// a feof() like function to check whether the end of a stream was reached
+BOOL mimestream_eof(const struct MimeStream *ms)
+{
+  return ms->eof;
+}
+
+///
+/// mimestream_close
+// closes a file opened by the stream itself. A memory buffer written to
+// is kept and must be taken over by the caller.
+BOOL mimestream_close(struct MimeStream *ms)
+{
+  BOOL result = (ms->error == FALSE);
+
+  ENTER();
+
+  if(ms->fh != NULL && ms->ownFile == TRUE)
+  {
+    if(fclose(ms->fh) != 0)
+      result = FALSE;
+
+    ms->fh = NULL;
+    ms->ownFile = FALSE;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
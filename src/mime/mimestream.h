@@ -0,0 +1,62 @@
+#ifndef MIMESTREAM_H
+#define MIMESTREAM_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdio.h>
+
+#include <exec/types.h>
+
+// a source or destination of the MIME decoding routines which is either
+// a file or a memory buffer. A memory destination may move its data to a
+// file as soon as a given size limit is exceeded.
+struct MimeStream
+{
+  FILE *fh;              // the file or NULL if the data is kept in memory
+  char *buffer;          // the data kept in memory
+  size_t size;           // number of valid bytes in the buffer
+  size_t allocated;      // number of allocated bytes of the buffer
+  size_t pos;            // current read position within the buffer
+  size_t spillSize;      // maximum number of bytes to be kept in memory
+  const char *spillFile; // file to move the data to if spillSize is exceeded
+  BOOL ownFile;          // the file was opened by the stream itself
+  BOOL eof;              // the end of the data was reached
+  BOOL error;            // a read or write error occurred
+};
+
+// stream handling routines
+void mimestream_file(struct MimeStream *ms, FILE *fh);
+void mimestream_memory(struct MimeStream *ms, const char *buffer, size_t size);
+void mimestream_spill(struct MimeStream *ms, size_t spillSize, const char *spillFile);
+size_t mimestream_read(struct MimeStream *ms, void *ptr, size_t len);
+char *mimestream_gets(struct MimeStream *ms, char *str, int len);
+size_t mimestream_write(struct MimeStream *ms, const void *ptr, size_t len);
+BOOL mimestream_eof(const struct MimeStream *ms);
+BOOL mimestream_close(struct MimeStream *ms);
+
+#endif // MIMESTREAM_H
@@ -35,6 +35,8 @@
 #include "YAM.h"
 
 #include "mime/qprintable.h"
+#include "mime/mimecodec.h"
+#include "mime/mimestream.h"
 
 #include "Config.h"
 
@@ -224,24 +226,92 @@ long qpencode_file(FILE *in, FILE *out)
 }
 
 ///
-/// qpdecode_file()
+/// WriteDecodedData()
+// writes a chunk of decoded data to the out stream after optionally
+// detecting the cyrillic codeset and converting it to UTF8
+static BOOL WriteDecodedData(struct MimeStream *out, unsigned char *buffer, size_t len, struct codeset **srcCodeset, BOOL isText)
+{
+  unsigned char *dptr = buffer;
+  size_t todo = len;
+  BOOL success = TRUE;
+
+  ENTER();
+
+  // in case the user wants us to detect the correct cyrillic codeset
+  // we do it now
+  if(C->DetectCyrillic == TRUE && isText == TRUE)
+  {
+    if(*srcCodeset == NULL || ((*srcCodeset)->name != NULL && stricmp((*srcCodeset)->name, "utf-8") != 0))
+    {
+      struct codeset *cs = CodesetsFindBest(CSA_Source,         dptr,
+                                            CSA_SourceLen,      todo,
+                                            CSA_CodesetFamily,  CSV_CodesetFamily_Cyrillic,
+                                            TAG_DONE);
+
+      if(cs != NULL && cs != *srcCodeset)
+      {
+        D(DBF_MIME, "using codeset '%s' instead of '%s'", *srcCodeset != NULL ? (*srcCodeset)->name : "none", cs->name);
+        *srcCodeset = cs;
+      }
+    }
+  }
+
+  // if the caller supplied a source codeset, we have to
+  // make sure we convert our outbuffer before writing it out
+  // to the file in UTF8, but we must not touch binary/non-text data
+  if(isText == TRUE && *srcCodeset != NULL && stricmp((*srcCodeset)->name, "utf-8") != 0)
+  {
+    ULONG strLen = 0;
+
+    UTF8 *str = CodesetsUTF8Create(CSA_Source,          dptr,
+                                   CSA_SourceLen,       todo,
+                                   CSA_SourceCodeset,   *srcCodeset,
+                                   CSA_DestLenPtr,      &strLen,
+                                   TAG_DONE);
+
+    if(str != NULL && strLen > 0)
+    {
+      // if we end up here we successfully converted the
+      // sourcebuffer to a destination buffer which complies to our local
+      // charset
+      dptr = (unsigned char *)str;
+      todo = strLen;
+    }
+    else
+      W(DBF_MIME, "error while trying to convert qpdecoded string to UTF8");
+  }
+
+  // now we do a binary write of the data
+  if(mimestream_write(out, dptr, todo) != todo)
+  {
+    E(DBF_MIME, "error on writing data!");
+    success = FALSE;
+  }
+
+  // in case the dptr buffer was allocated by codesets.library,
+  // we have to free it now
+  if(dptr != buffer)
+    CodesetsFreeA(dptr, NULL);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// qpdecode_stream()
 // Decodes a whole file using the quoted-printable format defined in
 // RFC 2045 (page 19)
-long qpdecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
+long qpdecode_stream(struct MimeStream *in, struct MimeStream *out, struct codeset *srcCodeset, BOOL isText)
 {
   unsigned char inbuffer[QPDEC_BUF+1]; // lets use a 4096 byte large input buffer
   unsigned char outbuffer[QPDEC_BUF+1];// to speed things up we use the same amount
                                        // of memory for an output buffer as the
                                        // decoded string can't be larger than
                                        // the encoded one.
-
-  unsigned char *iptr;
-  unsigned char *optr = outbuffer;
-  unsigned char c;
-  size_t read = 0;
+  size_t read;
   size_t next_unget = 0;
   long decoded = 0;
-  int result = 0;
+  int warning = 0;
   BOOL eof_reached = FALSE;
 
   ENTER();
@@ -250,16 +320,19 @@ long qpdecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
 
   while(eof_reached == FALSE)
   {
+    size_t consumed;
+    size_t todo;
+
     // do a binary read of ~4096 chunks
-    read = fread(&inbuffer[next_unget], sizeof(char), QPDEC_BUF-next_unget, in);
+    read = mimestream_read(in, &inbuffer[next_unget], QPDEC_BUF-next_unget);
 
     // on a short item count we check for a potential
     // error and return immediatly.
     if(read != QPDEC_BUF-next_unget)
     {
-      if(feof(in) != 0)
+      if(mimestream_eof(in) == TRUE)
       {
-        D(DBF_MIME, "EOF file at %ld", ftell(in));
+        D(DBF_MIME, "EOF reached");
 
         eof_reached = TRUE; // we found an EOF
 
@@ -277,247 +350,38 @@ long qpdecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
       }
     }
 
-    // increase/reset the counters
     read += next_unget;
-    next_unget = 0;
 
     // now that we have read in our buffer we have to parse through
     // it and decode eventually existing quoted printable encoded
-    // chunks. The routines also analyze the data and returns an
-    // error if non quoted-printable safe data is found, however
-    // it still tries to decode the data until the end. This fail-safe
+    // chunks. The kernel also analyzes the data and reports a warning
+    // if non quoted-printable safe data is found, however it still
+    // tries to decode the data until the end. This fail-safe
     // behaviour is suggested in RFC 2045 on page 22.
-    iptr = inbuffer;
-
-    while(read != 0)
-    {
-      c = *iptr++;
-      read--;
-
-      if(c == '=')
-      {
-        // check if the next char is a newline so that
-        // we can skip the current =
-        if(read != 0 && *iptr == '\n')
-        {
-          // skip the newline..
-          iptr++;
-          read--;
-
-          continue;
-        }
-
-        // a '=' is the sign that a encoded string is following, so
-        // let us check if we have enough space in our input buffer
-        // and then decode it accordingly
-        if(read >= 2)
-        {
-          unsigned char c1 = hexchar(*iptr);
-          unsigned char c2 = hexchar(*(iptr+1));
-
-          // so we have enough space, lets decode it, but let us
-          // check if the two chars are really hexadecimal chars
-          if(c1 != 255 && c2 != 255)
-          {
-            *optr++ = c1<<4 | c2;
-
-            // increase the counters
-            iptr += 2;
-            read -= 2;
-
-            // count the decoded chars
-            decoded++;
-          }
-          else
-          {
-            // as suggested by RFC 2045 we keep the =XX sequence
-            // and report a warning later to the user
-            *optr++ = c;
-            *optr++ = *iptr++;
-            *optr++ = *iptr++;
-            read -= 2;
-            result = -3; // indicate a "decoding warning"
-          }
-        }
-        else
-        {
-          // ok, there isn't enough space in the input buffer
-          // so we break out here and parse the stuff on
-          // the next iteration
-          next_unget = read+1;
-          memcpy(inbuffer, iptr-1, next_unget);
-
-          break;
-        }
-      }
-      else if(!isascii(c) ||
-              (is_ctrl(c) && c != '\t' && c != '\n' &&
-               c == '\r' && *iptr != '\n'))
-      {
-        // we found some not allowed char, so lets ignore it
-        // but warn the user
-        W(DBF_MIME, "nonallowed character '%lc' (%02lx) found", c, c);
-        result = -4; // indicate a "unallowed control chars" warning
-      }
-      else
-      {
-        // the current char seems to be a normal
-        // char, so lets output it
-        *optr++ = c;
-      }
+    todo = qpdecode_block(outbuffer, inbuffer, read, &consumed, eof_reached == TRUE, &warning);
 
-      // let us now check if our outbuffer is filled up so that we can write
-      // out the data to our out stream.
-      if(optr-outbuffer >= QPDEC_BUF)
-      {
-        unsigned char *dptr = outbuffer;
-        size_t todo = optr-outbuffer;
+    // an incomplete sequence at the end of the buffer is moved to
+    // the front and parsed again together with the next chunk
+    next_unget = read - consumed;
+    if(next_unget > 0)
+      memmove(inbuffer, &inbuffer[consumed], next_unget);
 
-        // in case the user wants us to detect the correct cyrillic codeset
-        // we do it now
-        if(C->DetectCyrillic == TRUE && isText == TRUE)
-        {
-          if(srcCodeset == NULL || (srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
-          {
-            struct codeset *cs = CodesetsFindBest(CSA_Source,         dptr,
-                                                  CSA_SourceLen,      todo,
-                                                  CSA_CodesetFamily,  CSV_CodesetFamily_Cyrillic,
-                                                  TAG_DONE);
-
-            if(cs != NULL && cs != srcCodeset)
-            {
-              D(DBF_MIME, "using codeset '%s' instead of '%s'", srcCodeset != NULL ? srcCodeset->name : "none", cs->name);
-              srcCodeset = cs;
-            }
-          }
-        }
-
-        // if the caller supplied a source codeset, we have to
-        // make sure we convert our outbuffer before writing it out
-        // to the file in UTF8, but we must not touch binary/non-text data
-        if(isText == TRUE && srcCodeset != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
-        {
-          ULONG strLen = 0;
-
-          UTF8 *str = CodesetsUTF8Create(CSA_Source,          dptr,
-                                         CSA_SourceLen,       todo,
-                                         CSA_SourceCodeset,   srcCodeset,
-                                         CSA_DestLenPtr,      &strLen,
-                                         TAG_DONE);
-
-          if(str != NULL && strLen > 0)
-          {
-            // if we end up here we successfully converted the
-            // sourcebuffer to a destination buffer which complies to our local
-            // charset
-            dptr = (unsigned char *)str;
-            todo = strLen;
-          }
-          else
-            W(DBF_MIME, "error while trying to convert qpdecoded string to UTF8");
-        }
-
-        // now we do a binary write of the data
-        if(fwrite(dptr, 1, todo, out) != todo)
-        {
-          E(DBF_MIME, "error on writing data!");
-
-          // in case the dptr buffer was allocated by codesets.library,
-          // we have to free it now
-          if(dptr != outbuffer)
-            CodesetsFreeA(dptr, NULL);
-
-          // an error must have occurred.
-          RETURN(-1);
-          return -1;
-        }
-
-        // in case the dptr buffer was allocated by codesets.library,
-        // we have to free it now
-        if(dptr != outbuffer)
-          CodesetsFreeA(dptr, NULL);
-
-        // now reset the outbuffer and stuff
-        optr = outbuffer;
-      }
-    }
-  }
-
-  // check if there is something in the outbuffer that
-  // hasn't been written out yet
-  if(optr-outbuffer > 0)
-  {
-    unsigned char *dptr = outbuffer;
-    size_t todo = optr-outbuffer;
-
-    // in case the user wants us to detect the correct cyrillic codeset
-    // we do it now
-    if(C->DetectCyrillic == TRUE && isText == TRUE)
+    if(todo > 0)
     {
-      if(srcCodeset == NULL || (srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
+      if(WriteDecodedData(out, outbuffer, todo, &srcCodeset, isText) == FALSE)
       {
-        struct codeset *cs = CodesetsFindBest(CSA_Source,         dptr,
-                                              CSA_SourceLen,      todo,
-                                              CSA_CodesetFamily,  CSV_CodesetFamily_Cyrillic,
-                                              TAG_DONE);
-
-        if(cs != NULL && cs != srcCodeset)
-        {
-          D(DBF_MIME, "using codeset '%s' instead of '%s'", srcCodeset != NULL ? srcCodeset->name : "none", cs->name);
-          srcCodeset = cs;
-        }
+        // an error must have occurred.
+        RETURN(-1);
+        return -1;
       }
-    }
-
-    // if the caller supplied a source codeset, we have to
-    // make sure we convert our outbuffer before writing it out
-    // to the file in UTF8, but we must not touch binary/non-text data
-    if(isText == TRUE && srcCodeset != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
-    {
-      ULONG strLen = 0;
-
-      UTF8 *str = CodesetsUTF8Create(CSA_Source,          dptr,
-                                     CSA_SourceLen,       todo,
-                                     CSA_SourceCodeset,   srcCodeset,
-                                     CSA_DestLenPtr,      &strLen,
-                                     TAG_DONE);
 
-      if(str != NULL && strLen > 0)
-      {
-        // if we end up here we successfully converted the
-        // sourcebuffer to a destination buffer which complies to our local
-        // charset
-        dptr = (unsigned char *)str;
-        todo = strLen;
-      }
-      else
-        W(DBF_MIME, "error while trying to convert qpdecoded string to UTF8");
+      decoded += todo;
     }
-
-    // now we do a binary write of the data
-    if(fwrite(dptr, 1, todo, out) != todo)
-    {
-      E(DBF_MIME, "error on writing data!");
-
-      // in case the dptr buffer was allocated by codesets.library,
-      // we have to free it now
-      if(dptr != outbuffer)
-        CodesetsFreeA(dptr, NULL);
-
-      // an error must have occurred.
-      RETURN(-1);
-      return -1;
-    }
-
-    // in case the dptr buffer was allocated by codesets.library,
-    // we have to free it now
-    if(dptr != outbuffer)
-      CodesetsFreeA(dptr, NULL);
   }
 
-  // if we end up here and read > 0 then the decoding wasn't finished
-  // and we have to return an error
-  if(read > 0)
+  // if we end up here and there are still unparsed chars left
+  // then the decoding wasn't finished and we have to return an error
+  if(next_unget > 0)
   {
     RETURN(-2);
     return -2; // -2 means "unfinished decoding"
@@ -525,8 +389,28 @@ long qpdecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
 
   // on success lets return the number of decoded
   // chars
-  RETURN(result == 0 ? decoded : result);
-  return result == 0 ? decoded : result;
+  RETURN(warning == 0 ? decoded : warning);
+  return warning == 0 ? decoded : warning;
+}
+
+///
+/// qpdecode_file()
+// decodes the contents of file 'in' and writes them to file 'out'
+long qpdecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
+{
+  struct MimeStream inStream;
+  struct MimeStream outStream;
+  long result;
+
+  ENTER();
+
+  mimestream_file(&inStream, in);
+  mimestream_file(&outStream, out);
+
+  result = qpdecode_stream(&inStream, &outStream, srcCodeset, isText);
+
+  RETURN(result);
+  return result;
 }
 
 ///
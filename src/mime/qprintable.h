@@ -32,10 +32,12 @@
 
 // forward declarations
 struct codeset;
+struct MimeStream;
 
 // quoted-printable encoding/decoding routines
 long qpencode_file(FILE *in, FILE *out);
 long qpdecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText);
+long qpdecode_stream(struct MimeStream *in, struct MimeStream *out, struct codeset *srcCodeset, BOOL isText);
 
 // macros & static variables
 static const char basis_hex[] = "0123456789ABCDEF";
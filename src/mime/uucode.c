@@ -34,7 +34,9 @@
 
 #include "YAM.h"
 
+#include "mime/mimestream.h"
 #include "mime/qprintable.h"
+#include "mime/uucode.h"
 
 #include "Config.h"
 
@@ -217,12 +219,12 @@ long uuencode_file(FILE *in, FILE *out)
 }
 
 ///
-/// uudecode_file()
+/// uudecode_stream()
 // Decode a UUencoded file using separate input/output buffers to speed up
 // processing. It also takes respect of eventually existing checksums and
 // tries to validate the UUencoded file to conform to the BSD standard or
 // otherwise return an error/warning by returning negative values.
-long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
+long uudecode_stream(struct MimeStream *in, struct MimeStream *out, struct codeset *srcCodeset, BOOL isText)
 {
   unsigned char inbuffer[UUDEC_IBUF+1]; // we read out data in ~4500 byte chunks
   unsigned char outbuffer[UUDEC_OBUF+1];// the output buffer
@@ -244,14 +246,14 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
   // the starting "begin XXX" line
   do
   {
-    if(fgets((char *)inbuffer, UUDEC_IBUF, in) != 0)
+    if(mimestream_gets(in, (char *)inbuffer, UUDEC_IBUF) != NULL)
     {
       // check if this line start with "begin " and if so
       // break out and continue decoding the real data
       if(strncmp((char *)inbuffer, "begin ", 6) == 0)
         break;
     }
-    else if(feof(in) != 0)
+    else if(mimestream_eof(in) == TRUE)
     {
       RETURN(-2);
       return -2; // -2 means "no UUcode start found"
@@ -268,15 +270,15 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
   while(eof_reached == FALSE)
   {
     // do a binary read of a multiple of UUDEC_IBUF
-    read = fread(&inbuffer[next_unget], sizeof(char), UUDEC_IBUF-next_unget, in);
+    read = mimestream_read(in, &inbuffer[next_unget], UUDEC_IBUF-next_unget);
 
     // on a short item count we check for a potential
     // error and return immediatly.
     if(read != UUDEC_IBUF-next_unget)
     {
-      if(feof(in) != 0)
+      if(mimestream_eof(in) == TRUE)
       {
-        D(DBF_MIME, "EOF file at %ld", ftell(in));
+        D(DBF_MIME, "EOF reached");
 
         eof_reached = TRUE; // we found an EOF
 
@@ -349,7 +351,7 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
               memcpy(inbuffer, iptr, read);
 
               // do a small binary read
-              read += fread(&inbuffer[read], sizeof(char), 3-read, in);
+              read += mimestream_read(in, &inbuffer[read], 3-read);
 
               iptr = inbuffer;
             }
@@ -476,7 +478,7 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
           }
 
           // now we do a binary write of the data
-          if(fwrite(dptr, 1, todo, out) != todo)
+          if(mimestream_write(out, dptr, todo) != todo)
           {
             E(DBF_MIME, "error on writing data!");
 
@@ -611,7 +613,7 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
     }
 
     // now we do a binary write of the data
-    if(fwrite(dptr, 1, todo, out) != todo)
+    if(mimestream_write(out, dptr, todo) != todo)
     {
       E(DBF_MIME, "error on writing data!");
 
@@ -638,3 +640,23 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
 }
 
 ///
+/// uudecode_file()
+// decodes the contents of file 'in' and writes them to file 'out'
+long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
+{
+  struct MimeStream inStream;
+  struct MimeStream outStream;
+  long result;
+
+  ENTER();
+
+  mimestream_file(&inStream, in);
+  mimestream_file(&outStream, out);
+
+  result = uudecode_stream(&inStream, &outStream, srcCodeset, isText);
+
+  RETURN(result);
+  return result;
+}
+
+///
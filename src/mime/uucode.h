@@ -32,9 +32,11 @@
 
 // forward declarations
 struct codeset;
+struct MimeStream;
 
 // uucode encoding/decoding routines
 long uuencode_file(FILE *in, FILE *out);
 long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText);
+long uudecode_stream(struct MimeStream *in, struct MimeStream *out, struct codeset *srcCodeset, BOOL isText);
 
 #endif // UUCODE_H
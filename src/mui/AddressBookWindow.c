@@ -962,6 +962,7 @@ DECLARE(UpdateOldEntry) // Object *editWindow, struct MUI_NListtree_TreeNode *tn
     {
       // copy everything back
       memcpy(oldABN, &abn, sizeof(*oldABN));
+      InvalidateABookIndexes(&G->abook);
 
       // update the listtree and mark the address book as modified
       DoMethod(data->LV_ADDRESSES, MUIM_NListtree_Redraw, msg->tn, MUIF_NONE);
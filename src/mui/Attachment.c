@@ -339,6 +339,7 @@ DECLARE(Display)
       fileName = SuggestPartFileName(data->mailPart);
 
       // run our MIME routines for displaying the part to the user
+      RE_FlushPart(data->mailPart);
       RE_DisplayMIME(data->mailPart->Filename, fileName,
                      data->mailPart->ContentType, isPrintable(data->mailPart));
 
@@ -388,6 +389,7 @@ DECLARE(Save)
 
       fileName = SuggestPartFileName(rp);
 
+      RE_FlushPart(rp);
       RE_Export(rp->rmData,
                 rp->Filename,
                 "",
@@ -451,6 +453,7 @@ DECLARE(Print)
 
     busy = BusyBegin(BUSY_TEXT);
     BusyText(busy, tr(MSG_BusyDecPrinting), "");
+    RE_FlushPart(data->mailPart);
     RE_PrintFile(data->mailPart->Filename, _win(obj));
     BusyEnd(busy);
   }
@@ -492,6 +495,7 @@ DECLARE(ImageDropped) // const char *dropPath
     // then add the file name to the drop path
     AddPath(filePathBuf, msg->dropPath, fileName, sizeof(filePathBuf));
 
+    RE_FlushPart(data->mailPart);
     result = RE_Export(data->mailPart->rmData,
                        data->mailPart->Filename,
                        filePathBuf,
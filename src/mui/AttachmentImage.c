@@ -274,7 +274,8 @@ static void LoadImage(struct IClass *cl, Object *obj)
     // we first make sure we have freed everything
     UnloadImage(data);
 
-    if(isDecoded(mailPart) == TRUE && mailPart->Filename[0] != '\0')
+    // the icon is identified by the contents of the part's file
+    if(isDecoded(mailPart) == TRUE && mailPart->Filename[0] != '\0' && RE_FlushPart(mailPart) == TRUE)
     {
       iconFile = mailPart->Filename;
     }
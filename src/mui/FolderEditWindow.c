@@ -69,6 +69,7 @@
 #include "MUIObjects.h"
 #include "Requesters.h"
 #include "Signature.h"
+#include "TextIndex.h"
 #include "UserIdentity.h"
 
 #include "Debug.h"
@@ -92,6 +93,7 @@ struct Data
   Object *CH_STATS;
   Object *CH_JUMPTOUNREAD;
   Object *CH_JUMPTORECENT;
+  Object *CH_FULLTEXTINDEX;
   Object *CH_MLSUPPORT;
   Object *BT_AUTODETECT;
   Object *BT_OKAY;
@@ -138,6 +140,7 @@ static BOOL CompareFolders(const struct Folder *fo1, const struct Folder *fo2)
      fo1->Stats                 != fo2->Stats ||
      fo1->JumpToUnread          != fo2->JumpToUnread ||
      fo1->JumpToRecent          != fo2->JumpToRecent ||
+     fo1->FullTextIndex         != fo2->FullTextIndex ||
      fo1->MLSupport             != fo2->MLSupport)
   {
     equal = FALSE;
@@ -312,6 +315,12 @@ static BOOL SaveOldFolder(struct IClass *cl, Object *obj)
       data->oldFolder->JumpToRecent = folder.JumpToRecent;
       data->oldFolder->MLSupport    = folder.MLSupport;
 
+      // throw away the full-text index if it is no longer wanted
+      if(data->oldFolder->FullTextIndex == TRUE && folder.FullTextIndex == FALSE)
+        TextIndexDelete(data->oldFolder);
+
+      data->oldFolder->FullTextIndex = folder.FullTextIndex;
+
       if(xget(data->CY_FTYPE, MUIA_Disabled) == FALSE)
       {
         enum FolderMode oldmode = data->oldFolder->Mode;
@@ -553,6 +562,7 @@ OVERLOAD(OM_NEW)
   Object *CH_STATS;
   Object *CH_JUMPTOUNREAD;
   Object *CH_JUMPTORECENT;
+  Object *CH_FULLTEXTINDEX;
   Object *CH_MLSUPPORT;
   Object *BT_AUTODETECT;
   Object *BT_OKAY;
@@ -639,6 +649,8 @@ OVERLOAD(OM_NEW)
         Child, MakeCheckGroup(&CH_JUMPTOUNREAD, tr(MSG_FO_JUMP_TO_UNREAD_MESSAGE)),
         Child, HSpace(0),
         Child, MakeCheckGroup(&CH_JUMPTORECENT, tr(MSG_FO_JUMP_TO_RECENT_MESSAGE)),
+        Child, HSpace(0),
+        Child, MakeCheckGroup(&CH_FULLTEXTINDEX, tr(MSG_FO_FULLTEXT_INDEX)),
       End,
       Child, GR_MLPRORPERTIES = ColGroup(2), GroupFrameT(tr(MSG_FO_MLSupport)),
         MUIA_ShowMe, FALSE,
@@ -692,6 +704,7 @@ OVERLOAD(OM_NEW)
     data->CH_STATS            = CH_STATS;
     data->CH_JUMPTOUNREAD     = CH_JUMPTOUNREAD;
     data->CH_JUMPTORECENT     = CH_JUMPTORECENT;
+    data->CH_FULLTEXTINDEX    = CH_FULLTEXTINDEX;
     data->CH_MLSUPPORT        = CH_MLSUPPORT;
     data->BT_AUTODETECT       = BT_AUTODETECT;
     data->BT_OKAY             = BT_OKAY;
@@ -724,6 +737,7 @@ OVERLOAD(OM_NEW)
     SetHelp(CH_STATS,        MSG_HELP_FO_CH_STATS);
     SetHelp(CH_JUMPTOUNREAD, MSG_HELP_FO_CH_JUMPTOUNREAD);
     SetHelp(CH_JUMPTORECENT, MSG_HELP_FO_CH_JUMPTORECENT);
+    SetHelp(CH_FULLTEXTINDEX, MSG_HELP_FO_CH_FULLTEXTINDEX);
     SetHelp(CH_EXPIREUNREAD, MSG_HELP_FO_CH_EXPIREUNREAD);
     SetHelp(CH_MLSUPPORT,    MSG_HELP_FO_CH_MLSUPPORT);
     SetHelp(BT_AUTODETECT,   MSG_HELP_FO_BT_AUTODETECT);
@@ -832,6 +846,7 @@ DECLARE(FolderToGUI)
   set(data->CH_STATS,        MUIA_Selected, folder->Stats);
   set(data->CH_JUMPTOUNREAD, MUIA_Selected, folder->JumpToUnread);
   set(data->CH_JUMPTORECENT, MUIA_Selected, folder->JumpToRecent);
+  set(data->CH_FULLTEXTINDEX, MUIA_Selected, folder->FullTextIndex);
   xset(data->ST_HELLOTEXT, MUIA_String_Contents, folder->WriteIntro,
                            MUIA_Disabled,        isArchive);
   xset(data->ST_BYETEXT,   MUIA_String_Contents, folder->WriteGreetings,
@@ -900,6 +915,7 @@ DECLARE(GUIToFolder) // struct Folder *folder
   folder->Stats = GetMUICheck(data->CH_STATS);
   folder->JumpToUnread = GetMUICheck(data->CH_JUMPTOUNREAD);
   folder->JumpToRecent = GetMUICheck(data->CH_JUMPTORECENT);
+  folder->FullTextIndex = GetMUICheck(data->CH_FULLTEXTINDEX);
 
   GetMUIString(folder->WriteIntro, data->ST_HELLOTEXT, sizeof(folder->WriteIntro));
   GetMUIString(folder->WriteGreetings, data->ST_BYETEXT, sizeof(folder->WriteGreetings));
@@ -1025,8 +1041,8 @@ DECLARE(MLAutoDetect)
     {
       #define SCANMSGS  5
       struct MailNode *mnode;
-      char *toPattern;
-      char *toAddress;
+      const char *toPattern;
+      const char *toAddress;
       char *res = NULL;
       BOOL takePattern = TRUE;
       BOOL takeAddress = TRUE;
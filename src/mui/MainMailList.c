@@ -50,6 +50,7 @@
 #include "BayesFilter.h"
 #include "Busy.h"
 #include "Config.h"
+#include "HashTable.h"
 #include "Locale.h"
 #include "MailList.h"
 #include "MUIObjects.h"
@@ -71,6 +72,7 @@ struct Data
   char context_menu_title[SIZE_DEFAULT];
   BOOL inSearchWindow;
   LONG helpEntry;
+  struct HashTable *sortKeys;
 };
 */
 
@@ -82,18 +84,35 @@ struct Data
 #define NUMBER_MAILLIST_COLUMNS 9
 */
 
+/* Private Definitions */
+// the sort keys of a mail which are expensive to calculate. Each key is
+// calculated on first use only. The keys are kept during a single sort or
+// sorted insert operation only and hence can't get outdated by changes of
+// the mails.
+struct MailSortKey
+{
+  struct HashEntryHeader header;
+  void *key;           // the mail
+  const char *name;    // sender/recipient name, resolved via the address book
+  const char *subject; // subject without reply prefixes and mailing list names
+  int status;          // the status score
+  ULONG valid;         // the keys which are calculated already
+};
+
+#define SKF_STATUS  (1<<0)
+#define SKF_NAME    (1<<1)
+#define SKF_SUBJECT (1<<2)
+
 /* Private Functions */
-/// MailCompare
-//  Compares two messages
-static int MailCompare(struct Mail *entry1, struct Mail *entry2, LONG column)
+/// CalcSortKey
+//  Calculates a sort key of a mail
+static void CalcSortKey(struct MailSortKey *sortKey, const struct Mail *mail, const ULONG which)
 {
-  switch (column)
+  switch(which)
   {
-    case 0:
+    case SKF_STATUS:
     {
-      // lets calculate each value
-      int status1 = 0;
-      int status2 = 0;
+      int status = 0;
 
       // We do not sort on other things than the real status and the Importance+Marked flag of
       // the message because this would be confusing if you use "Status" as a sorting
@@ -103,70 +122,134 @@ static int MailCompare(struct Mail *entry1, struct Mail *entry2, LONG column)
       // depending on other stuff than importance will make it impossible to sort for
       // status+date in the folder config. Perhaps we need to have a configuable way for
       // sorting by status later, but this is future stuff..
-      status1 += hasStatusNew(entry1) ? 512 : 0;
-      status2 += hasStatusNew(entry2) ? 512 : 0;
-      status1 += !hasStatusRead(entry1) ? 256 : 0;
-      status2 += !hasStatusRead(entry2) ? 256 : 0;
-      status1 += !hasStatusError(entry1) ? 256 : 0;
-      status2 += !hasStatusError(entry2) ? 256 : 0;
-      status1 += hasStatusReplied(entry1) ? 64 : 0;
-      status2 += hasStatusReplied(entry2) ? 64 : 0;
-      status1 += hasStatusForwarded(entry1) ? 32 : 0;
-      status2 += hasStatusForwarded(entry2) ? 32 : 0;
-      status1 += hasStatusSent(entry1) ? 32 : 0;
-      status2 += hasStatusSent(entry2) ? 32 : 0;
-      status1 += hasStatusMarked(entry1) ? 8  : 0;
-      status2 += hasStatusMarked(entry2) ? 8  : 0;
-      status1 += (getImportanceLevel(entry1) == IMP_HIGH) ? 16 : 0;
-      status2 += (getImportanceLevel(entry2) == IMP_HIGH) ? 16 : 0;
-
-      return -(status1)+(status2);
+      status += hasStatusNew(mail) ? 512 : 0;
+      status += !hasStatusRead(mail) ? 256 : 0;
+      status += !hasStatusError(mail) ? 256 : 0;
+      status += hasStatusReplied(mail) ? 64 : 0;
+      status += hasStatusForwarded(mail) ? 32 : 0;
+      status += hasStatusSent(mail) ? 32 : 0;
+      status += hasStatusMarked(mail) ? 8  : 0;
+      status += (getImportanceLevel(mail) == IMP_HIGH) ? 16 : 0;
+
+      sortKey->status = status;
     }
     break;
 
-    case 1:
+    case SKF_NAME:
     {
-      struct Person *pe1;
-      struct Person *pe2;
-      char *addr1;
-      char *addr2;
+      const struct MailPerson *pe;
 
-      if(isSentMailFolder(entry1->Folder))
-      {
-        pe1 = &entry1->To;
-        pe2 = &entry2->To;
-      }
+      if(isSentMailFolder(mail->Folder))
+        pe = &mail->To;
       else
-      {
-        pe1 = &entry1->From;
-        pe2 = &entry2->From;
-      }
+        pe = &mail->From;
+
+      sortKey->name = AddrName(*pe);
 
       // in case the user wants to take the additional pain
       // of performing an addressbook lookup for every entry in the
       // list we do it right here.
       if(C->ABookLookup == TRUE)
       {
-        struct ABookNode *abn1;
-        struct ABookNode *abn2;
+        struct ABookNode *abn;
 
-        if((abn1 = FindPersonInABook(&G->abook, pe1)) != NULL)
-          addr1 = abn1->RealName[0] != '\0' ? abn1->RealName : AddrName(*pe1);
-        else
-          addr1 = AddrName(*pe1);
-
-        if((abn2 = FindPersonInABook(&G->abook, pe2)) != NULL)
-          addr2 = abn2->RealName[0] != '\0' ? abn2->RealName : AddrName(*pe2);
-        else
-          addr2 = AddrName(*pe2);
-      }
-      else
-      {
-        addr1 = AddrName(*pe1);
-        addr2 = AddrName(*pe2);
+        if((abn = FindAddressInABook(&G->abook, pe->Address)) != NULL && abn->RealName[0] != '\0')
+          sortKey->name = abn->RealName;
       }
+    }
+    break;
 
-      return stricmp(addr1, addr2);
+    case SKF_SUBJECT:
+    {
+      sortKey->subject = MA_GetRealSubject(mail->Subject);
+    }
+    break;
+  }
+
+  sortKey->valid |= which;
+}
+
+///
+/// GetSortKey
+//  Returns the sort keys of a mail with the requested key being calculated.
+//  Outside of a sort operation the supplied temporary structure is used.
+static const struct MailSortKey *GetSortKey(struct Data *data, struct Mail *mail, const ULONG which, struct MailSortKey *tempKey)
+{
+  struct MailSortKey *sortKey = NULL;
+
+  if(data->sortKeys != NULL)
+  {
+    if((sortKey = (struct MailSortKey *)HashTableOperate(data->sortKeys, mail, htoAdd)) != NULL)
+      sortKey->key = mail;
+  }
+
+  if(sortKey == NULL)
+  {
+    tempKey->valid = 0;
+    sortKey = tempKey;
+  }
+
+  if(isFlagClear(sortKey->valid, which))
+    CalcSortKey(sortKey, mail, which);
+
+  return sortKey;
+}
+
+///
+/// BeginSortKeys
+//  Sets up the cache for the sort keys of the given number of mails
+static void BeginSortKeys(struct Data *data, const LONG numEntries)
+{
+  ENTER();
+
+  // comparing without cached keys still works in case this fails
+  data->sortKeys = HashTableNew(HashTableGetDefaultOps(), NULL, sizeof(struct MailSortKey), numEntries);
+
+  LEAVE();
+}
+
+///
+/// EndSortKeys
+//  Throws away all cached sort keys
+static void EndSortKeys(struct Data *data)
+{
+  ENTER();
+
+  if(data->sortKeys != NULL)
+  {
+    HashTableDestroy(data->sortKeys);
+    data->sortKeys = NULL;
+  }
+
+  LEAVE();
+}
+
+///
+/// MailCompare
+//  Compares two messages
+static int MailCompare(struct Data *data, struct Mail *entry1, struct Mail *entry2, LONG column)
+{
+  // the keys are fetched one after the other as looking up the second
+  // one may move the first one within the cache
+  struct MailSortKey tempKey;
+
+  switch (column)
+  {
+    case 0:
+    {
+      int status1 = GetSortKey(data, entry1, SKF_STATUS, &tempKey)->status;
+      int status2 = GetSortKey(data, entry2, SKF_STATUS, &tempKey)->status;
+
+      return -(status1)+(status2);
+    }
+    break;
+
+    case 1:
+    {
+      const char *name1 = GetSortKey(data, entry1, SKF_NAME, &tempKey)->name;
+      const char *name2 = GetSortKey(data, entry2, SKF_NAME, &tempKey)->name;
+
+      return stricmp(name1, name2);
     }
     break;
 
@@ -178,7 +261,10 @@ static int MailCompare(struct Mail *entry1, struct Mail *entry2, LONG column)
 
     case 3:
     {
-      return stricmp(MA_GetRealSubject(entry1->Subject), MA_GetRealSubject(entry2->Subject));
+      const char *subject1 = GetSortKey(data, entry1, SKF_SUBJECT, &tempKey)->subject;
+      const char *subject2 = GetSortKey(data, entry2, SKF_SUBJECT, &tempKey)->subject;
+
+      return stricmp(subject1, subject2);
     }
     break;
 
@@ -378,6 +464,7 @@ OVERLOAD(MUIM_NList_Destruct)
 //  Message listview compare method
 OVERLOAD(MUIM_NList_Compare)
 {
+  GETDATA;
   struct MUIP_NList_Compare *ncm = (struct MUIP_NList_Compare *)msg;
   struct Mail *entry1 = (struct Mail *)ncm->entry1;
   struct Mail *entry2 = (struct Mail *)ncm->entry2;
@@ -393,8 +480,8 @@ OVERLOAD(MUIM_NList_Compare)
     return 0;
   }
 
-  if(ncm->sort_type1 & MUIV_NList_TitleMark_TypeMask) cmp = MailCompare(entry2, entry1, col1);
-  else                                                cmp = MailCompare(entry1, entry2, col1);
+  if(ncm->sort_type1 & MUIV_NList_TitleMark_TypeMask) cmp = MailCompare(data, entry2, entry1, col1);
+  else                                                cmp = MailCompare(data, entry1, entry2, col1);
 
   if(cmp != 0 || col1 == col2)
   {
@@ -402,13 +489,92 @@ OVERLOAD(MUIM_NList_Compare)
     return cmp;
   }
 
-  if(ncm->sort_type2 & MUIV_NList_TitleMark2_TypeMask) cmp = MailCompare(entry2, entry1, col2);
-  else                                                 cmp = MailCompare(entry1, entry2, col2);
+  if(ncm->sort_type2 & MUIV_NList_TitleMark2_TypeMask) cmp = MailCompare(data, entry2, entry1, col2);
+  else                                                 cmp = MailCompare(data, entry1, entry2, col2);
 
   RETURN(cmp);
   return cmp;
 }
 
+///
+/// OVERLOAD(MUIM_NList_Sort)
+//  Sorts the list with a cache of the sort keys
+OVERLOAD(MUIM_NList_Sort)
+{
+  GETDATA;
+  IPTR result;
+
+  ENTER();
+
+  BeginSortKeys(data, xget(obj, MUIA_NList_Entries));
+  result = DoSuperMethodA(cl, obj, msg);
+  EndSortKeys(data);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// OVERLOAD(MUIM_NList_Sort2)
+//  Sorts the list with a cache of the sort keys
+OVERLOAD(MUIM_NList_Sort2)
+{
+  GETDATA;
+  IPTR result;
+
+  ENTER();
+
+  BeginSortKeys(data, xget(obj, MUIA_NList_Entries));
+  result = DoSuperMethodA(cl, obj, msg);
+  EndSortKeys(data);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// OVERLOAD(MUIM_NList_Sort3)
+//  Sorts the list with a cache of the sort keys
+OVERLOAD(MUIM_NList_Sort3)
+{
+  GETDATA;
+  IPTR result;
+
+  ENTER();
+
+  BeginSortKeys(data, xget(obj, MUIA_NList_Entries));
+  result = DoSuperMethodA(cl, obj, msg);
+  EndSortKeys(data);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// OVERLOAD(MUIM_NList_Insert)
+//  Inserts several mails with a cache of the sort keys if they are sorted in
+OVERLOAD(MUIM_NList_Insert)
+{
+  GETDATA;
+  struct MUIP_NList_Insert *nim = (struct MUIP_NList_Insert *)msg;
+  IPTR result;
+
+  ENTER();
+
+  // single mails are compared to a few others only, that's not worth it
+  if(nim->pos == MUIV_NList_Insert_Sorted && nim->count != 1)
+  {
+    BeginSortKeys(data, xget(obj, MUIA_NList_Entries) + MAX(nim->count, 0));
+    result = DoSuperMethodA(cl, obj, msg);
+    EndSortKeys(data);
+  }
+  else
+    result = DoSuperMethodA(cl, obj, msg);
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// OVERLOAD(MUIM_NList_Display)
 OVERLOAD(MUIM_NList_Display)
@@ -456,8 +622,8 @@ OVERLOAD(MUIM_NList_Display)
       if(hasMColSender(C->MessageCols) || data->inSearchWindow == TRUE)
       {
         BOOL toPrefix = FALSE;
-        struct Person *pe;
-        char *addr = NULL;
+        const struct MailPerson *pe;
+        const char *addr = NULL;
 
         if(((isCustomMixedFolder(mail->Folder) || isTrashFolder(mail->Folder) || isSpamFolder(mail->Folder)) &&
             (hasStatusSent(mail) || hasStatusError(mail))) || (data->inSearchWindow == TRUE && isSentMailFolder(mail->Folder)))
@@ -477,7 +643,7 @@ OVERLOAD(MUIM_NList_Display)
         {
           struct ABookNode *abn;
 
-          if((abn = FindPersonInABook(&G->abook, pe)) != NULL)
+          if((abn = FindAddressInABook(&G->abook, pe->Address)) != NULL)
           {
             if(abn->RealName[0] != '\0')
               addr = abn->RealName;
@@ -512,12 +678,12 @@ OVERLOAD(MUIM_NList_Display)
           ndm->strings[2] = data->replytoBuffer;
         }
         else
-          ndm->strings[2] = AddrName(mail->ReplyTo);
+          ndm->strings[2] = (STRPTR)AddrName(mail->ReplyTo);
       }
 
       // then the Subject
       if(IsStrEmpty(mail->Subject) == FALSE)
-        ndm->strings[3] = mail->Subject;
+        ndm->strings[3] = (STRPTR)mail->Subject;
       else
         ndm->strings[3] = (char *)tr(MSG_MA_NO_SUBJECT);
 
@@ -533,7 +699,7 @@ OVERLOAD(MUIM_NList_Display)
         FormatSize(mail->Size, data->sizeBuffer, sizeof(data->sizeBuffer), SF_AUTO);
       }
 
-      ndm->strings[6] = mail->MailFile;
+      ndm->strings[6] = (STRPTR)mail->MailFile;
 
       // we first copy the Date Received/sent because this would probably be not
       // set by all ppl and strcpy() is costy ;)
@@ -543,7 +709,7 @@ OVERLOAD(MUIM_NList_Display)
         ndm->strings[7] = data->date2Buffer;
       }
 
-      ndm->strings[8] = mail->MailAccount;
+      ndm->strings[8] = (STRPTR)mail->MailAccount;
 
       // The Folder is just a dummy entry to serve the SearchMailWindow DisplayHook
       ndm->strings[9] = mail->Folder->Name;
@@ -699,7 +865,7 @@ OVERLOAD(MUIM_NList_ContextMenuBuild)
         BOOL isArchive = isArchiveFolder(fo);
         BOOL hasattach = FALSE;
         ULONG numSelected = 0;
-        struct Person *pers = isSentMail ? &mail->To : &mail->From;
+        const struct MailPerson *pers = isSentMail ? &mail->To : &mail->From;
         char address[SIZE_LARGE];
         Object *afterThis;
 
@@ -51,6 +51,7 @@
 #include "Locale.h"
 #include "MailList.h"
 #include "MUIObjects.h"
+#include "TextIndex.h"
 
 #include "mui/AddressBookWindow.h"
 #include "mui/MainMailListGroup.h"
@@ -109,7 +110,8 @@ enum SearchFlags
 // function to actually check if a struct Mail* matches
 // the currently active criteria
 static BOOL MatchMail(const struct Mail *mail, enum ViewOptions vo,
-                      ULONG searchFlags, const struct BoyerMooreContext *bmContext, struct TimeVal *curTimeUTC)
+                      ULONG searchFlags, const struct BoyerMooreContext *bmContext,
+                      struct TextIndexQuery *textQuery, struct TimeVal *curTimeUTC)
 {
   BOOL foundMatch = FALSE;
 
@@ -159,7 +161,7 @@ static BOOL MatchMail(const struct Mail *mail, enum ViewOptions vo,
     // check if the mail comes from a person we know
     case VO_KNOWNPEOPLE:
     {
-      foundMatch = (FindPersonInABook(&G->abook, &mail->From) != NULL);
+      foundMatch = (FindAddressInABook(&G->abook, mail->From.Address) != NULL);
       if(foundMatch == FALSE && isMultiSenderMail(mail))
       {
         struct ExtendedMail *email;
@@ -271,10 +273,15 @@ static BOOL MatchMail(const struct Mail *mail, enum ViewOptions vo,
     if(foundMatch == FALSE && isFlagSet(searchFlags, SF_BODY))
     {
       struct ReadMailData *rmData;
+      enum TextIndexResult indexResult;
+
+      // ask the folder's full-text index first
+      indexResult = TextIndexMatchMail(textQuery, mail);
+      foundMatch = (indexResult == TIR_MATCH);
 
       // allocate a private readmaildata object in which we readin
       // the mail text
-      if((rmData = AllocPrivateRMData(mail, PM_TEXTS)) != NULL)
+      if(indexResult == TIR_UNKNOWN && (rmData = AllocPrivateRMData(mail, PM_TEXTS)) != NULL)
       {
         char *cmsg;
 
@@ -656,6 +663,7 @@ DECLARE(ProcessSearch)
     char *searchString = (char *)xget(data->ST_SEARCHSTRING, MUIA_String_Contents);
     struct TimeVal curTimeUTC;
     struct BoyerMooreContext *bmContext;
+    struct TextIndexQuery *textQuery = NULL;
     struct BusyNode *busy;
 
     // get the current time in UTC
@@ -678,6 +686,10 @@ DECLARE(ProcessSearch)
     if(xget(data->BT_BODY, MUIA_Selected) == TRUE)
       setFlag(searchFlags, SF_BODY);
 
+    // a body search may be answered by the folder's full-text index
+    if(searchString != NULL && isFlagSet(searchFlags, SF_BODY))
+      textQuery = TextIndexCreateQuery(searchString, FALSE, TRUE);
+
     // make sure the correct mailview list is visible and quiet
     DoMethod(G->MA->GUI.PG_MAILLIST, MUIM_MainMailListGroup_SwitchToList, LT_QUICKVIEW);
     set(G->MA->GUI.PG_MAILLIST, MUIA_NList_Quiet, TRUE);
@@ -698,7 +710,7 @@ DECLARE(ProcessSearch)
       struct Mail *curMail = mnode->mail;
 
       // check if that mail matches the search/view criteria
-      if(MatchMail(curMail, viewOption, searchFlags, bmContext, &curTimeUTC) == TRUE)
+      if(MatchMail(curMail, viewOption, searchFlags, bmContext, textQuery, &curTimeUTC) == TRUE)
         DoMethod(G->MA->GUI.PG_MAILLIST, MUIM_MainMailListGroup_AddMailToList, LT_QUICKVIEW, curMail);
 
       DoMethod(_app(obj), MUIM_Application_InputBuffered);
@@ -711,6 +723,7 @@ DECLARE(ProcessSearch)
     UnlockMailList(curFolder->messages);
 
     BoyerMooreCleanup(bmContext);
+    TextIndexDeleteQuery(textQuery);
 
     // only update the GUI if this search was not aborted
     if(data->abortSearch == FALSE)
@@ -779,7 +792,7 @@ DECLARE(MatchMail) // struct Mail *mail
 
   // now we check that a match is really required and if so we process it
   match = (ULONG)((viewOption != VO_ALL || searchString != NULL) &&
-                  MatchMail(msg->mail, viewOption, searchFlags, bmContext, &curTimeUTC) == TRUE);
+                  MatchMail(msg->mail, viewOption, searchFlags, bmContext, NULL, &curTimeUTC) == TRUE);
 
   BoyerMooreCleanup(bmContext);
 
@@ -1107,7 +1107,7 @@ DECLARE(UpdateHeaderDisplay) // ULONG flags
 {
   GETDATA;
   struct ReadMailData *rmData = data->readMailData;
-  struct Person *from = &rmData->mail->From;
+  const struct MailPerson *from = &rmData->mail->From;
   struct ABookNode *ab = NULL;
   struct ABookNode abtmpl;
   BOOL foundIdentity;
@@ -1384,6 +1384,8 @@ DECLARE(CheckPGPSignature) // ULONG forceRequester
         // decode the letter part first, otherwise PGP might want to check
         // a still encoded file which definitely will fail.
         RE_DecodePart(letterPart);
+        RE_FlushPart(letterPart);
+        RE_FlushPart(pgpPart);
 
         snprintf(options, sizeof(options), (G->PGPVersion == 5) ? "%s -o %s +batchmode=1 +force +language=us" : "%s %s +bat +f +lang=en", pgpPart->Filename, letterPart->Filename);
         error = PGPCommand((G->PGPVersion == 5) ? "pgpv": "pgp", options, KEEPLOG);
@@ -1572,6 +1574,7 @@ DECLARE(SaveDecryptedMail)
       {
         struct WritePart *p1 = comp.FirstPart;
 
+        RE_FlushPart(rmData->firstPart->Next);
         p1->Filename = rmData->firstPart->Next->Filename;
         WriteOutMessage(&comp);
         FreePartsList(p1, TRUE);
@@ -1697,6 +1700,7 @@ DECLARE(SaveMailRequest)
 
           suggestedFileName = SuggestPartFileName(part);
 
+          RE_FlushPart(part);
           RE_Export(rmData, part->Filename, "",
                     suggestedFileName, part->Nr,
                     FALSE, FALSE, part->ContentType);
@@ -1757,7 +1761,10 @@ DECLARE(PrintMailRequest)
         break;
 
         default:
+        {
+          RE_FlushPart(part);
           RE_PrintFile(part->Filename, _win(obj));
+        }
       }
     }
 
@@ -1805,6 +1812,7 @@ DECLARE(DisplayMailRequest)
           // get the suggested filename for the mail part
           fileName = SuggestPartFileName(part);
 
+          RE_FlushPart(part);
           RE_DisplayMIME(part->Filename, fileName,
                          part->ContentType, isPrintable(part));
 
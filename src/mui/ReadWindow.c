@@ -931,7 +931,7 @@ DECLARE(CopyMailRequest)
 
         if(MA_NewMailFile(dstfolder, mfilePath, sizeof(mfilePath)) == TRUE)
         {
-          strlcpy(mail->MailFile, FilePart(mfilePath), sizeof(mail->MailFile));
+          SetMailFile(mail, FilePart(mfilePath));
           if(RE_Export(rmData, rmData->readFile, mfilePath, "", 0, FALSE, FALSE, IntMimeTypeArray[MT_ME_EMAIL].ContentType) == TRUE)
           {
             struct Mail *newmail;
@@ -566,6 +566,8 @@ DECLARE(PrepareSearch) // struct Search *search
     setFlag(flags, SEARCHF_DOS_PATTERN);
   if(GetMUICheck(data->CH_SKIPENCRYPTED[pg]) == TRUE)
     setFlag(flags, SEARCHF_SKIP_ENCRYPTED);
+  // this is an interactive search, so the full-text indexes may be used
+  setFlag(flags, SEARCHF_TEXT_INDEX);
 
   FI_PrepareSearch(msg->search,
                    GetMUICycle(data->CY_MODE[data->remoteFilterMode]),
@@ -54,6 +54,7 @@
 #include "UIDL.h"
 #include "UserIdentity.h"
 
+#include "tcp/imap.h"
 #include "tcp/ssl.h"
 
 #include "Debug.h"
@@ -1168,8 +1169,9 @@ DECLARE(DeletePOP3Entry)
     // remove it from the internal mail server list as well.
     Remove((struct Node *)msn);
 
-    // delete a possibly existing UIDL database file
+    // delete a possibly existing UIDL database or IMAP state file
     DeleteUIDLfile(msn);
+    DeleteIMAPStateFile(msn);
 
     FreeSysObject(ASOT_NODE, msn);
   }
@@ -221,7 +221,8 @@ OVERLOAD(OM_DISPOSE)
   // remove the notification
   DoMethod(G->App, MUIM_KillNotifyObj, MUIA_Application_Iconified, obj);
 
-  // close the downloaded update file
+  // close the downloaded update file and forget its validators
+  DeleteURLValidators(data->tempFile->Filename);
   CloseTempFile(data->tempFile);
 
   // free the changelog text
@@ -314,11 +315,12 @@ DECLARE(CheckForUpdates) // ULONG quiet
     data->busy = BusyBegin(BUSY_TEXT);
     BusyText(data->busy, tr(MSG_BusyGettingVerInfo), "");
 
-    // now we send a specific request via DownloadURL() to our update server
+    // now we send a specific request via DownloadURL() to our update server,
+    // an unchanged answer to a previous check is not transferred again
     DoAction(obj, TA_DownloadURL, TT_DownloadURL_Server, C->UpdateServer,
                                   TT_DownloadURL_Request, request,
                                   TT_DownloadURL_Filename, data->tempFile->Filename,
-                                  TT_DownloadURL_Flags, DLURLF_NO_ERROR_ON_404,
+                                  TT_DownloadURL_Flags, DLURLF_NO_ERROR_ON_404|DLURLF_CONDITIONAL,
                                   TAG_DONE);
     free(request);
 
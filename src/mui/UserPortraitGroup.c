@@ -387,7 +387,7 @@ DECLARE(CheckGravatar)
       data->thread = DoAction(obj, TA_DownloadURL, TT_DownloadURL_Server, "http://www.gravatar.com/avatar",
                                                    TT_DownloadURL_Request, hdigest,
                                                    TT_DownloadURL_Filename, imagePath,
-                                                   TT_DownloadURL_Flags, DLURLF_VISIBLE|DLURLF_NO_ERROR_ON_404,
+                                                   TT_DownloadURL_Flags, DLURLF_VISIBLE|DLURLF_NO_ERROR_ON_404|DLURLF_CONDITIONAL,
                                                    TAG_DONE);
     }
   }
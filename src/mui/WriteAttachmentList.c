@@ -197,8 +197,10 @@ OVERLOAD(MUIM_DragDrop)
     busy = BusyBegin(BUSY_TEXT);
     BusyText(busy, tr(MSG_BusyDecSaving), "");
 
-    // make sure the mail part is properly decoded before we add it
+    // make sure the mail part is properly decoded and written
+    // to its file before we add it
     RE_DecodePart(mailPart);
+    RE_FlushPart(mailPart);
 
     // clear the attachment structure
     memset(&attach, 0, sizeof(struct Attach));
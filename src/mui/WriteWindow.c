@@ -3827,6 +3827,7 @@ DECLARE(SetupFromOldMail) // struct ReadMailData *rmData
       BusyText(busy, tr(MSG_BusyDecSaving), "");
 
       RE_DecodePart(part);
+      RE_FlushPart(part);
 
       attach.Size = part->Size;
       attach.IsTemp = TRUE;
@@ -4281,7 +4282,9 @@ DECLARE(ComposeMail) // enum WriteMode mode, ULONG closeWindow
               // to the emailCache
               if(C->EmailCache > 0)
               {
-                DoMethod(_app(obj), MUIM_YAMApplication_AddToEmailCache, &newMail->To);
+                struct Person to;
+
+                DoMethod(_app(obj), MUIM_YAMApplication_AddToEmailCache, GetMailPerson(&newMail->To, &to));
 
                 // if this mail has more than one recipient we have to add the others too
                 if(isMultiRCPTMail(newMail))
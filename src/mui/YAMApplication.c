@@ -76,6 +76,7 @@
 #include "UpdateCheck.h"
 #include "Requesters.h"
 #include "Rexx.h"
+#include "TextIndex.h"
 #include "Threads.h"
 
 #include "gitrev.h"
@@ -101,6 +102,8 @@ struct Data
 #include "AddressBook.h"
 #include "mui/AddressBookWindow.h"
 #include "mui/PreselectionWindow.h"
+#include "tcp/imap.h"
+#include "tcp/smtp.h"
 */
 
 /* Private functions */
@@ -368,8 +371,9 @@ static void FlushIndex(struct Folder *folder, time_t minAccessTime)
 {
   ENTER();
 
-  // make sure the folder index is saved
-  if(isModified(folder))
+  // make sure the folder index is saved and merge an oversized
+  // index journal into it
+  if(isModified(folder) || MA_JournalNeedsCompaction(folder) == TRUE)
     MA_SaveIndex(folder);
 
   // flush the index if
@@ -390,6 +394,9 @@ static void FlushIndex(struct Folder *folder, time_t minAccessTime)
     {
       folder->LoadedMode = LM_FLUSHED;
       clearFlag(folder->Flags, FOFL_FREEXS);
+
+      // the full-text index is kept on disk, so we can release it, too
+      TextIndexFree(folder);
     }
   }
 
@@ -785,6 +792,21 @@ OVERLOAD(MUIM_Application_PushMethod)
   return rc;
 }
 
+///
+/// OVERLOAD(MUIM_ThreadFinished)
+OVERLOAD(MUIM_ThreadFinished)
+{
+  struct MUIP_ThreadFinished *tf = (struct MUIP_ThreadFinished *)msg;
+
+  ENTER();
+
+  if(tf->action == TA_WatchIMAP)
+    IMAPWatcherFinished((struct IMAPWatcher *)GetTagData(TT_WatchIMAP_Watcher, (IPTR)NULL, tf->actionTags));
+
+  RETURN(0);
+  return 0;
+}
+
 ///
 /// DECLARE(UpdateCheck)
 DECLARE(UpdateCheck) // ULONG quiet
@@ -1011,6 +1033,51 @@ DECLARE(DeleteTransferGroup) // Object *transferGroup
   return 0;
 }
 
+///
+/// DECLARE(StartSendMailThread)
+// start an additional thread sending mails of a queue on behalf of a
+// sending thread, as new threads can be started by the main thread only
+DECLARE(StartSendMailThread) // struct SendMailQueue *queue
+{
+  APTR thread;
+
+  ENTER();
+
+  thread = DoAction(NULL, TA_SendMailQueue,
+    TT_SendMailQueue_Queue, msg->queue,
+    TAG_DONE);
+
+  RETURN((IPTR)thread);
+  return (IPTR)thread;
+}
+
+///
+/// DECLARE(ReceiveMailsFromServer)
+// download the new mails of a server on behalf of the thread watching its
+// IMAP mailbox, returns FALSE if the server is busy with another transfer
+DECLARE(ReceiveMailsFromServer) // int serverID
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if(G->Terminating == FALSE)
+  {
+    struct MailServerNode *msn;
+
+    // make sure the mail server node does not vanish
+    ObtainSemaphoreShared(G->configSemaphore);
+
+    if((msn = FindMailServer(&C->pop3ServerList, msg->serverID)) != NULL && isServerActive(msn))
+      success = MA_PopNow(msn, RECEIVEF_TIMER, NULL);
+
+    ReleaseSemaphore(G->configSemaphore);
+  }
+
+  RETURN(success);
+  return success;
+}
+
 ///
 /// DECLARE(ShowTransferWindow)
 DECLARE(ShowTransferWindow)
@@ -94,6 +94,8 @@ void rx_addredit(UNUSED struct RexxHost *host, struct RexxParams *params, enum R
           strlcpy(abn->RealName, args->name, sizeof(abn->RealName));
         if(args->email != NULL)
           strlcpy(abn->Address, args->email, sizeof(abn->Address));
+        if(args->alias != NULL || args->email != NULL)
+          InvalidateABookIndexes(&G->abook);
         if(args->pgp != NULL)
           strlcpy(abn->PGPId, args->pgp, sizeof(abn->PGPId));
         if(args->homepage != NULL)
@@ -75,7 +75,8 @@ void rx_readprint(UNUSED struct RexxHost *host, struct RexxParams *params, enum
           for(part = rmData->firstPart->Next; part; part = part->Next)
           {
             if(part->Nr == *(args->part) &&
-               RE_DecodePart(part))
+               RE_DecodePart(part) &&
+               RE_FlushPart(part))
             {
               success = CopyFile("PRT:", 0, part->Filename, 0);
             }
@@ -85,6 +85,7 @@ void rx_readsave(UNUSED struct RexxHost *host, struct RexxParams *params, enum R
 
               AddPath(file, C->DetachDir, part->Name, sizeof(file));
 
+              RE_FlushPart(part);
               success = RE_Export(rmData,
                                   part->Filename,
                                   args->filename ? args->filename : "",
@@ -1360,6 +1360,7 @@ static int ReadFromHost(struct Connection *conn, char *ptr, const int maxlen)
   GET_SOCKETBASE(conn);
 
   ENTER();
+  STARTSPAN(DBF_NET, "receive");
 
   if(conn->ssl != NULL)
   {
@@ -1557,6 +1558,7 @@ static int ReadFromHost(struct Connection *conn, char *ptr, const int maxlen)
   else
     result = nread;
 
+  STOPSPAN(DBF_NET);
   RETURN(result);
   return result;
 }
@@ -1622,9 +1624,10 @@ static int ReadFromHostBuffered(struct Connection *conn, char *ptr, const int ma
 
 ///
 /// ReceiveLineFromHost
-// a buffered version of readline() that reads out charwise from the
-// socket via TCPReadBuffered and returns the amount of chars copied
-// into the provided character array or -1 on error.
+// a buffered version of readline() that copies whole lines out of the
+// receive buffer and returns the amount of chars copied into the provided
+// character array or -1 on error. The end of a line is searched within the
+// buffered data via memchr() instead of obtaining it char by char.
 //
 // This implementation is a slightly adapted version of readline()/my_read()
 // examples from (W.Richard Stevens - Unix Network Programming) - Page 80
@@ -1639,42 +1642,57 @@ int ReceiveLineFromHost(struct Connection *conn, char *vptr, const int maxlen)
     // make sure the socket is active.
     if(conn->isConnected == TRUE)
     {
-      int n;
+      int n = 0;
       char *ptr = vptr;
 
       conn->error = CONNECTERR_NO_ERROR;
 
-      for(n = 1; n < maxlen; n++)
+      while(n < maxlen-1)
       {
-        int rc;
-        char c;
+        char *eol;
+        int len;
 
-        // read out one buffered char only.
-        rc = ReadFromHostBuffered(conn, &c, 1);
-        if(rc == 1)
+        // if the buffer is empty we fill it again from
+        // data we request from the socket.
+        if(conn->receiveCount <= 0)
         {
-          *ptr++ = c;
-          if(c == '\n')
-            break;  // newline is stored, like with getline()
-        }
-        else if(rc == 0)
-        {
-          // if n==1 then EOF, no data read
-          // otherwise    EOF, some data was read
-          if(n == 1)
-            n = 0;
+          conn->receiveCount = ReadFromHost(conn, conn->receiveBuffer, conn->receiveBufferSize);
+          conn->receivePtr = conn->receiveBuffer;
 
-          break;
+          if(conn->receiveCount < 0)
+          {
+            // error, errno set by ReadFromHost()
+            n = -1;
+            break;
+          }
+          else if(conn->receiveCount == 0)
+          {
+            // EOF, possibly some data was read
+            break;
+          }
         }
-        else
-        {
-          // error, errno set by readchar()
-          n = -1;
+
+        // copy everything up to and including the next newline
+        // at once, but not more than the caller's array can take
+        len = MIN(conn->receiveCount, maxlen-1-n);
+        if((eol = memchr(conn->receivePtr, '\n', len)) != NULL)
+          len = eol - conn->receivePtr + 1;
+
+        memcpy(ptr, conn->receivePtr, len);
+        ptr += len;
+        n += len;
+        conn->receivePtr += len;
+        conn->receiveCount -= len;
+
+        // newline is stored, like with getline()
+        if(eol != NULL)
           break;
-        }
       }
 
-      *ptr = '\0'; // null terminate like getline()
+      if(n >= 0)
+        *ptr = '\0'; // null terminate like getline()
+      else
+        vptr[0] = '\0';
 
       // perform some debug output on the console if requested
       // by the user
@@ -1749,6 +1767,69 @@ int ReceiveFromHost(struct Connection *conn, char *recvdata, const int maxlen)
   return nread;
 }
 
+///
+/// WaitForHostData
+// waits until data from the host can be received or the given number of
+// seconds has passed. Data which is buffered already is available at once.
+// Returns 1 if data is available, 0 on a timeout and -1 on an error or if
+// the thread was aborted, as the abort signal is part of the break mask.
+int WaitForHostData(struct Connection *conn, const int seconds)
+{
+  int result = -1;
+
+  ENTER();
+
+  if(conn != NULL)
+  {
+    // make sure the socket is active.
+    if(conn->isConnected == TRUE)
+    {
+      conn->error = CONNECTERR_NO_ERROR;
+
+      if(conn->receiveCount > 0 || (conn->ssl != NULL && SSL_pending(conn->ssl) > 0))
+      {
+        // there is still unread data in our buffer or in the SSL layer
+        result = 1;
+      }
+      else
+      {
+        LONG retVal;
+        GET_SOCKETBASE(conn);
+
+        conn->timeout.tv_sec = seconds;
+        conn->timeout.tv_usec = 0;
+
+        FD_ZERO(&conn->fdset);
+        FD_SET(conn->socket, &conn->fdset);
+        retVal = WaitSelect(conn->socket+1, &conn->fdset, NULL, NULL, (APTR)&conn->timeout, NULL);
+
+        if(retVal >= 1 && FD_ISSET(conn->socket, &conn->fdset))
+        {
+          result = 1;
+        }
+        else if(retVal == 0)
+        {
+          D(DBF_NET, "no data from host after %ld seconds", seconds);
+          result = 0;
+        }
+        else
+        {
+          W(DBF_NET, "WaitSelect() was interrupted or failed");
+          conn->error = CONNECTERR_UNKNOWN_ERROR;
+        }
+      }
+    }
+    else
+    {
+      W(DBF_NET, "socket not connected");
+      conn->error = CONNECTERR_NOT_CONNECTED;
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// WriteToHost
 // an unbuffered implementation/wrapper for SSL_write/send() where the supplied
@@ -1762,6 +1843,7 @@ static int WriteToHost(struct Connection *conn, const char *ptr, const int len)
   GET_SOCKETBASE(conn);
 
   ENTER();
+  STARTSPAN(DBF_NET, "send");
 
   if(conn->ssl != NULL)
   {
@@ -1973,6 +2055,7 @@ static int WriteToHost(struct Connection *conn, const char *ptr, const int len)
   else
     result = len-towrite;
 
+  STOPSPAN(DBF_NET);
   RETURN(result);
   return result;
 }
@@ -0,0 +1,593 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tcp/gzip.h"
+
+// the size of the sliding window of deflate, back references reach that
+// far at most
+#define WINDOW_SIZE  32768
+#define WINDOW_MASK  (WINDOW_SIZE-1)
+
+#define MAXBITS      15  // maximum bits of a code
+#define MAXLCODES    286 // maximum number of literal/length codes
+#define MAXDCODES    30  // maximum number of distance codes
+#define MAXCODES     (MAXLCODES+MAXDCODES)
+#define FIXLCODES    288 // number of fixed literal/length codes
+
+// flags of the gzip header (RFC 1952, 2.3.1)
+#define GZF_HCRC     (1<<1)
+#define GZF_EXTRA    (1<<2)
+#define GZF_NAME     (1<<3)
+#define GZF_COMMENT  (1<<4)
+
+// the state of an inflate operation
+struct Inflater
+{
+  const unsigned char *src; // the compressed data
+  size_t srclen;            // its length
+  size_t pos;               // the next byte to be read
+  unsigned long bitbuf;     // bits not yet consumed
+  int bitcnt;               // number of bits in bitbuf
+  int error;                // the data is invalid or truncated
+
+  FILE *out;                // the file to write the inflated data to
+  unsigned long total;      // the number of inflated bytes so far
+  unsigned long crc;        // the CRC32 of the inflated data so far
+  unsigned int wpos;        // the write position within the window
+  unsigned char window[WINDOW_SIZE];
+};
+
+// a canonical huffman code, given by the number of symbols of each code
+// length and the symbols ordered by their codes
+struct Huffman
+{
+  short count[MAXBITS+1];
+  short symbol[FIXLCODES];
+};
+
+static unsigned long crc_table[256];
+static int crc_table_ready = 0;
+
+// the bases and extra bits of the length and distance codes (RFC 1951, 3.2.5)
+static const short lbase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short lext[29]  = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const short dbase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const short dext[30]  = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// the order of the code length code lengths (RFC 1951, 3.2.7)
+static const short clorder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+/// make_crc_table
+// set up the table for the CRC32 of the inflated data, filling the table
+// twice in parallel threads doesn't hurt as both write the same values
+static void make_crc_table(void)
+{
+  unsigned long n;
+
+  for(n = 0; n < 256; n++)
+  {
+    unsigned long c = n;
+    int k;
+
+    for(k = 0; k < 8; k++)
+      c = (c & 1) ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+
+    crc_table[n] = c;
+  }
+
+  crc_table_ready = 1;
+}
+
+///
+/// update_crc
+static unsigned long update_crc(unsigned long crc, const unsigned char *buf, size_t len)
+{
+  crc ^= 0xffffffffUL;
+
+  while(len-- > 0)
+    crc = crc_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+  return crc ^ 0xffffffffUL;
+}
+
+///
+/// flush_window
+// write out the filled part of the window
+static void flush_window(struct Inflater *s)
+{
+  if(s->wpos > 0)
+  {
+    if(fwrite(s->window, 1, s->wpos, s->out) != s->wpos)
+      s->error = 1;
+
+    s->crc = update_crc(s->crc, s->window, s->wpos);
+    s->wpos = 0;
+  }
+}
+
+///
+/// put_byte
+static void put_byte(struct Inflater *s, unsigned char c)
+{
+  s->window[s->wpos++] = c;
+  s->total++;
+
+  // the window keeps its contents after being written out, so back
+  // references can still reach into the data written before
+  if(s->wpos == WINDOW_SIZE)
+    flush_window(s);
+}
+
+///
+/// bits
+// get the given number of bits from the input, a truncated input gives
+// zero bits and marks the state as failed
+static int bits(struct Inflater *s, int need)
+{
+  unsigned long val = s->bitbuf;
+
+  while(s->bitcnt < need)
+  {
+    if(s->pos == s->srclen)
+    {
+      s->error = 1;
+      return 0;
+    }
+
+    val |= (unsigned long)s->src[s->pos++] << s->bitcnt;
+    s->bitcnt += 8;
+  }
+
+  s->bitbuf = val >> need;
+  s->bitcnt -= need;
+
+  return (int)(val & ((1UL << need) - 1));
+}
+
+///
+/// decode
+// decode a symbol with the given huffman code, the code is read bit by bit
+// and compared against the first code of each length
+static int decode(struct Inflater *s, const struct Huffman *h)
+{
+  int code = 0;
+  int first = 0;
+  int index = 0;
+  int len;
+
+  for(len = 1; len <= MAXBITS; len++)
+  {
+    int count;
+
+    code |= bits(s, 1);
+    count = h->count[len];
+    if(code - count < first)
+      return h->symbol[index + (code - first)];
+
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+
+  // ran out of codes
+  return -1;
+}
+
+///
+/// construct
+// build a huffman code from a list of code lengths. Returns 0 for a complete
+// code, a positive value for an incomplete code and a negative value for an
+// over-subscribed code.
+static int construct(struct Huffman *h, const short *length, int n)
+{
+  short offs[MAXBITS+1];
+  int left = 1;
+  int symbol;
+  int len;
+
+  for(len = 0; len <= MAXBITS; len++)
+    h->count[len] = 0;
+  for(symbol = 0; symbol < n; symbol++)
+    h->count[length[symbol]]++;
+
+  // no codes at all is complete, but decoding will fail
+  if(h->count[0] == n)
+    return 0;
+
+  for(len = 1; len <= MAXBITS; len++)
+  {
+    left <<= 1;
+    left -= h->count[len];
+    if(left < 0)
+      return left;
+  }
+
+  offs[1] = 0;
+  for(len = 1; len < MAXBITS; len++)
+    offs[len + 1] = offs[len] + h->count[len];
+
+  for(symbol = 0; symbol < n; symbol++)
+  {
+    if(length[symbol] != 0)
+      h->symbol[offs[length[symbol]]++] = symbol;
+  }
+
+  return left;
+}
+
+///
+/// stored
+// copy a stored block (RFC 1951, 3.2.4)
+static void stored(struct Inflater *s)
+{
+  unsigned int len;
+
+  // the block starts at the next byte boundary
+  s->bitbuf = 0;
+  s->bitcnt = 0;
+
+  if(s->pos + 4 > s->srclen)
+  {
+    s->error = 1;
+    return;
+  }
+
+  len = s->src[s->pos] | (s->src[s->pos + 1] << 8);
+  if(s->src[s->pos + 2] != (~len & 0xff) || s->src[s->pos + 3] != ((~len >> 8) & 0xff))
+  {
+    s->error = 1;
+    return;
+  }
+  s->pos += 4;
+
+  if(s->pos + len > s->srclen)
+  {
+    s->error = 1;
+    return;
+  }
+
+  while(len-- > 0 && s->error == 0)
+    put_byte(s, s->src[s->pos++]);
+}
+
+///
+/// codes
+// inflate the literal/length and distance codes of a block until the end
+// of block symbol
+static void codes(struct Inflater *s, const struct Huffman *lencode, const struct Huffman *distcode)
+{
+  int symbol;
+
+  do
+  {
+    symbol = decode(s, lencode);
+
+    if(symbol < 0 || s->error != 0)
+    {
+      s->error = 1;
+    }
+    else if(symbol < 256)
+    {
+      put_byte(s, (unsigned char)symbol);
+    }
+    else if(symbol > 256)
+    {
+      unsigned int len;
+      unsigned int dist;
+
+      symbol -= 257;
+      if(symbol >= 29)
+      {
+        s->error = 1;
+        break;
+      }
+      len = lbase[symbol] + bits(s, lext[symbol]);
+
+      symbol = decode(s, distcode);
+      if(symbol < 0 || symbol >= 30)
+      {
+        s->error = 1;
+        break;
+      }
+      dist = dbase[symbol] + bits(s, dext[symbol]);
+
+      // a distance beyond the data inflated so far is invalid
+      if(dist > s->total)
+      {
+        s->error = 1;
+        break;
+      }
+
+      while(len-- > 0)
+        put_byte(s, s->window[(s->wpos - dist) & WINDOW_MASK]);
+    }
+  }
+  while(symbol != 256 && s->error == 0);
+}
+
+///
+/// fixed
+// inflate a block with the fixed huffman codes (RFC 1951, 3.2.6)
+static void fixed(struct Inflater *s)
+{
+  struct Huffman lencode;
+  struct Huffman distcode;
+  short lengths[FIXLCODES];
+  int symbol;
+
+  for(symbol = 0; symbol < 144; symbol++)
+    lengths[symbol] = 8;
+  for(; symbol < 256; symbol++)
+    lengths[symbol] = 9;
+  for(; symbol < 280; symbol++)
+    lengths[symbol] = 7;
+  for(; symbol < FIXLCODES; symbol++)
+    lengths[symbol] = 8;
+  construct(&lencode, lengths, FIXLCODES);
+
+  for(symbol = 0; symbol < MAXDCODES; symbol++)
+    lengths[symbol] = 5;
+  construct(&distcode, lengths, MAXDCODES);
+
+  codes(s, &lencode, &distcode);
+}
+
+///
+/// dynamic
+// inflate a block with huffman codes given in the block (RFC 1951, 3.2.7)
+static void dynamic(struct Inflater *s)
+{
+  struct Huffman lencode;
+  struct Huffman distcode;
+  short lengths[MAXCODES];
+  int nlen;
+  int ndist;
+  int ncode;
+  int index;
+  int err;
+
+  nlen = bits(s, 5) + 257;
+  ndist = bits(s, 5) + 1;
+  ncode = bits(s, 4) + 4;
+  if(nlen > MAXLCODES || ndist > MAXDCODES)
+  {
+    s->error = 1;
+    return;
+  }
+
+  // get the code length code lengths, the code must be complete
+  for(index = 0; index < ncode; index++)
+    lengths[clorder[index]] = bits(s, 3);
+  for(; index < 19; index++)
+    lengths[clorder[index]] = 0;
+
+  if(construct(&lencode, lengths, 19) != 0)
+  {
+    s->error = 1;
+    return;
+  }
+
+  // get the literal/length and distance code lengths
+  index = 0;
+  while(index < nlen + ndist && s->error == 0)
+  {
+    int symbol = decode(s, &lencode);
+
+    if(symbol < 0)
+    {
+      s->error = 1;
+    }
+    else if(symbol < 16)
+    {
+      lengths[index++] = symbol;
+    }
+    else
+    {
+      int len = 0;
+
+      if(symbol == 16)
+      {
+        // repeat the last length 3..6 times
+        if(index == 0)
+        {
+          s->error = 1;
+          break;
+        }
+        len = lengths[index - 1];
+        symbol = 3 + bits(s, 2);
+      }
+      else if(symbol == 17)
+        symbol = 3 + bits(s, 3);
+      else
+        symbol = 11 + bits(s, 7);
+
+      if(index + symbol > nlen + ndist)
+      {
+        s->error = 1;
+        break;
+      }
+
+      while(symbol-- > 0)
+        lengths[index++] = len;
+    }
+  }
+
+  // the end of block code is required
+  if(s->error != 0 || lengths[256] == 0)
+  {
+    s->error = 1;
+    return;
+  }
+
+  // incomplete codes are allowed for a single length only
+  err = construct(&lencode, lengths, nlen);
+  if(err < 0 || (err > 0 && nlen - lencode.count[0] != 1))
+  {
+    s->error = 1;
+    return;
+  }
+
+  err = construct(&distcode, lengths + nlen, ndist);
+  if(err < 0 || (err > 0 && ndist - distcode.count[0] != 1))
+  {
+    s->error = 1;
+    return;
+  }
+
+  codes(s, &lencode, &distcode);
+}
+
+///
+/// skip_header
+// skip the gzip header (RFC 1952, 2.3) and return the offset of the
+// compressed data or 0 for an invalid header
+static size_t skip_header(const unsigned char *src, size_t srclen)
+{
+  size_t pos = 10;
+  int flags;
+
+  if(srclen < 18 || src[0] != 0x1f || src[1] != 0x8b || src[2] != 8)
+    return 0;
+
+  flags = src[3];
+
+  if(flags & GZF_EXTRA)
+  {
+    if(pos + 2 > srclen)
+      return 0;
+
+    pos += 2 + (src[pos] | (src[pos + 1] << 8));
+  }
+
+  if(flags & GZF_NAME)
+  {
+    while(pos < srclen && src[pos] != '\0')
+      pos++;
+    pos++;
+  }
+
+  if(flags & GZF_COMMENT)
+  {
+    while(pos < srclen && src[pos] != '\0')
+      pos++;
+    pos++;
+  }
+
+  if(flags & GZF_HCRC)
+    pos += 2;
+
+  // the trailer must follow the data
+  if(pos + 8 > srclen)
+    return 0;
+
+  return pos;
+}
+
+///
+/// gzipdecode_file
+// inflate a complete gzip member held in memory and write the inflated data
+// to the given file. The CRC32 and the size stored in the trailer are
+// checked. Returns the number of bytes written or -1 in case of invalid data
+// or a write error.
+long gzipdecode_file(const unsigned char *src, size_t srclen, FILE *out)
+{
+  long result = -1;
+  struct Inflater *s;
+  size_t start;
+
+  if((start = skip_header(src, srclen)) != 0 && (s = malloc(sizeof(*s))) != NULL)
+  {
+    int last;
+
+    if(crc_table_ready == 0)
+      make_crc_table();
+
+    s->src = src;
+    s->srclen = srclen - 8;
+    s->pos = start;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+    s->error = 0;
+    s->out = out;
+    s->total = 0;
+    s->crc = 0;
+    s->wpos = 0;
+
+    do
+    {
+      int type;
+
+      last = bits(s, 1);
+      type = bits(s, 2);
+
+      if(s->error != 0)
+        break;
+
+      switch(type)
+      {
+        case 0:
+          stored(s);
+        break;
+
+        case 1:
+          fixed(s);
+        break;
+
+        case 2:
+          dynamic(s);
+        break;
+
+        default:
+          s->error = 1;
+        break;
+      }
+    }
+    while(last == 0 && s->error == 0);
+
+    flush_window(s);
+
+    if(s->error == 0)
+    {
+      const unsigned char *trailer = &src[srclen - 8];
+      unsigned long crc = trailer[0] | (trailer[1] << 8) | ((unsigned long)trailer[2] << 16) | ((unsigned long)trailer[3] << 24);
+      unsigned long size = trailer[4] | (trailer[5] << 8) | ((unsigned long)trailer[6] << 16) | ((unsigned long)trailer[7] << 24);
+
+      if(crc == s->crc && size == (s->total & 0xffffffffUL))
+        result = (long)s->total;
+    }
+
+    free(s);
+  }
+
+  return result;
+}
+
+///
@@ -0,0 +1,40 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdio.h>
+
+// The decoder in this file works on a memory buffer holding the complete
+// compressed data and doesn't depend on any other part of YAM. There is no
+// zlib for all of our target systems, hence this small inflate (RFC 1951)
+// implementation for HTTP bodies sent with "Content-Encoding: gzip".
+
+long gzipdecode_file(const unsigned char *src, size_t srclen, FILE *out);
+
+#endif // GZIP_H
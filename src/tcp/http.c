@@ -25,19 +25,25 @@
 
 ***************************************************************************/
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#include <proto/dos.h>
+
 #include "YAM.h"
 #include "YAM_error.h"
 #include "YAM_global.h"
+#include "YAM_utilities.h"
 
 #include "mui/TransferControlGroup.h"
 #include "mui/YAMApplication.h"
 #include "tcp/Connection.h"
+#include "tcp/gzip.h"
 #include "tcp/http.h"
 
 #include "Config.h"
+#include "FileInfo.h"
 #include "Locale.h"
 #include "MailServers.h"
 #include "MethodStack.h"
@@ -45,86 +51,333 @@
 
 #include "Debug.h"
 
+// the maximum number of redirections we follow before we give up
+#define MAX_REDIRECTIONS 5
+
 struct TransferContext
 {
   struct Connection *connection;
   Object *transferGroup;
 
-  int (* receiveFunc)(struct Connection *, char *, const int); // binary or text based receive function
-  LONG contentLength;
+  LONG contentLength;    // the length of the body or -1 if it is unknown
+  LONG bodyReceived;     // the number of body bytes received so far
+  LONG chunkLeft;        // the bytes left of the current chunk, -1 before the first chunk
+  BOOL chunked;          // the body is sent with "Transfer-Encoding: chunked"
+  BOOL gzipped;          // the body is sent with "Content-Encoding: gzip"
+  BOOL keepAlive;        // the server keeps the connection open after the response
+  BOOL bodyDone;         // the complete body has been received
 
   struct MailServerNode server; // dummy server structure to connect via ConnectToHost()
+  char connectedHost[SIZE_HOST]; // the host the connection is currently open to
+  int connectedPort;
 
   char transferGroupTitle[SIZE_DEFAULT]; // the TransferControlGroup's title
   char url[SIZE_URL];
+  char hostPart[SIZE_HOST];        // the "host[:port]" part of the URL
   char serverPath[SIZE_LINE];
   char requestResponse[SIZE_LINE];
+  char chunkLine[SIZE_DEFAULT];    // the size line of a chunk
   char redirectedURL[SIZE_URL];
+
+  char requestedURL[SIZE_URL];       // the URL as requested, before any redirection
+  char validatorsFile[SIZE_PATHFILE]; // the validators of the downloaded file
+  char etag[SIZE_DEFAULT*2];         // the validators of the existing file
+  char lastModified[SIZE_DEFAULT];
+  char newETag[SIZE_DEFAULT*2];      // the validators of the received document
+  char newLastModified[SIZE_DEFAULT];
 };
 
+/// GetHeaderValue
+// check if a header line contains the given field and return its value
+// without the leading white space and the trailing CR+LF
+static char *GetHeaderValue(char *line, const char *field)
+{
+  char *value = NULL;
+  size_t len = strlen(field);
+
+  ENTER();
+
+  if(strnicmp(line, field, len) == 0 && line[len] == ':')
+  {
+    value = TrimStart(&line[len+1]);
+    value[strcspn(value, "\r\n")] = '\0';
+  }
+
+  RETURN(value);
+  return value;
+}
+
+///
+/// LoadValidators
+// load the validators (RFC 7232) of a previous download of the same URL,
+// these are used only if the file downloaded back then still exists
+static void LoadValidators(struct TransferContext *tc, const char *filename)
+{
+  FILE *fh;
+
+  ENTER();
+
+  snprintf(tc->validatorsFile, sizeof(tc->validatorsFile), "%s.http", filename);
+
+  if(FileExists(filename) == TRUE && (fh = fopen(tc->validatorsFile, "r")) != NULL)
+  {
+    BOOL sameURL = FALSE;
+
+    while(fgets(tc->requestResponse, sizeof(tc->requestResponse), fh) != NULL)
+    {
+      char *value;
+
+      if((value = GetHeaderValue(tc->requestResponse, "URL")) != NULL)
+        sameURL = (strcmp(value, tc->requestedURL) == 0);
+      else if((value = GetHeaderValue(tc->requestResponse, "ETag")) != NULL)
+        strlcpy(tc->etag, value, sizeof(tc->etag));
+      else if((value = GetHeaderValue(tc->requestResponse, "Last-Modified")) != NULL)
+        strlcpy(tc->lastModified, value, sizeof(tc->lastModified));
+    }
+
+    fclose(fh);
+
+    // the validators of another document are useless
+    if(sameURL == FALSE)
+    {
+      tc->etag[0] = '\0';
+      tc->lastModified[0] = '\0';
+    }
+
+    D(DBF_NET, "validators of '%s': ETag '%s', Last-Modified '%s'", filename, tc->etag, tc->lastModified);
+  }
+
+  LEAVE();
+}
+
+///
+/// SaveValidators
+// save the validators of a downloaded document beside the downloaded file
+static void SaveValidators(struct TransferContext *tc)
+{
+  ENTER();
+
+  if(tc->newETag[0] != '\0' || tc->newLastModified[0] != '\0')
+  {
+    FILE *fh;
+
+    if((fh = fopen(tc->validatorsFile, "w")) != NULL)
+    {
+      fprintf(fh, "URL: %s\n", tc->requestedURL);
+      if(tc->newETag[0] != '\0')
+        fprintf(fh, "ETag: %s\n", tc->newETag);
+      if(tc->newLastModified[0] != '\0')
+        fprintf(fh, "Last-Modified: %s\n", tc->newLastModified);
+
+      fclose(fh);
+    }
+  }
+  else if(FileExists(tc->validatorsFile) == TRUE)
+  {
+    // the server gave no validators this time, so the old ones are outdated
+    DeleteFile(tc->validatorsFile);
+  }
+
+  LEAVE();
+}
+
+///
+/// DeleteURLValidators
+// delete the validators kept beside a downloaded file, this must be done
+// whenever the file itself is deleted
+void DeleteURLValidators(const char *filename)
+{
+  char validatorsFile[SIZE_PATHFILE];
+
+  ENTER();
+
+  snprintf(validatorsFile, sizeof(validatorsFile), "%s.http", filename);
+
+  if(FileExists(validatorsFile) == TRUE && DeleteFile(validatorsFile) == 0)
+    AddZombieFile(validatorsFile);
+
+  LEAVE();
+}
+
+///
 /// ReceiveHTTPHeader
 // receive a standard HTTP header
-BOOL ReceiveHTTPHeader(struct TransferContext *tc)
+BOOL ReceiveHTTPHeader(struct TransferContext *tc, const BOOL http11)
 {
   BOOL success = FALSE;
   int len;
 
   ENTER();
 
-  // default to a binary receive function
-  tc->receiveFunc = ReceiveFromHost;
   tc->contentLength = -1;
+  tc->bodyReceived = 0;
+  tc->chunkLeft = -1;
+  tc->chunked = FALSE;
+  tc->gzipped = FALSE;
+  tc->bodyDone = FALSE;
+  tc->newETag[0] = '\0';
+  tc->newLastModified[0] = '\0';
+
+  // HTTP/1.1 connections are persistent unless stated otherwise
+  tc->keepAlive = http11;
 
   // we can request all further lines from our socket
   // until we reach the entity body
   while(tc->connection->error == CONNECTERR_NO_ERROR &&
         (len = ReceiveLineFromHost(tc->connection, tc->requestResponse, sizeof(tc->requestResponse))) > 0)
   {
+    char *value;
+
     SHOWSTRING(DBF_NET, tc->requestResponse);
 
     // we scan for the end of the response header by searching for the first '\r\n' line
-    if(strnicmp(tc->requestResponse, "Content-Length:", 15) == 0)
+    if(strcmp(tc->requestResponse, "\r\n") == 0)
     {
-      tc->contentLength = atoi(&tc->requestResponse[16]);
+      // this is the end...
+      success = TRUE;
+      break;
     }
-    else if(strnicmp(tc->requestResponse, "Content-Type:", 13) == 0)
+    else if((value = GetHeaderValue(tc->requestResponse, "Content-Length")) != NULL)
     {
-      // for text bodies we use a line based receive function
-      if(strnicmp(&tc->requestResponse[14], "text", 4) == 0)
-      {
-        D(DBF_NET, "using line based content receive function");
-        tc->receiveFunc = ReceiveLineFromHost;
-      }
+      tc->contentLength = atol(value);
+    }
+    else if((value = GetHeaderValue(tc->requestResponse, "Transfer-Encoding")) != NULL)
+    {
+      // chunked is always the final encoding (RFC 7230, 3.3.1)
+      if(strcasestr(value, "chunked") != NULL)
+        tc->chunked = TRUE;
+    }
+    else if((value = GetHeaderValue(tc->requestResponse, "Content-Encoding")) != NULL)
+    {
+      if(stricmp(value, "gzip") == 0 || stricmp(value, "x-gzip") == 0)
+        tc->gzipped = TRUE;
     }
-    else if(strnicmp(tc->requestResponse, "Location:", 9) == 0)
+    else if((value = GetHeaderValue(tc->requestResponse, "Connection")) != NULL)
+    {
+      if(strcasestr(value, "close") != NULL)
+        tc->keepAlive = FALSE;
+      else if(strcasestr(value, "keep-alive") != NULL)
+        tc->keepAlive = TRUE;
+    }
+    else if((value = GetHeaderValue(tc->requestResponse, "Location")) != NULL)
     {
       // remember the redirected URL
-      strlcpy(tc->redirectedURL, &tc->requestResponse[10], sizeof(tc->redirectedURL));
-      // strip the trainling CR+LF
-      if(strlen(tc->redirectedURL) > 2)
-        tc->redirectedURL[strlen(tc->redirectedURL)-2] = '\0';
+      strlcpy(tc->redirectedURL, value, sizeof(tc->redirectedURL));
     }
-    else if(strcmp(tc->requestResponse, "\r\n") == 0)
+    else if((value = GetHeaderValue(tc->requestResponse, "ETag")) != NULL)
     {
-      // this is the end...
-      success = TRUE;
-      break;
+      strlcpy(tc->newETag, value, sizeof(tc->newETag));
+    }
+    else if((value = GetHeaderValue(tc->requestResponse, "Last-Modified")) != NULL)
+    {
+      strlcpy(tc->newLastModified, value, sizeof(tc->newLastModified));
     }
   }
 
+  // the length of a chunked body is known only at its end
+  if(tc->chunked == TRUE)
+    tc->contentLength = -1;
+
   RETURN(success);
   return success;
 }
 
+///
+/// ReadHTTPBody
+// read the next part of the body, the chunks of a chunked body are joined
+// transparently. Returns the number of bytes read, 0 at the end of the body
+// and -1 on errors.
+static int ReadHTTPBody(struct TransferContext *tc, char *buf, const int size)
+{
+  int len = 0;
+
+  ENTER();
+
+  if(tc->bodyDone == TRUE)
+  {
+    // nothing left
+  }
+  else if(tc->chunked == TRUE)
+  {
+    if(tc->chunkLeft <= 0)
+    {
+      // the data of each chunk is followed by a CR+LF, then the size of the
+      // next chunk follows (RFC 7230, 4.1)
+      if((tc->chunkLeft == 0 && ReceiveLineFromHost(tc->connection, tc->chunkLine, sizeof(tc->chunkLine)) <= 0) ||
+         ReceiveLineFromHost(tc->connection, tc->chunkLine, sizeof(tc->chunkLine)) <= 0)
+      {
+        len = -1;
+      }
+      else if((tc->chunkLeft = strtol(tc->chunkLine, NULL, 16)) == 0)
+      {
+        // the last chunk is followed by optional trailer fields and an empty line
+        while((len = ReceiveLineFromHost(tc->connection, tc->chunkLine, sizeof(tc->chunkLine))) > 0 &&
+              strcmp(tc->chunkLine, "\r\n") != 0)
+          ;
+
+        if(len > 0)
+        {
+          tc->bodyDone = TRUE;
+          len = 0;
+        }
+        else
+          len = -1;
+      }
+      else if(tc->chunkLeft < 0)
+      {
+        len = -1;
+      }
+    }
+
+    if(len == 0 && tc->bodyDone == FALSE)
+    {
+      if((len = ReceiveFromHost(tc->connection, buf, MIN(size-1, tc->chunkLeft)+1)) > 0)
+        tc->chunkLeft -= len;
+      else
+        len = -1;
+    }
+  }
+  else if(tc->contentLength >= 0)
+  {
+    LONG left = tc->contentLength - tc->bodyReceived;
+
+    if(left <= 0)
+      tc->bodyDone = TRUE;
+    else if((len = ReceiveFromHost(tc->connection, buf, MIN(size-1, left)+1)) > 0)
+      tc->bodyReceived += len;
+    else
+      len = -1;
+  }
+  else
+  {
+    // without any length the body ends when the server closes the connection
+    if((len = ReceiveFromHost(tc->connection, buf, size)) <= 0)
+    {
+      if(len == 0 || tc->connection->error == CONNECTERR_NO_ERROR)
+        len = 0;
+
+      tc->bodyDone = TRUE;
+      tc->keepAlive = FALSE;
+    }
+  }
+
+  RETURN(len);
+  return len;
+}
+
 ///
 /// ReceiveHTTPBody
-// receive the body document of a HTTP request to a file
+// receive the body document of a HTTP request to a file, a gzip compressed
+// body is collected in memory and inflated to the file at the end
 BOOL ReceiveHTTPBody(struct TransferContext *tc, const char *filename)
 {
   BOOL success = FALSE;
 
+  ENTER();
+
   SHOWVALUE(DBF_NET, tc->contentLength);
-  // contentLength == -1 can only happen if no Content-Length header line was found
+  // contentLength == -1 can happen if no Content-Length header line was found
+  // or if the body is chunked
   if(tc->contentLength > 0 || tc->contentLength == -1)
   {
     FILE *out = NULL;
@@ -133,12 +386,20 @@ BOOL ReceiveHTTPBody(struct TransferContext *tc, const char *filename)
     if(filename != NULL)
     {
       D(DBF_NET, "downloading to file '%s'", filename);
-      out = fopen(filename, "w");
+
+      // the old contents are gone from now on, so must be their validators.
+      // Otherwise an aborted download would be considered up to date later.
+      if((out = fopen(filename, "w")) != NULL)
+        DeleteURLValidators(filename);
     }
 
     if(filename == NULL || out != NULL)
     {
-      LONG received = -1;
+      char *packed = NULL;
+      size_t packedSize = 0;
+      size_t packedAllocated = 0;
+      LONG received = 0;
+      BOOL error = FALSE;
       int len;
 
       if(out != NULL)
@@ -150,31 +411,75 @@ BOOL ReceiveHTTPBody(struct TransferContext *tc, const char *filename)
       // we seem to have reached the entity body, so
       // from here we retrieve everything we can get and
       // immediately write it out to a file. that's it :)
-      while(tc->connection->error == CONNECTERR_NO_ERROR &&
-            (len = tc->receiveFunc(tc->connection, tc->requestResponse, sizeof(tc->requestResponse))) > 0)
+      while((len = ReadHTTPBody(tc, tc->requestResponse, sizeof(tc->requestResponse))) > 0)
       {
         PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, len, tr(MSG_HTTP_RECEIVING_DATA));
 
-        if(out != NULL && fwrite(tc->requestResponse, len, 1, out) != 1)
+        received += len;
+
+        if(out != NULL)
         {
-          received = -1; // signal an error!
-          break;
-        }
+          if(tc->gzipped == TRUE)
+          {
+            // collect the compressed data, doubling the buffer as required
+            if(packedSize + len > packedAllocated)
+            {
+              size_t newSize = MAX(packedAllocated*2, (size_t)SIZE_FILEBUF);
+              char *newPacked;
 
-        // forget the initial value and sum up all further sizes
-        if(received == -1)
-          received = len;
-        else
-          received += len;
+              while(newSize < packedSize + len)
+                newSize *= 2;
+
+              if((newPacked = realloc(packed, newSize)) == NULL)
+              {
+                error = TRUE;
+                break;
+              }
+
+              packed = newPacked;
+              packedAllocated = newSize;
+            }
+
+            memcpy(&packed[packedSize], tc->requestResponse, len);
+            packedSize += len;
+          }
+          else if(fwrite(tc->requestResponse, len, 1, out) != 1)
+          {
+            error = TRUE;
+            break;
+          }
+        }
       }
 
       D(DBF_NET, "received %ld/%ld bytes", received, tc->contentLength);
 
       PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_HTTP_RECEIVING_DATA));
 
-      // check if we retrieved anything
-      if(tc->connection->error == CONNECTERR_NO_ERROR && received >= 0)
-        success = TRUE;
+      // check if we retrieved everything
+      if(len == 0 && error == FALSE)
+      {
+        if(out != NULL && tc->gzipped == TRUE)
+        {
+          long inflated;
+
+          if((inflated = gzipdecode_file((unsigned char *)packed, packedSize, out)) >= 0)
+          {
+            D(DBF_NET, "inflated %ld bytes to %ld bytes", packedSize, inflated);
+            success = TRUE;
+          }
+          else
+            E(DBF_NET, "invalid gzip data of %ld bytes", packedSize);
+        }
+        else
+          success = TRUE;
+      }
+      else
+      {
+        // the rest of the body is lost, the connection can't be used any further
+        tc->keepAlive = FALSE;
+      }
+
+      free(packed);
 
       PushMethodOnStack(tc->transferGroup, 1, MUIM_TransferControlGroup_Finish);
 
@@ -196,7 +501,10 @@ BOOL ReceiveHTTPBody(struct TransferContext *tc, const char *filename)
 
 ///
 /// DownloadURL
-//  Downloads a file from the web using HTTP/1.1 (RFC 2616)
+//  Downloads a file from the web using HTTP/1.1 (RFC 7230). The connection
+//  is kept open while redirections lead to the same server. With the
+//  DLURLF_CONDITIONAL flag the validators of the previous download are sent
+//  along and an unchanged document is not transferred again.
 BOOL DownloadURL(const char *server, const char *request, const char *filename, const ULONG flags)
 {
   BOOL success = FALSE;
@@ -209,9 +517,18 @@ BOOL DownloadURL(const char *server, const char *request, const char *filename,
     if((tc->connection = CreateConnection(TRUE)) != NULL && ConnectionIsOnline(tc->connection) == TRUE)
     {
       BOOL noproxy = IsStrEmpty(C->ProxyServer);
+      int redirections = 0;
       char *path;
       char *bufptr;
 
+      // a conditional request requires the validators of the last download
+      // of the very same URL
+      if(isFlagSet(flags, DLURLF_CONDITIONAL) && filename != NULL)
+      {
+        snprintf(tc->requestedURL, sizeof(tc->requestedURL), "%s%s%s", server, request != NULL ? "/" : "", request != NULL ? request : "");
+        LoadValidators(tc, filename);
+      }
+
 redirected:
       // extract the server address and strip the http:// part
       // of the URI
@@ -239,6 +556,9 @@ redirected:
       else
         path = (char *)"";
 
+      // remember the host part for the "Host:" header and relative redirections
+      strlcpy(tc->hostPart, tc->url, sizeof(tc->hostPart));
+
       // extract the hostname from the URL or use the proxy server
       // address if specified.
       strlcpy(tc->server.hostname, noproxy ? tc->url : C->ProxyServer, sizeof(tc->server.hostname));
@@ -258,6 +578,14 @@ redirected:
       // use the extracted host name as description for logging purposes
       strlcpy(tc->server.description, tc->server.hostname, sizeof(tc->server.description));
 
+      // a connection kept alive to another server is of no use
+      if(tc->connection->isConnected == TRUE &&
+         (stricmp(tc->connectedHost, tc->server.hostname) != 0 || tc->connectedPort != tc->server.port))
+      {
+        PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_HTTP_DISCONNECTING_FROM_SERVER));
+        DisconnectFromHost(tc->connection);
+      }
+
       // create a new transfer window
       if(tc->transferGroup == NULL)
       {
@@ -272,45 +600,48 @@ redirected:
 
       if(tc->transferGroup != NULL)
       {
+        BOOL connected;
+
         PushMethodOnStack(tc->transferGroup, 3, MUIM_Set, MUIA_TransferControlGroup_MailMode, FALSE);
-        PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_HTTP_CONNECTING_TO_SERVER));
 
-        // open the TCP/IP connection to 'host' under the port 'hport'
-        if(ConnectToHost(tc->connection, &tc->server) == CONNECTERR_SUCCESS)
+        if(tc->connection->isConnected == TRUE)
+        {
+          D(DBF_NET, "reusing connection to '%s:%ld'", tc->server.hostname, tc->server.port);
+          connected = TRUE;
+        }
+        else
         {
-          char *serverHost;
-          char *port;
+          PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_HTTP_CONNECTING_TO_SERVER));
+
+          // open the TCP/IP connection to 'host' under the port 'hport'
+          if((connected = (ConnectToHost(tc->connection, &tc->server) == CONNECTERR_SUCCESS)) == TRUE)
+          {
+            strlcpy(tc->connectedHost, tc->server.hostname, sizeof(tc->connectedHost));
+            tc->connectedPort = tc->server.port;
+          }
+        }
 
+        if(connected == TRUE)
+        {
           // now we build the HTTP request we send out to the HTTP
           // server
           if(noproxy == TRUE)
-          {
             snprintf(tc->serverPath, sizeof(tc->serverPath), "/%s", path);
-            serverHost = tc->server.hostname;
-          }
-          else if((port = strchr(tc->url, ':')) != NULL)
-          {
-            *port++ = '\0';
-
-            snprintf(tc->serverPath, sizeof(tc->serverPath), "http://%s:%s/%s", tc->url, port, path);
-            serverHost = tc->url;
-          }
           else
-          {
-            snprintf(tc->serverPath, sizeof(tc->serverPath), "http://%s/%s", tc->url, path);
-            serverHost = tc->url;
-          }
+            snprintf(tc->serverPath, sizeof(tc->serverPath), "http://%s/%s", tc->hostPart, path);
 
-          // construct the HTTP request
-          // we send a HTTP/1.0 request because 1.1 implies that we have to be able
-          // to deal with e.g. "Transfer-Encoding: chunked" responses which we can't handle
-          // right now.
-          snprintf(tc->requestResponse, sizeof(tc->requestResponse), "GET %s HTTP/1.0\r\n"
+          // construct the HTTP request, we accept gzip compressed bodies and
+          // ask for the document only if it differs from the existing file
+          snprintf(tc->requestResponse, sizeof(tc->requestResponse), "GET %s HTTP/1.1\r\n"
                                                                      "Host: %s\r\n"
                                                                      "User-Agent: %s\r\n"
-                                                                     "Connection: close\r\n"
                                                                      "Accept: */*\r\n"
-                                                                     "\r\n", tc->serverPath, serverHost, yamuseragent);
+                                                                     "Accept-Encoding: gzip\r\n"
+                                                                     "%s%s%s"
+                                                                     "%s%s%s"
+                                                                     "\r\n", tc->serverPath, tc->hostPart, yamuseragent,
+                                                                     tc->etag[0] != '\0' ? "If-None-Match: " : "", tc->etag, tc->etag[0] != '\0' ? "\r\n" : "",
+                                                                     tc->lastModified[0] != '\0' ? "If-Modified-Since: " : "", tc->lastModified, tc->lastModified[0] != '\0' ? "\r\n" : "");
 
           SHOWSTRING(DBF_NET, tc->requestResponse);
 
@@ -332,6 +663,8 @@ redirected:
             // check the server response
             if(len > 0 && strnicmp(tc->requestResponse, "HTTP/", 5) == 0 && (p = strchr(tc->requestResponse, ' ')) != NULL)
             {
+              BOOL http11 = (strnicmp(tc->requestResponse, "HTTP/1.0", 8) != 0);
+
               error = atoi(TrimStart(p));
 
               switch(error)
@@ -340,26 +673,63 @@ redirected:
                 {
                   PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_HTTP_RECEIVING_DATA));
 
-                  if(ReceiveHTTPHeader(tc) == TRUE)
+                  if(ReceiveHTTPHeader(tc, http11) == TRUE)
                   {
                     // now receive the desired file contents
                     success = ReceiveHTTPBody(tc, filename);
-                    break;
+
+                    // remember the validators for the next download
+                    if(success == TRUE && tc->requestedURL[0] != '\0')
+                      SaveValidators(tc);
+                  }
+                }
+                break;
+
+                case 304: // Not Modified
+                {
+                  // this response comes without any body and only if we sent
+                  // the validators of the existing file, which is still up to date
+                  if(ReceiveHTTPHeader(tc, http11) == TRUE)
+                  {
+                    D(DBF_NET, "document '%s' is not modified", filename);
+                    success = TRUE;
                   }
                 }
                 break;
 
                 case 301: // Moved Permanently
                 case 302: // Found
+                case 303: // See Other
+                case 307: // Temporary Redirect
+                case 308: // Permanent Redirect
                 {
                   // receive redirection header
-                  if(ReceiveHTTPHeader(tc) == TRUE)
+                  if(ReceiveHTTPHeader(tc, http11) == TRUE)
                   {
                     // receive the body, but ignore its contents
                     if(ReceiveHTTPBody(tc, NULL) == TRUE)
                     {
-                      PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_HTTP_DISCONNECTING_FROM_SERVER));
-                      DisconnectFromHost(tc->connection);
+                      if(++redirections > MAX_REDIRECTIONS)
+                      {
+                        W(DBF_NET, "too many redirections, giving up at '%s'", tc->redirectedURL);
+                        ER_NewError(tr(MSG_ER_TOO_MANY_REDIRECTIONS), tc->redirectedURL);
+                        break;
+                      }
+
+                      // the connection is kept open if the server allows it
+                      if(tc->keepAlive == FALSE)
+                      {
+                        PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_HTTP_DISCONNECTING_FROM_SERVER));
+                        DisconnectFromHost(tc->connection);
+                      }
+
+                      // a relative redirection stays on the same server
+                      if(tc->redirectedURL[0] == '/')
+                      {
+                        snprintf(tc->serverPath, sizeof(tc->serverPath), "%s%s", tc->hostPart, tc->redirectedURL);
+                        strlcpy(tc->redirectedURL, tc->serverPath, sizeof(tc->redirectedURL));
+                      }
+
                       request = NULL;
                       server = tc->redirectedURL;
                       goto redirected;
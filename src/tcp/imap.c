@@ -0,0 +1,1989 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mui/NList_mcc.h>
+#include <mui/NListtree_mcc.h>
+
+#include <clib/alib_protos.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/timer.h>
+#include <proto/utility.h>
+
+#include "extrasrc.h"
+
+#include "YAM.h"
+#include "YAM_error.h"
+#include "YAM_find.h"
+#include "YAM_folderconfig.h"
+#include "YAM_mainFolder.h"
+#include "YAM_stringsizes.h"
+#include "YAM_utilities.h"
+
+#include "mime/base64.h"
+#include "mui/ClassesExtra.h"
+#include "mui/StringRequestWindow.h"
+#include "mui/TransferControlGroup.h"
+#include "mui/YAMApplication.h"
+#include "tcp/Connection.h"
+#include "tcp/imap.h"
+#include "tcp/pop3.h"
+#include "tcp/ssl.h"
+
+#include "Busy.h"
+#include "Config.h"
+#include "FileInfo.h"
+#include "FolderList.h"
+#include "Locale.h"
+#include "Logfile.h"
+#include "MailList.h"
+#include "MailServers.h"
+#include "MethodStack.h"
+#include "MailTransferList.h"
+#include "MUIObjects.h"
+#include "Threads.h"
+
+#include "Debug.h"
+
+/**************************************************************************/
+// IMAP commands (RFC 3501)
+// the order of the following enum & pointer array is important and have to
+// match each other or weird things will happen.
+enum IMAPCommand
+{
+  // IMAP4rev1 standard commands
+  IMAPCMD_CONNECT,      IMAPCMD_CAPABILITY, IMAPCMD_STARTTLS, IMAPCMD_LOGIN,
+  IMAPCMD_AUTHENTICATE, IMAPCMD_STATUS,     IMAPCMD_SELECT,   IMAPCMD_EXAMINE,
+  IMAPCMD_FETCH,        IMAPCMD_STORE,      IMAPCMD_EXPUNGE,  IMAPCMD_LOGOUT,
+
+  // IMAP extended commands
+  IMAPCMD_IDLE
+};
+
+static const char *const IMAPcmd[] =
+{
+  // IMAP4rev1 standard commands
+  "",             "CAPABILITY", "STARTTLS",  "LOGIN",
+  "AUTHENTICATE", "STATUS",     "SELECT",    "EXAMINE",
+  "UID FETCH",    "UID STORE",  "EXPUNGE",   "LOGOUT",
+
+  // IMAP extended commands
+  "IDLE"
+};
+
+// IMAP responses
+#define IMAP_RESP_OKAY       "OK"
+#define IMAP_RESP_UNTAGGED   "* "
+#define IMAP_RESP_CONTINUE   '+'
+
+/**************************************************************************/
+// local macros & defines
+
+// capabilities of an IMAP server we are interested in
+#define IMAPCAP_IDLE          (1<<0) // IDLE command (RFC 2177)
+#define IMAPCAP_CONDSTORE     (1<<1) // HIGHESTMODSEQ of a mailbox (RFC 7162)
+#define IMAPCAP_AUTH_PLAIN    (1<<2) // AUTHENTICATE PLAIN (RFC 4616)
+#define IMAPCAP_LOGINDISABLED (1<<3) // LOGIN command is not allowed
+
+// the IDLE command is renewed before the server may consider the connection
+// to be inactive after 30 minutes (RFC 2177)
+#define IMAP_IDLE_TIMEOUT     (29*60)
+
+// seconds to wait before a lost IDLE connection is established again
+#define IMAP_RECONNECT_DELAY  60
+
+// seconds to wait before the main thread is asked again to download the
+// new mails, in case a transfer from the same server was still running
+#define IMAP_RETRY_DELAY      30
+
+// a MODSEQ value (RFC 7162) has 63 bits and thus up to 19 digits
+#define SIZE_MODSEQ           20
+
+// the synchronization state of a mailbox, this is kept between two transfers
+struct IMAPState
+{
+  ULONG uidValidity;                     // the UIDs are valid as long as this doesn't change
+  ULONG uidNext;                         // the UID the next new mail will get at least
+  ULONG lastUID;                         // the highest UID which has been downloaded already
+  char highestModSeq[SIZE_MODSEQ];       // the mailbox' modification sequence, empty if unknown
+};
+
+// a thread which watches the mailbox of an IMAP server for new mails
+struct IMAPWatcher
+{
+  struct MinNode node;                   // for placing it into G->imapWatchers
+  struct MailServerNode *msn;            // a private copy of the server's settings
+  APTR thread;                           // the thread running WatchIMAPMailbox(), NULL when finished
+};
+
+struct TransferContext
+{
+  struct Connection *connection;
+  struct MailServerNode *msn;
+  ULONG abortMask;
+  ULONG timerMask;
+  Object *transferGroup;
+  char imapBuffer[SIZE_LINE];
+  char lineBuffer[SIZE_LINE];
+  char tag[SIZE_SMALL];                  // the tag of the last command sent
+  char windowTitle[SIZE_DEFAULT];        // the password window's title
+  char transferGroupTitle[SIZE_DEFAULT]; // the TransferControlGroup's title
+  char password[SIZE_PASSWORD];
+  ULONG flags;
+  ULONG capabilities;                    // the server's capabilities (IMAPCAP_#?)
+  int tagCounter;
+  BOOL gotCapabilities;                  // the capabilities are known
+  BOOL preauth;                          // the connection is authenticated already
+  BOOL loginFailed;                      // the server rejected the login
+  BOOL quiet;                            // don't report any errors, used by the IDLE watcher
+  BOOL collectMails;                     // add the mails of FETCH responses to the transfer list
+  BOOL newMails;                         // the number of mails in the mailbox increased
+  ULONG exists;                          // the number of mails in the selected mailbox
+  struct IMAPState state;                // the state of the mailbox after the last transfer
+  struct IMAPState status;               // the current state of the mailbox as told by the server
+  struct MailTransferList *transferList;
+  struct Folder *incomingFolder;         // the folder to place the downloaded mails into
+  struct DownloadResult downloadResult;
+  struct FilterResult filterResult;
+  long totalSize;
+  struct TimeVal lastUpdateTime;
+  struct BusyNode *busy;
+};
+
+/// BuildStateFilename
+// set up the name of the file keeping the synchronization state of a server
+static void BuildStateFilename(const struct MailServerNode *msn, char *statePath, const size_t statePathSize)
+{
+  char stateName[SIZE_FILE];
+
+  ENTER();
+
+  // create a file name using the mail server's unique ID
+  snprintf(stateName, sizeof(stateName), ".imap_%08x", msn->id);
+  CreateFilename(stateName, statePath, statePathSize);
+
+  LEAVE();
+}
+
+///
+/// LoadIMAPState
+// load the synchronization state of a server's mailbox, a missing file
+// results in a state which lets all mails be downloaded
+static void LoadIMAPState(const struct MailServerNode *msn, struct IMAPState *state)
+{
+  char statePath[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  memset(state, 0, sizeof(*state));
+
+  BuildStateFilename(msn, statePath, sizeof(statePath));
+
+  if((fh = fopen(statePath, "r")) != NULL)
+  {
+    char mailbox[SIZE_NAME];
+    char modSeq[SIZE_MODSEQ];
+
+    // the state is valid for the mailbox it was saved for only
+    if(fscanf(fh, "IMAPSTATE1 %lu %lu %lu %19s %29[^\n]", &state->uidValidity, &state->uidNext, &state->lastUID, modSeq, mailbox) == 5 &&
+       strcmp(mailbox, msn->imapMailbox) == 0)
+    {
+      // a zero MODSEQ marks an unknown value
+      if(strcmp(modSeq, "0") != 0)
+        strlcpy(state->highestModSeq, modSeq, sizeof(state->highestModSeq));
+
+      D(DBF_NET, "loaded IMAP state of server '%s': UIDVALIDITY %lu, UIDNEXT %lu, last UID %lu, HIGHESTMODSEQ '%s'", msn->description, state->uidValidity, state->uidNext, state->lastUID, state->highestModSeq);
+    }
+    else
+    {
+      W(DBF_NET, "ignoring IMAP state file '%s'", statePath);
+      memset(state, 0, sizeof(*state));
+    }
+
+    fclose(fh);
+  }
+
+  LEAVE();
+}
+
+///
+/// SaveIMAPState
+// save the synchronization state of a server's mailbox
+static void SaveIMAPState(const struct MailServerNode *msn, const struct IMAPState *state)
+{
+  char statePath[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  BuildStateFilename(msn, statePath, sizeof(statePath));
+
+  if((fh = fopen(statePath, "w")) != NULL)
+  {
+    fprintf(fh, "IMAPSTATE1 %lu %lu %lu %s %s\n", state->uidValidity, state->uidNext, state->lastUID, state->highestModSeq[0] != '\0' ? state->highestModSeq : "0", msn->imapMailbox);
+    fclose(fh);
+  }
+  else
+    E(DBF_NET, "couldn't save IMAP state file '%s'", statePath);
+
+  LEAVE();
+}
+
+///
+/// DeleteIMAPStateFile
+// delete the state file of a server in case it is no longer needed, i.e. the
+// account is deleted
+void DeleteIMAPStateFile(const struct MailServerNode *msn)
+{
+  char statePath[SIZE_PATHFILE];
+
+  ENTER();
+
+  BuildStateFilename(msn, statePath, sizeof(statePath));
+
+  if(FileExists(statePath) == TRUE && DeleteFile(statePath) == 0)
+    AddZombieFile(statePath);
+
+  LEAVE();
+}
+
+///
+/// ShowTransferStatus
+// show a status text in the transfer window, the IDLE watcher has got none
+static void ShowTransferStatus(struct TransferContext *tc, const char *status)
+{
+  ENTER();
+
+  if(tc->transferGroup != NULL)
+    PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, status);
+
+  LEAVE();
+}
+
+///
+/// QuoteString
+// make a quoted string (RFC 3501, 4.3) out of a user name, password or
+// mailbox name
+static void QuoteString(char *dst, const size_t dstSize, const char *src)
+{
+  size_t i = 0;
+
+  ENTER();
+
+  dst[i++] = '"';
+
+  // leave room for an escaped character, the closing quote and the NUL byte
+  while(*src != '\0' && i+4 <= dstSize)
+  {
+    if(*src == '"' || *src == '\\')
+      dst[i++] = '\\';
+
+    dst[i++] = *src++;
+  }
+
+  dst[i++] = '"';
+  dst[i] = '\0';
+
+  LEAVE();
+}
+
+///
+/// FindItem
+// find a data item like "UID 42" within a response and return a pointer
+// to its value
+static const char *FindItem(const char *items, const char *name)
+{
+  const char *result = NULL;
+  const char *p = items;
+  size_t len = strlen(name);
+
+  ENTER();
+
+  while((p = strcasestr(p, name)) != NULL)
+  {
+    // the name must be a complete word which is followed by its value
+    if((p == items || p[-1] == ' ' || p[-1] == '(' || p[-1] == '[') && p[len] == ' ')
+    {
+      result = &p[len+1];
+      break;
+    }
+
+    p += len;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// GetNumberItem
+// get the numerical value of a data item
+static BOOL GetNumberItem(const char *items, const char *name, ULONG *value)
+{
+  BOOL found = FALSE;
+  const char *p;
+
+  ENTER();
+
+  if((p = FindItem(items, name)) != NULL && isdigit(p[0]))
+  {
+    *value = strtoul(p, NULL, 10);
+    found = TRUE;
+  }
+
+  RETURN(found);
+  return found;
+}
+
+///
+/// GetModSeqItem
+// get a MODSEQ value, these don't fit into 32 bits and are kept as strings
+static void GetModSeqItem(const char *items, char *modSeq)
+{
+  const char *p;
+
+  ENTER();
+
+  if((p = FindItem(items, "HIGHESTMODSEQ")) != NULL)
+  {
+    size_t len = 0;
+
+    while(isdigit(p[len]) && len < SIZE_MODSEQ-1)
+    {
+      modSeq[len] = p[len];
+      len++;
+    }
+    modSeq[len] = '\0';
+  }
+
+  LEAVE();
+}
+
+///
+/// ParseCapabilities
+// remember the capabilities we are interested in from a CAPABILITY list
+static void ParseCapabilities(struct TransferContext *tc, const char *caps)
+{
+  static const struct
+  {
+    const char *name;
+    ULONG flag;
+  } knownCapabilities[] =
+  {
+    { "IDLE",          IMAPCAP_IDLE          },
+    { "CONDSTORE",     IMAPCAP_CONDSTORE     },
+    { "AUTH=PLAIN",    IMAPCAP_AUTH_PLAIN    },
+    { "LOGINDISABLED", IMAPCAP_LOGINDISABLED }
+  };
+  const char *p = caps;
+
+  ENTER();
+
+  tc->capabilities = 0;
+  tc->gotCapabilities = TRUE;
+
+  // the list ends with the line or with the response code's bracket
+  while(*p != '\0' && *p != ']' && *p != '\r' && *p != '\n')
+  {
+    size_t len = strcspn(p, " ]\r\n");
+    unsigned int i;
+
+    for(i = 0; i < ARRAY_SIZE(knownCapabilities); i++)
+    {
+      if(strlen(knownCapabilities[i].name) == len && strnicmp(p, knownCapabilities[i].name, len) == 0)
+      {
+        setFlag(tc->capabilities, knownCapabilities[i].flag);
+        break;
+      }
+    }
+
+    p += len;
+    if(*p == ' ')
+      p++;
+  }
+
+  D(DBF_NET, "IMAP server '%s' capabilities %08lx", tc->msn->hostname, tc->capabilities);
+
+  LEAVE();
+}
+
+///
+/// ParseResponseCode
+// evaluate the response code of a status response, like "[UIDNEXT 42]"
+static void ParseResponseCode(struct TransferContext *tc, const char *text)
+{
+  ENTER();
+
+  if(text[0] == '[')
+  {
+    if(strnicmp(&text[1], "CAPABILITY ", 11) == 0)
+      ParseCapabilities(tc, &text[12]);
+    else if(strnicmp(&text[1], "UIDVALIDITY ", 12) == 0)
+      tc->status.uidValidity = strtoul(&text[13], NULL, 10);
+    else if(strnicmp(&text[1], "UIDNEXT ", 8) == 0)
+      tc->status.uidNext = strtoul(&text[9], NULL, 10);
+    else if(strnicmp(&text[1], "HIGHESTMODSEQ ", 14) == 0)
+      GetModSeqItem(text, tc->status.highestModSeq);
+  }
+
+  LEAVE();
+}
+
+///
+/// ParseFetchResponse
+// evaluate the data items of a FETCH response while the list of new mails is
+// obtained, all other FETCH responses are not of interest
+static void ParseFetchResponse(struct TransferContext *tc, const char *items)
+{
+  ULONG uid;
+  ULONG size;
+
+  ENTER();
+
+  // the range "n:*" always contains the mail with the highest UID, even if
+  // it is below n (RFC 3501, 6.4.8), so this one is filtered out here
+  if(tc->collectMails == TRUE &&
+     GetNumberItem(items, "UID", &uid) == TRUE && uid > tc->state.lastUID &&
+     GetNumberItem(items, "RFC822.SIZE", &size) == TRUE)
+  {
+    struct Mail *newMail;
+
+    if((newMail = AllocMail()) != NULL)
+    {
+      struct MailTransferNode *tnode;
+      ULONG tflags = TRF_TRANSFER;
+
+      newMail->Size = size;
+
+      // mails are deleted only after they have been stored successfully
+      if(hasServerPurge(tc->msn) == TRUE)
+        setFlag(tflags, TRF_DELETE);
+
+      if((tnode = CreateMailTransferNode(newMail, tflags)) != NULL)
+      {
+        // IMAP servers identify the mails by their UIDs instead of an index
+        tnode->index = uid;
+
+        AddMailTransferNode(tc->transferList, tnode);
+      }
+      else
+        FreeMail(newMail);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// ParseUntaggedResponse
+// evaluate an untagged response of the server, the line starts right after
+// the leading "* "
+static void ParseUntaggedResponse(struct TransferContext *tc, const char *line)
+{
+  ENTER();
+
+  if(strnicmp(line, "CAPABILITY ", 11) == 0)
+  {
+    ParseCapabilities(tc, &line[11]);
+  }
+  else if(strnicmp(line, "OK ", 3) == 0 || strnicmp(line, "NO ", 3) == 0)
+  {
+    ParseResponseCode(tc, &line[3]);
+  }
+  else if(strnicmp(line, "PREAUTH ", 8) == 0)
+  {
+    ParseResponseCode(tc, &line[8]);
+  }
+  else if(strnicmp(line, "STATUS ", 7) == 0)
+  {
+    const char *items;
+
+    // the list of items follows the mailbox name
+    if((items = strrchr(line, '(')) != NULL)
+    {
+      GetNumberItem(items, "UIDVALIDITY", &tc->status.uidValidity);
+      GetNumberItem(items, "UIDNEXT", &tc->status.uidNext);
+      GetModSeqItem(items, tc->status.highestModSeq);
+    }
+  }
+  else if(isdigit(line[0]))
+  {
+    char *p;
+    ULONG number = strtoul(line, &p, 10);
+
+    if(*p == ' ')
+      p++;
+
+    if(strnicmp(p, "EXISTS", 6) == 0)
+    {
+      if(number > tc->exists)
+        tc->newMails = TRUE;
+
+      tc->exists = number;
+    }
+    else if(strnicmp(p, "EXPUNGE", 7) == 0)
+    {
+      if(tc->exists > 0)
+        tc->exists--;
+    }
+    else if(strnicmp(p, "FETCH ", 6) == 0)
+    {
+      ParseFetchResponse(tc, &p[6]);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// GetLiteralSize
+// check if a response line announces a literal "{n}" and return its size
+static long GetLiteralSize(const char *line)
+{
+  long size = -1;
+  size_t len = strlen(line);
+
+  ENTER();
+
+  if(len >= 5 && strcmp(&line[len-3], "}\r\n") == 0)
+  {
+    const char *p;
+
+    if((p = strrchr(line, '{')) != NULL && isdigit(p[1]))
+      size = strtol(&p[1], NULL, 10);
+  }
+
+  RETURN(size);
+  return size;
+}
+
+///
+/// SkipLiteral
+// receive and drop the data of a literal
+static BOOL SkipLiteral(struct TransferContext *tc, long size)
+{
+  BOOL success = TRUE;
+
+  ENTER();
+
+  while(size > 0)
+  {
+    int len;
+
+    if((len = ReceiveFromHost(tc->connection, tc->lineBuffer, MIN(size, (long)sizeof(tc->lineBuffer)-1)+1)) <= 0)
+    {
+      success = FALSE;
+      break;
+    }
+
+    size -= len;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// SkipRestOfLine
+// drop the rest of an overlong line, the important parts of a response
+// are at its beginning
+static BOOL SkipRestOfLine(struct TransferContext *tc, const char *line, int len)
+{
+  BOOL success = TRUE;
+
+  ENTER();
+
+  while(len > 0 && line[len-1] != '\n')
+  {
+    line = tc->lineBuffer;
+
+    if((len = ReceiveLineFromHost(tc->connection, tc->lineBuffer, sizeof(tc->lineBuffer))) <= 0)
+      success = FALSE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// ReceiveIMAPLine
+// receives the next response line from the IMAP server. Literals within
+// the line are skipped if requested, so that the line is complete then.
+static int ReceiveIMAPLine(struct TransferContext *tc, const BOOL skipLiterals)
+{
+  int len;
+
+  ENTER();
+
+  if((len = ReceiveLineFromHost(tc->connection, tc->imapBuffer, sizeof(tc->imapBuffer))) > 0)
+  {
+    long size;
+
+    if(SkipRestOfLine(tc, tc->imapBuffer, len) == FALSE)
+      len = -1;
+
+    while(skipLiterals == TRUE && len > 0 && (size = GetLiteralSize(tc->imapBuffer)) >= 0)
+    {
+      int more;
+
+      // strip the literal from the line and append the line's continuation
+      *strrchr(tc->imapBuffer, '{') = '\0';
+
+      if(SkipLiteral(tc, size) == FALSE ||
+         (more = ReceiveLineFromHost(tc->connection, tc->lineBuffer, sizeof(tc->lineBuffer))) <= 0)
+      {
+        len = -1;
+        break;
+      }
+
+      strlcat(tc->imapBuffer, tc->lineBuffer, sizeof(tc->imapBuffer));
+      len = strlen(tc->imapBuffer);
+
+      if(SkipRestOfLine(tc, tc->lineBuffer, more) == FALSE)
+        len = -1;
+    }
+  }
+
+  RETURN(len);
+  return len;
+}
+
+///
+/// IsTaggedResponse
+// check if the current response line is the final one to the last command
+static BOOL IsTaggedResponse(const struct TransferContext *tc)
+{
+  size_t tagLen = strlen(tc->tag);
+
+  return (BOOL)(strncmp(tc->imapBuffer, tc->tag, tagLen) == 0 && tc->imapBuffer[tagLen] == ' ');
+}
+
+///
+/// ReceiveIMAPReply
+//  Receives the reply to a command from the IMAP server. All untagged
+//  responses up to the tagged one are evaluated on the way.
+static char *ReceiveIMAPReply(struct TransferContext *tc, const enum IMAPCommand command, const char *errorMsg)
+{
+  char *result = NULL;
+  BOOL done = FALSE;
+
+  ENTER();
+
+  while(done == FALSE && ReceiveIMAPLine(tc, TRUE) > 0)
+  {
+    D(DBF_NET, "received IMAP answer '%s'", tc->imapBuffer);
+
+    if(strncmp(tc->imapBuffer, IMAP_RESP_UNTAGGED, strlen(IMAP_RESP_UNTAGGED)) == 0)
+    {
+      ParseUntaggedResponse(tc, &tc->imapBuffer[2]);
+    }
+    else if(tc->imapBuffer[0] == IMAP_RESP_CONTINUE)
+    {
+      // the server waits for more data, this is expected by some commands only
+      if(command == IMAPCMD_AUTHENTICATE || command == IMAPCMD_IDLE)
+        result = tc->imapBuffer;
+
+      done = TRUE;
+    }
+    else if(IsTaggedResponse(tc) == TRUE)
+    {
+      char *status = &tc->imapBuffer[strlen(tc->tag)+1];
+
+      if(strnicmp(status, IMAP_RESP_OKAY, 2) == 0 && (status[2] == ' ' || status[2] == '\r'))
+      {
+        if(status[2] == ' ')
+          ParseResponseCode(tc, &status[3]);
+
+        // everything worked out fine so lets set
+        // the result to our allocated buffer
+        result = status;
+      }
+
+      done = TRUE;
+    }
+  }
+
+  if(result == NULL)
+  {
+    // a rejected login is not worth being tried again
+    if(done == TRUE && (command == IMAPCMD_LOGIN || command == IMAPCMD_AUTHENTICATE))
+      tc->loginFailed = TRUE;
+
+    // only report an error if explicitly wanted and don't show an error
+    // message for a failed LOGOUT command with no answer at all
+    if(errorMsg != NULL && tc->quiet == FALSE && (command != IMAPCMD_LOGOUT || done == TRUE))
+      ER_NewError(errorMsg, tc->msn->hostname, tc->msn->description, (char *)IMAPcmd[command], tc->imapBuffer);
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// SendIMAPRequest
+//  Sends a command with a new tag to the IMAP server without waiting for
+//  the reply
+static BOOL SendIMAPRequest(struct TransferContext *tc, const enum IMAPCommand command, const char *parmtext)
+{
+  BOOL success;
+
+  ENTER();
+
+  snprintf(tc->tag, sizeof(tc->tag), "Y%04d", ++tc->tagCounter);
+
+  // if we specified a parameter for the command lets add it now
+  if(IsStrEmpty(parmtext))
+    snprintf(tc->imapBuffer, sizeof(tc->imapBuffer), "%s %s\r\n", tc->tag, IMAPcmd[command]);
+  else
+    snprintf(tc->imapBuffer, sizeof(tc->imapBuffer), "%s %s %s\r\n", tc->tag, IMAPcmd[command], parmtext);
+
+  D(DBF_NET, "send IMAP cmd '%s %s' with param '%s'", tc->tag, IMAPcmd[command], (command == IMAPCMD_LOGIN) ? "XXX" : SafeStr(parmtext));
+
+  success = (SendLineToHost(tc->connection, tc->imapBuffer) > 0);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// SendIMAPCommand
+//  Sends a command to the IMAP server and receives the reply
+static char *SendIMAPCommand(struct TransferContext *tc, const enum IMAPCommand command, const char *parmtext, const char *errorMsg)
+{
+  char *result = NULL;
+
+  ENTER();
+
+  if(SendIMAPRequest(tc, command, parmtext) == TRUE)
+    result = ReceiveIMAPReply(tc, command, errorMsg);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ReceiveIMAPGreeting
+//  Receives the greeting of the IMAP server, which might tell us that the
+//  connection is authenticated already
+static BOOL ReceiveIMAPGreeting(struct TransferContext *tc)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if(ReceiveIMAPLine(tc, TRUE) > 0)
+  {
+    D(DBF_NET, "received IMAP greeting '%s'", tc->imapBuffer);
+
+    if(strnicmp(tc->imapBuffer, "* OK", 4) == 0)
+      success = TRUE;
+    else if(strnicmp(tc->imapBuffer, "* PREAUTH", 9) == 0)
+      success = tc->preauth = TRUE;
+
+    // the greeting might contain the server's capabilities
+    if(success == TRUE)
+      ParseUntaggedResponse(tc, &tc->imapBuffer[2]);
+  }
+
+  if(success == FALSE && tc->quiet == FALSE)
+    ER_NewError(tr(MSG_ER_IMAPWELCOME), tc->msn->hostname, tc->msn->description, tc->imapBuffer);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// SecureIMAPConnection
+//  Starts the TLS/SSL negotiation on the connection
+static BOOL SecureIMAPConnection(struct TransferContext *tc)
+{
+  BOOL success;
+
+  ENTER();
+
+  ShowTransferStatus(tc, tr(MSG_TR_INITTLS));
+
+  if((success = MakeSecureConnection(tc->connection)) == FALSE && tc->quiet == FALSE)
+    ER_NewError(tr(MSG_ER_INITTLS_POP3), tc->msn->hostname, tc->msn->description);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// LoginToIMAP
+//  Authenticates the user, AUTHENTICATE PLAIN is preferred over LOGIN if the
+//  server offers it
+static BOOL LoginToIMAP(struct TransferContext *tc)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if(isFlagSet(tc->capabilities, IMAPCAP_AUTH_PLAIN))
+  {
+    ShowTransferStatus(tc, tr(MSG_TR_SendPassword));
+
+    // wait for the server's continuation request first
+    if(SendIMAPCommand(tc, IMAPCMD_AUTHENTICATE, "PLAIN", tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
+    {
+      char plain[SIZE_USERID+SIZE_PASSWORD+2];
+      size_t userLen = strlen(tc->msn->username);
+      size_t passLen = strlen(tc->password);
+      char *enctext = NULL;
+      char *resp;
+
+      // (RFC 4616) the credentials are sent as "\0user\0password"
+      plain[0] = '\0';
+      memcpy(&plain[1], tc->msn->username, userLen);
+      plain[userLen+1] = '\0';
+      memcpy(&plain[userLen+2], tc->password, passLen);
+
+      if(base64encode(&enctext, plain, userLen+passLen+2) > 0)
+      {
+        snprintf(tc->lineBuffer, sizeof(tc->lineBuffer), "%s\r\n", enctext);
+        free(enctext);
+
+        // another continuation request would be a challenge we can't answer
+        if(SendLineToHost(tc->connection, tc->lineBuffer) > 0 &&
+           (resp = ReceiveIMAPReply(tc, IMAPCMD_AUTHENTICATE, tr(MSG_ER_BADRESPONSE_POP3))) != NULL &&
+           resp[0] != IMAP_RESP_CONTINUE)
+        {
+          success = TRUE;
+        }
+      }
+
+      // don't leave the credentials in memory
+      memset(plain, 0, sizeof(plain));
+      memset(tc->lineBuffer, 0, sizeof(tc->lineBuffer));
+    }
+  }
+  else
+  {
+    char quotedUser[SIZE_USERID*2+3];
+    char quotedPassword[SIZE_PASSWORD*2+3];
+
+    ShowTransferStatus(tc, tr(MSG_TR_SendUserID));
+
+    QuoteString(quotedUser, sizeof(quotedUser), tc->msn->username);
+    QuoteString(quotedPassword, sizeof(quotedPassword), tc->password);
+    snprintf(tc->lineBuffer, sizeof(tc->lineBuffer), "%s %s", quotedUser, quotedPassword);
+
+    if(SendIMAPCommand(tc, IMAPCMD_LOGIN, tc->lineBuffer, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
+      success = TRUE;
+
+    // don't leave the credentials in memory
+    memset(quotedPassword, 0, sizeof(quotedPassword));
+    memset(tc->lineBuffer, 0, sizeof(tc->lineBuffer));
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// ConnectToIMAP
+//  Connects to an IMAP mail server and logs in
+static BOOL ConnectToIMAP(struct TransferContext *tc)
+{
+  BOOL success = FALSE;
+  enum ConnectError err;
+
+  ENTER();
+
+  D(DBF_NET, "connect to IMAP server '%s'", tc->msn->hostname);
+
+  // forget everything about a previous connection
+  tc->capabilities = 0;
+  tc->gotCapabilities = FALSE;
+  tc->preauth = FALSE;
+  tc->loginFailed = FALSE;
+  tc->newMails = FALSE;
+  tc->exists = 0;
+
+  ShowTransferStatus(tc, tr(MSG_TR_Connecting));
+
+  // show some busy text in the main window, but not for the IDLE watcher
+  if(tc->quiet == FALSE)
+  {
+    tc->busy = BusyBegin(BUSY_TEXT);
+    BusyText(tc->busy, tr(MSG_TR_MAILCHECKFROM), tc->msn->description);
+  }
+
+  // now we start our connection to the IMAP server
+  if((err = ConnectToHost(tc->connection, tc->msn)) != CONNECTERR_SUCCESS)
+  {
+    if(isFlagSet(tc->flags, RECEIVEF_USER))
+    {
+      switch(err)
+      {
+        case CONNECTERR_SUCCESS:
+        case CONNECTERR_ABORTED:
+        case CONNECTERR_NO_ERROR:
+          // do nothing
+        break;
+
+        // socket is already in use
+        case CONNECTERR_SOCKET_IN_USE:
+          ER_NewError(tr(MSG_ER_CONNECTERR_SOCKET_IN_USE_POP3), tc->msn->hostname, tc->msn->description);
+        break;
+
+        // socket() execution failed
+        case CONNECTERR_NO_SOCKET:
+          ER_NewError(tr(MSG_ER_CONNECTERR_NO_SOCKET_POP3), tc->msn->hostname, tc->msn->description);
+        break;
+
+        // couldn't establish non-blocking IO
+        case CONNECTERR_NO_NONBLOCKIO:
+          ER_NewError(tr(MSG_ER_CONNECTERR_NO_NONBLOCKIO_POP3), tc->msn->hostname, tc->msn->description);
+        break;
+
+        // connection request timed out
+        case CONNECTERR_TIMEDOUT:
+          ER_NewError(tr(MSG_ER_CONNECTERR_TIMEDOUT_POP3), tc->msn->hostname, tc->msn->description);
+        break;
+
+        // unknown host - gethostbyname() failed
+        case CONNECTERR_UNKNOWN_HOST:
+          ER_NewError(tr(MSG_ER_UNKNOWN_HOST_IMAP), tc->msn->hostname, tc->msn->description);
+        break;
+
+        // general connection error
+        case CONNECTERR_UNKNOWN_ERROR:
+          ER_NewError(tr(MSG_ER_CANNOT_CONNECT_IMAP), tc->msn->hostname, tc->msn->description);
+        break;
+
+        case CONNECTERR_SSLFAILED:
+        case CONNECTERR_INVALID8BIT:
+        case CONNECTERR_NO_CONNECTION:
+        case CONNECTERR_NOT_CONNECTED:
+          // can't occur, do nothing
+        break;
+      }
+    }
+
+    goto out;
+  }
+
+  // a connection on port 993 is secured before the server says anything
+  if(hasServerSSL(tc->msn) && SecureIMAPConnection(tc) == FALSE)
+    goto out;
+
+  ShowTransferStatus(tc, tr(MSG_TR_WaitWelcome));
+  if(ReceiveIMAPGreeting(tc) == FALSE)
+    goto out;
+
+  // If the user selected STARTTLS support we have to first send the command
+  // to start TLS negotiation (RFC 3501, 6.2.1)
+  if(hasServerTLS(tc->msn))
+  {
+    if(SendIMAPCommand(tc, IMAPCMD_STARTTLS, NULL, tr(MSG_ER_BADRESPONSE_POP3)) == NULL ||
+       SecureIMAPConnection(tc) == FALSE)
+    {
+      goto out;
+    }
+
+    // the capabilities told before the negotiation must be discarded
+    tc->gotCapabilities = FALSE;
+  }
+
+  if(tc->gotCapabilities == FALSE && SendIMAPCommand(tc, IMAPCMD_CAPABILITY, NULL, tr(MSG_ER_BADRESPONSE_POP3)) == NULL)
+    goto out;
+
+  if(tc->preauth == FALSE)
+  {
+    if(IsStrEmpty(tc->password))
+    {
+      Object *passwordWin;
+
+      // nobody can be asked for the password by the IDLE watcher
+      if(tc->quiet == TRUE)
+      {
+        tc->loginFailed = TRUE;
+        goto out;
+      }
+
+      snprintf(tc->windowTitle, sizeof(tc->windowTitle), tr(MSG_TR_ENTER_IMAP_PASSWORD), tc->msn->description);
+
+      if((passwordWin = (Object *)PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_CreatePasswordWindow, CurrentThread(), tr(MSG_TR_IMAPLogin), tc->windowTitle, sizeof(tc->password))) != NULL)
+      {
+        ShowTransferStatus(tc, tr(MSG_TR_WAIT_FOR_PASSWORD));
+
+        if(SleepThread() == TRUE)
+        {
+          ULONG result = 0;
+
+          PushMethodOnStackWait(passwordWin, 3, OM_GET, MUIA_StringRequestWindow_Result, &result);
+          if(result != 0)
+            PushMethodOnStackWait(passwordWin, 3, OM_GET, MUIA_StringRequestWindow_StringContents, tc->password);
+        }
+        else
+        {
+          // force "no password" if we were aborted
+          tc->password[0] = '\0';
+        }
+
+        PushMethodOnStack(G->App, 2, MUIM_YAMApplication_DisposeWindow, passwordWin);
+      }
+
+      // bail out if we still got no password
+      if(IsStrEmpty(tc->password))
+        goto out;
+    }
+
+    // the server may tell different capabilities after the login
+    tc->gotCapabilities = FALSE;
+
+    if(LoginToIMAP(tc) == FALSE)
+      goto out;
+
+    if(tc->gotCapabilities == FALSE && SendIMAPCommand(tc, IMAPCMD_CAPABILITY, NULL, tr(MSG_ER_BADRESPONSE_POP3)) == NULL)
+      goto out;
+  }
+
+  success = TRUE;
+
+out:
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// DisconnectFromIMAP
+static void DisconnectFromIMAP(struct TransferContext *tc)
+{
+  ENTER();
+
+  D(DBF_NET, "disconnecting from IMAP server '%s'", tc->msn->hostname);
+  ShowTransferStatus(tc, tr(MSG_TR_Disconnecting));
+  if(tc->connection->error == CONNECTERR_NO_ERROR)
+    SendIMAPCommand(tc, IMAPCMD_LOGOUT, NULL, tr(MSG_ER_BADRESPONSE_POP3));
+
+  DisconnectFromHost(tc->connection);
+
+  BusyEnd(tc->busy);
+  tc->busy = NULL;
+
+  LEAVE();
+}
+
+///
+/// GetMailboxStatus
+//  Asks for the state of the mailbox without selecting it
+static BOOL GetMailboxStatus(struct TransferContext *tc)
+{
+  BOOL success = FALSE;
+  char quotedMailbox[SIZE_NAME*2+3];
+
+  ENTER();
+
+  memset(&tc->status, 0, sizeof(tc->status));
+
+  QuoteString(quotedMailbox, sizeof(quotedMailbox), tc->msn->imapMailbox);
+  snprintf(tc->lineBuffer, sizeof(tc->lineBuffer), "%s (UIDVALIDITY UIDNEXT%s)", quotedMailbox, isFlagSet(tc->capabilities, IMAPCAP_CONDSTORE) ? " HIGHESTMODSEQ" : "");
+
+  if(SendIMAPCommand(tc, IMAPCMD_STATUS, tc->lineBuffer, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
+    success = TRUE;
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// SelectMailbox
+//  Selects the mailbox for reading and writing or examines it read-only
+static BOOL SelectMailbox(struct TransferContext *tc, const enum IMAPCommand command)
+{
+  BOOL success = FALSE;
+  char quotedMailbox[SIZE_NAME*2+16];
+
+  ENTER();
+
+  memset(&tc->status, 0, sizeof(tc->status));
+  tc->exists = 0;
+
+  QuoteString(quotedMailbox, sizeof(quotedMailbox), tc->msn->imapMailbox);
+
+  // let the server tell the HIGHESTMODSEQ of the mailbox as well
+  if(command == IMAPCMD_SELECT && isFlagSet(tc->capabilities, IMAPCAP_CONDSTORE))
+    strlcat(quotedMailbox, " (CONDSTORE)", sizeof(quotedMailbox));
+
+  if(SendIMAPCommand(tc, command, quotedMailbox, tc->quiet == FALSE ? tr(MSG_ER_BADRESPONSE_POP3) : NULL) != NULL)
+    success = TRUE;
+
+  // the mails which exist already are not new
+  tc->newMails = FALSE;
+
+  D(DBF_NET, "mailbox '%s' has %ld mails, UIDVALIDITY %lu, UIDNEXT %lu", tc->msn->imapMailbox, tc->exists, tc->status.uidValidity, tc->status.uidNext);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// CheckUIDValidity
+//  Forgets about all downloaded mails if the UIDs of the mailbox were
+//  reassigned by the server (RFC 3501, 2.3.1.1)
+static void CheckUIDValidity(struct TransferContext *tc)
+{
+  ENTER();
+
+  if(tc->status.uidValidity != tc->state.uidValidity)
+  {
+    W(DBF_NET, "UIDVALIDITY of mailbox '%s' changed from %lu to %lu", tc->msn->imapMailbox, tc->state.uidValidity, tc->status.uidValidity);
+
+    tc->state.uidValidity = tc->status.uidValidity;
+    tc->state.uidNext = 0;
+    tc->state.lastUID = 0;
+    tc->state.highestModSeq[0] = '\0';
+  }
+
+  LEAVE();
+}
+
+///
+/// MailboxHasNewMails
+//  Finds out from the state of the mailbox whether there might be mails
+//  which have not been downloaded yet
+static BOOL MailboxHasNewMails(struct TransferContext *tc)
+{
+  BOOL newMails = TRUE;
+
+  ENTER();
+
+  CheckUIDValidity(tc);
+
+  if(tc->status.highestModSeq[0] != '\0' && strcmp(tc->status.highestModSeq, tc->state.highestModSeq) == 0)
+  {
+    // nothing at all happened to the mailbox since the last transfer (RFC 7162)
+    D(DBF_NET, "HIGHESTMODSEQ of mailbox '%s' is unchanged", tc->msn->imapMailbox);
+    newMails = FALSE;
+  }
+  else if(tc->status.uidNext != 0 && tc->status.uidNext <= tc->state.lastUID+1)
+  {
+    // all existing mails have got UIDs below UIDNEXT
+    D(DBF_NET, "UIDNEXT of mailbox '%s' is %lu, last downloaded UID is %lu", tc->msn->imapMailbox, tc->status.uidNext, tc->state.lastUID);
+    newMails = FALSE;
+  }
+
+  RETURN(newMails);
+  return newMails;
+}
+
+///
+/// GetMessageList
+//  Collects the mails with UIDs above the last downloaded one
+static BOOL GetMessageList(struct TransferContext *tc)
+{
+  BOOL success = TRUE;
+
+  ENTER();
+
+  // an empty mailbox would let the range be rejected
+  if(tc->exists > 0)
+  {
+    // only the sizes of the new mails are of interest (RFC 3501, 6.4.8)
+    snprintf(tc->lineBuffer, sizeof(tc->lineBuffer), "%lu:* (UID RFC822.SIZE)", tc->state.lastUID+1);
+
+    tc->collectMails = TRUE;
+    if(SendIMAPCommand(tc, IMAPCMD_FETCH, tc->lineBuffer, tr(MSG_ER_BADRESPONSE_POP3)) == NULL)
+      success = FALSE;
+    tc->collectMails = FALSE;
+  }
+
+  // remember the total number of mails on the server
+  tc->downloadResult.onServer = tc->exists;
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// ReceiveLiteralToFile
+//  Receives the literal containing a mail and writes it to the given file,
+//  whereby the "\r\n" line endings are converted to "\n".
+static BOOL ReceiveLiteralToFile(struct TransferContext *tc, FILE *fh, const char *filename, long size)
+{
+  int unreported = 0;
+  BOOL pendingCR = FALSE;
+  BOOL error = FALSE;
+
+  ENTER();
+
+  // the first line we write out to our mail file is a X-YAM-MailAccount: header in which we
+  // mark through which mail account this mail was received.
+  fprintf(fh, "X-YAM-MailAccount: %s@%s\n", tc->msn->username, tc->msn->hostname);
+
+  // the literal is received completely even after a write error, as the
+  // rest of the reply follows it
+  while(size > 0)
+  {
+    char *buf = tc->lineBuffer;
+    int len;
+
+    if((len = ReceiveFromHost(tc->connection, buf, MIN(size, (long)sizeof(tc->lineBuffer)-1)+1)) <= 0)
+    {
+      if(tc->connection->error == CONNECTERR_NO_ERROR)
+        tc->connection->error = CONNECTERR_UNKNOWN_ERROR;
+
+      break;
+    }
+
+    size -= len;
+
+    if(error == FALSE)
+    {
+      int i;
+      int j = 0;
+
+      // a "\r" split from its "\n" by the end of the previous part
+      if(pendingCR == TRUE)
+      {
+        pendingCR = FALSE;
+
+        if(buf[0] != '\n' && fputc('\r', fh) == EOF)
+          error = TRUE;
+      }
+
+      // strip the "\r" of all "\r\n" line endings
+      for(i = 0; i < len; i++)
+      {
+        if(buf[i] == '\r')
+        {
+          if(i == len-1)
+          {
+            // decide about this "\r" with the next part
+            pendingCR = TRUE;
+            continue;
+          }
+          else if(buf[i+1] == '\n')
+            continue;
+        }
+
+        buf[j++] = buf[i];
+      }
+
+      if(error == TRUE || (j > 0 && fwrite(buf, 1, j, fh) != (size_t)j))
+      {
+        error = TRUE;
+        ER_NewError(tr(MSG_ER_ErrorWriteMailfile), filename);
+      }
+    }
+
+    // update the transfer status, but not for every single part
+    unreported += len;
+    if(unreported >= (int)sizeof(tc->lineBuffer))
+    {
+      PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, unreported, tr(MSG_TR_Downloading));
+      unreported = 0;
+    }
+  }
+
+  // a lonely "\r" at the very end is kept
+  if(size == 0 && error == FALSE && pendingCR == TRUE && fputc('\r', fh) == EOF)
+  {
+    error = TRUE;
+    ER_NewError(tr(MSG_ER_ErrorWriteMailfile), filename);
+  }
+
+  if(unreported > 0)
+    PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, unreported, tr(MSG_TR_Downloading));
+
+  RETURN((BOOL)(size == 0 && error == FALSE));
+  return (BOOL)(size == 0 && error == FALSE);
+}
+
+///
+/// ReceiveMessageBody
+//  Receives the reply to a "UID FETCH uid BODY.PEEK[]" command, the mail
+//  itself is sent as a literal within the FETCH response
+static BOOL ReceiveMessageBody(struct TransferContext *tc, FILE *fh, const char *filename)
+{
+  BOOL gotBody = FALSE;
+  BOOL success = FALSE;
+  BOOL done = FALSE;
+
+  ENTER();
+
+  while(done == FALSE && ReceiveIMAPLine(tc, FALSE) > 0)
+  {
+    long size;
+
+    if(IsTaggedResponse(tc) == TRUE)
+    {
+      char *status = &tc->imapBuffer[strlen(tc->tag)+1];
+
+      if(strnicmp(status, IMAP_RESP_OKAY, 2) == 0)
+        success = TRUE;
+      else if(tc->quiet == FALSE)
+        ER_NewError(tr(MSG_ER_BADRESPONSE_POP3), tc->msn->hostname, tc->msn->description, (char *)IMAPcmd[IMAPCMD_FETCH], tc->imapBuffer);
+
+      done = TRUE;
+    }
+    else if((size = GetLiteralSize(tc->imapBuffer)) >= 0)
+    {
+      // the rest of the FETCH response follows the literal as a line of its own
+      if(gotBody == FALSE && strncmp(tc->imapBuffer, IMAP_RESP_UNTAGGED, strlen(IMAP_RESP_UNTAGGED)) == 0 && strcasestr(tc->imapBuffer, "BODY[]") != NULL)
+      {
+        D(DBF_NET, "receiving mail of %ld bytes", size);
+        gotBody = ReceiveLiteralToFile(tc, fh, filename, size);
+      }
+      else if(SkipLiteral(tc, size) == FALSE)
+        break;
+    }
+    else if(strncmp(tc->imapBuffer, IMAP_RESP_UNTAGGED, strlen(IMAP_RESP_UNTAGGED)) == 0)
+    {
+      ParseUntaggedResponse(tc, &tc->imapBuffer[2]);
+    }
+  }
+
+  RETURN((BOOL)(success == TRUE && gotBody == TRUE));
+  return (BOOL)(success == TRUE && gotBody == TRUE);
+}
+
+///
+/// ReceiveMessage
+//  Downloads a complete message and adds it to the incoming folder
+static BOOL ReceiveMessage(struct TransferContext *tc, struct MailTransferNode *tnode, const int number)
+{
+  BOOL result = FALSE;
+  struct Folder *inFolder = tc->incomingFolder;
+  char msgfile[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  // update the transfer status
+  PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, number, tnode->position, tnode->mail->Size, tr(MSG_TR_Downloading));
+
+  MA_NewMailFile(inFolder, msgfile, sizeof(msgfile));
+
+  // open the new mailfile for writing out the retrieved
+  // data
+  if((fh = fopen(msgfile, "w")) != NULL)
+  {
+    BOOL done = FALSE;
+
+    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+    // BODY.PEEK[] leaves the \Seen flag of the mail on the server untouched
+    snprintf(tc->lineBuffer, sizeof(tc->lineBuffer), "%u BODY.PEEK[]", (unsigned int)tnode->index);
+    if(SendIMAPRequest(tc, IMAPCMD_FETCH, tc->lineBuffer) == TRUE)
+      done = ReceiveMessageBody(tc, fh, msgfile);
+
+    fclose(fh);
+
+    if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR && done == TRUE)
+    {
+      struct ExtendedMail *email;
+
+      if((email = MA_ExamineMail(inFolder, FilePart(msgfile), FALSE)) != NULL)
+      {
+        struct Mail *mail;
+
+        if((mail = CloneMail(&email->Mail)) != NULL)
+        {
+          // we have to get the actual Time and place it in the transDate, so that we know at
+          // which time this mail arrived
+          GetSysTimeUTC(&mail->transDate);
+
+          // the mail is recorded in the index journal with its final status
+          mail->sflags = SFLAG_NEW;
+          AddMailToFolder(mail, inFolder);
+
+          // the new filename is recorded in the index journal, too
+          MA_UpdateMailFile(mail);
+
+          D(DBF_NET, "adding mail to downloaded list");
+          // add the mail to the list of downloaded mails
+          LockMailList(tc->msn->downloadedMails);
+          AddNewMailNode(tc->msn->downloadedMails, mail);
+          UnlockMailList(tc->msn->downloadedMails);
+
+          // if the current folder is the inbox we can go and add the mail instantly to the maillist
+          if(inFolder == GetCurrentFolder())
+            PushMethodOnStack(G->MA->GUI.PG_MAILLIST, 3, MUIM_NList_InsertSingle, mail, MUIV_NList_Insert_Sorted);
+
+          AppendToLogfile(LF_VERBOSE, 32, tr(MSG_LOG_RetrievingVerbose), AddrName(mail->From), mail->Subject, mail->Size);
+
+          PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_StartMacro, MACRO_NEWMSG, msgfile);
+
+          result = TRUE;
+        }
+
+        MA_FreeEMailStruct(email);
+      }
+    }
+
+    if(result == FALSE)
+    {
+      DeleteFile(msgfile);
+
+      // we need to set the folder flags to modified so that the .index will be saved later.
+      setFlag(inFolder->Flags, FOFL_MODIFY);
+    }
+  }
+  else
+    ER_NewError(tr(MSG_ER_ErrorWriteMailfile), msgfile);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// DownloadMails
+//  Downloads the new mails in the order of their UIDs and marks them as
+//  deleted on the server if requested
+static void DownloadMails(struct TransferContext *tc)
+{
+  struct MailTransferNode *tnode;
+  int number = 0;
+
+  ENTER();
+
+  // Now we are actually downloading, so lets change the busy text
+  BusyText(tc->busy, tr(MSG_TR_MailTransferFrom), tc->msn->description);
+
+  GetSysTime(TIMEVAL(&tc->lastUpdateTime));
+
+  ForEachMailTransferNode(tc->transferList, tnode)
+  {
+    if(tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR)
+      break;
+
+    D(DBF_NET, "downloading mail with UID %ld and size %ld", tnode->index, tnode->mail->Size);
+
+    // a failed mail is tried again during the next transfer, hence all
+    // further mails must be left alone for now to keep the last UID valid
+    if(ReceiveMessage(tc, tnode, ++number) == FALSE)
+      break;
+
+    if(TimeHasElapsed(&tc->lastUpdateTime, 250000) == TRUE)
+    {
+      // redraw the folderentry in the listtree 4 times per second at most
+      PushMethodOnStack(G->MA->GUI.LT_FOLDERS, 3, MUIM_NListtree_Redraw, tc->incomingFolder->Treenode, MUIF_NONE);
+    }
+
+    // put the transferStat for this mail to 100%
+    PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Downloading));
+
+    tc->downloadResult.downloaded++;
+    tc->state.lastUID = tnode->index;
+
+    // a mail is marked as deleted only after it has been stored successfully,
+    // it vanishes with the EXPUNGE command at the end
+    if(isFlagSet(tnode->tflags, TRF_DELETE))
+    {
+      D(DBF_NET, "deleting mail with UID %ld on server", tnode->index);
+
+      PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_DeletingServerMail));
+
+      snprintf(tc->lineBuffer, sizeof(tc->lineBuffer), "%u +FLAGS.SILENT (\\Deleted)", (unsigned int)tnode->index);
+      if(SendIMAPCommand(tc, IMAPCMD_STORE, tc->lineBuffer, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
+        tc->downloadResult.deleted++;
+    }
+  }
+
+  PushMethodOnStack(tc->transferGroup, 1, MUIM_TransferControlGroup_Finish);
+
+  // update the stats
+  PushMethodOnStack(G->App, 3, MUIM_YAMApplication_DisplayStatistics, tc->incomingFolder, TRUE);
+
+  // update the menu items and toolbars
+  PushMethodOnStack(G->App, 3, MUIM_YAMApplication_ChangeSelected, tc->incomingFolder, TRUE);
+
+  LEAVE();
+}
+
+///
+/// SumUpMails
+static void SumUpMails(struct TransferContext *tc)
+{
+  struct MailTransferNode *tnode;
+
+  ENTER();
+
+  tc->totalSize = 0;
+
+  // sum up the sizes of all mails to be transferred
+  ForEachMailTransferNode(tc->transferList, tnode)
+  {
+    tc->totalSize += tnode->mail->Size;
+  }
+
+  LEAVE();
+}
+
+///
+/// SynchronizeMailbox
+//  Downloads all mails which arrived in the mailbox since the last transfer.
+//  The mailbox is selected only if its state tells that there are new mails.
+static void SynchronizeMailbox(struct TransferContext *tc)
+{
+  ENTER();
+
+  ShowTransferStatus(tc, tr(MSG_TR_GetStats));
+
+  if(GetMailboxStatus(tc) == TRUE)
+  {
+    if(MailboxHasNewMails(tc) == FALSE)
+    {
+      W(DBF_NET, "no new messages found on server '%s'", tc->msn->hostname);
+
+      if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+        tc->downloadResult.error = FALSE;
+    }
+    else if(SelectMailbox(tc, IMAPCMD_SELECT) == TRUE)
+    {
+      // the UIDVALIDITY told by SELECT is the one which counts
+      CheckUIDValidity(tc);
+
+      if(GetMessageList(tc) == TRUE)
+      {
+        if(IsMailTransferListEmpty(tc->transferList) == FALSE)
+        {
+          AppendToLogfile(LF_VERBOSE, 31, tr(MSG_LOG_CONNECT_IMAP), tc->msn->description, tc->transferList->count);
+
+          SumUpMails(tc);
+          PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Start, tc->transferList->count, tc->totalSize);
+
+          DownloadMails(tc);
+
+          // finally remove the mails marked as deleted
+          if(tc->downloadResult.deleted > 0 && tc->connection->error == CONNECTERR_NO_ERROR)
+            SendIMAPCommand(tc, IMAPCMD_EXPUNGE, NULL, tr(MSG_ER_BADRESPONSE_POP3));
+        }
+        else
+          W(DBF_NET, "no mails to be transferred");
+
+        if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR && tc->downloadResult.downloaded == (long)tc->transferList->count)
+          tc->downloadResult.error = FALSE;
+      }
+      else
+        E(DBF_NET, "couldn't retrieve MessageList");
+
+      // remember how far the mailbox has been downloaded, the modification
+      // sequence is valid only if nothing was left behind
+      tc->state.uidValidity = tc->status.uidValidity;
+      tc->state.uidNext = MAX(tc->status.uidNext, tc->state.lastUID+1);
+      if(tc->downloadResult.error == FALSE)
+        strlcpy(tc->state.highestModSeq, tc->status.highestModSeq, sizeof(tc->state.highestModSeq));
+      else
+        tc->state.highestModSeq[0] = '\0';
+
+      SaveIMAPState(tc->msn, &tc->state);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// ReceiveIMAPMails
+BOOL ReceiveIMAPMails(struct MailServerNode *msn, const ULONG flags, struct DownloadResult *dlResult)
+{
+  BOOL success = FALSE;
+  struct TransferContext *tc;
+
+  ENTER();
+
+  // make sure the mail server node does not vanish
+  ObtainSemaphoreShared(G->configSemaphore);
+
+  if((tc = calloc(1, sizeof(*tc))) != NULL)
+  {
+    tc->msn = msn;
+    tc->flags = flags;
+    // assume an error at first
+    tc->downloadResult.error = TRUE;
+    tc->abortMask = (1UL << ThreadAbortSignal());
+
+    // depending on the incoming folder settings in the
+    // server configuration we store mail either in the
+    // folder configured there or in the default incoming folder
+    if(tc->msn->mailStoreFolderID == 0 ||
+       (tc->incomingFolder = FindFolderByID(G->folders, tc->msn->mailStoreFolderID)) == NULL)
+    {
+      tc->incomingFolder = FO_GetFolderByType(FT_INCOMING, NULL);
+    }
+
+    if(tc->incomingFolder != NULL)
+    {
+      // try to open the TCP/IP stack
+      if((tc->connection = CreateConnection(TRUE)) != NULL && ConnectionIsOnline(tc->connection) == TRUE)
+      {
+        // copy a link to the mailservernode for which we created
+        // the connection
+        tc->connection->server = tc->msn;
+
+        if((tc->transferList = CreateMailTransferList()) != NULL)
+        {
+          ULONG twFlags;
+
+          LoadIMAPState(tc->msn, &tc->state);
+
+          strlcpy(tc->password, msn->password, sizeof(tc->password));
+          snprintf(tc->transferGroupTitle, sizeof(tc->transferGroupTitle), tr(MSG_TR_MAILCHECKFROM), msn->description);
+
+          twFlags = TWF_ACTIVATE;
+          if(isFlagSet(tc->flags, RECEIVEF_USER))
+            setFlag(twFlags, TWF_OPEN);
+
+          if((tc->transferGroup = (Object *)PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_CreateTransferGroup, CurrentThread(), tc->transferGroupTitle, tc->connection, twFlags)) != NULL)
+          {
+            if(ConnectToIMAP(tc) == TRUE)
+            {
+              // connection succeeded
+              success = TRUE;
+
+              if(isFlagClear(flags, RECEIVEF_TEST_CONNECTION))
+                SynchronizeMailbox(tc);
+              else if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+                tc->downloadResult.error = FALSE;
+            }
+
+            // disconnect no matter if the connect operation succeeded or not
+            DisconnectFromIMAP(tc);
+
+            PushMethodOnStack(G->App, 2, MUIM_YAMApplication_DeleteTransferGroup, tc->transferGroup);
+          }
+
+          // perform the finalizing actions only if we haven't been aborted externally
+          if(ThreadWasAborted() == FALSE)
+          {
+            char downloadedStr[SIZE_SMALL];
+
+            snprintf(downloadedStr, sizeof(downloadedStr), "%d", (int)tc->downloadResult.downloaded);
+            PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_StartMacro, MACRO_POSTGET, downloadedStr);
+
+            AppendToLogfile(LF_ALL, 30, tr(MSG_LOG_RETRIEVED_IMAP), tc->downloadResult.downloaded, msn->description);
+
+            // we only apply the filters if we downloaded something, or it's wasted
+            D(DBF_NET, "filter %ld downloaded mails", tc->downloadResult.downloaded);
+            if(tc->downloadResult.downloaded > 0)
+            {
+              PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_FilterNewMails, tc->msn->downloadedMails, &tc->filterResult);
+              PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_NewMailAlert, tc->msn, &tc->downloadResult, &tc->filterResult, tc->flags);
+            }
+
+            // forget about the downloaded mails again
+            LockMailList(tc->msn->downloadedMails);
+            ClearMailList(tc->msn->downloadedMails);
+            UnlockMailList(tc->msn->downloadedMails);
+          }
+          else
+          {
+            // signal failure
+            success = FALSE;
+          }
+
+          // clean up the transfer list
+          DeleteMailTransferList(tc->transferList);
+        }
+      }
+
+      DeleteConnection(tc->connection);
+    }
+    else
+    {
+      E(DBF_FOLDER, "could not resolve incoming folder of IMAP server '%s'", tc->msn->description);
+    }
+
+    // finally copy the download stats of this operation if someone is interested in them
+    if(dlResult != NULL)
+      memcpy(dlResult, &tc->downloadResult, sizeof(*dlResult));
+
+    free(tc);
+  }
+
+  // mark the server as being no longer "in use"
+  LockMailServer(msn);
+  msn->useCount--;
+  UnlockMailServer(msn);
+
+  // now we are done
+  ReleaseSemaphore(G->configSemaphore);
+
+  // wake up the calling thread if this is requested
+  if(isFlagSet(flags, RECEIVEF_SIGNAL))
+    WakeupThread(NULL);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// IdleOnMailbox
+//  Waits in the IDLE state (RFC 2177) until the server announces new mails
+//  and lets the main thread download them then. Returns on errors only.
+static void IdleOnMailbox(struct TransferContext *tc, const struct IMAPWatcher *watcher)
+{
+  BOOL mustNotify = FALSE;
+
+  ENTER();
+
+  while(ThreadWasAborted() == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+  {
+    int ready;
+
+    // the server confirms the IDLE state with a continuation request
+    if(SendIMAPCommand(tc, IMAPCMD_IDLE, NULL, NULL) == NULL || tc->imapBuffer[0] != IMAP_RESP_CONTINUE)
+      break;
+
+    D(DBF_NET, "idling on mailbox '%s' of server '%s'", tc->msn->imapMailbox, tc->msn->description);
+
+    // wait for the server to tell something, a pending download is tried
+    // again soon
+    while((ready = WaitForHostData(tc->connection, mustNotify == TRUE ? IMAP_RETRY_DELAY : IMAP_IDLE_TIMEOUT)) == 1)
+    {
+      if(ReceiveIMAPLine(tc, TRUE) <= 0)
+      {
+        ready = -1;
+        break;
+      }
+
+      D(DBF_NET, "received IMAP answer '%s'", tc->imapBuffer);
+
+      if(strncmp(tc->imapBuffer, IMAP_RESP_UNTAGGED, strlen(IMAP_RESP_UNTAGGED)) == 0)
+        ParseUntaggedResponse(tc, &tc->imapBuffer[2]);
+
+      if(tc->newMails == TRUE)
+        break;
+    }
+
+    // leave the IDLE state again, no matter if there are new mails or if it
+    // must be renewed
+    if(ready == -1 || SendLineToHost(tc->connection, "DONE\r\n") <= 0 || ReceiveIMAPReply(tc, IMAPCMD_IDLE, NULL) == NULL)
+      break;
+
+    if(tc->newMails == TRUE || mustNotify == TRUE)
+    {
+      D(DBF_NET, "new mails in mailbox '%s' of server '%s'", tc->msn->imapMailbox, tc->msn->description);
+
+      tc->newMails = FALSE;
+
+      // new threads are started by the main thread only, the download fails
+      // if the server is in use already
+      mustNotify = (PushMethodOnStackWait(G->App, 2, MUIM_YAMApplication_ReceiveMailsFromServer, watcher->msn->id) != TRUE);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// WatchIMAPMailbox
+//  Keeps a connection to an IMAP server to be told about new mails as soon
+//  as they arrive. The connection is established again after errors.
+BOOL WatchIMAPMailbox(struct IMAPWatcher *watcher)
+{
+  BOOL success = FALSE;
+  struct TransferContext *tc;
+
+  ENTER();
+
+  if((tc = calloc(1, sizeof(*tc))) != NULL)
+  {
+    // the watcher works on its private copy of the server settings and
+    // doesn't lock the configuration for hours
+    tc->msn = watcher->msn;
+    tc->quiet = TRUE;
+    tc->abortMask = (1UL << ThreadAbortSignal());
+
+    if(InitThreadTimer() == TRUE)
+    {
+      tc->timerMask = (1UL << ThreadTimerSignal());
+
+      while(ThreadWasAborted() == FALSE)
+      {
+        BOOL tryAgain = TRUE;
+        ULONG signals;
+
+        if((tc->connection = CreateConnection(TRUE)) != NULL && ConnectionIsOnline(tc->connection) == TRUE)
+        {
+          tc->connection->server = tc->msn;
+          strlcpy(tc->password, tc->msn->password, sizeof(tc->password));
+
+          if(ConnectToIMAP(tc) == TRUE)
+          {
+            if(isFlagSet(tc->capabilities, IMAPCAP_IDLE))
+            {
+              success = TRUE;
+
+              // a read-only access is sufficient
+              if(SelectMailbox(tc, IMAPCMD_EXAMINE) == TRUE)
+                IdleOnMailbox(tc, watcher);
+            }
+            else
+            {
+              // the periodical download must do the job then
+              W(DBF_NET, "IMAP server '%s' doesn't support IDLE", tc->msn->description);
+              tryAgain = FALSE;
+            }
+          }
+          else if(tc->loginFailed == TRUE)
+          {
+            W(DBF_NET, "login to IMAP server '%s' failed, stop watching", tc->msn->description);
+            tryAgain = FALSE;
+          }
+
+          DisconnectFromIMAP(tc);
+        }
+
+        DeleteConnection(tc->connection);
+        tc->connection = NULL;
+
+        if(tryAgain == FALSE || ThreadWasAborted() == TRUE)
+          break;
+
+        // wait a bit before the connection is established again
+        StartThreadTimer(IMAP_RECONNECT_DELAY, 0);
+        signals = Wait(tc->abortMask|tc->timerMask);
+        StopThreadTimer();
+
+        if(isFlagSet(signals, tc->abortMask))
+          break;
+      }
+
+      CleanupThreadTimer();
+    }
+
+    free(tc);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// StartIMAPWatchers
+// start watching the mailboxes of all active IMAP servers which are
+// configured to use IDLE
+void StartIMAPWatchers(void)
+{
+  struct MailServerNode *msn;
+
+  ENTER();
+
+  ObtainSemaphoreShared(G->configSemaphore);
+
+  IterateList(&C->pop3ServerList, struct MailServerNode *, msn)
+  {
+    // without a stored password nobody can be asked for it in the background
+    if(isIMAPServer(msn) && isServerActive(msn) && msn->imapIdle == TRUE && IsStrEmpty(msn->password) == FALSE)
+    {
+      struct IMAPWatcher *watcher;
+
+      if((watcher = calloc(1, sizeof(*watcher))) != NULL)
+      {
+        if((watcher->msn = CloneMailServer(msn)) != NULL &&
+           (watcher->thread = DoAction(G->App, TA_WatchIMAP, TT_WatchIMAP_Watcher, watcher, TAG_DONE)) != NULL)
+        {
+          D(DBF_NET, "watching mailbox '%s' of IMAP server '%s'", msn->imapMailbox, msn->description);
+          AddTail((struct List *)&G->imapWatchers, (struct Node *)watcher);
+        }
+        else
+        {
+          E(DBF_NET, "couldn't start watching IMAP server '%s'", msn->description);
+
+          if(watcher->msn != NULL)
+            DeleteMailServer(watcher->msn);
+
+          free(watcher);
+        }
+      }
+    }
+  }
+
+  ReleaseSemaphore(G->configSemaphore);
+
+  LEAVE();
+}
+
+///
+/// StopIMAPWatchers
+// stop watching the mailboxes of all IMAP servers
+void StopIMAPWatchers(void)
+{
+  struct IMAPWatcher *watcher;
+  struct IMAPWatcher *next;
+
+  ENTER();
+
+  SafeIterateList(&G->imapWatchers, struct IMAPWatcher *, watcher, next)
+  {
+    // abort the thread and wait until it finished its work, unless it
+    // gave up by itself already. The pointer is cleared by the main thread
+    // before the thread can be reused for another action.
+    if(watcher->thread != NULL)
+      AbortThread(watcher->thread, TRUE);
+
+    DeleteMailServer(watcher->msn);
+    free(watcher);
+  }
+  NewMinList(&G->imapWatchers);
+
+  LEAVE();
+}
+
+///
+/// IMAPWatcherFinished
+// forget the thread of a watcher which finished its work, called by the
+// main thread only
+void IMAPWatcherFinished(struct IMAPWatcher *watcher)
+{
+  ENTER();
+
+  if(watcher != NULL)
+  {
+    D(DBF_NET, "stopped watching IMAP server '%s'", watcher->msn->description);
+    watcher->thread = NULL;
+  }
+
+  LEAVE();
+}
+
+///
+/// RestartIMAPWatchers
+// restart watching the mailboxes after the configuration changed
+void RestartIMAPWatchers(void)
+{
+  ENTER();
+
+  StopIMAPWatchers();
+  StartIMAPWatchers();
+
+  LEAVE();
+}
+
+///
@@ -84,7 +84,7 @@ enum POPCommand
   POPCMD_UIDL,
 
   // POP3 extended commands
-  POPCMD_STLS
+  POPCMD_STLS, POPCMD_CAPA
 };
 
 static const char *const POPcmd[] =
@@ -95,7 +95,7 @@ static const char *const POPcmd[] =
   "UIDL",
 
   // POP3 extended commands
-  "STLS"
+  "STLS", "CAPA"
 };
 
 // POP responses
@@ -105,6 +105,17 @@ static const char *const POPcmd[] =
 /**************************************************************************/
 // local macros & defines
 
+// maximum number of pipelined commands (RFC 2449) whose replies are still
+// outstanding
+#define POP3_MAX_PIPELINED 32
+
+// a pipelined command whose reply has not been received yet
+struct PipelinedCommand
+{
+  enum POPCommand command;
+  struct MailTransferNode *tnode; // the mail the command refers to
+};
+
 struct TransferContext
 {
   struct Connection *connection;
@@ -133,6 +144,10 @@ struct TransferContext
   long totalSize;
   struct TimeVal lastUpdateTime;
   struct BusyNode *busy;
+  struct PipelinedCommand pipeline[POP3_MAX_PIPELINED]; // ring buffer of commands waiting for their replies
+  int pipelineHead;                      // the oldest command in the ring buffer
+  int numPipelined;                      // number of commands waiting for their replies
+  int pipelineWindow;                    // maximum number of commands waiting for their replies
 };
 
 /// ApplyRemoteFilters
@@ -175,6 +190,67 @@ static void ApplyRemoteFilters(struct TransferContext *tc, struct MailTransferNo
   LEAVE();
 }
 
+///
+/// ReceivePOP3Reply
+//  Receives the status line of the reply to a command from the POP3 server
+static char *ReceivePOP3Reply(struct TransferContext *tc, const enum POPCommand command, const char *errorMsg)
+{
+  char *result = NULL;
+  int received;
+
+  ENTER();
+
+  // let us read the next line from the server and check if
+  // some status message can be retrieved.
+  if((received = ReceiveLineFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer))) > 0)
+  {
+    D(DBF_NET, "received POP3 answer '%s'", tc->pop3Buffer);
+
+    if(strncmp(tc->pop3Buffer, POP_RESP_OKAY, strlen(POP_RESP_OKAY)) == 0)
+    {
+      // everything worked out fine so lets set
+      // the result to our allocated buffer
+      result = tc->pop3Buffer;
+    }
+  }
+
+  if(result == NULL)
+  {
+    BOOL showError;
+
+    // don't show an error message for a failed QUIT command with no answer at all
+    if(command == POPCMD_QUIT && received == -1)
+      showError = FALSE;
+    else
+      showError = TRUE;
+
+    // only report an error if explicitly wanted
+    if(showError == TRUE && errorMsg != NULL)
+    {
+      // if we just issued a PASS command and that failed, then overwrite the visible
+      // password with X chars now, so that nobody else can read your password
+      if(command == POPCMD_PASS)
+      {
+        char *p;
+
+        // find the beginning of the password
+        if((p = strstr(tc->pop3Buffer, POPcmd[POPCMD_PASS])) != NULL &&
+           (p = strchr(p, ' ')) != NULL)
+        {
+          // now cross it out
+          while(*p != '\0' && *p != ' ' && *p != '\n' && *p != '\r')
+            *p++ = 'X';
+        }
+      }
+
+      ER_NewError(errorMsg, tc->msn->hostname, tc->msn->description, (char *)POPcmd[command], tc->pop3Buffer);
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// SendPOP3Command
 //  Sends a command to the POP3 server
@@ -196,56 +272,7 @@ static char *SendPOP3Command(struct TransferContext *tc, const enum POPCommand c
   // and for a connect we don't send something or the server will get
   // confused.
   if(command == POPCMD_CONNECT || SendLineToHost(tc->connection, tc->pop3Buffer) > 0)
-  {
-    int received;
-
-    // let us read the next line from the server and check if
-    // some status message can be retrieved.
-    if((received = ReceiveLineFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer))) > 0)
-    {
-      D(DBF_NET, "received POP3 answer '%s'", tc->pop3Buffer);
-
-      if(strncmp(tc->pop3Buffer, POP_RESP_OKAY, strlen(POP_RESP_OKAY)) == 0)
-      {
-        // everything worked out fine so lets set
-        // the result to our allocated buffer
-        result = tc->pop3Buffer;
-      }
-    }
-
-    if(result == NULL)
-    {
-      BOOL showError;
-
-      // don't show an error message for a failed QUIT command with no answer at all
-      if(command == POPCMD_QUIT && received == -1)
-        showError = FALSE;
-      else
-        showError = TRUE;
-
-      // only report an error if explicitly wanted
-      if(showError == TRUE && errorMsg != NULL)
-      {
-        // if we just issued a PASS command and that failed, then overwrite the visible
-        // password with X chars now, so that nobody else can read your password
-        if(command == POPCMD_PASS)
-        {
-          char *p;
-
-          // find the beginning of the password
-          if((p = strstr(tc->pop3Buffer, POPcmd[POPCMD_PASS])) != NULL &&
-             (p = strchr(p, ' ')) != NULL)
-          {
-            // now cross it out
-            while(*p != '\0' && *p != ' ' && *p != '\n' && *p != '\r')
-              *p++ = 'X';
-          }
-        }
-
-        ER_NewError(errorMsg, tc->msn->hostname, tc->msn->description, (char *)POPcmd[command], tc->pop3Buffer);
-      }
-    }
-  }
+    result = ReceivePOP3Reply(tc, command, errorMsg);
 
   RETURN(result);
   return result;
@@ -253,187 +280,103 @@ static char *SendPOP3Command(struct TransferContext *tc, const enum POPCommand c
 
 ///
 /// ReceiveToFile
+//  Receives a multi-line reply from the POP3 server and writes it to the
+//  given file. The data is handled line by line, whereby the "\r\n" line
+//  endings are converted to "\n" and byte-stuffed "." at the beginning of
+//  a line are removed (RFC 1939). The reply ends with a single "." line.
 static int ReceiveToFile(struct TransferContext *tc, FILE *fh, const char *filename, const BOOL isTemp)
 {
-  int count;
-  int l=0, read, state=0;
+  int count = 0;
+  int unreported = 0;
+  BOOL atLineStart = TRUE;
+  BOOL pendingCR = FALSE;
   BOOL error = FALSE;
   BOOL done = FALSE;
-  char *lineptr = tc->lineBuffer;
 
   ENTER();
 
-  // get the first data the pop server returns after the TOP command
-  if((read = count = ReceiveFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer))) <= 0)
-    tc->connection->error = CONNECTERR_UNKNOWN_ERROR;
-  else
-  {
-    // the first line we write out to our mail file is a X-YAM-MailAccount: header in which we
-    // mark through which mail account this mail was received.
-    fprintf(fh, "X-YAM-MailAccount: %s@%s\n", tc->msn->username, tc->msn->hostname);
-  }
+  // the first line we write out to our mail file is a X-YAM-MailAccount: header in which we
+  // mark through which mail account this mail was received.
+  fprintf(fh, "X-YAM-MailAccount: %s@%s\n", tc->msn->username, tc->msn->hostname);
 
   while(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
   {
-    char *bufptr;
+    char *line = tc->lineBuffer;
+    int len;
 
-    // now we iterate through the received string
-    // and strip out the '\r' character.
-    // we iterate through it because the strings we receive
-    // from the socket can be splitted somehow.
-    for(bufptr = tc->pop3Buffer; read > 0; bufptr++, read--)
+    // get the next line or at least the next part of a very long line
+    if((len = ReceiveLineFromHost(tc->connection, tc->lineBuffer, sizeof(tc->lineBuffer))) <= 0)
     {
-      // first we check if our buffer is full and if so we
-      // write it to the file.
-      if(l == sizeof(tc->lineBuffer) || done == TRUE)
-      {
-        // update the transfer status during the final download
-        if(isTemp == FALSE)
-          PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, l, tr(MSG_TR_Downloading));
+      if(count == 0)
+        tc->connection->error = CONNECTERR_UNKNOWN_ERROR;
 
-        // write the line to the file now
-        if(fwrite(tc->lineBuffer, 1, l, fh) != (size_t)l)
-        {
-          error = TRUE;
-          ER_NewError(tr(MSG_ER_ErrorWriteMailfile), filename);
-          break;
-        }
-
-        // if we end up here and done is true we have to break that iteration
-        if(done == TRUE)
-          break;
+      break;
+    }
 
-        // set l to zero so that the next char gets written to the beginning
-        l = 0;
-        lineptr = tc->lineBuffer;
-      }
+    count += len;
 
-      // we have to analyze different states because we iterate through our
-      // received buffer char by char.
-      switch(state)
+    if(atLineStart == TRUE && line[0] == '.')
+    {
+      // the termination line "\r\n.\r\n" ends the reply
+      if(strcmp(line, ".\r\n") == 0)
       {
-        // stat==1 is only reached if a "\r" was found previously
-        case 1:
-        {
-          // if we previously found a \r and the actual char is not a \n, then
-          // we write the \r in the buffer and iterate to the next char.
-          if(*bufptr != '\n')
-          {
-            *lineptr++ = '\r';
-            l++;
-            read++;
-            bufptr--;
-            state = 0;
-
-            continue;
-          }
-
-          // write the actual char "\n" in the line buffer
-          *lineptr++ = *bufptr;
-          l++;
-
-          state = 2; // we found a "\r\n" so we move to stat 2 on the next iteration.
-          continue;
-        }
-        break;
-
-        // stat==2 is only reached if we previously found a "\r\n"
-        // stat==5 if we found a lonely "\n"
-        case 2:
-        case 5:
-        {
-          if(*bufptr == '.')
-          {
-            state++; // now it's 3 or 6
-            continue;
-          }
-
-          state = 0;
-        }
-        break;
-
-        // stat==3 is only reached if we previously found a "\r\n."
-        // stat==6 if we found a lonely "\n."
-        case 3:
-        case 6:
-        {
-          if(state == 3 && *bufptr == '\r')
-          {
-            state = 4; // we found a \r directly after a "\r\n.", so it can be the start of a TERM
-          }
-          else if(*bufptr == '.')
-          {
-            // (RFC 1939) - the server handles "." as "..", so we only write "."
-            *lineptr++ = '.';
-            l++;
-            state = 0;
-          }
-          else
-          {
-            // write the actual char in the line buffer
-            *lineptr++ = '.';
-            l++;
-            read++;
-            bufptr--;
-            state = 0;
-          }
-
-          continue;
-        }
-        break;
-
-        // stat==4 is only reached if we previsouly found a "\r\n.\r"
-        case 4:
-        {
-          if(*bufptr != '\n')
-          {
-            *lineptr++ = '.';
-            l++;
-            read += 2;
-            bufptr -= 2;
-            state = 0;
-
-            continue;
-          }
-
-          // so if we end up here we finally found our termination line "\r\n.\r\n"
-          // and make sure the buffer is written before we break out here.
-          read = 2;
-          done = TRUE;
-
-          continue;
-        }
+        done = TRUE;
         break;
       }
 
-      // if we find a \r we set the stat to 1 and check on the next iteration if
-      // the following char is a \n and if so we have to strip it out.
-      if(*bufptr == '\r')
+      // (RFC 1939) - the server handles "." as "..", so we only write "."
+      if(line[1] == '.')
       {
-        state = 1;
-        continue;
-      }
-      else if(*bufptr == '\n')
-      {
-        state=5;
+        line++;
+        len--;
       }
+    }
+
+    // a "\r" split from its "\n" by the end of the previous part
+    if(pendingCR == TRUE)
+    {
+      pendingCR = FALSE;
 
-      // write the actual char in the line buffer
-      *lineptr++ = *bufptr;
-      l++;
+      if(line[0] != '\n' && fputc('\r', fh) == EOF)
+        error = TRUE;
     }
 
-    // if we received the term octet we can exit the while loop now
-    if(done == TRUE || error == TRUE || tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR)
-      break;
+    atLineStart = (line[len-1] == '\n');
 
-    // if not, we get another bunch of data and start over again.
-    if((read = ReceiveFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer))) <= 0)
+    // strip the "\r" of a "\r\n" line ending
+    if(atLineStart == TRUE && len >= 2 && line[len-2] == '\r')
+    {
+      line[len-2] = '\n';
+      len--;
+    }
+    else if(atLineStart == FALSE && line[len-1] == '\r')
+    {
+      // decide about this "\r" with the next part
+      pendingCR = TRUE;
+      len--;
+    }
+
+    // write the line to the file now
+    if(error == TRUE || (len > 0 && fwrite(line, 1, len, fh) != (size_t)len))
+    {
+      error = TRUE;
+      ER_NewError(tr(MSG_ER_ErrorWriteMailfile), filename);
       break;
+    }
 
-    count += read;
+    // update the transfer status during the final download, but not
+    // for every single line
+    unreported += len;
+    if(isTemp == FALSE && unreported >= (int)sizeof(tc->lineBuffer))
+    {
+      PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, unreported, tr(MSG_TR_Downloading));
+      unreported = 0;
+    }
   }
 
+  if(isTemp == FALSE && unreported > 0)
+    PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, unreported, tr(MSG_TR_Downloading));
+
   if(done == FALSE || error == TRUE)
     count = 0;
 
@@ -599,9 +542,10 @@ static BOOL GetMessageList(struct TransferContext *tc)
 }
 
 ///
-/// GetSingleMessageDetails
-//  Gets header from a message stored on the POP3 server
-static void GetSingleMessageDetails(struct TransferContext *tc, struct MailTransferNode *tnode, int lline)
+/// ReceiveMessageDetails
+//  Receives the header of a message stored on the POP3 server as reply to
+//  a TOP command
+static void ReceiveMessageDetails(struct TransferContext *tc, struct MailTransferNode *tnode, int lline, const BOOL gotReply)
 {
   struct Mail *mail = tnode->mail;
 
@@ -609,7 +553,86 @@ static void GetSingleMessageDetails(struct TransferContext *tc, struct MailTrans
 
   D(DBF_NET, "get details for mail %ld", lline);
 
-  if(IsStrEmpty(mail->From.Address) &&
+  if(gotReply == TRUE)
+  {
+    struct TempFile *tf;
+
+    // we generate a temporary file to buffer the TOP list into
+    if((tf = OpenTempFile("w")) != NULL)
+    {
+      struct ExtendedMail *email;
+      BOOL done = FALSE;
+
+      // now we call a subfunction to receive data from the POP3 server
+      // and write it in the filehandle as long as there is no termination \r\n.\r\n
+      if(ReceiveToFile(tc, tf->FP, tf->Filename, TRUE) > 0)
+        done = TRUE;
+
+      // close the filehandle now
+      fclose(tf->FP);
+      tf->FP = NULL;
+
+      // If we end up here because of an error, abort or the upper loop wasn't finished
+      // we exit immediatly with deleting the temp file also.
+      if(tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR || done == FALSE)
+      {
+        lline = -1;
+      }
+      else if((email = MA_ExamineMail(NULL, FilePart(tf->Filename), TRUE)) != NULL)
+      {
+        SetMailPerson(&mail->From, email->Mail.From.Address, email->Mail.From.RealName);
+        SetMailPerson(&mail->To, email->Mail.To.Address, email->Mail.To.RealName);
+        SetMailPerson(&mail->ReplyTo, email->Mail.ReplyTo.Address, email->Mail.ReplyTo.RealName);
+        SetMailSubject(mail, email->Mail.Subject);
+        SetMailFile(mail, email->Mail.MailFile);
+        memcpy(&mail->Date, &email->Mail.Date, sizeof(mail->Date));
+
+        // if this function was called with -1, then the POP3 server
+        // doesn't have the UIDL command and we have to generate our
+        // own one by using the MsgID.
+        if(lline == -1)
+          tnode->uidl = strdup(email->messageID);
+
+        // apply possible remote filters
+        if(isFlagClear(tnode->tflags, TRF_REMOTE_FILTER_APPLIED) && hasServerApplyRemoteFilters(tc->msn) == TRUE && IsMinListEmpty(tc->remoteFilters) == FALSE)
+          ApplyRemoteFilters(tc, tnode);
+
+        MA_FreeEMailStruct(email);
+      }
+      else
+        E(DBF_NET, "couldn't examine mail file '%s'", tf->Filename);
+
+      CloseTempFile(tf);
+    }
+    else
+    {
+      ER_NewError(tr(MSG_ER_CantCreateTempfile));
+
+      // the header lines are on their way already and would be taken as
+      // reply to the next command, hence we must give up here
+      tc->connection->error = CONNECTERR_UNKNOWN_ERROR;
+    }
+  }
+
+  // now we got the details
+  setFlag(tnode->tflags, TRF_GOT_DETAILS);
+
+  if(lline >= 0 && tc->preselectWindow != NULL)
+    PushMethodOnStack(tc->preselectWindow, 2, MUIM_PreselectionWindow_RefreshMail, lline);
+
+  LEAVE();
+}
+
+///
+/// GetSingleMessageDetails
+//  Gets header from a message stored on the POP3 server
+static void GetSingleMessageDetails(struct TransferContext *tc, struct MailTransferNode *tnode, int lline)
+{
+  BOOL gotReply = FALSE;
+
+  ENTER();
+
+  if(IsStrEmpty(tnode->mail->From.Address) &&
      tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
   {
     char cmdbuf[SIZE_SMALL];
@@ -620,66 +643,288 @@ static void GetSingleMessageDetails(struct TransferContext *tc, struct MailTrans
     // and therefore we don't throw any error
     snprintf(cmdbuf, sizeof(cmdbuf), "%d 1", tnode->index);
     if(SendPOP3Command(tc, POPCMD_TOP, cmdbuf, NULL) != NULL)
+      gotReply = TRUE;
+  }
+
+  ReceiveMessageDetails(tc, tnode, lline, gotReply);
+
+  LEAVE();
+}
+
+///
+/// QueuePOP3Command
+//  Sends a TOP, RETR or DELE command for a single mail to the POP3 server
+//  without waiting for its reply. The replies are received in the same order
+//  by ReceivePipelinedReply().
+static BOOL QueuePOP3Command(struct TransferContext *tc, const enum POPCommand command, struct MailTransferNode *tnode)
+{
+  BOOL success = FALSE;
+  char cmdbuf[SIZE_DEFAULT];
+
+  ENTER();
+
+  // we request the headers and a one line message body only for TOP
+  if(command == POPCMD_TOP)
+    snprintf(cmdbuf, sizeof(cmdbuf), "%s %d 1\r\n", POPcmd[command], tnode->index);
+  else
+    snprintf(cmdbuf, sizeof(cmdbuf), "%s %d\r\n", POPcmd[command], tnode->index);
+
+  D(DBF_NET, "pipeline POP3 cmd '%s' for mail %ld, %ld commands outstanding", POPcmd[command], tnode->index, tc->numPipelined);
+
+  // the command is sent as soon as we wait for the first reply
+  if(tc->numPipelined < POP3_MAX_PIPELINED &&
+     SendToHost(tc->connection, cmdbuf, strlen(cmdbuf), TCPF_NONE) > 0)
+  {
+    struct PipelinedCommand *pc = &tc->pipeline[(tc->pipelineHead + tc->numPipelined) % POP3_MAX_PIPELINED];
+
+    pc->command = command;
+    pc->tnode = tnode;
+    tc->numPipelined++;
+
+    setFlag(tnode->tflags, TRF_PIPELINED);
+
+    success = TRUE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// ReceiveMessage
+//  Receives a complete message as reply to a RETR command and adds it to
+//  the incoming folder
+static BOOL ReceiveMessage(struct TransferContext *tc, struct MailTransferNode *tnode, const BOOL gotReply)
+{
+  BOOL result = FALSE;
+  struct Folder *inFolder = tc->incomingFolder;
+  char msgfile[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  // update the transfer status
+  PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tnode->index - tc->numberOfMailsSkipped, tnode->position, tnode->mail->Size, tr(MSG_TR_Downloading));
+
+  MA_NewMailFile(inFolder, msgfile, sizeof(msgfile));
+
+  // open the new mailfile for writing out the retrieved
+  // data
+  if((fh = fopen(msgfile, "w")) != NULL)
+  {
+    BOOL done = FALSE;
+
+    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+    if(gotReply == TRUE)
     {
-      struct TempFile *tf;
+      // now we call a subfunction to receive data from the POP3 server
+      // and write it in the filehandle as long as there is no termination \r\n.\r\n
+      if(ReceiveToFile(tc, fh, msgfile, FALSE) > 0)
+        done = TRUE;
+    }
+    fclose(fh);
 
-      // we generate a temporary file to buffer the TOP list into
-      if((tf = OpenTempFile("w")) != NULL)
+    if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR && done == TRUE)
+    {
+      struct ExtendedMail *email;
+
+      if((email = MA_ExamineMail(inFolder, FilePart(msgfile), FALSE)) != NULL)
       {
-        struct ExtendedMail *email;
-        BOOL done = FALSE;
+        struct Mail *mail;
+
+        if((mail = CloneMail(&email->Mail)) != NULL)
+        {
+          // we have to get the actual Time and place it in the transDate, so that we know at
+          // which time this mail arrived
+          GetSysTimeUTC(&mail->transDate);
+
+          // the mail is recorded in the index journal with its final status
+          mail->sflags = SFLAG_NEW;
+          AddMailToFolder(mail, inFolder);
 
-        // now we call a subfunction to receive data from the POP3 server
-        // and write it in the filehandle as long as there is no termination \r\n.\r\n
-        if(ReceiveToFile(tc, tf->FP, tf->Filename, TRUE) > 0)
-          done = TRUE;
+          // the new filename is recorded in the index journal, too
+          MA_UpdateMailFile(mail);
 
-        // close the filehandle now
-        fclose(tf->FP);
-        tf->FP = NULL;
+          D(DBF_NET, "adding mail to downloaded list");
+          // add the mail to the list of downloaded mails
+          LockMailList(tc->msn->downloadedMails);
+          AddNewMailNode(tc->msn->downloadedMails, mail);
+          UnlockMailList(tc->msn->downloadedMails);
+
+          // if the current folder is the inbox we can go and add the mail instantly to the maillist
+          if(inFolder == GetCurrentFolder())
+            PushMethodOnStack(G->MA->GUI.PG_MAILLIST, 3, MUIM_NList_InsertSingle, mail, MUIV_NList_Insert_Sorted);
 
-        // If we end up here because of an error, abort or the upper loop wasn't finished
-        // we exit immediatly with deleting the temp file also.
-        if(tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR || done == FALSE)
+          AppendToLogfile(LF_VERBOSE, 32, tr(MSG_LOG_RetrievingVerbose), AddrName(mail->From), mail->Subject, mail->Size);
+
+          PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_StartMacro, MACRO_NEWMSG, msgfile);
+
+          result = TRUE;
+        }
+
+        MA_FreeEMailStruct(email);
+      }
+    }
+
+    if(result == FALSE)
+    {
+      DeleteFile(msgfile);
+
+      // we need to set the folder flags to modified so that the .index will be saved later.
+      setFlag(inFolder->Flags, FOFL_MODIFY);
+    }
+  }
+  else
+  {
+    ER_NewError(tr(MSG_ER_ErrorWriteMailfile), msgfile);
+
+    // the mail's data is on its way already and would be taken as reply
+    // to the next pipelined command, hence we must give up here
+    if(gotReply == TRUE)
+      tc->connection->error = CONNECTERR_UNKNOWN_ERROR;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ReceivePipelinedReply
+//  Receives the reply to the oldest pipelined command and handles it
+//  according to the command
+static void ReceivePipelinedReply(struct TransferContext *tc)
+{
+  ENTER();
+
+  if(tc->numPipelined > 0)
+  {
+    struct PipelinedCommand *pc = &tc->pipeline[tc->pipelineHead];
+    enum POPCommand command = pc->command;
+    struct MailTransferNode *tnode = pc->tnode;
+    struct Mail *mail = tnode->mail;
+    BOOL gotReply = FALSE;
+
+    tc->pipelineHead = (tc->pipelineHead + 1) % POP3_MAX_PIPELINED;
+    tc->numPipelined--;
+    clearFlag(tnode->tflags, TRF_PIPELINED);
+
+    // send out all commands queued so far, a failure will let the
+    // following receive operation fail as well
+    FlushConnection(tc->connection);
+
+    // the TOP command is optional within the RFC 1939 specification
+    // and therefore we don't throw any error
+    if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR &&
+       ReceivePOP3Reply(tc, command, (command == POPCMD_TOP) ? NULL : tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
+    {
+      gotReply = TRUE;
+    }
+
+    switch(command)
+    {
+      case POPCMD_TOP:
+      {
+        ReceiveMessageDetails(tc, tnode, tnode->index-1, gotReply);
+      }
+      break;
+
+      case POPCMD_RETR:
+      {
+        if(ReceiveMessage(tc, tnode, gotReply) == TRUE)
         {
-          lline = -1;
+          if(TimeHasElapsed(&tc->lastUpdateTime, 250000) == TRUE)
+          {
+            // redraw the folderentry in the listtree 4 times per second at most
+            PushMethodOnStack(G->MA->GUI.LT_FOLDERS, 3, MUIM_NListtree_Redraw, tc->incomingFolder->Treenode, MUIF_NONE);
+          }
+
+          // put the transferStat for this mail to 100%
+          PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Downloading));
+
+          tc->downloadResult.downloaded++;
+
+          // Remember the UIDL of this mail, no matter if it is going
+          // to be deleted or not. Some servers don't delete a mail
+          // right after the DELETE command, but only after a successful
+          // QUIT command. Personal experience shows that pop.gmx.de is
+          // one of these servers.
+          if(hasServerAvoidDuplicates(tc->msn) == TRUE)
+          {
+            D(DBF_NET, "adding mail with subject '%s' to UIDL hash", mail->Subject);
+            // add the UIDL to the hash table or update an existing entry
+            AddUIDLtoHash(tc->UIDLhashTable, tnode->uidl, UIDLF_NEW);
+          }
+
+          // a mail is deleted on the server only after it has been stored
+          // successfully, hence the DELE command can't be queued earlier
+          if(isFlagSet(tnode->tflags, TRF_DELETE))
+          {
+            D(DBF_NET, "deleting mail with subject '%s' on server", mail->Subject);
+
+            // update the transfer status
+            PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_DeletingServerMail));
+
+            QueuePOP3Command(tc, POPCMD_DELE, tnode);
+          }
+          else
+            D(DBF_NET, "leaving mail with subject '%s' and size %ld on server to be downloaded again", mail->Subject, mail->Size);
         }
-        else if((email = MA_ExamineMail(NULL, FilePart(tf->Filename), TRUE)) != NULL)
+      }
+      break;
+
+      case POPCMD_DELE:
+      {
+        // a mail which is only to be deleted needs its own progress entry
+        if(isFlagClear(tnode->tflags, TRF_TRANSFER))
         {
-          memcpy(&mail->From, &email->Mail.From, sizeof(mail->From));
-          memcpy(&mail->To, &email->Mail.To, sizeof(mail->To));
-          memcpy(&mail->ReplyTo, &email->Mail.ReplyTo, sizeof(mail->ReplyTo));
-          strlcpy(mail->Subject, email->Mail.Subject, sizeof(mail->Subject));
-          strlcpy(mail->MailFile, email->Mail.MailFile, sizeof(mail->MailFile));
-          memcpy(&mail->Date, &email->Mail.Date, sizeof(mail->Date));
-
-          // if this function was called with -1, then the POP3 server
-          // doesn't have the UIDL command and we have to generate our
-          // own one by using the MsgID.
-          if(lline == -1)
-            tnode->uidl = strdup(email->messageID);
-
-          // apply possible remote filters
-          if(isFlagClear(tnode->tflags, TRF_REMOTE_FILTER_APPLIED) && hasServerApplyRemoteFilters(tc->msn) == TRUE && IsMinListEmpty(tc->remoteFilters) == FALSE)
-            ApplyRemoteFilters(tc, tnode);
-
-          MA_FreeEMailStruct(email);
+          // update the transfer status, use a zero mail size
+          PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tnode->index - tc->numberOfMailsSkipped, tnode->position, 0, tr(MSG_TR_DeletingServerMail));
+
+          // now we "know" that this mail had existed, don't forget this in case
+          // the delete operation fails
+          if(hasServerAvoidDuplicates(tc->msn) == TRUE)
+          {
+            D(DBF_NET, "adding mail with subject '%s' to UIDL hash", mail->Subject);
+            // add the UIDL to the hash table or update an existing entry
+            AddUIDLtoHash(tc->UIDLhashTable, tnode->uidl, UIDLF_NEW);
+          }
         }
-        else
-          E(DBF_NET, "couldn't examine mail file '%s'", tf->Filename);
 
-        CloseTempFile(tf);
+        if(gotReply == TRUE)
+          tc->downloadResult.deleted++;
+      }
+      break;
+
+      default:
+        // nothing
+      break;
+    }
+
+    // the replies to all other commands are lost after an error
+    if(tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR)
+    {
+      while(tc->numPipelined > 0)
+      {
+        clearFlag(tc->pipeline[tc->pipelineHead].tnode->tflags, TRF_PIPELINED);
+        tc->pipelineHead = (tc->pipelineHead + 1) % POP3_MAX_PIPELINED;
+        tc->numPipelined--;
       }
-      else
-        ER_NewError(tr(MSG_ER_CantCreateTempfile));
     }
   }
 
-  // now we got the details
-  setFlag(tnode->tflags, TRF_GOT_DETAILS);
+  LEAVE();
+}
 
-  if(lline >= 0 && tc->preselectWindow != NULL)
-    PushMethodOnStack(tc->preselectWindow, 2, MUIM_PreselectionWindow_RefreshMail, lline);
+///
+/// FinishPipeline
+//  Receives the replies to all still pending pipelined commands
+static void FinishPipeline(struct TransferContext *tc)
+{
+  ENTER();
+
+  while(tc->numPipelined > 0)
+    ReceivePipelinedReply(tc);
 
   LEAVE();
 }
@@ -764,15 +1009,35 @@ static int GetAllMessageDetails(struct TransferContext *tc, BOOL remoteFilters)
 
     if(tnode != NULL)
     {
+      struct MailTransferNode *nextToQueue = tnode;
+
       D(DBF_NET, "pass %ld start at mail %ld", pass, tnode->index-1);
 
       // get all message details until the end of the list
       do
       {
+        // keep as many TOP commands in flight as the server allows
+        while(nextToQueue != NULL && tc->numPipelined < tc->pipelineWindow)
+        {
+          if(isFlagClear(nextToQueue->tflags, TRF_GOT_DETAILS) && isFlagClear(nextToQueue->tflags, TRF_PIPELINED) &&
+             IsStrEmpty(nextToQueue->mail->From.Address))
+          {
+            if(QueuePOP3Command(tc, POPCMD_TOP, nextToQueue) == FALSE)
+              break;
+          }
+
+          nextToQueue = NextMailTransferNode(nextToQueue);
+        }
+
         // get the message details only if this has not been done before already
         if(isFlagClear(tnode->tflags, TRF_GOT_DETAILS))
         {
-          GetSingleMessageDetails(tc, tnode, tnode->index-1);
+          // the replies arrive in the same order as the mails are handled here,
+          // hence the oldest pending reply belongs to this mail
+          if(isFlagSet(tnode->tflags, TRF_PIPELINED))
+            ReceivePipelinedReply(tc);
+          else
+            ReceiveMessageDetails(tc, tnode, tnode->index-1, FALSE);
 
           // update the progress bar
           handledMails++;
@@ -782,6 +1047,9 @@ static int GetAllMessageDetails(struct TransferContext *tc, BOOL remoteFilters)
 
         if((success = CheckAbort(tc)) != 1)
         {
+          // receive all outstanding replies to keep the connection in sync
+          FinishPipeline(tc);
+
           // bail out completely
           tnode = NULL;
           pass = 3;
@@ -972,6 +1240,44 @@ static BOOL FilterDuplicates(struct TransferContext *tc)
   return result;
 }
 
+///
+/// GetCapabilities
+//  Asks the POP3 server for its capabilities (RFC 2449) to find out if
+//  commands may be pipelined
+static void GetCapabilities(struct TransferContext *tc)
+{
+  BOOL pipelining = FALSE;
+
+  ENTER();
+
+  // CAPA is an optional command and not every server knows it,
+  // therefore we don't throw any error
+  if(SendPOP3Command(tc, POPCMD_CAPA, NULL, NULL) != NULL)
+  {
+    // the capabilities are listed one per line up to a single "."
+    while(ReceiveLineFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer)) > 0)
+    {
+      if(strncmp(tc->pop3Buffer, ".\r\n", 3) == 0)
+        break;
+
+      D(DBF_NET, "POP3 server capability '%s'", tc->pop3Buffer);
+
+      if(strnicmp(tc->pop3Buffer, "PIPELINING", 10) == 0)
+        pipelining = TRUE;
+    }
+  }
+
+  // without pipelining we wait for the reply to each single command
+  if(pipelining == TRUE && C->POP3PipelineWindow > 1)
+    tc->pipelineWindow = MIN(C->POP3PipelineWindow, POP3_MAX_PIPELINED);
+  else
+    tc->pipelineWindow = 1;
+
+  D(DBF_NET, "POP3 server '%s' pipelines %ld commands", tc->msn->hostname, tc->pipelineWindow);
+
+  LEAVE();
+}
+
 ///
 /// ConnectToPOP3
 //  Connects to a POP3 mail server
@@ -1171,6 +1477,9 @@ static int ConnectToPOP3(struct TransferContext *tc)
       goto out;
   }
 
+  // find out whether the server supports pipelining
+  GetCapabilities(tc);
+
   PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_GetStats));
   if((resp = SendPOP3Command(tc, POPCMD_STAT, NULL, tr(MSG_ER_BADRESPONSE_POP3))) == NULL)
     goto out;
@@ -1213,120 +1522,11 @@ static void DisconnectFromPOP3(struct TransferContext *tc)
   LEAVE();
 }
 
-///
-/// LoadMessage
-static BOOL LoadMessage(struct TransferContext *tc, struct Folder *inFolder, const int number)
-{
-  BOOL result = FALSE;
-  char msgfile[SIZE_PATHFILE];
-  FILE *fh;
-
-  ENTER();
-
-  MA_NewMailFile(inFolder, msgfile, sizeof(msgfile));
-
-  // open the new mailfile for writing out the retrieved
-  // data
-  if((fh = fopen(msgfile, "w")) != NULL)
-  {
-    char msgnum[SIZE_SMALL];
-    BOOL done = FALSE;
-
-    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
-
-    snprintf(msgnum, sizeof(msgnum), "%d", number);
-    if(SendPOP3Command(tc, POPCMD_RETR, msgnum, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
-    {
-      // now we call a subfunction to receive data from the POP3 server
-      // and write it in the filehandle as long as there is no termination \r\n.\r\n
-      if(ReceiveToFile(tc, fh, msgfile, FALSE) > 0)
-        done = TRUE;
-    }
-    fclose(fh);
-
-    if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR && done == TRUE)
-    {
-      struct ExtendedMail *email;
-
-      if((email = MA_ExamineMail(inFolder, FilePart(msgfile), FALSE)) != NULL)
-      {
-        struct Mail *mail;
-
-        if((mail = CloneMail(&email->Mail)) != NULL)
-        {
-          AddMailToFolder(mail, inFolder);
-
-          // we have to get the actual Time and place it in the transDate, so that we know at
-          // which time this mail arrived
-          GetSysTimeUTC(&mail->transDate);
-
-          mail->sflags = SFLAG_NEW;
-          MA_UpdateMailFile(mail);
-
-          D(DBF_NET, "adding mail to downloaded list");
-          // add the mail to the list of downloaded mails
-          LockMailList(tc->msn->downloadedMails);
-          AddNewMailNode(tc->msn->downloadedMails, mail);
-          UnlockMailList(tc->msn->downloadedMails);
-
-          // if the current folder is the inbox we can go and add the mail instantly to the maillist
-          if(inFolder == GetCurrentFolder())
-            PushMethodOnStack(G->MA->GUI.PG_MAILLIST, 3, MUIM_NList_InsertSingle, mail, MUIV_NList_Insert_Sorted);
-
-          AppendToLogfile(LF_VERBOSE, 32, tr(MSG_LOG_RetrievingVerbose), AddrName(mail->From), mail->Subject, mail->Size);
-
-          PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_StartMacro, MACRO_NEWMSG, msgfile);
-
-          result = TRUE;
-        }
-
-        MA_FreeEMailStruct(email);
-      }
-    }
-
-    if(result == FALSE)
-    {
-      DeleteFile(msgfile);
-
-      // we need to set the folder flags to modified so that the .index will be saved later.
-      setFlag(inFolder->Flags, FOFL_MODIFY);
-    }
-  }
-  else
-    ER_NewError(tr(MSG_ER_ErrorWriteMailfile), msgfile);
-
-  RETURN(result);
-  return result;
-}
-
-///
-/// DeleteMessage
-static BOOL DeleteMessage(struct TransferContext *tc, const int number)
-{
-  BOOL result = FALSE;
-  char msgnum[SIZE_SMALL];
-
-  ENTER();
-
-  // update the transfer status
-  PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_DeletingServerMail));
-
-  snprintf(msgnum, sizeof(msgnum), "%d", number);
-  if(SendPOP3Command(tc, POPCMD_DELE, msgnum, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
-  {
-    tc->downloadResult.deleted++;
-    result = TRUE;
-  }
-
-  RETURN(result);
-  return result;
-}
-
 ///
 /// DownloadMails
 static void DownloadMails(struct TransferContext *tc)
 {
-  struct MailTransferNode *tnode;
+  struct MailTransferNode *nextToQueue;
 
   ENTER();
 
@@ -1335,82 +1535,46 @@ static void DownloadMails(struct TransferContext *tc)
 
   GetSysTime(TIMEVAL(&tc->lastUpdateTime));
 
-  ForEachMailTransferNode(tc->transferList, tnode)
-  {
-    struct Mail *mail = tnode->mail;
+  nextToQueue = FirstMailTransferNode(tc->transferList);
 
-    D(DBF_NET, "download flags %08lx=%s%s%s for mail with subject '%s' and size %ld", tnode->tflags, isFlagSet(tnode->tflags, TRF_TRANSFER) ? "TR_TRANSFER " : "" , isFlagSet(tnode->tflags, TRF_DELETE) ? "TR_DELETE " : "", isFlagSet(tnode->tflags, TRF_PRESELECT) ? "TR_PRESELECT " : "", mail->Subject, mail->Size);
-    if(isFlagSet(tnode->tflags, TRF_TRANSFER))
+  do
+  {
+    // keep as many commands in flight as the server allows
+    while(nextToQueue != NULL && tc->numPipelined < tc->pipelineWindow &&
+          tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
     {
-      D(DBF_NET, "downloading mail with subject '%s' and size %ld", mail->Subject, mail->Size);
+      struct MailTransferNode *tnode = nextToQueue;
+      struct Mail *mail = tnode->mail;
 
-      // update the transfer status
-      PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tnode->index - tc->numberOfMailsSkipped, tnode->position, mail->Size, tr(MSG_TR_Downloading));
+      nextToQueue = NextMailTransferNode(nextToQueue);
 
-      if(LoadMessage(tc, tc->incomingFolder, tnode->index) == TRUE)
+      D(DBF_NET, "download flags %08lx=%s%s%s for mail with subject '%s' and size %ld", tnode->tflags, isFlagSet(tnode->tflags, TRF_TRANSFER) ? "TR_TRANSFER " : "" , isFlagSet(tnode->tflags, TRF_DELETE) ? "TR_DELETE " : "", isFlagSet(tnode->tflags, TRF_PRESELECT) ? "TR_PRESELECT " : "", mail->Subject, mail->Size);
+      if(isFlagSet(tnode->tflags, TRF_TRANSFER))
       {
-        if(TimeHasElapsed(&tc->lastUpdateTime, 250000) == TRUE)
-        {
-          // redraw the folderentry in the listtree 4 times per second at most
-          PushMethodOnStack(G->MA->GUI.LT_FOLDERS, 3, MUIM_NListtree_Redraw, tc->incomingFolder->Treenode, MUIF_NONE);
-        }
-
-        // put the transferStat for this mail to 100%
-        PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Downloading));
-
-        tc->downloadResult.downloaded++;
-
-        // Remember the UIDL of this mail, no matter if it is going
-        // to be deleted or not. Some servers don't delete a mail
-        // right after the DELETE command, but only after a successful
-        // QUIT command. Personal experience shows that pop.gmx.de is
-        // one of these servers.
-        if(hasServerAvoidDuplicates(tc->msn) == TRUE)
-        {
-          D(DBF_NET, "adding mail with subject '%s' to UIDL hash", mail->Subject);
-          // add the UIDL to the hash table or update an existing entry
-          AddUIDLtoHash(tc->UIDLhashTable, tnode->uidl, UIDLF_NEW);
-        }
-
-        if(isFlagSet(tnode->tflags, TRF_DELETE))
-        {
-          D(DBF_NET, "deleting mail with subject '%s' on server", mail->Subject);
+        D(DBF_NET, "downloading mail with subject '%s' and size %ld", mail->Subject, mail->Size);
 
-          DeleteMessage(tc, tnode->index);
-        }
-        else
-          D(DBF_NET, "leaving mail with subject '%s' and size %ld on server to be downloaded again", mail->Subject, mail->Size);
+        QueuePOP3Command(tc, POPCMD_RETR, tnode);
       }
-    }
-    else if(isFlagSet(tnode->tflags, TRF_DELETE))
-    {
-      D(DBF_NET, "deleting mail with subject '%s' on server", mail->Subject);
-
-      // update the transfer status, use a zero mail size
-      PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tnode->index - tc->numberOfMailsSkipped, tnode->position, 0, tr(MSG_TR_DeletingServerMail));
+      else if(isFlagSet(tnode->tflags, TRF_DELETE))
+      {
+        D(DBF_NET, "deleting mail with subject '%s' on server", mail->Subject);
 
-      // now we "know" that this mail had existed, don't forget this in case
-      // the delete operation fails
-      if(hasServerAvoidDuplicates(tc->msn) == TRUE)
+        QueuePOP3Command(tc, POPCMD_DELE, tnode);
+      }
+      else
       {
-        D(DBF_NET, "adding mail with subject '%s' to UIDL hash", mail->Subject);
-        // add the UIDL to the hash table or update an existing entry
-        AddUIDLtoHash(tc->UIDLhashTable, tnode->uidl, UIDLF_NEW);
+        D(DBF_NET, "leaving mail with subject '%s' and size %ld on server to be downloaded again", mail->Subject, mail->Size);
+        // Do not modify the UIDL hash here!
+        // The mail was marked as "don't download", but here we don't know if that
+        // is due to the duplicates checking or if the user did that himself.
       }
-
-      DeleteMessage(tc, tnode->index);
-    }
-    else
-    {
-      D(DBF_NET, "leaving mail with subject '%s' and size %ld on server to be downloaded again", mail->Subject, mail->Size);
-      // Do not modify the UIDL hash here!
-      // The mail was marked as "don't download", but here we don't know if that
-      // is due to the duplicates checking or if the user did that himself.
     }
 
-    if(tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR)
-      break;
+    // now handle the reply to the oldest command, this might queue
+    // a DELE command for a just downloaded mail
+    ReceivePipelinedReply(tc);
   }
+  while((tc->numPipelined > 0 || nextToQueue != NULL) && tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR);
 
   PushMethodOnStack(tc->transferGroup, 1, MUIM_TransferControlGroup_Finish);
 
@@ -1538,6 +1702,8 @@ BOOL ReceiveMails(struct MailServerNode *msn, const ULONG flags, struct Download
     tc->downloadResult.error = TRUE;
     tc->abortMask = (1UL << ThreadAbortSignal());
     tc->wakeupMask = (1UL << ThreadWakeupSignal());
+    // wait for each single reply until we know better
+    tc->pipelineWindow = 1;
 
     // depending on the incoming folder settings in the
     // POP3 server configuration we store mail either in the
@@ -124,10 +124,51 @@ static const char *const SMTPcmd[] =
 // help macros for SMTP routines
 #define getResponseCode(str)          ((int)strtol((str), NULL, 10))
 
+// maximum number of pipelined commands (RFC 2920) whose replies are still
+// outstanding, this keeps the server from blocking on writing its replies
+#define SMTP_MAX_PIPELINED 64
+
+// a pipelined command whose reply has not been read yet
+struct PipelinedCommand
+{
+  enum SMTPCommand command;
+  char text[SIZE_ADDRESS+SIZE_SMALL]; // the command line for error reports
+};
+
+// an additional connection is opened only if each connection gets at least
+// this number of mails to send
+#define SMTP_MIN_MAILS_PER_CONNECTION 8
+
+// a thread sending mails of a queue over its own connection
+struct SendMailThread
+{
+  APTR thread;                           // the thread, NULL for an unused slot
+  struct Connection *conn;               // the connection used by the thread
+};
+
+// the mails of a transfer shared by several connections to the same server
+struct SendMailQueue
+{
+  struct MailTransferList *transferList; // the mails to send, its semaphore protects the queue
+  struct MailTransferNode *nextNode;     // the next mail to be sent
+  struct UserIdentityNode *uin;          // ptr to user identity sending mails
+  struct MailServerNode *msn;
+  struct Folder *outFolder;              // the folder to send mails from
+  struct Folder *sentFolder;             // the folder to store sent mails into
+  struct MinList *sentMailFilters;       // the filters to apply to sent mails
+  Object *transferGroup;                 // the TransferControlGroup of all connections
+  APTR ownerThread;                      // the thread which started the sending threads
+  struct SendMailThread threads[SMTP_MAX_CONNECTIONS]; // the running sending threads
+  ULONG finishedThreads;                 // number of sending threads which ran out of work
+  BOOL aborted;                          // the transfer was aborted by the user
+  BOOL failed;                           // a connection was broken during a transfer
+};
+
 struct TransferContext
 {
   struct Connection *conn;
   struct MailServerNode *msn;
+  struct SendMailQueue *queue;           // the queue to take the mails to be sent from
   struct UserIdentityNode *uin;          // ptr to user identity sending mails
   Object *transferGroup;
   struct Folder *outFolder;              // the folder to send mails from
@@ -136,16 +177,165 @@ struct TransferContext
   char challenge[SIZE_LINE];
   char tempBuffer[SIZE_LINE];
   char transferGroupTitle[SIZE_DEFAULT]; // the TransferControlGroup's title
+  struct PipelinedCommand pipeline[SMTP_MAX_PIPELINED]; // commands waiting for their replies
+  int numPipelined;                      // number of commands in the pipeline
+  BOOL senderRejected;                   // the pipelined MAIL command was rejected
+  BOOL sharedProgress;                   // other connections report to the same TransferControlGroup
   BOOL useTLS;
+  unsigned int smtpFlags;                // the SMTP flags found for this connection
 };
 
+/// ReceiveSMTPReply
+//  Reads the (possibly multiline) reply of the SMTP server to a command and
+//  checks its response code (RFC 2821). The command text is used for error
+//  reports only.
+static char *ReceiveSMTPReply(struct TransferContext *tc, const enum SMTPCommand command, const char *cmdText, const char *errorMsg)
+{
+  BOOL success = FALSE;
+  char *result = tc->smtpBuffer;
+  int len = 0;
+
+  ENTER();
+
+  // read out the server response to the command
+  if((len = ReceiveLineFromHost(tc->conn, tc->smtpBuffer, sizeof(tc->smtpBuffer))) > 0)
+  {
+    // get the response code
+    int rc = strtol(tc->smtpBuffer, NULL, 10);
+
+    D(DBF_NET, "received SMTP answer '%s'", tc->smtpBuffer);
+
+    // if the response is a multiline response we have to get out more
+    // from the socket
+    if(tc->smtpBuffer[3] == '-') // (RFC 2821) - section 4.2.1
+    {
+      char tbuf[SIZE_LINE];
+
+      // now we concatenate the multiline reply to
+      // out main buffer
+      do
+      {
+        // lets get out the next line from the socket
+        if((len = ReceiveLineFromHost(tc->conn, tbuf, sizeof(tbuf))) > 0)
+        {
+          // get the response code
+          int rc2 = strtol(tbuf, NULL, 10);
+
+          // check if the response code matches the one
+          // of the first line
+          if(rc == rc2)
+          {
+            // lets concatenate both strings while stripping the
+            // command code and make sure we didn't reach the end
+            // of the buffer
+            if(strlcat(tc->smtpBuffer, tbuf, sizeof(tc->smtpBuffer)) >= sizeof(tc->smtpBuffer))
+              W(DBF_NET, "buffer overrun on trying to concatenate a multiline reply!");
+          }
+          else
+          {
+            E(DBF_NET, "response codes of multiline reply doesn't match!");
+
+            errorMsg = NULL;
+            len = 0;
+            break;
+          }
+        }
+        else
+        {
+          errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
+          break;
+        }
+      }
+      while(tbuf[3] == '-');
+    }
+
+    // check that the concatentation worked
+    // out fine and that the rc is valid
+    if(len > 0 && rc >= 100)
+    {
+      // Now we check if we got the correct response code for the command
+      // we issued
+      switch(command)
+      {
+        //  Reponse    Description (RFC 2821 - section 4.2.1)
+        //  1xx        Positive Preliminary reply
+        //  2xx        Positive Completion reply
+        //  3xx        Positive Intermediate reply
+        //  4xx        Transient Negative Completion reply
+        //  5xx        Permanent Negative Completion reply
+
+        case SMTP_HELP:    { success = (rc == 211 || rc == 214); } break;
+        case SMTP_VRFY:    { success = (rc == 250 || rc == 251); } break;
+        case SMTP_CONNECT: { success = (rc == 220); } break;
+        case SMTP_QUIT:    { success = (rc == 221); } break;
+        case SMTP_DATA:    { success = (rc == 354); } break;
+
+        // all codes that accept 250 response code
+        case SMTP_HELO:
+        case SMTP_MAIL:
+        case SMTP_RCPT:
+        case SMTP_FINISH:
+        case SMTP_RSET:
+        case SMTP_SEND:
+        case SMTP_SOML:
+        case SMTP_SAML:
+        case SMTP_EXPN:
+        case SMTP_NOOP:
+        case SMTP_TURN:    { success = (rc == 250); } break;
+
+        // ESMTP commands & response codes
+        case ESMTP_EHLO:            { success = (rc == 250); } break;
+        case ESMTP_STARTTLS:        { success = (rc == 220); } break;
+
+        // ESMTP_AUTH command responses
+        case ESMTP_AUTH_CRAM_MD5:
+        case ESMTP_AUTH_DIGEST_MD5:
+        case ESMTP_AUTH_LOGIN:
+        case ESMTP_AUTH_PLAIN:      { success = (rc == 334); } break;
+      }
+    }
+  }
+  else
+  {
+    // Unfortunately, there are broken SMTP server implementations out there
+    // like the one used by "smtp.googlemail.com" or "smtp.gmail.com".
+    //
+    // It seems these broken SMTP servers do automatically drop the
+    // data connection right after the 'QUIT' command was send and don't
+    // reply with a status message like it is clearly defined in RFC 2821
+    // (section 4.1.1.10). Unfortunately we can't do anything about
+    // it really and have to consider this a bad and ugly workaround. :(
+    if(command == SMTP_QUIT)
+    {
+      W(DBF_NET, "broken SMTP server implementation found on QUIT, keeping quiet...");
+
+      success = TRUE;
+      tc->smtpBuffer[0] = '\0';
+    }
+    else
+      errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
+  }
+
+  // the rest of the responses throws an error
+  if(success == FALSE)
+  {
+    if(errorMsg != NULL)
+      ER_NewError(errorMsg, tc->msn->hostname, (char *)cmdText, tc->smtpBuffer);
+
+    result = NULL;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
 /// SendSMTPCommand
 //  Sends a command to the SMTP server and returns the response message
 //  described in (RFC 2821)
 static char *SendSMTPCommand(struct TransferContext *tc, const enum SMTPCommand command, const char *parmtext, const char *errorMsg)
 {
-  BOOL success = FALSE;
-  char *result = tc->smtpBuffer;
+  char *result = NULL;
 
   ENTER();
 
@@ -162,142 +352,119 @@ static char *SendSMTPCommand(struct TransferContext *tc, const enum SMTPCommand
   // state
   if(command == SMTP_CONNECT || SendLineToHost(tc->conn, tc->smtpBuffer) > 0)
   {
-    int len = 0;
-
     // after issuing the SMTP command we read out the server response to it
-    // but only if this wasn't the SMTP_QUIT command.
-    if((len = ReceiveLineFromHost(tc->conn, tc->smtpBuffer, sizeof(tc->smtpBuffer))) > 0)
-    {
-      // get the response code
-      int rc = strtol(tc->smtpBuffer, NULL, 10);
+    result = ReceiveSMTPReply(tc, command, SMTPcmd[command], errorMsg);
+  }
+  else
+    ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[command]);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// CollectSMTPReplies
+//  Flushes all pipelined commands (RFC 2920) to the server and reads their
+//  replies in the order the commands were sent. Every rejected command is
+//  reported, except for the recipients of a rejected sender which the server
+//  refuses as a consequence. Returns FALSE if any of the commands was
+//  rejected or the connection broke.
+static BOOL CollectSMTPReplies(struct TransferContext *tc)
+{
+  BOOL success = TRUE;
+
+  ENTER();
 
-      D(DBF_NET, "received SMTP answer '%s'", tc->smtpBuffer);
+  if(tc->numPipelined > 0)
+  {
+    if(FlushConnection(tc->conn) >= 0)
+    {
+      int i;
 
-      // if the response is a multiline response we have to get out more
-      // from the socket
-      if(tc->smtpBuffer[3] == '-') // (RFC 2821) - section 4.2.1
+      for(i = 0; i < tc->numPipelined; i++)
       {
-        char tbuf[SIZE_LINE];
+        struct PipelinedCommand *pc = &tc->pipeline[i];
+        const char *errorMsg = (tc->senderRejected == TRUE) ? NULL : tr(MSG_ER_BADRESPONSE_SMTP);
 
-        // now we concatenate the multiline reply to
-        // out main buffer
-        do
+        if(ReceiveSMTPReply(tc, pc->command, pc->text, errorMsg) == NULL)
         {
-          // lets get out the next line from the socket
-          if((len = ReceiveLineFromHost(tc->conn, tbuf, sizeof(tbuf))) > 0)
-          {
-            // get the response code
-            int rc2 = strtol(tbuf, NULL, 10);
+          success = FALSE;
 
-            // check if the response code matches the one
-            // of the first line
-            if(rc == rc2)
-            {
-              // lets concatenate both strings while stripping the
-              // command code and make sure we didn't reach the end
-              // of the buffer
-              if(strlcat(tc->smtpBuffer, tbuf, sizeof(tc->smtpBuffer)) >= sizeof(tc->smtpBuffer))
-                W(DBF_NET, "buffer overrun on trying to concatenate a multiline reply!");
-            }
-            else
-            {
-              E(DBF_NET, "response codes of multiline reply doesn't match!");
+          if(pc->command == SMTP_MAIL)
+            tc->senderRejected = TRUE;
 
-              errorMsg = NULL;
-              len = 0;
-              break;
-            }
-          }
-          else
-          {
-            errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
+          // there is no point in waiting for more replies on a broken connection
+          if(tc->conn->error != CONNECTERR_NO_ERROR)
             break;
-          }
-        }
-        while(tbuf[3] == '-');
-      }
-
-      // check that the concatentation worked
-      // out fine and that the rc is valid
-      if(len > 0 && rc >= 100)
-      {
-        // Now we check if we got the correct response code for the command
-        // we issued
-        switch(command)
-        {
-          //  Reponse    Description (RFC 2821 - section 4.2.1)
-          //  1xx        Positive Preliminary reply
-          //  2xx        Positive Completion reply
-          //  3xx        Positive Intermediate reply
-          //  4xx        Transient Negative Completion reply
-          //  5xx        Permanent Negative Completion reply
-
-          case SMTP_HELP:    { success = (rc == 211 || rc == 214); } break;
-          case SMTP_VRFY:    { success = (rc == 250 || rc == 251); } break;
-          case SMTP_CONNECT: { success = (rc == 220); } break;
-          case SMTP_QUIT:    { success = (rc == 221); } break;
-          case SMTP_DATA:    { success = (rc == 354); } break;
-
-          // all codes that accept 250 response code
-          case SMTP_HELO:
-          case SMTP_MAIL:
-          case SMTP_RCPT:
-          case SMTP_FINISH:
-          case SMTP_RSET:
-          case SMTP_SEND:
-          case SMTP_SOML:
-          case SMTP_SAML:
-          case SMTP_EXPN:
-          case SMTP_NOOP:
-          case SMTP_TURN:    { success = (rc == 250); } break;
-
-          // ESMTP commands & response codes
-          case ESMTP_EHLO:            { success = (rc == 250); } break;
-          case ESMTP_STARTTLS:        { success = (rc == 220); } break;
-
-          // ESMTP_AUTH command responses
-          case ESMTP_AUTH_CRAM_MD5:
-          case ESMTP_AUTH_DIGEST_MD5:
-          case ESMTP_AUTH_LOGIN:
-          case ESMTP_AUTH_PLAIN:      { success = (rc == 334); } break;
         }
       }
     }
     else
     {
-      // Unfortunately, there are broken SMTP server implementations out there
-      // like the one used by "smtp.googlemail.com" or "smtp.gmail.com".
-      //
-      // It seems these broken SMTP servers do automatically drop the
-      // data connection right after the 'QUIT' command was send and don't
-      // reply with a status message like it is clearly defined in RFC 2821
-      // (section 4.1.1.10). Unfortunately we can't do anything about
-      // it really and have to consider this a bad and ugly workaround. :(
-      if(command == SMTP_QUIT)
-      {
-        W(DBF_NET, "broken SMTP server implementation found on QUIT, keeping quiet...");
-
-        success = TRUE;
-        tc->smtpBuffer[0] = '\0';
-      }
-      else
-        errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
+      ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[tc->pipeline[0].command]);
+      success = FALSE;
     }
+
+    D(DBF_NET, "collected replies of %ld pipelined SMTP commands, success %ld", tc->numPipelined, success);
+
+    tc->numPipelined = 0;
   }
-  else
-    errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
 
-  // the rest of the responses throws an error
-  if(success == FALSE)
+  RETURN(success);
+  return success;
+}
+
+///
+/// SendEnvelopeCommand
+//  Sends a MAIL or RCPT command to the server. If the server supports
+//  pipelining the command is only put into the send buffer and its reply
+//  is checked later by CollectSMTPReplies(). Returns FALSE if the command
+//  or one of the previously pipelined commands was rejected.
+static BOOL SendEnvelopeCommand(struct TransferContext *tc, const enum SMTPCommand command, const char *parmtext)
+{
+  BOOL success = TRUE;
+
+  ENTER();
+
+  if(hasPIPELINING(tc->smtpFlags))
   {
-    if(errorMsg != NULL)
-      ER_NewError(errorMsg, tc->msn->hostname, (char *)SMTPcmd[command], tc->smtpBuffer);
+    // make room in the pipeline first
+    if(tc->numPipelined == SMTP_MAX_PIPELINED)
+      success = CollectSMTPReplies(tc);
 
-    result = NULL;
+    if(tc->conn->error == CONNECTERR_NO_ERROR)
+    {
+      struct PipelinedCommand *pc = &tc->pipeline[tc->numPipelined];
+
+      // a new transaction starts with the MAIL command
+      if(command == SMTP_MAIL)
+        tc->senderRejected = FALSE;
+
+      snprintf(tc->smtpBuffer, sizeof(tc->smtpBuffer), "%s %s\r\n", SMTPcmd[command], parmtext);
+
+      D(DBF_NET, "TCP: pipeline SMTP cmd '%s' with param '%s'", SMTPcmd[command], parmtext);
+
+      // the command will be flushed together with the other ones
+      if(SendToHost(tc->conn, tc->smtpBuffer, strlen(tc->smtpBuffer), TCPF_NONE) > 0)
+      {
+        pc->command = command;
+        snprintf(pc->text, sizeof(pc->text), "%s %s", SMTPcmd[command], parmtext);
+        tc->numPipelined++;
+      }
+      else
+      {
+        ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[command]);
+        success = FALSE;
+      }
+    }
+    else
+      success = FALSE;
   }
+  else
+    success = (SendSMTPCommand(tc, command, parmtext, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL);
 
-  RETURN(result);
-  return result;
+  RETURN(success);
+  return success;
 }
 
 ///
@@ -453,6 +620,9 @@ static BOOL ConnectToSMTP(struct TransferContext *tc)
       W(DBF_NET, "error on SMTP server negotation");
     }
 
+    // remember the flags of this session, other connections to the same
+    // server may still be busy with their own negotiation
+    tc->smtpFlags = flags;
     tc->msn->smtpFlags = flags;
   }
   else
@@ -472,7 +642,7 @@ static BOOL InitSTARTTLS(struct TransferContext *tc)
   ENTER();
 
   // If this server doesn't support TLS at all we return with an error
-  if(hasSTARTTLS(tc->msn->smtpFlags))
+  if(hasSTARTTLS(tc->smtpFlags))
   {
     // If we end up here the server supports STARTTLS and we can start
     // initializing the connection
@@ -531,44 +701,44 @@ static BOOL InitSMTPAUTH(struct TransferContext *tc)
   // supports that method or not
   if(hasServerAuth_AUTO(tc->msn))
   {
-    D(DBF_NET, "about to automatically choose which SMTP-AUTH to prefer. smtpFlags=0x%08lx", tc->msn->smtpFlags);
+    D(DBF_NET, "about to automatically choose which SMTP-AUTH to prefer. smtpFlags=0x%08lx", tc->smtpFlags);
 
     // we select the most secure one the server supports
-    if(hasDIGEST_MD5_Auth(tc->msn->smtpFlags))
+    if(hasDIGEST_MD5_Auth(tc->smtpFlags))
       selectedMethod = MSF_AUTH_DIGEST;
-    else if(hasCRAM_MD5_Auth(tc->msn->smtpFlags))
+    else if(hasCRAM_MD5_Auth(tc->smtpFlags))
       selectedMethod = MSF_AUTH_CRAM;
-    else if(hasLOGIN_Auth(tc->msn->smtpFlags))
+    else if(hasLOGIN_Auth(tc->smtpFlags))
       selectedMethod = MSF_AUTH_LOGIN;
-    else if(hasPLAIN_Auth(tc->msn->smtpFlags))
+    else if(hasPLAIN_Auth(tc->smtpFlags))
       selectedMethod = MSF_AUTH_PLAIN;
     else
       W(DBF_NET, "Server doesn't seem to support any SMTP-AUTH method but InitSMTPAUTH function called?");
   }
   else if(hasServerAuth_DIGEST(tc->msn))
   {
-    if(hasDIGEST_MD5_Auth(tc->msn->smtpFlags))
+    if(hasDIGEST_MD5_Auth(tc->smtpFlags))
       selectedMethod = MSF_AUTH_DIGEST;
     else
       W(DBF_NET, "User selected SMTP-Auth 'DIGEST-MD5', but server doesn't support it!");
   }
   else if(hasServerAuth_CRAM(tc->msn))
   {
-    if(hasCRAM_MD5_Auth(tc->msn->smtpFlags))
+    if(hasCRAM_MD5_Auth(tc->smtpFlags))
       selectedMethod = MSF_AUTH_CRAM;
     else
       W(DBF_NET, "User selected SMTP-Auth 'CRAM-MD5', but server doesn't support it!");
   }
   else if(hasServerAuth_LOGIN(tc->msn))
   {
-    if(hasLOGIN_Auth(tc->msn->smtpFlags))
+    if(hasLOGIN_Auth(tc->smtpFlags))
       selectedMethod = MSF_AUTH_LOGIN;
     else
       W(DBF_NET, "User selected SMTP-Auth 'LOGIN', but server doesn't support it!");
   }
   else if(hasServerAuth_PLAIN(tc->msn))
   {
-    if(hasPLAIN_Auth(tc->msn->smtpFlags))
+    if(hasPLAIN_Auth(tc->smtpFlags))
       selectedMethod = MSF_AUTH_PLAIN;
     else
       W(DBF_NET, "User selected SMTP-Auth 'PLAIN', but server doesn't support it!");
@@ -1123,29 +1293,31 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
   if((buf = malloc(buflen)) != NULL &&
      (fh = fopen(mailfile, "r")) != NULL)
   {
-    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
-
-    // now we put together our parameters for our MAIL command
-    // which in fact may contain serveral parameters as well according
-    // to ESMTP extensions.
-    snprintf(buf, buflen, "FROM:<%s>", tc->uin->address);
-
-    // in case the server supports the ESMTP SIZE extension lets add the
-    // size
-    if(hasSIZE(tc->msn->smtpFlags) && mail->Size > 0)
-      snprintf(buf, buflen, "%s SIZE=%ld", buf, mail->Size);
+    struct ExtendedMail *email;
 
-    // in case the server supports the ESMTP 8BITMIME extension we can
-    // add information about the encoding mode
-    if(has8BITMIME(tc->msn->smtpFlags))
-      snprintf(buf, buflen, "%s BODY=%s", buf, hasServer8bit(tc->msn) ? "8BITMIME" : "7BIT");
+    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
-    // send the MAIL command with the FROM: message
-    if(SendSMTPCommand(tc, SMTP_MAIL, buf, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL)
+    if((email = MA_ExamineMail(tc->outFolder, mail->MailFile, TRUE)) != NULL)
     {
-      struct ExtendedMail *email = MA_ExamineMail(tc->outFolder, mail->MailFile, TRUE);
-
-      if(email != NULL)
+      // now we put together our parameters for our MAIL command
+      // which in fact may contain serveral parameters as well according
+      // to ESMTP extensions.
+      snprintf(buf, buflen, "FROM:<%s>", tc->uin->address);
+
+      // in case the server supports the ESMTP SIZE extension lets add the
+      // size
+      if(hasSIZE(tc->smtpFlags) && mail->Size > 0)
+        snprintf(buf, buflen, "%s SIZE=%ld", buf, mail->Size);
+
+      // in case the server supports the ESMTP 8BITMIME extension we can
+      // add information about the encoding mode
+      if(has8BITMIME(tc->smtpFlags))
+        snprintf(buf, buflen, "%s BODY=%s", buf, hasServer8bit(tc->msn) ? "8BITMIME" : "7BIT");
+
+      // send the MAIL command with the FROM: message, in case the server
+      // supports pipelining the MAIL and all RCPT commands are sent at once
+      // and their replies are checked afterwards
+      if(SendEnvelopeCommand(tc, SMTP_MAIL, buf) == TRUE)
       {
         BOOL rcptok = TRUE;
         int j;
@@ -1158,7 +1330,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumResentTo; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->ResentTo[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1166,14 +1338,14 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
         {
           // specify the main 'To:' recipient
           snprintf(buf, buflen, "TO:<%s>", mail->To.Address);
-          if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+          if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
             rcptok = FALSE;
 
           // now add the additional 'To:' recipients of the mail
           for(j=0; j < email->NumSTo && rcptok; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->STo[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1184,7 +1356,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumResentCC; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->ResentCC[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1194,7 +1366,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumCC && rcptok; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->CC[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1205,7 +1377,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumResentBCC; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->ResentBCC[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1215,11 +1387,15 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumBCC && rcptok; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->BCC[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
 
+        // check the replies to all still pipelined commands
+        if(CollectSMTPReplies(tc) == FALSE)
+          rcptok = FALSE;
+
         if(rcptok == TRUE)
         {
           D(DBF_NET, "RCPTs accepted, sending mail data");
@@ -1232,6 +1408,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
             ssize_t curlen;
             ssize_t proclen = 0;
             size_t sentbytes = 0;
+            ULONG reported = 0;
 
             // as long there is no abort situation we go on reading out
             // from the stream and sending it to our SMTP server
@@ -1321,6 +1498,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
               }
 
               PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, proclen, tr(MSG_TR_Sending));
+              reported += proclen;
             }
 
             D(DBF_NET, "transfered %ld bytes (raw: %ld bytes) error: %ld/%ld", sentbytes, mail->Size, tc->conn->abort, tc->conn->error);
@@ -1347,8 +1525,13 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
                 // will be send incomplete.
                 if(SendSMTPCommand(tc, SMTP_FINISH, NULL, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL)
                 {
-                  // put the transferStat to 100%
-                  PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Sending));
+                  // put the transferStat to 100%, but if other connections report
+                  // their mails to the same group the current mail of the group might
+                  // be a different one and we just add what is left of this mail
+                  if(tc->sharedProgress == FALSE)
+                    PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Sending));
+                  else if(mail->Size > (LONG)reported)
+                    PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, mail->Size - (LONG)reported, tr(MSG_TR_Sending));
 
                   // now that we are at 100% we have to set the transfer Date of the message
                   GetSysTimeUTC(&mail->transDate);
@@ -1363,12 +1546,12 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
               result = -1; // signal the caller that we aborted within the DATA part
           }
         }
-
-        MA_FreeEMailStruct(email);
       }
-      else
-        ER_NewError(tr(MSG_ER_CantOpenFile), mailfile);
+
+      MA_FreeEMailStruct(email);
     }
+    else
+      ER_NewError(tr(MSG_ER_CantOpenFile), mailfile);
 
     fclose(fh);
   }
@@ -1381,6 +1564,461 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
   return result;
 }
 
+///
+/// ConnectToSMTPServer
+// Connects to the SMTP server and initializes the SMTP session including a
+// possible TLS negotiation and the authentication. Returns TRUE if the
+// session is ready to send mails, otherwise the error is returned in *err.
+static BOOL ConnectToSMTPServer(struct TransferContext *tc, enum ConnectError *err)
+{
+  BOOL connected = FALSE;
+
+  ENTER();
+
+  D(DBF_NET, "connecting to host '%s' port %ld", tc->msn->hostname, tc->msn->port);
+  if((*err = ConnectToHost(tc->conn, tc->msn)) == CONNECTERR_SUCCESS)
+  {
+    // first we check whether the user wants to connect to a plain SSLv3 server
+    // so that we initiate the SSL connection now
+    if(hasServerSSL(tc->msn) == TRUE)
+    {
+      // lets try to establish the SSL connection via AmiSSL
+      if(MakeSecureConnection(tc->conn) == TRUE)
+        tc->useTLS = TRUE;
+      else
+        *err = CONNECTERR_SSLFAILED; // special SSL connection error
+    }
+
+    // first we have to check whether the TCP/IP connection could
+    // be successfully opened so that we can init the SMTP connection
+    // and query the SMTP server for its capabilities now.
+    if(*err == CONNECTERR_SUCCESS)
+    {
+      // initialize the SMTP connection which will also
+      // query the SMTP server for its capabilities
+      connected = ConnectToSMTP(tc);
+
+      // Now we have to check whether the user has selected SSL/TLS
+      // and then we have to initiate the STARTTLS command followed by the TLS negotiation
+      if(connected == TRUE && hasServerTLS(tc->msn) == TRUE)
+      {
+        connected = InitSTARTTLS(tc);
+
+        // then we have to refresh the SMTPflags and check
+        // again what features we have after the STARTTLS
+        if(connected == TRUE)
+        {
+          // first we flag this connection as a sucessfull
+          // TLS session
+          tc->useTLS = TRUE;
+
+          // now run the connect SMTP function again
+          // so that the SMTP server flags will be refreshed
+          // accordingly.
+          connected = ConnectToSMTP(tc);
+        }
+      }
+
+      // If the user selected SMTP_AUTH we have to initiate
+      // a AUTH connection
+      if(connected == TRUE && hasServerAuth(tc->msn) == TRUE)
+        connected = InitSMTPAUTH(tc);
+    }
+
+    if(connected == FALSE)
+    {
+      // check if we end up here cause of the 8BITMIME differences
+      if(has8BITMIME(tc->smtpFlags) == FALSE && hasServer8bit(tc->msn) == TRUE)
+      {
+        W(DBF_NET, "incorrect Allow8bit setting!");
+        *err = CONNECTERR_INVALID8BIT;
+      }
+      else if(*err != CONNECTERR_SSLFAILED)
+        *err = CONNECTERR_UNKNOWN_ERROR;
+    }
+  }
+
+  if(connected == TRUE)
+    AppendToLogfile(LF_VERBOSE, 41, tr(MSG_LOG_ConnectSMTP), tc->msn->hostname);
+
+  RETURN(connected);
+  return connected;
+}
+
+///
+/// ReportConnectError
+// tell the user why the connection to the SMTP server failed
+static void ReportConnectError(const struct MailServerNode *msn, const enum ConnectError err)
+{
+  ENTER();
+
+  switch(err)
+  {
+    case CONNECTERR_SUCCESS:
+    case CONNECTERR_ABORTED:
+    case CONNECTERR_NO_ERROR:
+      // do nothing
+    break;
+
+    // a socket is already in use so we return
+    // a specific error to the user
+    case CONNECTERR_SOCKET_IN_USE:
+      ER_NewError(tr(MSG_ER_CONNECTERR_SOCKET_IN_USE_SMTP), msn->hostname);
+    break;
+
+    // socket() execution failed
+    case CONNECTERR_NO_SOCKET:
+      ER_NewError(tr(MSG_ER_CONNECTERR_NO_SOCKET_SMTP), msn->hostname);
+    break;
+
+    // couldn't establish non-blocking IO
+    case CONNECTERR_NO_NONBLOCKIO:
+      ER_NewError(tr(MSG_ER_CONNECTERR_NO_NONBLOCKIO_SMTP), msn->hostname);
+    break;
+
+    // the specified hostname isn't valid, so
+    // lets tell the user
+    case CONNECTERR_UNKNOWN_HOST:
+      ER_NewError(tr(MSG_ER_UNKNOWN_HOST_SMTP), msn->hostname);
+    break;
+
+    // the connection request timed out, so tell
+    // the user
+    case CONNECTERR_TIMEDOUT:
+      ER_NewError(tr(MSG_ER_CONNECTERR_TIMEDOUT_SMTP), msn->hostname);
+    break;
+
+    // an error occurred while checking for 8bit MIME
+    // compatibility
+    case CONNECTERR_INVALID8BIT:
+      ER_NewError(tr(MSG_ER_NO8BITMIME_SMTP), msn->hostname);
+    break;
+
+    // error during initialization of an SSL connection
+    case CONNECTERR_SSLFAILED:
+      ER_NewError(tr(MSG_ER_INITTLS_SMTP), msn->hostname);
+    break;
+
+    // an unknown error occurred so lets show
+    // a generic error message
+    case CONNECTERR_UNKNOWN_ERROR:
+      ER_NewError(tr(MSG_ER_CANNOT_CONNECT_SMTP), msn->hostname);
+    break;
+
+    case CONNECTERR_NO_CONNECTION:
+    case CONNECTERR_NOT_CONNECTED:
+      // cannot happen, do nothing
+    break;
+  }
+
+  LEAVE();
+}
+
+///
+/// GetNextQueuedMail
+// take the next mail to be sent from a queue, returns NULL if there are no
+// more mails or if the transfer was aborted
+static struct MailTransferNode *GetNextQueuedMail(struct SendMailQueue *queue)
+{
+  struct MailTransferNode *tn;
+
+  ENTER();
+
+  LockMailTransferList(queue->transferList);
+
+  if(queue->aborted == FALSE && (tn = queue->nextNode) != NULL)
+    queue->nextNode = NextMailTransferNode(tn);
+  else
+    tn = NULL;
+
+  UnlockMailTransferList(queue->transferList);
+
+  RETURN(tn);
+  return tn;
+}
+
+///
+/// SendQueuedMailsOverConnection
+// send the mails of a queue over an established SMTP session until the queue
+// is empty or the connection fails
+static void SendQueuedMailsOverConnection(struct TransferContext *tc)
+{
+  struct SendMailQueue *queue = tc->queue;
+  struct MailTransferNode *tn;
+
+  ENTER();
+
+  while(tc->conn->abort == FALSE && tc->conn->error == CONNECTERR_NO_ERROR &&
+        (tn = GetNextQueuedMail(queue)) != NULL)
+  {
+    struct Mail *mail = tn->mail;
+
+    PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tn->index, -1, mail->Size, tr(MSG_TR_Sending));
+
+    switch(SendMessage(tc, mail))
+    {
+      // -1 means that SendMessage was aborted within the
+      // DATA part and so we cannot issue a RSET command and have to abort
+      // immediatly by leaving the mailserver alone.
+      case -1:
+      {
+        setStatusToError(mail);
+        tc->conn->error = CONNECTERR_UNKNOWN_ERROR;
+      }
+      break;
+
+      // 0 means that an error occured before the DATA part and
+      // so we can abort the transaction cleanly by a RSET and QUIT
+      case 0:
+      {
+        setStatusToError(mail);
+        SendSMTPCommand(tc, SMTP_RSET, NULL, NULL); // no error check
+        tc->conn->error = CONNECTERR_NO_ERROR;
+      }
+      break;
+
+      // 1 means we filter the mails and then copy/move the mail to the send folder
+      case 1:
+      {
+        setStatusToSent(mail);
+        if(PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_FilterMail, queue->sentMailFilters, mail) == TRUE)
+        {
+          // the filter process did not move the mail, hence we do it now
+          PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_MoveCopyMail, mail, tc->sentFolder, "sent mail", MVCPF_CLOSE_WINDOWS);
+        }
+        else
+        {
+          // update the Outgoing folder's stats as the mail just got (re)moved
+          PushMethodOnStack(G->App, 3, MUIM_YAMApplication_DisplayStatistics, tc->outFolder, TRUE);
+        }
+      }
+      break;
+
+      // 2 means we filter and delete afterwards
+      case 2:
+      {
+        setStatusToSent(mail);
+        if(PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_FilterMail, queue->sentMailFilters, mail) == TRUE)
+        {
+          // the filter process did not delete the mail, hence we do it now
+          PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_DeleteMail, mail, DELF_UPDATE_APPICON);
+        }
+      }
+      break;
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// SendQueuedMails
+//  Sends mails of a queue over an additional connection to the SMTP server.
+//  This is executed by several threads in parallel (TA_SendMailQueue) while
+//  the thread which started them sends mails over its own connection. Each
+//  thread takes the next mail from the queue until all mails have been sent.
+LONG SendQueuedMails(struct SendMailQueue *queue)
+{
+  BOOL success = FALSE;
+  struct TransferContext *tc;
+  int slot = -1;
+
+  ENTER();
+
+  if((tc = calloc(1, sizeof(*tc))) != NULL)
+  {
+    tc->queue = queue;
+    tc->uin = queue->uin;
+    tc->msn = queue->msn;
+    tc->outFolder = queue->outFolder;
+    tc->sentFolder = queue->sentFolder;
+    tc->transferGroup = queue->transferGroup;
+    tc->sharedProgress = TRUE;
+
+    if((tc->conn = CreateConnection(TRUE)) != NULL && ConnectionIsOnline(tc->conn) == TRUE)
+    {
+      // copy a link to the mailservernode for which we created
+      // the connection
+      tc->conn->server = tc->msn;
+
+      // register ourself so that an abort can be passed on to us
+      LockMailTransferList(queue->transferList);
+
+      if(queue->aborted == FALSE)
+      {
+        int i;
+
+        for(i = 0; i < SMTP_MAX_CONNECTIONS; i++)
+        {
+          if(queue->threads[i].thread == NULL)
+          {
+            queue->threads[i].thread = CurrentThread();
+            queue->threads[i].conn = tc->conn;
+            slot = i;
+            break;
+          }
+        }
+      }
+
+      UnlockMailTransferList(queue->transferList);
+
+      if(slot != -1)
+      {
+        enum ConnectError err;
+
+        if(ConnectToSMTPServer(tc, &err) == TRUE)
+        {
+          SendQueuedMailsOverConnection(tc);
+
+          // send a 'QUIT' command, but only if
+          // we didn't receive any error during the transfer
+          if(tc->conn->error == CONNECTERR_NO_ERROR)
+          {
+            SendSMTPCommand(tc, SMTP_QUIT, NULL, tr(MSG_ER_BADRESPONSE_SMTP));
+            success = TRUE;
+          }
+        }
+        else
+        {
+          // the remaining mails are left to the other connections
+          W(DBF_NET, "additional connection to SMTP server '%s' failed, error %ld", tc->msn->hostname, err);
+          success = TRUE;
+        }
+
+        // make sure to shutdown the socket and all possible SSL connection stuff
+        DisconnectFromHost(tc->conn);
+      }
+    }
+  }
+
+  // let the thread owning the queue know that we ran out of work
+  LockMailTransferList(queue->transferList);
+
+  if(slot != -1)
+  {
+    queue->threads[slot].thread = NULL;
+    queue->threads[slot].conn = NULL;
+  }
+
+  if(slot != -1 && success == FALSE)
+    queue->failed = TRUE;
+
+  queue->finishedThreads++;
+  WakeupThread(queue->ownerThread);
+
+  UnlockMailTransferList(queue->transferList);
+
+  if(tc != NULL)
+  {
+    DeleteConnection(tc->conn);
+    free(tc);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// AbortSendMailThreads
+// pass an abort of the transfer on to all threads sending mails of a queue
+static void AbortSendMailThreads(struct SendMailQueue *queue)
+{
+  int i;
+
+  ENTER();
+
+  LockMailTransferList(queue->transferList);
+
+  queue->aborted = TRUE;
+
+  for(i = 0; i < SMTP_MAX_CONNECTIONS; i++)
+  {
+    struct SendMailThread *smt = &queue->threads[i];
+
+    if(smt->thread != NULL)
+    {
+      // set the connection state to aborted
+      smt->conn->abort = TRUE;
+      smt->conn->error = CONNECTERR_ABORTED;
+
+      AbortThread(smt->thread, FALSE);
+    }
+  }
+
+  UnlockMailTransferList(queue->transferList);
+
+  LEAVE();
+}
+
+///
+/// StartSendMailThreads
+// start additional threads sending the mails of a queue, returns the number
+// of started threads
+static ULONG StartSendMailThreads(struct SendMailQueue *queue)
+{
+  ULONG numThreads;
+  ULONG startedThreads = 0;
+  ULONG i;
+
+  ENTER();
+
+  // there is no point in opening more connections than there are mails
+  // to be sent, so we need a couple of mails for every connection
+  numThreads = MIN((ULONG)queue->msn->smtpConnections, queue->transferList->count / SMTP_MIN_MAILS_PER_CONNECTION);
+  if(numThreads > 0)
+    numThreads--;
+
+  // threads can only be started by the main thread
+  for(i = 0; i < numThreads; i++)
+  {
+    if(PushMethodOnStackWait(G->App, 2, MUIM_YAMApplication_StartSendMailThread, queue) == (IPTR)NULL)
+    {
+      W(DBF_NET, "could only start %ld of %ld sending threads", startedThreads, numThreads);
+      break;
+    }
+
+    startedThreads++;
+  }
+
+  D(DBF_NET, "sending %ld mails over %ld connections", queue->transferList->count, startedThreads+1);
+
+  RETURN(startedThreads);
+  return startedThreads;
+}
+
+///
+/// WaitForSendMailThreads
+// wait until all threads sending mails of a queue ran out of work, an abort
+// of our own connection is passed on to them
+static void WaitForSendMailThreads(struct SendMailQueue *queue, const ULONG startedThreads, struct Connection *conn)
+{
+  BOOL finished;
+
+  ENTER();
+
+  do
+  {
+    LockMailTransferList(queue->transferList);
+    finished = (queue->finishedThreads == startedThreads);
+    UnlockMailTransferList(queue->transferList);
+
+    if(finished == FALSE)
+    {
+      // the TransferControlGroup aborts our connection only
+      if(queue->aborted == FALSE && conn->abort == TRUE)
+      {
+        D(DBF_NET, "passing abort on to the sending threads");
+        AbortSendMailThreads(queue);
+      }
+      else
+        SleepThread();
+    }
+  }
+  while(finished == FALSE);
+
+  LEAVE();
+}
+
 ///
 /// SendMails
 BOOL SendMails(struct UserIdentityNode *uin, struct MailList *mailsToSend, enum SendMailMode mode, const ULONG flags)
@@ -1488,224 +2126,69 @@ BOOL SendMails(struct UserIdentityNode *uin, struct MailList *mailsToSend, enum
                 busy = BusyBegin(BUSY_TEXT);
                 BusyText(busy, tr(MSG_TR_MailTransferTo), msn->hostname);
 
-                D(DBF_NET, "connecting to host '%s' port %ld", msn->hostname, msn->port);
-                if((err = ConnectToHost(tc->conn, tc->msn)) == CONNECTERR_SUCCESS)
+                // If we are "connected" we can proceed with transfering the data
+                if(ConnectToSMTPServer(tc, &err) == TRUE)
                 {
-                  BOOL connected = FALSE;
+                  BOOL failed = FALSE;
 
-                  // first we check whether the user wants to connect to a plain SSLv3 server
-                  // so that we initiate the SSL connection now
-                  if(hasServerSSL(tc->msn) == TRUE)
-                  {
-                    // lets try to establish the SSL connection via AmiSSL
-                    if(MakeSecureConnection(tc->conn) == TRUE)
-                      tc->useTLS = TRUE;
-                    else
-                      err = CONNECTERR_SSLFAILED; // special SSL connection error
-                  }
+                  // set the success to TRUE as everything worked out fine
+                  // until here.
+                  success = TRUE;
 
-                  // first we have to check whether the TCP/IP connection could
-                  // be successfully opened so that we can init the SMTP connection
-                  // and query the SMTP server for its capabilities now.
-                  if(err == CONNECTERR_SUCCESS)
+                  if(isFlagClear(flags, SENDF_TEST_CONNECTION))
                   {
-                    // initialize the SMTP connection which will also
-                    // query the SMTP server for its capabilities
-                    connected = ConnectToSMTP(tc);
-
-                    // Now we have to check whether the user has selected SSL/TLS
-                    // and then we have to initiate the STARTTLS command followed by the TLS negotiation
-                    if(connected == TRUE && hasServerTLS(tc->msn) == TRUE)
-                    {
-                      connected = InitSTARTTLS(tc);
-
-                      // then we have to refresh the SMTPflags and check
-                      // again what features we have after the STARTTLS
-                      if(connected == TRUE)
-                      {
-                        // first we flag this connection as a sucessfull
-                        // TLS session
-                        tc->useTLS = TRUE;
-
-                        // now run the connect SMTP function again
-                        // so that the SMTP server flags will be refreshed
-                        // accordingly.
-                        connected = ConnectToSMTP(tc);
-                      }
-                    }
-
-                    // If the user selected SMTP_AUTH we have to initiate
-                    // a AUTH connection
-                    if(connected == TRUE && hasServerAuth(tc->msn) == TRUE)
-                      connected = InitSMTPAUTH(tc);
+                    struct SendMailQueue queue;
+                    ULONG startedThreads;
+
+                    memset(&queue, 0, sizeof(queue));
+                    queue.transferList = transferList;
+                    queue.nextNode = FirstMailTransferNode(transferList);
+                    queue.uin = tc->uin;
+                    queue.msn = tc->msn;
+                    queue.outFolder = tc->outFolder;
+                    queue.sentFolder = tc->sentFolder;
+                    queue.sentMailFilters = sentMailFilters;
+                    queue.transferGroup = tc->transferGroup;
+                    queue.ownerThread = CurrentThread();
+
+                    tc->queue = &queue;
+
+                    // open additional connections for larger amounts of
+                    // mails, all connections take their mails from the same queue
+                    startedThreads = StartSendMailThreads(&queue);
+                    tc->sharedProgress = (startedThreads > 0);
+
+                    SendQueuedMailsOverConnection(tc);
+
+                    if(startedThreads > 0)
+                      WaitForSendMailThreads(&queue, startedThreads, tc->conn);
+
+                    failed = queue.failed;
+                    tc->queue = NULL;
                   }
 
-                  // If we are still "connected" we can proceed with transfering the data
-                  if(connected == TRUE)
-                  {
-                    struct MailTransferNode *tn;
-
-                    // set the success to TRUE as everything worked out fine
-                    // until here.
-                    success = TRUE;
-                    AppendToLogfile(LF_VERBOSE, 41, tr(MSG_LOG_ConnectSMTP), msn->hostname);
-
-                    if(isFlagClear(flags, SENDF_TEST_CONNECTION))
-                    {
-                      ForEachMailTransferNode(transferList, tn)
-                      {
-                        struct Mail *mail = tn->mail;
-
-                        if(tc->conn->abort == TRUE || tc->conn->error != CONNECTERR_NO_ERROR)
-                          break;
-
-                        PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tn->index, -1, mail->Size, tr(MSG_TR_Sending));
-
-                        switch(SendMessage(tc, mail))
-                        {
-                          // -1 means that SendMessage was aborted within the
-                          // DATA part and so we cannot issue a RSET command and have to abort
-                          // immediatly by leaving the mailserver alone.
-                          case -1:
-                          {
-                            setStatusToError(mail);
-                            tc->conn->error = CONNECTERR_UNKNOWN_ERROR;
-                          }
-                          break;
-
-                          // 0 means that an error occured before the DATA part and
-                          // so we can abort the transaction cleanly by a RSET and QUIT
-                          case 0:
-                          {
-                            setStatusToError(mail);
-                            SendSMTPCommand(tc, SMTP_RSET, NULL, NULL); // no error check
-                            tc->conn->error = CONNECTERR_NO_ERROR;
-                          }
-                          break;
-
-                          // 1 means we filter the mails and then copy/move the mail to the send folder
-                          case 1:
-                          {
-                            setStatusToSent(mail);
-                            if(PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_FilterMail, sentMailFilters, mail) == TRUE)
-                            {
-                              // the filter process did not move the mail, hence we do it now
-                              PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_MoveCopyMail, mail, tc->sentFolder, "sent mail", MVCPF_CLOSE_WINDOWS);
-                            }
-                            else
-                            {
-                              // update the Outgoing folder's stats as the mail just got (re)moved
-                              PushMethodOnStack(G->App, 3, MUIM_YAMApplication_DisplayStatistics, tc->outFolder, TRUE);
-                            }
-                          }
-                          break;
-
-                          // 2 means we filter and delete afterwards
-                          case 2:
-                          {
-                            setStatusToSent(mail);
-                            if(PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_FilterMail, sentMailFilters, mail) == TRUE)
-                            {
-                              // the filter process did not delete the mail, hence we do it now
-                              PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_DeleteMail, mail, DELF_UPDATE_APPICON);
-                            }
-                          }
-                          break;
-                        }
-                      }
-                    }
-
-                    PushMethodOnStack(tc->transferGroup, 1, MUIM_TransferControlGroup_Finish);
-
-                    if(tc->conn->error == CONNECTERR_NO_ERROR)
-                      AppendToLogfile(LF_NORMAL, 40, tr(MSG_LOG_Sending), transferList->count, msn->hostname);
-                    else
-                      AppendToLogfile(LF_NORMAL, 40, tr(MSG_LOG_SENDING_FAILED), transferList->count, msn->hostname);
-
-                    // now we can disconnect from the SMTP
-                    // server again
-                    PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_Disconnecting));
-
-                    // send a 'QUIT' command, but only if
-                    // we didn't receive any error during the transfer
-                    if(tc->conn->error == CONNECTERR_NO_ERROR)
-                      SendSMTPCommand(tc, SMTP_QUIT, NULL, tr(MSG_ER_BADRESPONSE_SMTP));
-                  }
+                  PushMethodOnStack(tc->transferGroup, 1, MUIM_TransferControlGroup_Finish);
+
+                  if(tc->conn->error == CONNECTERR_NO_ERROR && failed == FALSE)
+                    AppendToLogfile(LF_NORMAL, 40, tr(MSG_LOG_Sending), transferList->count, msn->hostname);
                   else
-                  {
-                    // check if we end up here cause of the 8BITMIME differences
-                    if(has8BITMIME(tc->msn->smtpFlags) == FALSE && hasServer8bit(tc->msn) == TRUE)
-                    {
-                      W(DBF_NET, "incorrect Allow8bit setting!");
-                      err = CONNECTERR_INVALID8BIT;
-                    }
-                    else if(err != CONNECTERR_SSLFAILED)
-                      err = CONNECTERR_UNKNOWN_ERROR;
-                  }
+                    AppendToLogfile(LF_NORMAL, 40, tr(MSG_LOG_SENDING_FAILED), transferList->count, msn->hostname);
+
+                  // now we can disconnect from the SMTP
+                  // server again
+                  PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_Disconnecting));
+
+                  // send a 'QUIT' command, but only if
+                  // we didn't receive any error during the transfer
+                  if(tc->conn->error == CONNECTERR_NO_ERROR)
+                    SendSMTPCommand(tc, SMTP_QUIT, NULL, tr(MSG_ER_BADRESPONSE_SMTP));
                 }
 
                 // make sure to shutdown the socket and all possible SSL connection stuff
                 DisconnectFromHost(tc->conn);
 
                 // if we got an error here, let's throw it
-                switch(err)
-                {
-                  case CONNECTERR_SUCCESS:
-                  case CONNECTERR_ABORTED:
-                  case CONNECTERR_NO_ERROR:
-                    // do nothing
-                  break;
-
-                  // a socket is already in use so we return
-                  // a specific error to the user
-                  case CONNECTERR_SOCKET_IN_USE:
-                    ER_NewError(tr(MSG_ER_CONNECTERR_SOCKET_IN_USE_SMTP), msn->hostname);
-                  break;
-
-                  // socket() execution failed
-                  case CONNECTERR_NO_SOCKET:
-                    ER_NewError(tr(MSG_ER_CONNECTERR_NO_SOCKET_SMTP), msn->hostname);
-                  break;
-
-                  // couldn't establish non-blocking IO
-                  case CONNECTERR_NO_NONBLOCKIO:
-                    ER_NewError(tr(MSG_ER_CONNECTERR_NO_NONBLOCKIO_SMTP), msn->hostname);
-                  break;
-
-                  // the specified hostname isn't valid, so
-                  // lets tell the user
-                  case CONNECTERR_UNKNOWN_HOST:
-                    ER_NewError(tr(MSG_ER_UNKNOWN_HOST_SMTP), msn->hostname);
-                  break;
-
-                  // the connection request timed out, so tell
-                  // the user
-                  case CONNECTERR_TIMEDOUT:
-                    ER_NewError(tr(MSG_ER_CONNECTERR_TIMEDOUT_SMTP), msn->hostname);
-                  break;
-
-                  // an error occurred while checking for 8bit MIME
-                  // compatibility
-                  case CONNECTERR_INVALID8BIT:
-                    ER_NewError(tr(MSG_ER_NO8BITMIME_SMTP), msn->hostname);
-                  break;
-
-                  // error during initialization of an SSL connection
-                  case CONNECTERR_SSLFAILED:
-                    ER_NewError(tr(MSG_ER_INITTLS_SMTP), msn->hostname);
-                  break;
-
-                  // an unknown error occurred so lets show
-                  // a generic error message
-                  case CONNECTERR_UNKNOWN_ERROR:
-                    ER_NewError(tr(MSG_ER_CANNOT_CONNECT_SMTP), msn->hostname);
-                  break;
-
-                  case CONNECTERR_NO_CONNECTION:
-                  case CONNECTERR_NOT_CONNECTED:
-                    // cannot happen, do nothing
-                  break;
-                }
+                ReportConnectError(msn, err);
 
                 BusyEnd(busy);
 
@@ -30,6 +30,7 @@
 
 // forward declarations
 struct MailList;
+struct SendMailQueue;
 struct UserIdentityNode;
 
 enum SendMailMode
@@ -45,6 +46,7 @@ enum SendMailMode
 
 // prototypes
 BOOL SendMails(struct UserIdentityNode *uin, struct MailList *mailsToSend, enum SendMailMode mode, const ULONG flags);
+LONG SendQueuedMails(struct SendMailQueue *queue);
 void CleanMailsInTransfer(const struct MailList *mlist);
 
 #endif /* SMTP_H */
@@ -0,0 +1,489 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2022 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+
+// A small host side benchmark for the base64 and quoted-printable kernels
+// in mime/mimecodec.c. It compares the kernels against the char by char
+// loops YAM used before and verifies that both produce the same output.
+// The base64 encoder is additionally checked for all lengths of a final
+// incomplete group and line around every line break position and its
+// output must decode back to the original data.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mime/mimecodec.h"
+
+#define DATA_SIZE   (4*1024*1024) // size of the test data
+#define CHUNK_SIZE  4096          // same buffer size as the stream functions
+#define ITERATIONS  20
+#define ENC_CHUNK   4095          // encoding buffer size of base64encode_file()
+#define CHECK_SIZE  (3*BASE64ENC_LINELEN) // largest input of the encoder checks
+
+static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/// elapsed()
+// returns the seconds since 'start'
+static double elapsed(clock_t start)
+{
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+///
+/// ref_base64decode()
+// the previous decoding loop: strip all whitespace and decode one char at
+// a time with a range check for each char
+static size_t ref_base64decode(unsigned char *dst, const unsigned char *src, size_t srclen)
+{
+  unsigned char *dptr = dst;
+  unsigned long bits = 0;
+  int count = 0;
+  size_t i;
+
+  for(i = 0; i < srclen; i++)
+  {
+    const char *p;
+    int c = src[i];
+
+    if(isspace(c))
+      continue;
+
+    if(c == '=')
+      break;
+
+    if(c > 127 || (p = strchr(digits, c)) == NULL)
+      continue;
+
+    bits = (bits << 6) | (p - digits);
+    if(++count == 4)
+    {
+      *dptr++ = (bits >> 16) & 0xff;
+      *dptr++ = (bits >> 8) & 0xff;
+      *dptr++ = bits & 0xff;
+      bits = 0;
+      count = 0;
+    }
+  }
+
+  if(count == 2)
+    *dptr++ = (bits >> 4) & 0xff;
+  else if(count == 3)
+  {
+    *dptr++ = (bits >> 10) & 0xff;
+    *dptr++ = (bits >> 2) & 0xff;
+  }
+
+  return dptr - dst;
+}
+
+///
+/// ref_base64encode()
+// the previous encoding loop: encode everything in one go and split the
+// result into lines of 72 chars afterwards
+static size_t ref_base64encode(char *dst, const unsigned char *src, size_t srclen)
+{
+  char *tmp = malloc(BASE64ENC_MAXOUT(srclen) + 1);
+  size_t len = 0;
+
+  if(tmp != NULL)
+  {
+    char *tptr = tmp;
+    size_t tmplen;
+    size_t i;
+
+    for(; srclen >= 3; srclen -= 3)
+    {
+      *tptr++ = digits[src[0] >> 2];
+      *tptr++ = digits[((src[0] << 4) & 0x30) | (src[1] >> 4)];
+      *tptr++ = digits[((src[1] << 2) & 0x3c) | (src[2] >> 6)];
+      *tptr++ = digits[src[2] & 0x3f];
+      src += 3;
+    }
+
+    if(srclen > 0)
+    {
+      unsigned char c1 = srclen > 1 ? src[1] : 0;
+
+      *tptr++ = digits[src[0] >> 2];
+      *tptr++ = digits[((src[0] << 4) & 0x30) | (c1 >> 4)];
+      *tptr++ = srclen > 1 ? digits[(c1 << 2) & 0x3c] : '=';
+      *tptr++ = '=';
+    }
+
+    tmplen = tptr - tmp;
+    for(i = 0; i < tmplen; i += BASE64ENC_LINELEN)
+    {
+      size_t n = tmplen - i < BASE64ENC_LINELEN ? tmplen - i : BASE64ENC_LINELEN;
+
+      if(i > 0)
+        dst[len++] = '\n';
+
+      memcpy(&dst[len], &tmp[i], n);
+      len += n;
+    }
+
+    free(tmp);
+  }
+
+  return len;
+}
+
+///
+/// kernel_base64encode()
+// encodes like base64encode_file() does in chunks of 'chunk' bytes, which
+// must be a multiple of 3
+static size_t kernel_base64encode(char *dst, const unsigned char *src, size_t srclen, size_t chunk)
+{
+  size_t len = 0;
+  size_t pos;
+  int column = 0;
+
+  for(pos = 0; pos < srclen; pos += chunk)
+    len += base64encode_lines(&dst[len], &src[pos], srclen - pos < chunk ? srclen - pos : chunk, &column);
+
+  return len;
+}
+
+///
+/// hexval()
+static int hexval(int c)
+{
+  if(c >= '0' && c <= '9')
+    return c - '0';
+  if(c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if(c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+
+  return -1;
+}
+
+///
+/// ref_qpdecode()
+// the previous decoding loop which handles one char at a time
+static size_t ref_qpdecode(unsigned char *dst, const unsigned char *src, size_t srclen)
+{
+  unsigned char *dptr = dst;
+  size_t i = 0;
+
+  while(i < srclen)
+  {
+    unsigned char c = src[i++];
+
+    if(c == '=')
+    {
+      if(i < srclen && src[i] == '\n')
+        i++;
+      else if(i+1 < srclen && hexval(src[i]) >= 0 && hexval(src[i+1]) >= 0)
+      {
+        *dptr++ = (hexval(src[i]) << 4) | hexval(src[i+1]);
+        i += 2;
+      }
+      else
+        *dptr++ = c;
+    }
+    else if(c > 127 || (c == '\r' && (i == srclen || src[i] != '\n')))
+      continue;
+    else
+      *dptr++ = c;
+  }
+
+  return dptr - dst;
+}
+
+///
+/// make_base64()
+// encodes random binary data to base64 with lines of 72 chars
+static size_t make_base64(unsigned char *dst, const unsigned char *src, size_t srclen)
+{
+  size_t len = 0;
+  size_t i;
+
+  for(i = 0; i < srclen; i += 54)
+  {
+    size_t n = srclen - i < 54 ? srclen - i : 54;
+
+    len += base64encode_block((char *)&dst[len], &src[i], n);
+    dst[len++] = '\n';
+  }
+
+  return len;
+}
+
+///
+/// make_qp()
+// creates quoted-printable encoded text with mostly plain chars, some
+// encoded 8bit chars and soft line breaks
+static size_t make_qp(unsigned char *dst, size_t maxlen)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  size_t len = 0;
+  int column = 0;
+
+  while(len < maxlen - 8)
+  {
+    int r = rand() % 100;
+
+    if(r < 5)
+    {
+      int c = 128 + rand() % 128;
+
+      dst[len++] = '=';
+      dst[len++] = hex[c >> 4];
+      dst[len++] = hex[c & 15];
+      column += 3;
+    }
+    else if(r < 20)
+      dst[len++] = ' ';
+    else
+      dst[len++] = 'a' + rand() % 26;
+
+    if(++column >= 72)
+    {
+      if(rand() % 2)
+        dst[len++] = '=';
+      dst[len++] = '\n';
+      column = 0;
+    }
+  }
+
+  return len;
+}
+
+///
+/// bench_base64()
+static int bench_base64(const unsigned char *src, size_t srclen, unsigned char *ref, unsigned char *out)
+{
+  size_t reflen = 0;
+  size_t outlen = 0;
+  clock_t start;
+  double t;
+  int i;
+
+  start = clock();
+  for(i = 0; i < ITERATIONS; i++)
+    reflen = ref_base64decode(ref, src, srclen);
+  t = elapsed(start);
+  printf("base64 decode, reference: %8.1f MB/s\n", srclen * ITERATIONS / t / 1048576.0);
+
+  start = clock();
+  for(i = 0; i < ITERATIONS; i++)
+  {
+    struct Base64Decoder dec;
+    size_t pos;
+
+    // decode in the same chunk sizes as the stream functions do
+    base64decode_init(&dec);
+    outlen = 0;
+    for(pos = 0; pos < srclen; pos += CHUNK_SIZE)
+      outlen += base64decode_block(&dec, &out[outlen], &src[pos], srclen - pos < CHUNK_SIZE ? srclen - pos : CHUNK_SIZE);
+    outlen += base64decode_finish(&dec, &out[outlen]);
+  }
+  t = elapsed(start);
+  printf("base64 decode, kernel:    %8.1f MB/s\n", srclen * ITERATIONS / t / 1048576.0);
+
+  return reflen == outlen && memcmp(ref, out, outlen) == 0;
+}
+
+///
+/// bench_base64encode()
+static int bench_base64encode(const unsigned char *src, size_t srclen, char *ref, char *out)
+{
+  size_t reflen = 0;
+  size_t outlen = 0;
+  clock_t start;
+  double t;
+  int i;
+
+  start = clock();
+  for(i = 0; i < ITERATIONS; i++)
+    reflen = ref_base64encode(ref, src, srclen);
+  t = elapsed(start);
+  printf("base64 encode, reference: %8.1f MB/s\n", srclen * ITERATIONS / t / 1048576.0);
+
+  start = clock();
+  for(i = 0; i < ITERATIONS; i++)
+    outlen = kernel_base64encode(out, src, srclen, ENC_CHUNK);
+  t = elapsed(start);
+  printf("base64 encode, kernel:    %8.1f MB/s\n", srclen * ITERATIONS / t / 1048576.0);
+
+  return reflen == outlen && memcmp(ref, out, outlen) == 0;
+}
+
+///
+/// roundtrip_base64()
+// decodes base64 data and compares the result with the original data
+static int roundtrip_base64(const char *src, size_t srclen, const unsigned char *orig, size_t origlen, unsigned char *out)
+{
+  struct Base64Decoder dec;
+  size_t outlen;
+
+  base64decode_init(&dec);
+  outlen = base64decode_block(&dec, out, (const unsigned char *)src, srclen);
+  outlen += base64decode_finish(&dec, &out[outlen]);
+
+  return dec.invalid == 0 && outlen == origlen && memcmp(out, orig, outlen) == 0;
+}
+
+///
+/// check_base64encode()
+// encodes all lengths up to CHECK_SIZE bytes, which covers both kinds of
+// final incomplete groups at and around each line break, with several
+// chunk sizes and compares the output with the reference encoder
+static int check_base64encode(const unsigned char *src, char *ref, char *out, unsigned char *dec)
+{
+  static const size_t chunks[] = { 3, 51, 54, 57, ENC_CHUNK };
+  size_t len;
+  int ok = 1;
+
+  for(len = 0; len <= CHECK_SIZE; len++)
+  {
+    size_t reflen = ref_base64encode(ref, src, len);
+    size_t i;
+
+    for(i = 0; i < sizeof(chunks)/sizeof(chunks[0]); i++)
+    {
+      size_t outlen = kernel_base64encode(out, src, len, chunks[i]);
+
+      if(outlen != reflen || memcmp(out, ref, outlen) != 0)
+      {
+        printf("base64 encode: %lu bytes in chunks of %lu differ from reference\n", (unsigned long)len, (unsigned long)chunks[i]);
+        ok = 0;
+      }
+      else if(roundtrip_base64(out, outlen, src, len, dec) == 0)
+      {
+        printf("base64 encode: %lu bytes in chunks of %lu don't decode to the input\n", (unsigned long)len, (unsigned long)chunks[i]);
+        ok = 0;
+      }
+    }
+  }
+
+  return ok;
+}
+
+///
+/// bench_qp()
+static int bench_qp(const unsigned char *src, size_t srclen, unsigned char *ref, unsigned char *out)
+{
+  size_t reflen = 0;
+  size_t outlen = 0;
+  clock_t start;
+  double t;
+  int i;
+
+  start = clock();
+  for(i = 0; i < ITERATIONS; i++)
+    reflen = ref_qpdecode(ref, src, srclen);
+  t = elapsed(start);
+  printf("qp decode, reference:     %8.1f MB/s\n", srclen * ITERATIONS / t / 1048576.0);
+
+  start = clock();
+  for(i = 0; i < ITERATIONS; i++)
+  {
+    size_t pos = 0;
+    int warning = 0;
+
+    // decode in the same chunk sizes as the stream functions do,
+    // incomplete sequences are passed on to the next chunk
+    outlen = 0;
+    while(pos < srclen)
+    {
+      size_t len = srclen - pos < CHUNK_SIZE ? srclen - pos : CHUNK_SIZE;
+      size_t consumed;
+
+      outlen += qpdecode_block(&out[outlen], &src[pos], len, &consumed, pos + len == srclen, &warning);
+      pos += consumed;
+    }
+  }
+  t = elapsed(start);
+  printf("qp decode, kernel:        %8.1f MB/s\n", srclen * ITERATIONS / t / 1048576.0);
+
+  return reflen == outlen && memcmp(ref, out, outlen) == 0;
+}
+
+///
+/// main()
+int main(void)
+{
+  unsigned char *raw = malloc(DATA_SIZE);
+  unsigned char *enc = malloc(BASE64ENC_MAXLINES(DATA_SIZE));
+  char *encref = malloc(BASE64ENC_MAXLINES(DATA_SIZE));
+  unsigned char *ref = malloc(DATA_SIZE + 3);
+  unsigned char *out = malloc(DATA_SIZE + 3);
+  int result = EXIT_FAILURE;
+
+  if(raw != NULL && enc != NULL && encref != NULL && ref != NULL && out != NULL)
+  {
+    size_t len;
+    size_t i;
+    int ok = 1;
+
+    srand(42);
+    for(i = 0; i < DATA_SIZE; i++)
+      raw[i] = rand() & 0xff;
+
+    if(check_base64encode(raw, encref, (char *)enc, out) == 0)
+      ok = 0;
+
+    if(bench_base64encode(raw, DATA_SIZE, encref, (char *)enc) == 0 ||
+       roundtrip_base64((char *)enc, kernel_base64encode((char *)enc, raw, DATA_SIZE, ENC_CHUNK), raw, DATA_SIZE, out) == 0)
+    {
+      printf("base64 encode: output mismatch\n");
+      ok = 0;
+    }
+
+    len = make_base64(enc, raw, DATA_SIZE);
+    if(bench_base64(enc, len, ref, out) == 0 || memcmp(out, raw, DATA_SIZE) != 0)
+    {
+      printf("base64 decode: output mismatch\n");
+      ok = 0;
+    }
+
+    len = make_qp(enc, DATA_SIZE);
+    if(bench_qp(enc, len, ref, out) == 0)
+    {
+      printf("qp decode: output mismatch\n");
+      ok = 0;
+    }
+
+    if(ok)
+      result = EXIT_SUCCESS;
+  }
+
+  free(raw);
+  free(enc);
+  free(encref);
+  free(ref);
+  free(out);
+
+  return result;
+}
+
+///